@@ -37,6 +37,7 @@ void *parseAttributes(uint16_t length, attribute_info_t **attributes, class_t *c
             if(!attr->code)
                 goto fail2;
             memcpy(attr->code, classData, attr->codeLength);
+            atomic_init(&attr->translatedCode, NULL);
             classData += attr->codeLength;
             attr->exceptionTableLength = readu2(classData);
             classData += 2;
@@ -3,60 +3,1080 @@
 //
 
 #include "bytecode_interpreter.h"
+#include "bytecode_translator.h"
 #include "mm.h"
 #include "opcodes.h"
 #include "gc.h"
 #include "flags.h"
 #include "utils.h"
 #include "classloader.h"
+#ifdef BASELINE_JIT
+#include "jit.h"
+#endif
+#include "monitor.h"
 #include <math.h>
 #include <string.h>
 #include <stdio.h>
+#include <inttypes.h>
+
+#ifdef INLINE_CACHE_STATISTICS
+atomic_size_t inlineCacheHits;
+atomic_size_t inlineCacheMisses;
+atomic_size_t megamorphicLookups;
+#define COUNT(counter) atomic_fetch_add_explicit(&(counter), 1, memory_order_relaxed)
+
+void printInlineCacheStatistics() {
+    printf("Inline cache hits: %zu\nInline cache misses: %zu\nMegamorphic lookups: %zu\n", atomic_load(&inlineCacheHits), atomic_load(&inlineCacheMisses), atomic_load(&megamorphicLookups));
+}
+#else
+#define COUNT(counter)
+#endif
+
+#ifdef OPCODE_PROFILING
+// number of entries in each list printed by printOpcodeProfile
+#define PROFILE_TOP_ENTRIES 20
+// triples are counted in an open addressing hash table since a dense table would be too large. Triples that don't fit are dropped
+#define TRIPLE_TABLE_SIZE 65536
+
+// executions of each pair of instructions where the second instruction directly followed the first in the code
+static atomic_ulong pairCounts[NUM_OPCODES][NUM_OPCODES];
+static struct {
+    atomic_uint key; // 0 for unused entries
+    atomic_ulong count;
+} tripleCounts[TRIPLE_TABLE_SIZE];
+
+// the last two instructions executed by each thread
+static _Thread_local uint16_t previousOpcodes[2];
+static _Thread_local code_word_t *previousNextPC; // the word following the last instruction
+static _Thread_local bool previousWasSequential; // whether the last instruction directly followed the one before it
+
+static void countTriple(uint32_t key) {
+    for(uint32_t i = 0; i < TRIPLE_TABLE_SIZE; ++i) {
+        uint32_t index = (key * 2654435761u + i) % TRIPLE_TABLE_SIZE;
+        uint32_t entryKey = atomic_load_explicit(&tripleCounts[index].key, memory_order_relaxed);
+        if(entryKey == 0 && atomic_compare_exchange_strong(&tripleCounts[index].key, &entryKey, key))
+            entryKey = key;
+        if(entryKey == key) {
+            atomic_fetch_add_explicit(&tripleCounts[index].count, 1, memory_order_relaxed);
+            return;
+        }
+    }
+}
+
+/**
+ * Counts the instruction at pc along with the one or two instructions executed before it if they directly precede it in
+ * the code. Sequences that are interrupted by a branch, call, or return can't be combined into superinstructions so they
+ * aren't counted.
+ * @param method the method being executed
+ * @param pc
+ */
+void profileInstruction(method_t *method, code_word_t *pc) {
+    translated_code_t *translatedCode = getTranslatedCode(method);
+    uint32_t wordIndex = pc - translatedCode->code;
+    uint16_t opcode = canonicalOpcode(translatedCode->opcodes[wordIndex]);
+    uint32_t numWords;
+    instructionSize(method->codeAttribute->code, translatedCode->bytecodeOffsets[wordIndex], method->codeAttribute->codeLength, &numWords);
+
+    bool sequential = pc == previousNextPC;
+    if(sequential) {
+        atomic_fetch_add_explicit(&pairCounts[previousOpcodes[0]][opcode], 1, memory_order_relaxed);
+        if(previousWasSequential)
+            countTriple(((uint32_t) previousOpcodes[1] * NUM_OPCODES + previousOpcodes[0]) * NUM_OPCODES + opcode + 1);
+    }
+    previousOpcodes[1] = previousOpcodes[0];
+    previousOpcodes[0] = opcode;
+    previousNextPC = pc + numWords;
+    previousWasSequential = sequential;
+}
+
+/**
+ * Inserts an entry into a list of the entries with the highest counts sorted from highest to lowest
+ */
+static void insertTopEntry(uint64_t *topCounts, uint32_t *topKeys, uint64_t count, uint32_t key) {
+    if(count <= topCounts[PROFILE_TOP_ENTRIES - 1])
+        return;
+    int i = PROFILE_TOP_ENTRIES - 1;
+    for(; i > 0 && topCounts[i - 1] < count; --i) {
+        topCounts[i] = topCounts[i - 1];
+        topKeys[i] = topKeys[i - 1];
+    }
+    topCounts[i] = count;
+    topKeys[i] = key;
+}
 
+void printOpcodeProfile() {
+    uint64_t topCounts[PROFILE_TOP_ENTRIES] = {0};
+    uint32_t topKeys[PROFILE_TOP_ENTRIES];
+    for(uint32_t first = 0; first < NUM_OPCODES; ++first) {
+        for(uint32_t second = 0; second < NUM_OPCODES; ++second)
+            insertTopEntry(topCounts, topKeys, atomic_load(&pairCounts[first][second]), first * NUM_OPCODES + second);
+    }
+    printf("Most executed instruction pairs:\n");
+    for(int i = 0; i < PROFILE_TOP_ENTRIES && topCounts[i]; ++i)
+        printf("%s %s: %" PRIu64 "\n", instr_names[topKeys[i] / NUM_OPCODES], instr_names[topKeys[i] % NUM_OPCODES], topCounts[i]);
+
+    memset(topCounts, 0, sizeof(topCounts));
+    for(uint32_t i = 0; i < TRIPLE_TABLE_SIZE; ++i) {
+        uint32_t key = atomic_load(&tripleCounts[i].key);
+        if(key)
+            insertTopEntry(topCounts, topKeys, atomic_load(&tripleCounts[i].count), key - 1);
+    }
+    printf("Most executed instruction triples:\n");
+    for(int i = 0; i < PROFILE_TOP_ENTRIES && topCounts[i]; ++i) {
+        uint32_t key = topKeys[i];
+        printf("%s %s %s: %" PRIu64 "\n", instr_names[key / NUM_OPCODES / NUM_OPCODES], instr_names[key / NUM_OPCODES % NUM_OPCODES], instr_names[key % NUM_OPCODES], topCounts[i]);
+    }
+}
+#endif
+
+/**
+ *
+ * @param cache
+ * @param class the class of the receiver
+ * @return the method cached for the class or NULL if the class isn't in the cache
+ */
+static inline method_t *findInInlineCache(inline_cache_t *cache, class_t *class) {
+    for(int i = 0; i < INLINE_CACHE_SIZE; ++i) {
+        if(atomic_load_explicit(&cache->entries[i].class, memory_order_acquire) == class) {
+            COUNT(inlineCacheHits);
+            return cache->entries[i].method;
+        }
+    }
+    return NULL;
+}
+
+// stores of references run the write barrier, which is passed as the barrier argument of the store instructions
+#define NO_WRITE_BARRIER(jthread, field)
+
+#ifdef DIRECT_THREADED_INTERPRETER
+
+// set by run(NULL) since the addresses of labels can't be taken outside of the function they're in
+static const void *const *dispatchTableAddress;
+
+// translated instructions start with the address of the label implementing them
+#ifdef OPCODE_PROFILING
+#define DISPATCH() do { profileInstruction(frame->currentMethod, pc); goto *pc->label; } while(0)
+#else
+#define DISPATCH() goto *pc->label
+#endif
+#define NEXT(length) do { pc += (length); DISPATCH(); } while(0)
+
+// copies the cached interpreter state back into the thread so that out of line handlers and the gc can see it
+#define SYNC_STATE() do { jthread->pc = pc; frame->topOfStack = tos; } while(0)
+#define LOAD_STATE() do { \
+        frame = jthread->currentStackFrame; \
+        pc = jthread->pc; \
+        locals = frame->localVariableBase; \
+        stack = frame->operandStackBase; \
+        tos = frame->topOfStack; \
+    } while(0)
+
+// only taken branches, method entries, and returns are safepoints. Every loop contains a taken branch
+#define POLL() do { SYNC_STATE(); SAFEPOINT_POLL(); JIT_POLL(); } while(0)
+
+#ifdef BASELINE_JIT
+// taken branches and method entries also count towards compiling the method and switch to its compiled code once it exists
+#define JIT_POLL() do { if(frame->compiledCode || countHotness(frame)) goto op_compiled; } while(0)
+#else
+#define JIT_POLL() do {} while(0)
+#endif
+
+// the garbage collector finds references on the stack with stack maps, so the types of operands aren't stored
+#define PUSH(value) (stack[tos++] = (value))
+#define PUSH2(value) do { *(double_cell_t *) (stack + tos) = (value); tos += 2; } while(0)
+#define POP() (stack[--tos])
+#define POP2() (*(double_cell_t *) (stack + (tos -= 2)))
+#define TOP2(index) (*(double_cell_t *) (stack + tos - 2 - (index)))
+#define MOVE_SLOT(to, from) (stack[to] = stack[from])
+
+#define CONST_INSTR(name, field, value) op_##name: { cell_t cell = {.field = (value)}; PUSH(cell); NEXT(1); }
+#define CONST2_INSTR(name, field, value) op_##name: { double_cell_t cell = {.field = (value)}; PUSH2(cell); NEXT(1); }
+#define LOAD_INSTR(name, index, length) op_##name: PUSH(locals[index]); NEXT(length);
+#define LOAD2_INSTR(name, index, length) op_##name: PUSH2(*(double_cell_t *) (locals + (index))); NEXT(length);
+#define STORE_INSTR(name, index, length) op_##name: locals[index] = POP(); NEXT(length);
+#define STORE2_INSTR(name, index, length) op_##name: *(double_cell_t *) (locals + (index)) = POP2(); NEXT(length);
+#define BINARY_INSTR(name, field, op) op_##name: stack[tos - 2].field = stack[tos - 2].field op stack[tos - 1].field; --tos; NEXT(1);
+#define BINARY2_INSTR(name, field, op) op_##name: TOP2(2).field = TOP2(2).field op TOP2(0).field; tos -= 2; NEXT(1);
+#define UNARY_INSTR(name, field, op) op_##name: stack[tos - 1].field = op stack[tos - 1].field; NEXT(1);
+#define UNARY2_INSTR(name, field, op) op_##name: TOP2(0).field = op TOP2(0).field; NEXT(1);
+#define CONVERT_INSTR(name, fromField, toField, cast) op_##name: { cell_t cell = {.toField = (cast) stack[tos - 1].fromField}; stack[tos - 1] = cell; NEXT(1); }
+// null objects are left to the out of line handlers which throw the NullPointerException
+#define GETSTATIC_QUICK_INSTR(name, dataType, field) op_##name: { cell_t cell = {.field = *(dataType *) pc[2].ptr}; PUSH(cell); NEXT(3); }
+#define GETSTATIC2_QUICK_INSTR(name, dataType, field) op_##name: { double_cell_t cell = {.field = *(dataType *) pc[2].ptr}; PUSH2(cell); NEXT(3); }
+#define PUTSTATIC_QUICK_INSTR(name, dataType, field, barrier) op_##name: barrier(jthread, pc[2].ptr); *(dataType *) pc[2].ptr = POP().field; NEXT(3);
+#define PUTSTATIC2_QUICK_INSTR(name, dataType, field) op_##name: *(dataType *) pc[2].ptr = POP2().field; NEXT(3);
+#define GETFIELD_QUICK_INSTR(name, dataType, field) op_##name: { \
+        object_t *obj = getObject(stack[tos - 1].a); \
+        if(!obj) \
+            goto op_slow; \
+        stack[tos - 1].field = *(dataType *) ((void *) obj + pc[2].u); \
+        NEXT(3); \
+    }
+#define GETFIELD2_QUICK_INSTR(name, dataType, field) op_##name: { \
+        object_t *obj = getObject(stack[tos - 1].a); \
+        if(!obj) \
+            goto op_slow; \
+        double_cell_t cell = {.field = *(dataType *) ((void *) obj + pc[2].u)}; \
+        --tos; \
+        PUSH2(cell); \
+        NEXT(3); \
+    }
+#define PUTFIELD_QUICK_INSTR(name, dataType, field, barrier) op_##name: { \
+        object_t *obj = getObject(stack[tos - 2].a); \
+        if(!obj) \
+            goto op_slow; \
+        barrier(jthread, (void *) obj + pc[2].u); \
+        *(dataType *) ((void *) obj + pc[2].u) = stack[tos - 1].field; \
+        tos -= 2; \
+        NEXT(3); \
+    }
+#define PUTFIELD2_QUICK_INSTR(name, dataType, field) op_##name: { \
+        object_t *obj = getObject(stack[tos - 3].a); \
+        if(!obj) \
+            goto op_slow; \
+        *(dataType *) ((void *) obj + pc[2].u) = TOP2(0).field; \
+        tos -= 3; \
+        NEXT(3); \
+    }
+// NaN compares as the given result. This is the only difference between the l and g variants
+#define COMPARE_INSTR(name, cellType, field, pop, nanResult) op_##name: { \
+        cellType top = pop(); \
+        cellType next = pop(); \
+        cell_t result; \
+        if(isnan(top.field) || isnan(next.field)) \
+            result.i = (nanResult); \
+        else \
+            result.i = next.field > top.field ? 1 : (next.field < top.field ? -1 : 0); \
+        PUSH(result); \
+        NEXT(1); \
+    }
+#define BRANCH_INSTR(name, condition, numPopped) op_##name: { \
+        tos -= (numPopped); \
+        if(condition) { \
+            pc = pc[1].target; \
+            POLL(); \
+            DISPATCH(); \
+        } \
+        NEXT(2); \
+    }
+// out of range indices and null arrays are left to the out of line handlers which throw the exception
+#define ARRAY_LOAD_INSTR(name, elementType, field) op_##name: { \
+        object_t *array = getObject(stack[tos - 2].a); \
+        int32_t index = stack[tos - 1].i; \
+        if(!array || index < 0 || index >= ARRAY_LENGTH(array)) \
+            goto op_slow; \
+        stack[--tos - 1].field = ((elementType *) ARRAY_ELEMENTS(array))[index]; \
+        NEXT(1); \
+    }
+#define ARRAY_LOAD2_INSTR(name, elementType, field) op_##name: { \
+        object_t *array = getObject(stack[tos - 2].a); \
+        int32_t index = stack[tos - 1].i; \
+        if(!array || index < 0 || index >= ARRAY_LENGTH(array)) \
+            goto op_slow; \
+        tos -= 2; \
+        double_cell_t cell = {.field = ((elementType *) ARRAY_ELEMENTS(array))[index]}; \
+        PUSH2(cell); \
+        NEXT(1); \
+    }
+#define ARRAY_STORE_INSTR(name, elementType, field, barrier) op_##name: { \
+        object_t *array = getObject(stack[tos - 3].a); \
+        int32_t index = stack[tos - 2].i; \
+        if(!array || index < 0 || index >= ARRAY_LENGTH(array)) \
+            goto op_slow; \
+        barrier(jthread, (elementType *) ARRAY_ELEMENTS(array) + index); \
+        ((elementType *) ARRAY_ELEMENTS(array))[index] = stack[tos - 1].field; \
+        tos -= 3; \
+        NEXT(1); \
+    }
+#define ARRAY_STORE2_INSTR(name, elementType, field) op_##name: { \
+        object_t *array = getObject(stack[tos - 4].a); \
+        int32_t index = stack[tos - 3].i; \
+        if(!array || index < 0 || index >= ARRAY_LENGTH(array)) \
+            goto op_slow; \
+        ((elementType *) ARRAY_ELEMENTS(array))[index] = TOP2(0).field; \
+        tos -= 4; \
+        NEXT(1); \
+    }
+// two int loads followed by a compare and branch
+#define LOAD_LOAD_BRANCH_INSTR(name, op) op_##name: \
+        if(locals[pc[1].u].i op locals[pc[3].u].i) { \
+            pc = pc[5].target; \
+            POLL(); \
+            DISPATCH(); \
+        } \
+        NEXT(6);
+// a null object is left to the out of line handler of the getfield after the load is done
+#define LOAD_GETFIELD_QUICK_INSTR(name, dataType, field) op_##name: { \
+        object_t *obj = getObject(locals[pc[1].u].a); \
+        if(!obj) { \
+            PUSH(locals[pc[1].u]); \
+            pc += 2; \
+            goto op_slow; \
+        } \
+        cell_t cell = {.field = *(dataType *) ((void *) obj + pc[4].u)}; \
+        PUSH(cell); \
+        NEXT(5); \
+    }
+// frames are always pushed out of line. Method entry polls for garbage collection so that recursion without loops still reaches a safepoint
+#define INVOKE(method) do { SYNC_STATE(); invokeMethod(interpreter, (method), 3); LOAD_STATE(); POLL(); DISPATCH(); } while(0)
+
+bool invokeMethod(bc_interpreter_t *interpreter, method_t *method, uint16_t instructionLength);
+
+const void *const *getDispatchTable() {
+    if(!dispatchTableAddress)
+        run(NULL);
+    return dispatchTableAddress;
+}
+
+/**
+ * Direct threaded version of the interpreter loop. Simple instructions are executed inline using locally cached copies
+ * of the pc, stack frame, and top of stack. Everything else falls back to the handlers in instr_table.
+ * @param interpreter if NULL, the dispatch table is published for the translator and nothing is executed
+ * @return 0 if the root frame returned normally, otherwise 1
+ */
 int run(bc_interpreter_t *interpreter) {
+    static const void *const dispatchTable[NUM_OPCODES] = {
+        [0 ... NUM_OPCODES - 1] = &&op_slow,
+        [OP_nop] = &&op_nop,
+        [OP_aconst_null] = &&op_aconst_null,
+        [OP_iconst_m1] = &&op_iconst_m1,
+        [OP_iconst_0] = &&op_iconst_0,
+        [OP_iconst_1] = &&op_iconst_1,
+        [OP_iconst_2] = &&op_iconst_2,
+        [OP_iconst_3] = &&op_iconst_3,
+        [OP_iconst_4] = &&op_iconst_4,
+        [OP_iconst_5] = &&op_iconst_5,
+        [OP_lconst_0] = &&op_lconst_0,
+        [OP_lconst_1] = &&op_lconst_1,
+        [OP_fconst_0] = &&op_fconst_0,
+        [OP_fconst_1] = &&op_fconst_1,
+        [OP_fconst_2] = &&op_fconst_2,
+        [OP_dconst_0] = &&op_dconst_0,
+        [OP_dconst_1] = &&op_dconst_1,
+        [OP_bipush] = &&op_bipush,
+        [OP_sipush] = &&op_sipush,
+        [OP_iload] = &&op_iload,
+        [OP_lload] = &&op_lload,
+        [OP_fload] = &&op_fload,
+        [OP_dload] = &&op_dload,
+        [OP_aload] = &&op_aload,
+        [OP_iload_0] = &&op_iload_0,
+        [OP_iload_1] = &&op_iload_1,
+        [OP_iload_2] = &&op_iload_2,
+        [OP_iload_3] = &&op_iload_3,
+        [OP_lload_0] = &&op_lload_0,
+        [OP_lload_1] = &&op_lload_1,
+        [OP_lload_2] = &&op_lload_2,
+        [OP_lload_3] = &&op_lload_3,
+        [OP_fload_0] = &&op_fload_0,
+        [OP_fload_1] = &&op_fload_1,
+        [OP_fload_2] = &&op_fload_2,
+        [OP_fload_3] = &&op_fload_3,
+        [OP_dload_0] = &&op_dload_0,
+        [OP_dload_1] = &&op_dload_1,
+        [OP_dload_2] = &&op_dload_2,
+        [OP_dload_3] = &&op_dload_3,
+        [OP_aload_0] = &&op_aload_0,
+        [OP_aload_1] = &&op_aload_1,
+        [OP_aload_2] = &&op_aload_2,
+        [OP_aload_3] = &&op_aload_3,
+        [OP_iaload] = &&op_iaload,
+        [OP_laload] = &&op_laload,
+        [OP_faload] = &&op_faload,
+        [OP_daload] = &&op_daload,
+        [OP_aaload] = &&op_aaload,
+        [OP_baload] = &&op_baload,
+        [OP_caload] = &&op_caload,
+        [OP_saload] = &&op_saload,
+        [OP_istore] = &&op_istore,
+        [OP_lstore] = &&op_lstore,
+        [OP_fstore] = &&op_fstore,
+        [OP_dstore] = &&op_dstore,
+        [OP_astore] = &&op_astore,
+        [OP_istore_0] = &&op_istore_0,
+        [OP_istore_1] = &&op_istore_1,
+        [OP_istore_2] = &&op_istore_2,
+        [OP_istore_3] = &&op_istore_3,
+        [OP_lstore_0] = &&op_lstore_0,
+        [OP_lstore_1] = &&op_lstore_1,
+        [OP_lstore_2] = &&op_lstore_2,
+        [OP_lstore_3] = &&op_lstore_3,
+        [OP_fstore_0] = &&op_fstore_0,
+        [OP_fstore_1] = &&op_fstore_1,
+        [OP_fstore_2] = &&op_fstore_2,
+        [OP_fstore_3] = &&op_fstore_3,
+        [OP_dstore_0] = &&op_dstore_0,
+        [OP_dstore_1] = &&op_dstore_1,
+        [OP_dstore_2] = &&op_dstore_2,
+        [OP_dstore_3] = &&op_dstore_3,
+        [OP_astore_0] = &&op_astore_0,
+        [OP_astore_1] = &&op_astore_1,
+        [OP_astore_2] = &&op_astore_2,
+        [OP_astore_3] = &&op_astore_3,
+        [OP_iastore] = &&op_iastore,
+        [OP_lastore] = &&op_lastore,
+        [OP_fastore] = &&op_fastore,
+        [OP_dastore] = &&op_dastore,
+        [OP_aastore] = &&op_aastore,
+        [OP_bastore] = &&op_bastore,
+        [OP_castore] = &&op_castore,
+        [OP_sastore] = &&op_sastore,
+        [OP_pop] = &&op_pop,
+        [OP_pop2] = &&op_pop2,
+        [OP_dup] = &&op_dup,
+        [OP_dup_x1] = &&op_dup_x1,
+        [OP_dup_x2] = &&op_dup_x2,
+        [OP_dup2] = &&op_dup2,
+        [OP_dup2_x1] = &&op_dup2_x1,
+        [OP_dup2_x2] = &&op_dup2_x2,
+        [OP_swap] = &&op_swap,
+        [OP_iadd] = &&op_iadd,
+        [OP_ladd] = &&op_ladd,
+        [OP_fadd] = &&op_fadd,
+        [OP_dadd] = &&op_dadd,
+        [OP_isub] = &&op_isub,
+        [OP_lsub] = &&op_lsub,
+        [OP_fsub] = &&op_fsub,
+        [OP_dsub] = &&op_dsub,
+        [OP_imul] = &&op_imul,
+        [OP_lmul] = &&op_lmul,
+        [OP_fmul] = &&op_fmul,
+        [OP_dmul] = &&op_dmul,
+        [OP_idiv] = &&op_idiv,
+        [OP_ldiv] = &&op_ldiv,
+        [OP_fdiv] = &&op_fdiv,
+        [OP_ddiv] = &&op_ddiv,
+        [OP_irem] = &&op_irem,
+        [OP_lrem] = &&op_lrem,
+        [OP_ineg] = &&op_ineg,
+        [OP_lneg] = &&op_lneg,
+        [OP_fneg] = &&op_fneg,
+        [OP_dneg] = &&op_dneg,
+        [OP_ishl] = &&op_ishl,
+        [OP_lshl] = &&op_lshl,
+        [OP_ishr] = &&op_ishr,
+        [OP_lshr] = &&op_lshr,
+        [OP_iushr] = &&op_iushr,
+        [OP_lushr] = &&op_lushr,
+        [OP_iand] = &&op_iand,
+        [OP_land] = &&op_land,
+        [OP_ior] = &&op_ior,
+        [OP_lor] = &&op_lor,
+        [OP_ixor] = &&op_ixor,
+        [OP_lxor] = &&op_lxor,
+        [OP_iinc] = &&op_iinc,
+        [OP_i2l] = &&op_i2l,
+        [OP_i2f] = &&op_i2f,
+        [OP_i2d] = &&op_i2d,
+        [OP_l2i] = &&op_l2i,
+        [OP_l2f] = &&op_l2f,
+        [OP_l2d] = &&op_l2d,
+        [OP_f2i] = &&op_f2i,
+        [OP_f2l] = &&op_f2l,
+        [OP_f2d] = &&op_f2d,
+        [OP_d2i] = &&op_d2i,
+        [OP_d2l] = &&op_d2l,
+        [OP_d2f] = &&op_d2f,
+        [OP_i2b] = &&op_i2b,
+        [OP_i2c] = &&op_i2c,
+        [OP_i2s] = &&op_i2s,
+        [OP_lcmp] = &&op_lcmp,
+        [OP_fcmpl] = &&op_fcmpl,
+        [OP_fcmpg] = &&op_fcmpg,
+        [OP_dcmpl] = &&op_dcmpl,
+        [OP_dcmpg] = &&op_dcmpg,
+        [OP_ifeq] = &&op_ifeq,
+        [OP_ifne] = &&op_ifne,
+        [OP_iflt] = &&op_iflt,
+        [OP_ifge] = &&op_ifge,
+        [OP_ifgt] = &&op_ifgt,
+        [OP_ifle] = &&op_ifle,
+        [OP_if_icmpeq] = &&op_if_icmpeq,
+        [OP_if_icmpne] = &&op_if_icmpne,
+        [OP_if_icmplt] = &&op_if_icmplt,
+        [OP_if_icmpge] = &&op_if_icmpge,
+        [OP_if_icmpgt] = &&op_if_icmpgt,
+        [OP_if_icmple] = &&op_if_icmple,
+        [OP_if_acmpeq] = &&op_if_acmpeq,
+        [OP_if_acmpne] = &&op_if_acmpne,
+        [OP_goto] = &&op_goto,
+        [OP_ifnull] = &&op_ifnull,
+        [OP_ifnonnull] = &&op_ifnonnull,
+        [OP_goto_w] = &&op_goto_w,
+        [OP_tableswitch] = &&op_tableswitch,
+        [OP_lookupswitch] = &&op_lookupswitch,
+        [OP_getstatic_quick_b] = &&op_getstatic_quick_b,
+        [OP_getstatic_quick_c] = &&op_getstatic_quick_c,
+        [OP_getstatic_quick_s] = &&op_getstatic_quick_s,
+        [OP_getstatic_quick_z] = &&op_getstatic_quick_z,
+        [OP_getstatic_quick_i] = &&op_getstatic_quick_i,
+        [OP_getstatic_quick_f] = &&op_getstatic_quick_f,
+        [OP_getstatic_quick_j] = &&op_getstatic_quick_j,
+        [OP_getstatic_quick_d] = &&op_getstatic_quick_d,
+        [OP_getstatic_quick_a] = &&op_getstatic_quick_a,
+        [OP_putstatic_quick_8] = &&op_putstatic_quick_8,
+        [OP_putstatic_quick_16] = &&op_putstatic_quick_16,
+        [OP_putstatic_quick_32] = &&op_putstatic_quick_32,
+        [OP_putstatic_quick_64] = &&op_putstatic_quick_64,
+        [OP_putstatic_quick_a] = &&op_putstatic_quick_a,
+        [OP_getfield_quick_b] = &&op_getfield_quick_b,
+        [OP_getfield_quick_c] = &&op_getfield_quick_c,
+        [OP_getfield_quick_s] = &&op_getfield_quick_s,
+        [OP_getfield_quick_z] = &&op_getfield_quick_z,
+        [OP_getfield_quick_i] = &&op_getfield_quick_i,
+        [OP_getfield_quick_f] = &&op_getfield_quick_f,
+        [OP_getfield_quick_j] = &&op_getfield_quick_j,
+        [OP_getfield_quick_d] = &&op_getfield_quick_d,
+        [OP_getfield_quick_a] = &&op_getfield_quick_a,
+        [OP_putfield_quick_8] = &&op_putfield_quick_8,
+        [OP_putfield_quick_16] = &&op_putfield_quick_16,
+        [OP_putfield_quick_32] = &&op_putfield_quick_32,
+        [OP_putfield_quick_64] = &&op_putfield_quick_64,
+        [OP_putfield_quick_a] = &&op_putfield_quick_a,
+        [OP_invokevirtual_quick] = &&op_invokevirtual_quick,
+        [OP_invokespecial_quick] = &&op_invokespecial_quick,
+        [OP_invokestatic_quick] = &&op_invokestatic_quick,
+        [OP_invokeinterface_quick] = &&op_invokeinterface_quick,
+        [OP_iload_iload_iadd] = &&op_iload_iload_iadd,
+        [OP_iload_iload_if_icmpeq] = &&op_iload_iload_if_icmpeq,
+        [OP_iload_iload_if_icmpne] = &&op_iload_iload_if_icmpne,
+        [OP_iload_iload_if_icmplt] = &&op_iload_iload_if_icmplt,
+        [OP_iload_iload_if_icmpge] = &&op_iload_iload_if_icmpge,
+        [OP_iload_iload_if_icmpgt] = &&op_iload_iload_if_icmpgt,
+        [OP_iload_iload_if_icmple] = &&op_iload_iload_if_icmple,
+        [OP_iload_iload] = &&op_iload_iload,
+        [OP_aload_getfield_quick_i] = &&op_aload_getfield_quick_i,
+        [OP_aload_getfield_quick_a] = &&op_aload_getfield_quick_a,
+        [OP_iinc_goto] = &&op_iinc_goto,
+        [OP_iadd_istore] = &&op_iadd_istore,
+    };
+    
+    if(!interpreter) {
+        dispatchTableAddress = dispatchTable;
+        return 0;
+    }
+    
     jthread_t *jthread = interpreter->jthread;
+    stack_frame_t *frame;
+    code_word_t *pc;
+    cell_t *locals;
+    cell_t *stack;
+    uint16_t tos;
+    // the frame that called into the interpreter. Returning to it ends this run
+    stack_frame_t *callerFrame = jthread->currentStackFrame->previousStackFrame;
     
-    while(true) {
-        // allows garbage collection to occur
-        savePoint();
-        
-        uint8_t *bytecode = jthread->pc;
-        uint8_t opcode = bytecode[0];
-        
-        int ret = instr_table[opcode](interpreter, false);
+    LOAD_STATE();
+    DISPATCH();
+    
+    op_slow: {
+        SYNC_STATE();
+        translated_code_t *translatedCode = getTranslatedCode(frame->currentMethod);
+        int ret = instr_table[translatedCode->opcodes[pc - translatedCode->code]](interpreter, false);
         if(ret > 0) {
             jthread->pc += ret;
         }
         else if(ret == -EJUST_RETURNED) {
-            if(!interpreter->jthread->currentStackFrame)
+            if(jthread->currentStackFrame == callerFrame)
                 return 0;
         }
         else if(ret == -ETHREW_OFF_THREAD) {
             // TODO print exception
             return 1;
         }
+        // handlers which set the pc themselves branched, invoked, returned, or threw
+        if(ret <= 0)
+            SAFEPOINT_POLL();
+        LOAD_STATE();
+#ifdef BASELINE_JIT
+        // returns to a compiled caller continue in its compiled code
+        if(frame->compiledCode)
+            goto op_compiled;
+#endif
+        DISPATCH();
     }
     
-    return 0;
+#ifdef BASELINE_JIT
+    op_compiled: {
+        int ret = runCompiledCode(interpreter, callerFrame);
+        if(ret == -EJUST_RETURNED) {
+            if(jthread->currentStackFrame == callerFrame)
+                return 0;
+        }
+        else if(ret == -ETHREW_OFF_THREAD) {
+            // TODO print exception
+            return 1;
+        }
+        // compiled code already polled when it left
+        LOAD_STATE();
+        // compiled code leaves for frames without compiled code, which counts as a call of their method
+        if(frame->compiledCode || countHotness(frame))
+            goto op_compiled;
+        DISPATCH();
+    }
+#endif
+    
+    op_nop: NEXT(1);
+    
+    CONST_INSTR(aconst_null, a, 0)
+    CONST_INSTR(iconst_m1, i, -1)
+    CONST_INSTR(iconst_0, i, 0)
+    CONST_INSTR(iconst_1, i, 1)
+    CONST_INSTR(iconst_2, i, 2)
+    CONST_INSTR(iconst_3, i, 3)
+    CONST_INSTR(iconst_4, i, 4)
+    CONST_INSTR(iconst_5, i, 5)
+    CONST2_INSTR(lconst_0, l, 0)
+    CONST2_INSTR(lconst_1, l, 1)
+    CONST_INSTR(fconst_0, f, 0.0f)
+    CONST_INSTR(fconst_1, f, 1.0f)
+    CONST_INSTR(fconst_2, f, 2.0f)
+    CONST2_INSTR(dconst_0, d, 0.0)
+    CONST2_INSTR(dconst_1, d, 1.0)
+    
+    op_bipush: {
+        cell_t cell = {.i = pc[1].i};
+        PUSH(cell);
+        NEXT(2);
+    }
+    
+    op_sipush: {
+        cell_t cell = {.i = pc[1].i};
+        PUSH(cell);
+        NEXT(2);
+    }
+    
+    LOAD_INSTR(iload, pc[1].u, 2)
+    LOAD2_INSTR(lload, pc[1].u, 2)
+    LOAD_INSTR(fload, pc[1].u, 2)
+    LOAD2_INSTR(dload, pc[1].u, 2)
+    LOAD_INSTR(aload, pc[1].u, 2)
+    LOAD_INSTR(iload_0, 0, 2)
+    LOAD_INSTR(iload_1, 1, 2)
+    LOAD_INSTR(iload_2, 2, 2)
+    LOAD_INSTR(iload_3, 3, 2)
+    LOAD2_INSTR(lload_0, 0, 2)
+    LOAD2_INSTR(lload_1, 1, 2)
+    LOAD2_INSTR(lload_2, 2, 2)
+    LOAD2_INSTR(lload_3, 3, 2)
+    LOAD_INSTR(fload_0, 0, 2)
+    LOAD_INSTR(fload_1, 1, 2)
+    LOAD_INSTR(fload_2, 2, 2)
+    LOAD_INSTR(fload_3, 3, 2)
+    LOAD2_INSTR(dload_0, 0, 2)
+    LOAD2_INSTR(dload_1, 1, 2)
+    LOAD2_INSTR(dload_2, 2, 2)
+    LOAD2_INSTR(dload_3, 3, 2)
+    LOAD_INSTR(aload_0, 0, 2)
+    LOAD_INSTR(aload_1, 1, 2)
+    LOAD_INSTR(aload_2, 2, 2)
+    LOAD_INSTR(aload_3, 3, 2)
+    
+    ARRAY_LOAD_INSTR(iaload, int32_t, i)
+    ARRAY_LOAD2_INSTR(laload, int64_t, l)
+    ARRAY_LOAD_INSTR(faload, float, f)
+    ARRAY_LOAD2_INSTR(daload, double, d)
+    ARRAY_LOAD_INSTR(aaload, slot_t, a)
+    ARRAY_LOAD_INSTR(baload, int8_t, i)
+    ARRAY_LOAD_INSTR(caload, uint16_t, i)
+    ARRAY_LOAD_INSTR(saload, int16_t, i)
+    
+    STORE_INSTR(istore, pc[1].u, 2)
+    STORE2_INSTR(lstore, pc[1].u, 2)
+    STORE_INSTR(fstore, pc[1].u, 2)
+    STORE2_INSTR(dstore, pc[1].u, 2)
+    STORE_INSTR(astore, pc[1].u, 2)
+    STORE_INSTR(istore_0, 0, 2)
+    STORE_INSTR(istore_1, 1, 2)
+    STORE_INSTR(istore_2, 2, 2)
+    STORE_INSTR(istore_3, 3, 2)
+    STORE2_INSTR(lstore_0, 0, 2)
+    STORE2_INSTR(lstore_1, 1, 2)
+    STORE2_INSTR(lstore_2, 2, 2)
+    STORE2_INSTR(lstore_3, 3, 2)
+    STORE_INSTR(fstore_0, 0, 2)
+    STORE_INSTR(fstore_1, 1, 2)
+    STORE_INSTR(fstore_2, 2, 2)
+    STORE_INSTR(fstore_3, 3, 2)
+    STORE2_INSTR(dstore_0, 0, 2)
+    STORE2_INSTR(dstore_1, 1, 2)
+    STORE2_INSTR(dstore_2, 2, 2)
+    STORE2_INSTR(dstore_3, 3, 2)
+    STORE_INSTR(astore_0, 0, 2)
+    STORE_INSTR(astore_1, 1, 2)
+    STORE_INSTR(astore_2, 2, 2)
+    STORE_INSTR(astore_3, 3, 2)
+    
+    ARRAY_STORE_INSTR(iastore, int32_t, i, NO_WRITE_BARRIER)
+    ARRAY_STORE2_INSTR(lastore, int64_t, l)
+    ARRAY_STORE_INSTR(fastore, float, f, NO_WRITE_BARRIER)
+    ARRAY_STORE2_INSTR(dastore, double, d)
+    ARRAY_STORE_INSTR(aastore, slot_t, a, OBJECT_WRITE_BARRIER)
+    ARRAY_STORE_INSTR(bastore, int8_t, b, NO_WRITE_BARRIER)
+    ARRAY_STORE_INSTR(castore, uint16_t, c, NO_WRITE_BARRIER)
+    ARRAY_STORE_INSTR(sastore, int16_t, s, NO_WRITE_BARRIER)
+    
+    op_pop: --tos; NEXT(1);
+    op_pop2: tos -= 2; NEXT(1);
+    
+    op_dup:
+        MOVE_SLOT(tos, tos - 1);
+        ++tos;
+        NEXT(1);
+    
+    op_dup_x1:
+        MOVE_SLOT(tos, tos - 1);
+        MOVE_SLOT(tos - 1, tos - 2);
+        MOVE_SLOT(tos - 2, tos);
+        ++tos;
+        NEXT(1);
+    
+    op_dup_x2:
+        MOVE_SLOT(tos, tos - 1);
+        MOVE_SLOT(tos - 1, tos - 2);
+        MOVE_SLOT(tos - 2, tos - 3);
+        MOVE_SLOT(tos - 3, tos);
+        ++tos;
+        NEXT(1);
+    
+    op_dup2:
+        MOVE_SLOT(tos, tos - 2);
+        MOVE_SLOT(tos + 1, tos - 1);
+        tos += 2;
+        NEXT(1);
+    
+    op_dup2_x1:
+        MOVE_SLOT(tos + 1, tos - 1);
+        MOVE_SLOT(tos, tos - 2);
+        MOVE_SLOT(tos - 1, tos - 3);
+        MOVE_SLOT(tos - 2, tos + 1);
+        MOVE_SLOT(tos - 3, tos);
+        tos += 2;
+        NEXT(1);
+    
+    op_dup2_x2:
+        MOVE_SLOT(tos + 1, tos - 1);
+        MOVE_SLOT(tos, tos - 2);
+        MOVE_SLOT(tos - 1, tos - 3);
+        MOVE_SLOT(tos - 2, tos - 4);
+        MOVE_SLOT(tos - 3, tos + 1);
+        MOVE_SLOT(tos - 4, tos);
+        tos += 2;
+        NEXT(1);
+    
+    op_swap:
+        MOVE_SLOT(tos, tos - 1);
+        MOVE_SLOT(tos - 1, tos - 2);
+        MOVE_SLOT(tos - 2, tos);
+        NEXT(1);
+    
+    BINARY_INSTR(iadd, i, +)
+    BINARY2_INSTR(ladd, l, +)
+    BINARY_INSTR(fadd, f, +)
+    BINARY2_INSTR(dadd, d, +)
+    BINARY_INSTR(isub, i, -)
+    BINARY2_INSTR(lsub, l, -)
+    BINARY_INSTR(fsub, f, -)
+    BINARY2_INSTR(dsub, d, -)
+    BINARY_INSTR(imul, i, *)
+    BINARY2_INSTR(lmul, l, *)
+    BINARY_INSTR(fmul, f, *)
+    BINARY2_INSTR(dmul, d, *)
+    BINARY_INSTR(fdiv, f, /)
+    BINARY2_INSTR(ddiv, d, /)
+    BINARY_INSTR(iand, i, &)
+    BINARY2_INSTR(land, l, &)
+    BINARY_INSTR(ior, i, |)
+    BINARY2_INSTR(lor, l, |)
+    BINARY_INSTR(ixor, i, ^)
+    BINARY2_INSTR(lxor, l, ^)
+    
+    // division by zero is left to the out of line handlers which throw the ArithmeticException
+    op_idiv:
+        if(stack[tos - 1].i == 0)
+            goto op_slow;
+        // INT32_MIN / -1 traps on x86 so negate instead. Java defines the result as INT32_MIN
+        if(stack[tos - 1].i == -1)
+            stack[tos - 2].i = (int32_t) -(uint32_t) stack[tos - 2].i;
+        else
+            stack[tos - 2].i /= stack[tos - 1].i;
+        --tos;
+        NEXT(1);
+    
+    op_ldiv:
+        if(TOP2(0).l == 0)
+            goto op_slow;
+        if(TOP2(0).l == -1)
+            TOP2(2).l = (int64_t) -(uint64_t) TOP2(2).l;
+        else
+            TOP2(2).l /= TOP2(0).l;
+        tos -= 2;
+        NEXT(1);
+    
+    op_irem:
+        if(stack[tos - 1].i == 0)
+            goto op_slow;
+        if(stack[tos - 1].i == -1)
+            stack[tos - 2].i = 0;
+        else
+            stack[tos - 2].i %= stack[tos - 1].i;
+        --tos;
+        NEXT(1);
+    
+    op_lrem:
+        if(TOP2(0).l == 0)
+            goto op_slow;
+        if(TOP2(0).l == -1)
+            TOP2(2).l = 0;
+        else
+            TOP2(2).l %= TOP2(0).l;
+        tos -= 2;
+        NEXT(1);
+    
+    UNARY_INSTR(ineg, i, -)
+    UNARY2_INSTR(lneg, l, -)
+    UNARY_INSTR(fneg, f, -)
+    UNARY2_INSTR(dneg, d, -)
+    
+    // shift distances are masked the same way the JVM specification requires
+    op_ishl: stack[tos - 2].i = (int32_t) ((uint32_t) stack[tos - 2].i << (stack[tos - 1].i & 0x1F)); --tos; NEXT(1);
+    op_ishr: stack[tos - 2].i >>= stack[tos - 1].i & 0x1F; --tos; NEXT(1);
+    op_iushr: stack[tos - 2].i = (int32_t) ((uint32_t) stack[tos - 2].i >> (stack[tos - 1].i & 0x1F)); --tos; NEXT(1);
+    op_lshl: { int32_t shift = POP().i & 0x3F; TOP2(0).l = (int64_t) ((uint64_t) TOP2(0).l << shift); NEXT(1); }
+    op_lshr: { int32_t shift = POP().i & 0x3F; TOP2(0).l >>= shift; NEXT(1); }
+    op_lushr: { int32_t shift = POP().i & 0x3F; TOP2(0).l = (int64_t) ((uint64_t) TOP2(0).l >> shift); NEXT(1); }
+    
+    op_iinc:
+        locals[pc[1].u].i += pc[2].i;
+        NEXT(3);
+    
+    op_i2l: { double_cell_t cell = {.l = POP().i}; PUSH2(cell); NEXT(1); }
+    CONVERT_INSTR(i2f, i, f, float)
+    op_i2d: { double_cell_t cell = {.d = POP().i}; PUSH2(cell); NEXT(1); }
+    op_l2i: { cell_t cell = {.i = (int32_t) POP2().l}; PUSH(cell); NEXT(1); }
+    op_l2f: { cell_t cell = {.f = (float) POP2().l}; PUSH(cell); NEXT(1); }
+    op_l2d: { double_cell_t cell = {.d = (double) POP2().l}; PUSH2(cell); NEXT(1); }
+    CONVERT_INSTR(f2i, f, i, int32_t)
+    op_f2l: { double_cell_t cell = {.l = (int64_t) POP().f}; PUSH2(cell); NEXT(1); }
+    op_f2d: { double_cell_t cell = {.d = POP().f}; PUSH2(cell); NEXT(1); }
+    op_d2i: { cell_t cell = {.i = (int32_t) POP2().d}; PUSH(cell); NEXT(1); }
+    op_d2l: { double_cell_t cell = {.l = (int64_t) POP2().d}; PUSH2(cell); NEXT(1); }
+    op_d2f: { cell_t cell = {.f = (float) POP2().d}; PUSH(cell); NEXT(1); }
+    CONVERT_INSTR(i2b, i, i, int8_t)
+    CONVERT_INSTR(i2c, i, i, uint16_t)
+    CONVERT_INSTR(i2s, i, i, int16_t)
+    
+    op_lcmp: {
+        double_cell_t top = POP2();
+        double_cell_t next = POP2();
+        cell_t result = {.i = next.l > top.l ? 1 : (next.l < top.l ? -1 : 0)};
+        PUSH(result);
+        NEXT(1);
+    }
+    
+    COMPARE_INSTR(fcmpl, cell_t, f, POP, -1)
+    COMPARE_INSTR(fcmpg, cell_t, f, POP, 1)
+    COMPARE_INSTR(dcmpl, double_cell_t, d, POP2, -1)
+    COMPARE_INSTR(dcmpg, double_cell_t, d, POP2, 1)
+    
+    BRANCH_INSTR(ifeq, stack[tos].i == 0, 1)
+    BRANCH_INSTR(ifne, stack[tos].i != 0, 1)
+    BRANCH_INSTR(iflt, stack[tos].i < 0, 1)
+    BRANCH_INSTR(ifge, stack[tos].i >= 0, 1)
+    BRANCH_INSTR(ifgt, stack[tos].i > 0, 1)
+    BRANCH_INSTR(ifle, stack[tos].i <= 0, 1)
+    BRANCH_INSTR(if_icmpeq, stack[tos].i == stack[tos + 1].i, 2)
+    BRANCH_INSTR(if_icmpne, stack[tos].i != stack[tos + 1].i, 2)
+    BRANCH_INSTR(if_icmplt, stack[tos].i < stack[tos + 1].i, 2)
+    BRANCH_INSTR(if_icmpge, stack[tos].i >= stack[tos + 1].i, 2)
+    BRANCH_INSTR(if_icmpgt, stack[tos].i > stack[tos + 1].i, 2)
+    BRANCH_INSTR(if_icmple, stack[tos].i <= stack[tos + 1].i, 2)
+    BRANCH_INSTR(if_acmpeq, stack[tos].a == stack[tos + 1].a, 2)
+    BRANCH_INSTR(if_acmpne, stack[tos].a != stack[tos + 1].a, 2)
+    BRANCH_INSTR(ifnull, stack[tos].a == 0, 1)
+    BRANCH_INSTR(ifnonnull, stack[tos].a != 0, 1)
+    
+    op_goto:
+    op_goto_w:
+        pc = pc[1].target;
+        POLL();
+        DISPATCH();
+    
+    GETSTATIC_QUICK_INSTR(getstatic_quick_b, int8_t, i)
+    GETSTATIC_QUICK_INSTR(getstatic_quick_c, uint16_t, i)
+    GETSTATIC_QUICK_INSTR(getstatic_quick_s, int16_t, i)
+    GETSTATIC_QUICK_INSTR(getstatic_quick_z, uint8_t, i)
+    GETSTATIC_QUICK_INSTR(getstatic_quick_i, int32_t, i)
+    GETSTATIC_QUICK_INSTR(getstatic_quick_f, float, f)
+    GETSTATIC2_QUICK_INSTR(getstatic_quick_j, int64_t, l)
+    GETSTATIC2_QUICK_INSTR(getstatic_quick_d, double, d)
+    GETSTATIC_QUICK_INSTR(getstatic_quick_a, slot_t, a)
+    
+    PUTSTATIC_QUICK_INSTR(putstatic_quick_8, uint8_t, z, NO_WRITE_BARRIER)
+    PUTSTATIC_QUICK_INSTR(putstatic_quick_16, uint16_t, c, NO_WRITE_BARRIER)
+    PUTSTATIC_QUICK_INSTR(putstatic_quick_32, uint32_t, i, NO_WRITE_BARRIER)
+    PUTSTATIC2_QUICK_INSTR(putstatic_quick_64, int64_t, l)
+    PUTSTATIC_QUICK_INSTR(putstatic_quick_a, slot_t, a, SATB_WRITE_BARRIER)
+    
+    GETFIELD_QUICK_INSTR(getfield_quick_b, int8_t, i)
+    GETFIELD_QUICK_INSTR(getfield_quick_c, uint16_t, i)
+    GETFIELD_QUICK_INSTR(getfield_quick_s, int16_t, i)
+    GETFIELD_QUICK_INSTR(getfield_quick_z, uint8_t, i)
+    GETFIELD_QUICK_INSTR(getfield_quick_i, int32_t, i)
+    GETFIELD_QUICK_INSTR(getfield_quick_f, float, f)
+    GETFIELD2_QUICK_INSTR(getfield_quick_j, int64_t, l)
+    GETFIELD2_QUICK_INSTR(getfield_quick_d, double, d)
+    GETFIELD_QUICK_INSTR(getfield_quick_a, slot_t, a)
+    
+    PUTFIELD_QUICK_INSTR(putfield_quick_8, uint8_t, z, NO_WRITE_BARRIER)
+    PUTFIELD_QUICK_INSTR(putfield_quick_16, uint16_t, c, NO_WRITE_BARRIER)
+    PUTFIELD_QUICK_INSTR(putfield_quick_32, uint32_t, i, NO_WRITE_BARRIER)
+    PUTFIELD2_QUICK_INSTR(putfield_quick_64, int64_t, l)
+    PUTFIELD_QUICK_INSTR(putfield_quick_a, slot_t, a, OBJECT_WRITE_BARRIER)
+    
+    // null receivers and inline cache misses are left to the out of line handlers
+    op_invokevirtual_quick: {
+        inline_cache_t *cache = pc[2].ptr;
+        object_t *obj = getObject(stack[tos - cache->method->numParameters].a);
+        if(!obj)
+            goto op_slow;
+        method_t *method = findInInlineCache(cache, obj->class);
+        if(!method)
+            goto op_slow;
+        INVOKE(method);
+    }
+    
+    op_invokeinterface_quick: {
+        inline_cache_t *cache = pc[2].ptr;
+        object_t *obj = getObject(stack[tos - cache->method->numParameters].a);
+        if(!obj)
+            goto op_slow;
+        method_t *method = findInInlineCache(cache, obj->class);
+        if(!method)
+            goto op_slow;
+        INVOKE(method);
+    }
+    
+    op_invokespecial_quick: {
+        method_t *method = pc[2].ptr;
+        if(!getObject(stack[tos - method->numParameters].a))
+            goto op_slow;
+        INVOKE(method);
+    }
+    
+    op_invokestatic_quick: INVOKE((method_t *) pc[2].ptr);
+    
+    // superinstructions read the operands of the instructions they combine from the words of those instructions
+    op_iload_iload_iadd: {
+        cell_t cell = {.i = locals[pc[1].u].i + locals[pc[3].u].i};
+        PUSH(cell);
+        NEXT(5);
+    }
+    
+    LOAD_LOAD_BRANCH_INSTR(iload_iload_if_icmpeq, ==)
+    LOAD_LOAD_BRANCH_INSTR(iload_iload_if_icmpne, !=)
+    LOAD_LOAD_BRANCH_INSTR(iload_iload_if_icmplt, <)
+    LOAD_LOAD_BRANCH_INSTR(iload_iload_if_icmpge, >=)
+    LOAD_LOAD_BRANCH_INSTR(iload_iload_if_icmpgt, >)
+    LOAD_LOAD_BRANCH_INSTR(iload_iload_if_icmple, <=)
+    
+    op_iload_iload:
+        PUSH(locals[pc[1].u]);
+        PUSH(locals[pc[3].u]);
+        NEXT(4);
+    
+    LOAD_GETFIELD_QUICK_INSTR(aload_getfield_quick_i, int32_t, i)
+    LOAD_GETFIELD_QUICK_INSTR(aload_getfield_quick_a, slot_t, a)
+    
+    op_iinc_goto:
+        locals[pc[1].u].i += pc[2].i;
+        pc = pc[4].target;
+        POLL();
+        DISPATCH();
+    
+    op_iadd_istore:
+        locals[pc[2].u].i = stack[tos - 2].i + stack[tos - 1].i;
+        tos -= 2;
+        NEXT(3);
+    
+    op_tableswitch: {
+        int32_t index = POP().i;
+        if(index < pc[2].i || index > pc[3].i)
+            pc = pc[1].target;
+        else
+            pc = pc[4 + (index - pc[2].i)].target;
+        POLL();
+        DISPATCH();
+    }
+    
+    op_lookupswitch: {
+        int32_t key = POP().i;
+        code_word_t *pairs = pc + 3;
+        int32_t start = 0;
+        int32_t end = pc[2].i;
+        code_word_t *target = pc[1].target;
+        while(start < end) {
+            int32_t mid = start + (end - start) / 2;
+            if(pairs[2 * mid].i == key) {
+                target = pairs[2 * mid + 1].target;
+                break;
+            }
+            else if(pairs[2 * mid].i < key)
+                start = mid + 1;
+            else
+                end = mid;
+        }
+        pc = target;
+        POLL();
+        DISPATCH();
+    }
 }
 
-int8_t readByteOperand(jthread_t *jthread, int offset) {
-    return *((uint8_t *) jthread->pc + offset);
-}
+#else
 
-int16_t readShortOperand(jthread_t *jthread, int offset) {
-    int16_t value = *((uint8_t *) jthread->pc + offset);
-    value = (value << 8) + *((uint8_t *) jthread->pc + offset + 1);
-    return value;
+int run(bc_interpreter_t *interpreter) {
+    jthread_t *jthread = interpreter->jthread;
+    // the frame that called into the interpreter. Returning to it ends this run
+    stack_frame_t *callerFrame = jthread->currentStackFrame->previousStackFrame;
+    
+    while(true) {
+        int ret;
+#ifdef BASELINE_JIT
+        if(jthread->currentStackFrame->compiledCode)
+            ret = runCompiledCode(interpreter, callerFrame);
+        else
+#endif
+        {
+#ifdef OPCODE_PROFILING
+            profileInstruction(jthread->currentStackFrame->currentMethod, jthread->pc);
+#endif
+            ret = jthread->pc->handler(interpreter, false);
+        }
+        if(ret > 0) {
+            jthread->pc += ret;
+        }
+        else if(ret == -EJUST_RETURNED) {
+            if(jthread->currentStackFrame == callerFrame)
+                return 0;
+        }
+        else if(ret == -ETHREW_OFF_THREAD) {
+            // TODO print exception
+            return 1;
+        }
+        // calls, returns, and taken branches set the pc themselves. They are the safepoints, so every loop reaches one
+        if(ret <= 0) {
+            SAFEPOINT_POLL();
+#ifdef BASELINE_JIT
+            // they also count towards compiling the method execution continues in
+            if(!jthread->currentStackFrame->compiledCode)
+                countHotness(jthread->currentStackFrame);
+#endif
+        }
+    }
+    
+    return 0;
 }
 
-int32_t readIntOperand(jthread_t *jthread, int offset) {
-    int32_t value = *((uint8_t *) jthread->pc + offset);
-    value = (value << 8) + *((uint8_t *) jthread->pc + offset + 1);
-    value = (value << 8) + *((uint8_t *) jthread->pc + offset + 2);
-    value = (value << 8) + *((uint8_t *) jthread->pc + offset + 3);
-    return value;
-}
+#endif
 
 bool initializeClass(bc_interpreter_t *interpreter, class_t *class);
 
@@ -77,19 +1097,24 @@ void throwException(bc_interpreter_t *interpreter, char *exceptionClassName, cha
         printf("InternalError: Failed to initialize an internal exception class\n");
         exit(1);
     }
-    slot_t exceptionSlot = newObject(exceptionClass);
+    slot_t exceptionSlot = newObject(interpreter->jthread, exceptionClass);
     if(!exceptionSlot) {
         printf("OutOfMemoryError: Failed to allocate an instance of an internal exception class\n");
         exit(1);
     }
-    slot_t messageSlot = convertToJavaString(exceptionMessage);
+    pushRoot(interpreter->jthread, exceptionSlot);
+    slot_t messageSlot = convertToJavaString(interpreter->jthread, exceptionMessage);
+    exceptionSlot = popRoot(interpreter->jthread);
     
     // TODO call <init>(Ljava/lang/String;)V instead
     
     for(int i = 0; i < exceptionClass->numFields; ++i) {
         field_t *field = exceptionClass->fields + i;
         if(!(field->flags & FIELD_ACC_STATIC) && strcmp(field->descriptor, "Ljava/lang/String;") == 0) {
-            *(slot_t *) ((void *) getObject(exceptionSlot) + field->objectOffset) = messageSlot;
+            slot_t *message = (void *) getObject(exceptionSlot) + field->objectOffset;
+            // allocating the message can move the exception into the old generation
+            MARK_CARD(message);
+            *message = messageSlot;
             break;
         }
     }
@@ -105,11 +1130,10 @@ bool initializeClass(bc_interpreter_t *interpreter, class_t *class) {
     if(class->status == CLASS_STATUS_INITIALIZING && class->jlock.owner == interpreter->jthread->id)
         return true;
     
-    // busy loop to wait for the class to be loaded if another thread is loading it
-    while(class->status == CLASS_STATUS_INITIALIZING);
     if(class->status == CLASS_STATUS_INITIALIZED)
         return true;
     
+    // if another thread is initializing the class this blocks until it's done, since it holds the lock meanwhile
     jlock_lock(interpreter->jthread->id, &class->jlock);
     if(class->status == CLASS_STATUS_INITIALIZED) {
         jlock_unlock(interpreter->jthread->id, &class->jlock);
@@ -140,7 +1164,7 @@ bool initializeClass(bc_interpreter_t *interpreter, class_t *class) {
                     else if(tag == CONSTANT_String) {
                         uint16_t stringIndex = constant->stringInfo.stringIndex;
                         utf8_info_t *utfInfo = &class->constantPool[stringIndex]->utf8Info;
-                        slot_t slot = convertToJavaString(utfInfo->chars);
+                        slot_t slot = convertToJavaString(interpreter->jthread, utfInfo->chars);
                         if(slot == 0) {
                             class->status = CLASS_STATUS_LOADED;
                             throwException(interpreter, "java/lang/ExceptionInInitializerError", "Failed to load string constant");
@@ -169,19 +1193,31 @@ bool initializeClass(bc_interpreter_t *interpreter, class_t *class) {
         return true;
     }
     
+    translated_code_t *clinitCode = getTranslatedCode(clinit);
+    if(!clinitCode) {
+        class->status = CLASS_STATUS_LOADED;
+        throwException(interpreter, "java/lang/VerifyError", "Malformed bytecode in static initializer");
+        jlock_unlock(interpreter->jthread->id, &class->jlock);
+        return false;
+    }
+    
     jthread_t *jthread = interpreter->jthread;
     stack_frame_t *currentFrame = jthread->currentStackFrame;
-    void *currentPC = jthread->pc;
+    code_word_t *currentPC = jthread->pc;
     stack_frame_t clinitFrame;
     clinitFrame.currentMethod = clinit;
-    clinitFrame.previousStackFrame = NULL;
-    clinitFrame.prevFramePC = NULL;
+    // linked to the current frame so that the whole stack can be walked while the initializer runs
+    clinitFrame.previousStackFrame = currentFrame;
+    clinitFrame.prevFramePC = currentPC;
     clinitFrame.topOfStack = 0;
+#ifdef BASELINE_JIT
+    clinitFrame.compiledCode = atomic_load_explicit(&clinitCode->compiledCode, memory_order_acquire);
+#endif
     clinitFrame.localVariableBase = currentFrame->operandStackBase + currentFrame->topOfStack;
-    clinitFrame.operandStackTypeBase = (void *) (clinitFrame.localVariableBase + clinit->codeAttribute->maxLocals);
-    clinitFrame.operandStackBase = (void *) (clinitFrame.operandStackTypeBase + clinit->codeAttribute->maxStack);
+    clinitFrame.operandStackBase = (void *) (clinitFrame.localVariableBase + clinit->codeAttribute->maxLocals);
+    memset(clinitFrame.localVariableBase, 0, clinit->codeAttribute->maxLocals * sizeof(cell_t));
     jthread->currentStackFrame = &clinitFrame;
-    jthread->pc = clinit->codeAttribute->code;
+    jthread->pc = clinitCode->code;
     
     int result = run(interpreter);
     jthread->currentStackFrame = currentFrame;
@@ -234,7 +1270,22 @@ field_t *resolveField0(bc_interpreter_t *interpreter, class_t *fieldClass, char
 }
 
 field_t *resolveField(bc_interpreter_t *interpreter, uint16_t fieldIndex, bool isStatic) {
-    constant_info_t **constantPool = interpreter->jthread->currentStackFrame->currentMethod->class->constantPool;
+    class_t *currentClass = interpreter->jthread->currentStackFrame->currentMethod->class;
+    field_t *field = atomic_load_explicit(&currentClass->resolvedReferences[fieldIndex], memory_order_acquire);
+    if(field) {
+        if((bool) (field->flags & FIELD_ACC_STATIC) != isStatic) {
+            throwException(interpreter, "java/lang/IncompatibleClassChangeError", "No field found that matches the name and descriptor");
+            return NULL;
+        }
+        // the class may have been resolved by an instruction that doesn't initialize it
+        if(!initializeClass(interpreter, field->class)) {
+            throwException(interpreter, "java/lang/ExceptionInInitializerError", "Failed to initialize class");
+            return NULL;
+        }
+        return field;
+    }
+    
+    constant_info_t **constantPool = currentClass->constantPool;
     field_method_interface_method_ref_info_t *fieldRef = &constantPool[fieldIndex]->fieldMethodInterfaceMethodRefInfo;
     
     name_and_type_info_t *nameAndTypeInfo = &constantPool[fieldRef->nameAndTypeIndex]->nameAndTypeInfo;
@@ -250,101 +1301,221 @@ field_t *resolveField(bc_interpreter_t *interpreter, uint16_t fieldIndex, bool i
         return NULL;
     }
     
-    return resolveField0(interpreter, fieldClass, fieldName, descriptor, isStatic);
+    field = resolveField0(interpreter, fieldClass, fieldName, descriptor, isStatic);
+    if(field)
+        atomic_store_explicit(&currentClass->resolvedReferences[fieldIndex], field, memory_order_release);
+    return field;
 }
 
-method_t *resolveMethod0(bc_interpreter_t *interpreter, class_t *methodClass, char *methodName, char* descriptor, bool isStatic) {
+/**
+ *
+ * @return the method declared by the class with the given name and descriptor or NULL if there isn't one
+ */
+method_t *findDeclaredMethod(class_t *class, char *methodName, char *descriptor) {
+    for(int i = 0; i < class->numMethods; ++i) {
+        method_t *method = class->methods + i;
+        if(strcmp(method->name, methodName) == 0 && strcmp(method->descriptor, descriptor) == 0)
+            return method;
+    }
+    return NULL;
+}
 
+/**
+ * Looks up a method in the class and its superclasses followed by its superinterfaces. The same lookup is used for
+ * interface methods since the superclass of an interface is Object
+ * @param interpreter
+ * @param methodClass
+ * @param methodName
+ * @param descriptor
+ * @return the method or NULL if no method was found in which case an exception is thrown
+ */
+method_t *resolveMethod0(bc_interpreter_t *interpreter, class_t *methodClass, char *methodName, char* descriptor) {
+    for(class_t *class = methodClass; class; class = class->superClass) {
+        method_t *method = findDeclaredMethod(class, methodName, descriptor);
+        if(method)
+            return method;
+    }
+    
+    // the itable contains every superinterface. Methods with a body are preferred over abstract ones
+    method_t *abstractMethod = NULL;
+    for(int i = 0; i < methodClass->itableLength; ++i) {
+        method_t *method = findDeclaredMethod(methodClass->itable[i].interface, methodName, descriptor);
+        if(!method || (method->flags & (METHOD_ACC_STATIC | METHOD_ACC_PRIVATE)))
+            continue;
+        if(!(method->flags & METHOD_ACC_ABSTRACT))
+            return method;
+        if(!abstractMethod)
+            abstractMethod = method;
+    }
+    
+    if(!abstractMethod)
+        throwException(interpreter, "java/lang/NoSuchMethodError", "No method found that matches the name and descriptor");
+    return abstractMethod;
 }
 
 method_t *resolveMethod(bc_interpreter_t *interpreter, uint16_t methodIndex, bool isStatic) {
-    constant_info_t **constantPool = interpreter->jthread->currentStackFrame->currentMethod->class->constantPool;
-    field_method_interface_method_ref_info_t *methodRef = &constantPool[methodIndex]->fieldMethodInterfaceMethodRefInfo;
-    
-    name_and_type_info_t *nameAndTypeInfo = &constantPool[methodRef->nameAndTypeIndex]->nameAndTypeInfo;
-    char *methodName = constantPool[nameAndTypeInfo->nameIndex]->utf8Info.chars;
-    char *descriptor = constantPool[nameAndTypeInfo->descriptorIndex]->utf8Info.chars;
+    class_t *currentClass = interpreter->jthread->currentStackFrame->currentMethod->class;
+    method_t *method = atomic_load_explicit(&currentClass->resolvedReferences[methodIndex], memory_order_acquire);
     
-    class_info_t *methodClassInfo = &constantPool[methodRef->classIndex]->classInfo;
-    char *className = constantPool[methodClassInfo->nameIndex]->utf8Info.chars;
+    if(!method) {
+        constant_info_t **constantPool = currentClass->constantPool;
+        field_method_interface_method_ref_info_t *methodRef = &constantPool[methodIndex]->fieldMethodInterfaceMethodRefInfo;
+        
+        name_and_type_info_t *nameAndTypeInfo = &constantPool[methodRef->nameAndTypeIndex]->nameAndTypeInfo;
+        char *methodName = constantPool[nameAndTypeInfo->nameIndex]->utf8Info.chars;
+        char *descriptor = constantPool[nameAndTypeInfo->descriptorIndex]->utf8Info.chars;
+        
+        class_info_t *methodClassInfo = &constantPool[methodRef->classIndex]->classInfo;
+        char *className = constantPool[methodClassInfo->nameIndex]->utf8Info.chars;
+        
+        class_t *methodClass = loadClass(className);
+        if(!methodClass) {
+            throwException(interpreter, "java/lang/NoClassDefFoundError", "Failed to load class");
+            return NULL;
+        }
+        
+        method = resolveMethod0(interpreter, methodClass, methodName, descriptor);
+        if(!method)
+            return NULL;
+        atomic_store_explicit(&currentClass->resolvedReferences[methodIndex], method, memory_order_release);
+    }
     
-    class_t *methodClass;
-    if(isStatic) {
-        methodClass = loadClass(className);
+    if((bool) (method->flags & METHOD_ACC_STATIC) != isStatic) {
+        throwException(interpreter, "java/lang/IncompatibleClassChangeError", "No method found that matches the name and descriptor");
+        return NULL;
     }
-    else {
-        uint16_t numArgs = countNumParametersFromMethodDescriptor(descriptor, isStatic);
-        object_t *obj = getObject(peekOperand(interpreter->jthread->currentStackFrame, numArgs - 1, NULL).a);
-        methodClass = obj->class;
+    if(isStatic && !initializeClass(interpreter, method->class)) {
+        throwException(interpreter, "java/lang/ExceptionInInitializerError", "Failed to initialize class");
+        return NULL;
+    }
+    return method;
+}
+
+/**
+ * Pushes a new stack frame for the method. The arguments on top of the current frame's operand stack become the first
+ * local variables of the new frame so they don't need to be copied.
+ * @param interpreter
+ * @param method
+ * @param instructionLength the number of words in the invoke instruction. Used for finding where to return to
+ * @return true if the frame was pushed, otherwise false in which case an exception is thrown
+ */
+bool invokeMethod(bc_interpreter_t *interpreter, method_t *method, uint16_t instructionLength) {
+    if(method->flags & METHOD_ACC_ABSTRACT) {
+        throwException(interpreter, "java/lang/AbstractMethodError", "Invoked an abstract method");
+        return false;
+    }
+    if(method->flags & METHOD_ACC_NATIVE) {
+        throwException(interpreter, "java/lang/UnsatisfiedLinkError", "Native methods are not supported");
+        return false;
+    }
+    translated_code_t *translatedCode = getTranslatedCode(method);
+    if(!translatedCode) {
+        throwException(interpreter, "java/lang/VerifyError", "Malformed bytecode");
+        return false;
     }
     
-    if(!methodClass) {
-        throwException(interpreter, "java/lang/NoClassDefFoundError", "Failed to load class");
-        return NULL;
+    jthread_t *jthread = interpreter->jthread;
+    stack_frame_t *currentFrame = jthread->currentStackFrame;
+    code_attribute_t *codeAttribute = method->codeAttribute;
+    cell_t *localVariableBase = currentFrame->operandStackBase + currentFrame->topOfStack - method->numParameters;
+    stack_frame_t *frame = (void *) ALIGN((uintptr_t) (localVariableBase + codeAttribute->maxLocals));
+    void *frameEnd = (void *) frame + sizeof(stack_frame_t) + codeAttribute->maxStack * sizeof(cell_t);
+    if(frameEnd > jthread->stack + jthread->stackSize) {
+        throwException(interpreter, "java/lang/StackOverflowError", "Thread stack is full");
+        return false;
     }
     
-    return resolveMethod0(interpreter, methodClass, methodName, descriptor, isStatic);
+    currentFrame->topOfStack -= method->numParameters;
+    // a local which holds a reference on only some paths may be reported by the stack map, so it starts out as null
+    // rather than as whatever was left on the stack
+    if(codeAttribute->maxLocals > method->numParameters)
+        memset(localVariableBase + method->numParameters, 0, (codeAttribute->maxLocals - method->numParameters) * sizeof(cell_t));
+    frame->previousStackFrame = currentFrame;
+    frame->prevFramePC = jthread->pc + instructionLength;
+    frame->currentMethod = method;
+    frame->localVariableBase = localVariableBase;
+    frame->operandStackBase = (void *) frame + sizeof(stack_frame_t);
+    frame->topOfStack = 0;
+#ifdef BASELINE_JIT
+    frame->compiledCode = atomic_load_explicit(&translatedCode->compiledCode, memory_order_acquire);
+#endif
+    jthread->currentStackFrame = frame;
+    jthread->pc = translatedCode->code;
+    return true;
+}
+
+/**
+ * Finds the implementation of an interface method in the class of the receiver
+ * @param interpreter
+ * @param class the class of the receiver
+ * @param method the resolved interface method
+ * @return the implementation or NULL in which case an exception is thrown
+ */
+method_t *selectInterfaceMethod(bc_interpreter_t *interpreter, class_t *class, method_t *method) {
+    class_t *interface = method->class;
+    // methods of Object can be invoked through an interface
+    if(!(interface->flags & CLASS_ACC_INTERFACE))
+        return class->vtable[method->vtableIndex];
+    // private interface methods are invoked directly
+    if(method->flags & METHOD_ACC_PRIVATE)
+        return method;
+    for(int i = 0; i < class->itableLength; ++i) {
+        if(class->itable[i].interface == interface)
+            return class->itable[i].methods[method - interface->methods];
+    }
+    throwException(interpreter, "java/lang/IncompatibleClassChangeError", "Class does not implement the interface");
+    return NULL;
 }
 
 int handle_instr_xload(bc_interpreter_t *interpreter, bool wide, uint8_t type) {
     jthread_t *jthread = interpreter->jthread;
-    uint16_t index;
-    if(wide)
-        index = readShortOperand(jthread, 2);
-    else
-        index = (uint8_t) readByteOperand(jthread, 1);
+    uint16_t index = jthread->pc[1].u;
     if(type == TYPE_LONG || type == TYPE_DOUBLE)
-        pushOperand2(jthread->currentStackFrame, readLocal2(jthread->currentStackFrame, index, NULL), type);
+        pushOperand2(jthread->currentStackFrame, readLocal2(jthread->currentStackFrame, index, NULL));
     else
-        pushOperand(jthread->currentStackFrame, readLocal(jthread->currentStackFrame, index, NULL), type);
-    return wide ? 4 : 2;
+        pushOperand(jthread->currentStackFrame, readLocal(jthread->currentStackFrame, index, NULL));
+    return 2;
 }
 
-int handle_instr_xstore(bc_interpreter_t *interpreter, bool wide) {
+int handle_instr_xstore(bc_interpreter_t *interpreter, bool wide, uint8_t type) {
     jthread_t *jthread = interpreter->jthread;
-    uint16_t index;
-    if(wide)
-        index = readShortOperand(jthread, 2);
-    else
-        index = (uint8_t) readByteOperand(jthread, 1);
-    uint8_t type = peekOperandType(jthread->currentStackFrame, 0);
+    uint16_t index = jthread->pc[1].u;
     if(type == TYPE_LONG || type == TYPE_DOUBLE)
-        writeLocal2(jthread->currentStackFrame, index, popOperand2(jthread->currentStackFrame, NULL), type);
+        writeLocal2(jthread->currentStackFrame, index, popOperand2(jthread->currentStackFrame));
     else
-        writeLocal(jthread->currentStackFrame, index, popOperand(jthread->currentStackFrame, NULL), type);
-    return wide ? 4 : 2;
+        writeLocal(jthread->currentStackFrame, index, popOperand(jthread->currentStackFrame));
+    return 2;
 }
 
 int handle_instr_xload_n(bc_interpreter_t *interpreter, uint16_t index, uint8_t type) {
     jthread_t *jthread = interpreter->jthread;
     if(type == TYPE_LONG || type == TYPE_DOUBLE)
-        pushOperand2(jthread->currentStackFrame, readLocal2(jthread->currentStackFrame, index, NULL), type);
+        pushOperand2(jthread->currentStackFrame, readLocal2(jthread->currentStackFrame, index, NULL));
     else
-        pushOperand(jthread->currentStackFrame, readLocal(jthread->currentStackFrame, index, NULL), type);
-    return 1;
+        pushOperand(jthread->currentStackFrame, readLocal(jthread->currentStackFrame, index, NULL));
+    return 2;
 }
 
-int handle_instr_xstore_n(bc_interpreter_t *interpreter, uint16_t index) {
+int handle_instr_xstore_n(bc_interpreter_t *interpreter, uint16_t index, uint8_t type) {
     jthread_t *jthread = interpreter->jthread;
-    uint8_t type = peekOperandType(jthread->currentStackFrame, index);
     if(type == TYPE_LONG || type == TYPE_DOUBLE)
-        writeLocal2(jthread->currentStackFrame, index, popOperand2(jthread->currentStackFrame, NULL), type);
+        writeLocal2(jthread->currentStackFrame, index, popOperand2(jthread->currentStackFrame));
     else
-        writeLocal(jthread->currentStackFrame, index, popOperand(jthread->currentStackFrame, NULL), type);
-    return 1;
+        writeLocal(jthread->currentStackFrame, index, popOperand(jthread->currentStackFrame));
+    return 2;
 }
 
 int handle_instr_xaload(bc_interpreter_t *interpreter) {
     jthread_t *jthread = interpreter->jthread;
-    int32_t index = popOperand(jthread->currentStackFrame, NULL).i;
-    slot_t slot = popOperand(jthread->currentStackFrame, NULL).a;
+    int32_t index = popOperand(jthread->currentStackFrame).i;
+    slot_t slot = popOperand(jthread->currentStackFrame).a;
     object_t *obj = getObject(slot);
     
     if(!obj) {
         throwException(interpreter, "java/lang/NullPointerException", "Array was null");
         return 0;
     }
-    if(index < 0 || index >= obj->length) {
+    if(index < 0 || index >= ARRAY_LENGTH(obj)) {
         throwException(interpreter, "java/lang/ArrayIndexOutOfBoundsException", "index was out of bounds for the array");
         return 0;
     }
@@ -352,29 +1523,28 @@ int handle_instr_xaload(bc_interpreter_t *interpreter) {
     uint8_t type = getArrayElementType(obj);
     if(type == TYPE_LONG || type == TYPE_DOUBLE) {
         double_cell_t element = getArrayElement2(obj, index, NULL);
-        pushOperand2(jthread->currentStackFrame, element, type);
+        pushOperand2(jthread->currentStackFrame, element);
     }
     else {
         cell_t element = getArrayElement(obj, index, NULL);
-        pushOperand(jthread->currentStackFrame, element, type);
+        pushOperand(jthread->currentStackFrame, element);
     }
     return 1;
 }
 
-int handle_instr_xastore(bc_interpreter_t *interpreter) {
+int handle_instr_xastore(bc_interpreter_t *interpreter, uint8_t type) {
     jthread_t *jthread = interpreter->jthread;
-    uint8_t type = peekOperandType(jthread->currentStackFrame, 0);
     if(type == TYPE_LONG || type == TYPE_DOUBLE) {
-        double_cell_t value = popOperand2(jthread->currentStackFrame, NULL);
-        int32_t index = popOperand(jthread->currentStackFrame, NULL).i;
-        slot_t slot = popOperand(jthread->currentStackFrame, NULL).a;
+        double_cell_t value = popOperand2(jthread->currentStackFrame);
+        int32_t index = popOperand(jthread->currentStackFrame).i;
+        slot_t slot = popOperand(jthread->currentStackFrame).a;
         object_t *obj = getObject(slot);
     
         if(!obj) {
             throwException(interpreter, "java/lang/NullPointerException", "Array was null");
             return 0;
         }
-        if(index < 0 || index >= obj->length) {
+        if(index < 0 || index >= ARRAY_LENGTH(obj)) {
             throwException(interpreter, "java/lang/ArrayIndexOutOfBoundsException", "index was out of bounds for the array");
             return 0;
         }
@@ -382,20 +1552,22 @@ int handle_instr_xastore(bc_interpreter_t *interpreter) {
         setArrayElement2(obj, index, value);
     }
     else {
-        cell_t value = popOperand(jthread->currentStackFrame, NULL);
-        int32_t index = popOperand(jthread->currentStackFrame, NULL).i;
-        slot_t slot = popOperand(jthread->currentStackFrame, NULL).a;
+        cell_t value = popOperand(jthread->currentStackFrame);
+        int32_t index = popOperand(jthread->currentStackFrame).i;
+        slot_t slot = popOperand(jthread->currentStackFrame).a;
         object_t *obj = getObject(slot);
     
         if(!obj) {
             throwException(interpreter, "java/lang/NullPointerException", "Array was null");
             return 0;
         }
-        if(index < 0 || index >= obj->length) {
+        if(index < 0 || index >= ARRAY_LENGTH(obj)) {
             throwException(interpreter, "java/lang/ArrayIndexOutOfBoundsException", "index was out of bounds for the array");
             return 0;
         }
     
+        if(type == TYPE_REFERENCE)
+            OBJECT_WRITE_BARRIER(jthread, (slot_t *) ARRAY_ELEMENTS(obj) + index);
         setArrayElement(obj, index, value);
     }
     return 1;
@@ -412,132 +1584,132 @@ int handle_instr_nop(bc_interpreter_t *interpreter, bool wide) {
 
 int handle_instr_aconst_null(bc_interpreter_t *interpreter, bool wide) {
     cell_t cell = {.a = 0};
-	pushOperand(interpreter->jthread->currentStackFrame, cell, TYPE_REFERENCE);
+	pushOperand(interpreter->jthread->currentStackFrame, cell);
 	return 1;
 }
 
 int handle_instr_iconst_m1(bc_interpreter_t *interpreter, bool wide) {
     cell_t cell = {.i = -1};
-    pushOperand(interpreter->jthread->currentStackFrame, cell, TYPE_INT);
+    pushOperand(interpreter->jthread->currentStackFrame, cell);
     return 1;
 }
 
 int handle_instr_iconst_0(bc_interpreter_t *interpreter, bool wide) {
     cell_t cell = {.i = 0};
-    pushOperand(interpreter->jthread->currentStackFrame, cell, TYPE_INT);
+    pushOperand(interpreter->jthread->currentStackFrame, cell);
     return 1;
 }
 
 int handle_instr_iconst_1(bc_interpreter_t *interpreter, bool wide) {
     cell_t cell = {.i = 1};
-    pushOperand(interpreter->jthread->currentStackFrame, cell, TYPE_INT);
+    pushOperand(interpreter->jthread->currentStackFrame, cell);
     return 1;
 }
 
 int handle_instr_iconst_2(bc_interpreter_t *interpreter, bool wide) {
     cell_t cell = {.i = 2};
-    pushOperand(interpreter->jthread->currentStackFrame, cell, TYPE_INT);
+    pushOperand(interpreter->jthread->currentStackFrame, cell);
     return 1;
 }
 
 int handle_instr_iconst_3(bc_interpreter_t *interpreter, bool wide) {
     cell_t cell = {.i = 3};
-    pushOperand(interpreter->jthread->currentStackFrame, cell, TYPE_INT);
+    pushOperand(interpreter->jthread->currentStackFrame, cell);
     return 1;
 }
 
 int handle_instr_iconst_4(bc_interpreter_t *interpreter, bool wide) {
     cell_t cell = {.i = 4};
-    pushOperand(interpreter->jthread->currentStackFrame, cell, TYPE_INT);
+    pushOperand(interpreter->jthread->currentStackFrame, cell);
     return 1;
 }
 
 int handle_instr_iconst_5(bc_interpreter_t *interpreter, bool wide) {
     cell_t cell = {.i = 5};
-    pushOperand(interpreter->jthread->currentStackFrame, cell, TYPE_INT);
+    pushOperand(interpreter->jthread->currentStackFrame, cell);
     return 1;
 }
 
 int handle_instr_lconst_0(bc_interpreter_t *interpreter, bool wide) {
     double_cell_t cell = {.l = 0};
-    pushOperand2(interpreter->jthread->currentStackFrame, cell, TYPE_LONG);
+    pushOperand2(interpreter->jthread->currentStackFrame, cell);
     return 1;
 }
 
 int handle_instr_lconst_1(bc_interpreter_t *interpreter, bool wide) {
     double_cell_t cell = {.l = 1};
-    pushOperand2(interpreter->jthread->currentStackFrame, cell, TYPE_LONG);
+    pushOperand2(interpreter->jthread->currentStackFrame, cell);
     return 1;
 }
 
 int handle_instr_fconst_0(bc_interpreter_t *interpreter, bool wide) {
     cell_t cell = {.f = 0.0f};
-    pushOperand(interpreter->jthread->currentStackFrame, cell, TYPE_FLOAT);
+    pushOperand(interpreter->jthread->currentStackFrame, cell);
     return 1;
 }
 
 int handle_instr_fconst_1(bc_interpreter_t *interpreter, bool wide) {
     cell_t cell = {.f = 1.0f};
-    pushOperand(interpreter->jthread->currentStackFrame, cell, TYPE_FLOAT);
+    pushOperand(interpreter->jthread->currentStackFrame, cell);
     return 1;
 }
 
 int handle_instr_fconst_2(bc_interpreter_t *interpreter, bool wide) {
     cell_t cell = {.f = 2.0f};
-    pushOperand(interpreter->jthread->currentStackFrame, cell, TYPE_FLOAT);
+    pushOperand(interpreter->jthread->currentStackFrame, cell);
     return 1;
 }
 
 int handle_instr_dconst_0(bc_interpreter_t *interpreter, bool wide) {
     double_cell_t cell = {.d = 0.0};
-    pushOperand2(interpreter->jthread->currentStackFrame, cell, TYPE_DOUBLE);
+    pushOperand2(interpreter->jthread->currentStackFrame, cell);
     return 1;
 }
 
 int handle_instr_dconst_1(bc_interpreter_t *interpreter, bool wide) {
     double_cell_t cell = {.d = 1.0};
-    pushOperand2(interpreter->jthread->currentStackFrame, cell, TYPE_DOUBLE);
+    pushOperand2(interpreter->jthread->currentStackFrame, cell);
     return 1;
 }
 
 int handle_instr_bipush(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
 	cell_t cell;
-	cell.i = readByteOperand(jthread, 1);
-	pushOperand(jthread->currentStackFrame, cell, TYPE_BYTE);
+	cell.i = jthread->pc[1].i;
+	pushOperand(jthread->currentStackFrame, cell);
 	return 2;
 }
 
 int handle_instr_sipush(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
     cell_t cell;
-    cell.i = readShortOperand(jthread, 1);
-    pushOperand(jthread->currentStackFrame, cell, TYPE_SHORT);
-    return 3;
+    cell.i = jthread->pc[1].i;
+    pushOperand(jthread->currentStackFrame, cell);
+    return 2;
 }
 
 int handle_instr_ldc(bc_interpreter_t *interpreter, bool wide) {
-	uint8_t index = readByteOperand(interpreter->jthread, 1);
+	uint16_t index = interpreter->jthread->pc[1].u;
 	constant_info_t *constant = interpreter->jthread->currentStackFrame->currentMethod->class->constantPool[index];
 	uint8_t tag = constant->integerFloatInfo.tag;
 	cell_t cell;
 	if(tag == CONSTANT_Integer) {
 	    cell.a = constant->integerFloatInfo.bytes;
-	    pushOperand(interpreter->jthread->currentStackFrame, cell, TYPE_INT);
+	    pushOperand(interpreter->jthread->currentStackFrame, cell);
 	}
 	else if(tag == CONSTANT_Float) {
         cell.a = constant->integerFloatInfo.bytes;
-        pushOperand(interpreter->jthread->currentStackFrame, cell, TYPE_FLOAT);
+        pushOperand(interpreter->jthread->currentStackFrame, cell);
 	}
 	else if(tag == CONSTANT_String) {
 	    uint16_t stringIndex = constant->stringInfo.stringIndex;
 	    char *characters = interpreter->jthread->currentStackFrame->currentMethod->class->constantPool[stringIndex]->utf8Info.chars;
-        cell.a = convertToJavaString(characters);
+        cell.a = convertToJavaString(interpreter->jthread, characters);
         if(!cell.a) {
             throwException(interpreter, "java/lang/OutOfMemoryError", "Failed to load string from constant pool");
             return 0;
         }
-        pushOperand(interpreter->jthread->currentStackFrame, cell, TYPE_REFERENCE);
+        pushOperand(interpreter->jthread->currentStackFrame, cell);
 	}
     else {
         // TODO implement remaining constants
@@ -548,50 +1720,50 @@ int handle_instr_ldc(bc_interpreter_t *interpreter, bool wide) {
 }
 
 int handle_instr_ldc_w(bc_interpreter_t *interpreter, bool wide) {
-    uint16_t index = readShortOperand(interpreter->jthread, 1);
+    uint16_t index = interpreter->jthread->pc[1].u;
     constant_info_t *constant = interpreter->jthread->currentStackFrame->currentMethod->class->constantPool[index];
     uint8_t tag = constant->integerFloatInfo.tag;
     cell_t cell;
     if(tag == CONSTANT_Integer) {
         cell.a = constant->integerFloatInfo.bytes;
-        pushOperand(interpreter->jthread->currentStackFrame, cell, TYPE_INT);
+        pushOperand(interpreter->jthread->currentStackFrame, cell);
     }
     else if(tag == CONSTANT_Float) {
         cell.a = constant->integerFloatInfo.bytes;
-        pushOperand(interpreter->jthread->currentStackFrame, cell, TYPE_FLOAT);
+        pushOperand(interpreter->jthread->currentStackFrame, cell);
     }
     else if(tag == CONSTANT_String) {
         uint16_t stringIndex = constant->stringInfo.stringIndex;
         char *characters = interpreter->jthread->currentStackFrame->currentMethod->class->constantPool[stringIndex]->utf8Info.chars;
-        cell.a = convertToJavaString(characters);
+        cell.a = convertToJavaString(interpreter->jthread, characters);
         if(!cell.a) {
             throwException(interpreter, "java/lang/OutOfMemoryError", "Failed to load string from constant pool");
             return 0;
         }
-        pushOperand(interpreter->jthread->currentStackFrame, cell, TYPE_REFERENCE);
+        pushOperand(interpreter->jthread->currentStackFrame, cell);
     }
     else {
         // TODO implement remaining constants
         throwException(interpreter, "java/lang/InternalError", "Unsupported ldc constant");
         return 0;
     }
-    return 3;
+    return 2;
 }
 
 int handle_instr_ldc2_w(bc_interpreter_t *interpreter, bool wide) {
-    uint16_t index = readShortOperand(interpreter->jthread, 1);
+    uint16_t index = interpreter->jthread->pc[1].u;
     constant_info_t *constant = interpreter->jthread->currentStackFrame->currentMethod->class->constantPool[index];
     uint8_t tag = constant->longDoubleInfo.tag;
     double_cell_t cell;
     if(tag == CONSTANT_Long) {
         cell.l = constant->longDoubleInfo.bytes;
-        pushOperand2(interpreter->jthread->currentStackFrame, cell, TYPE_LONG);
+        pushOperand2(interpreter->jthread->currentStackFrame, cell);
     }
     else if(tag == CONSTANT_Double) {
         cell.l = constant->longDoubleInfo.bytes;
-        pushOperand2(interpreter->jthread->currentStackFrame, cell, TYPE_DOUBLE);
+        pushOperand2(interpreter->jthread->currentStackFrame, cell);
     }
-    return 3;
+    return 2;
 }
 
 int handle_instr_iload(bc_interpreter_t *interpreter, bool wide) {
@@ -727,135 +1899,135 @@ int handle_instr_saload(bc_interpreter_t *interpreter, bool wide) {
 }
 
 int handle_instr_istore(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xstore(interpreter, wide);
+    return handle_instr_xstore(interpreter, wide, TYPE_INT);
 }
 
 int handle_instr_lstore(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xstore(interpreter, wide);
+    return handle_instr_xstore(interpreter, wide, TYPE_LONG);
 }
 
 int handle_instr_fstore(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xstore(interpreter, wide);
+    return handle_instr_xstore(interpreter, wide, TYPE_FLOAT);
 }
 
 int handle_instr_dstore(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xstore(interpreter, wide);
+    return handle_instr_xstore(interpreter, wide, TYPE_DOUBLE);
 }
 
 int handle_instr_astore(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xstore(interpreter, wide);
+    return handle_instr_xstore(interpreter, wide, TYPE_REFERENCE);
 }
 
 int handle_instr_istore_0(bc_interpreter_t *interpreter, bool wide) {
-	return handle_instr_xstore_n(interpreter, 0);
+	return handle_instr_xstore_n(interpreter, 0, TYPE_INT);
 }
 
 int handle_instr_istore_1(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xstore_n(interpreter, 1);
+    return handle_instr_xstore_n(interpreter, 1, TYPE_INT);
 }
 
 int handle_instr_istore_2(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xstore_n(interpreter, 2);
+    return handle_instr_xstore_n(interpreter, 2, TYPE_INT);
 }
 
 int handle_instr_istore_3(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xstore_n(interpreter, 3);
+    return handle_instr_xstore_n(interpreter, 3, TYPE_INT);
 }
 
 int handle_instr_lstore_0(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xstore_n(interpreter, 0);
+    return handle_instr_xstore_n(interpreter, 0, TYPE_LONG);
 }
 
 int handle_instr_lstore_1(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xstore_n(interpreter, 1);
+    return handle_instr_xstore_n(interpreter, 1, TYPE_LONG);
 }
 
 int handle_instr_lstore_2(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xstore_n(interpreter, 2);
+    return handle_instr_xstore_n(interpreter, 2, TYPE_LONG);
 }
 
 int handle_instr_lstore_3(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xstore_n(interpreter, 3);
+    return handle_instr_xstore_n(interpreter, 3, TYPE_LONG);
 }
 
 int handle_instr_fstore_0(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xstore_n(interpreter, 0);
+    return handle_instr_xstore_n(interpreter, 0, TYPE_FLOAT);
 }
 
 int handle_instr_fstore_1(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xstore_n(interpreter, 1);
+    return handle_instr_xstore_n(interpreter, 1, TYPE_FLOAT);
 }
 
 int handle_instr_fstore_2(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xstore_n(interpreter, 2);
+    return handle_instr_xstore_n(interpreter, 2, TYPE_FLOAT);
 }
 
 int handle_instr_fstore_3(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xstore_n(interpreter, 3);
+    return handle_instr_xstore_n(interpreter, 3, TYPE_FLOAT);
 }
 
 int handle_instr_dstore_0(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xstore_n(interpreter, 0);
+    return handle_instr_xstore_n(interpreter, 0, TYPE_DOUBLE);
 }
 
 int handle_instr_dstore_1(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xstore_n(interpreter, 1);
+    return handle_instr_xstore_n(interpreter, 1, TYPE_DOUBLE);
 }
 
 int handle_instr_dstore_2(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xstore_n(interpreter, 2);
+    return handle_instr_xstore_n(interpreter, 2, TYPE_DOUBLE);
 }
 
 int handle_instr_dstore_3(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xstore_n(interpreter, 3);
+    return handle_instr_xstore_n(interpreter, 3, TYPE_DOUBLE);
 }
 
 int handle_instr_astore_0(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xstore_n(interpreter, 0);
+    return handle_instr_xstore_n(interpreter, 0, TYPE_REFERENCE);
 }
 
 int handle_instr_astore_1(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xstore_n(interpreter, 1);
+    return handle_instr_xstore_n(interpreter, 1, TYPE_REFERENCE);
 }
 
 int handle_instr_astore_2(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xstore_n(interpreter, 2);
+    return handle_instr_xstore_n(interpreter, 2, TYPE_REFERENCE);
 }
 
 int handle_instr_astore_3(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xstore_n(interpreter, 3);
+    return handle_instr_xstore_n(interpreter, 3, TYPE_REFERENCE);
 }
 
 int handle_instr_iastore(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xastore(interpreter);
+    return handle_instr_xastore(interpreter, TYPE_INT);
 }
 
 int handle_instr_lastore(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xastore(interpreter);
+    return handle_instr_xastore(interpreter, TYPE_LONG);
 }
 
 int handle_instr_fastore(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xastore(interpreter);
+    return handle_instr_xastore(interpreter, TYPE_FLOAT);
 }
 
 int handle_instr_dastore(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xastore(interpreter);
+    return handle_instr_xastore(interpreter, TYPE_DOUBLE);
 }
 
 int handle_instr_aastore(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xastore(interpreter);
+    return handle_instr_xastore(interpreter, TYPE_REFERENCE);
 }
 
 int handle_instr_bastore(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xastore(interpreter);
+    return handle_instr_xastore(interpreter, TYPE_BYTE);
 }
 
 int handle_instr_castore(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xastore(interpreter);
+    return handle_instr_xastore(interpreter, TYPE_CHAR);
 }
 
 int handle_instr_sastore(bc_interpreter_t *interpreter, bool wide) {
-    return handle_instr_xastore(interpreter);
+    return handle_instr_xastore(interpreter, TYPE_SHORT);
 }
 
 int handle_instr_pop(bc_interpreter_t *interpreter, bool wide) {
@@ -870,580 +2042,571 @@ int handle_instr_pop2(bc_interpreter_t *interpreter, bool wide) {
 
 int handle_instr_dup(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    uint8_t tosType;
-	pushOperand(jthread->currentStackFrame, peekOperand(jthread->currentStackFrame, 0, &tosType), tosType);
-	return 1;
+    cell_t top = peekOperand(jthread->currentStackFrame, 0);
+    pushOperand(jthread->currentStackFrame, top);
+    return 1;
 }
 
 int handle_instr_dup_x1(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    uint8_t tosType;
-    uint8_t nextType;
-	cell_t top = popOperand(jthread->currentStackFrame, &tosType);
-	cell_t next = popOperand(jthread->currentStackFrame, &nextType);
-	pushOperand(jthread->currentStackFrame, top, tosType);
-    pushOperand(jthread->currentStackFrame, next, nextType);
-    pushOperand(jthread->currentStackFrame, top, tosType);
+	cell_t top = popOperand(jthread->currentStackFrame);
+	cell_t next = popOperand(jthread->currentStackFrame);
+	pushOperand(jthread->currentStackFrame, top);
+    pushOperand(jthread->currentStackFrame, next);
+    pushOperand(jthread->currentStackFrame, top);
     return 1;
 }
 
 int handle_instr_dup_x2(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    uint8_t tosType;
-    uint8_t nextType;
-    uint8_t next2Type;
-    cell_t top = popOperand(jthread->currentStackFrame, &tosType);
-    cell_t next = popOperand(jthread->currentStackFrame, &nextType);
-    cell_t next2 = popOperand(jthread->currentStackFrame, &next2Type);
-    pushOperand(jthread->currentStackFrame, top, tosType);
-    pushOperand(jthread->currentStackFrame, next2, next2Type);
-    pushOperand(jthread->currentStackFrame, next, nextType);
-    pushOperand(jthread->currentStackFrame, top, tosType);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    cell_t next = popOperand(jthread->currentStackFrame);
+    cell_t next2 = popOperand(jthread->currentStackFrame);
+    pushOperand(jthread->currentStackFrame, top);
+    pushOperand(jthread->currentStackFrame, next2);
+    pushOperand(jthread->currentStackFrame, next);
+    pushOperand(jthread->currentStackFrame, top);
     return 1;
 }
 
 int handle_instr_dup2(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    uint8_t tosType;
-    uint8_t nextType;
-    pushOperand(jthread->currentStackFrame, peekOperand(jthread->currentStackFrame, 1, &nextType), nextType);
-    pushOperand(jthread->currentStackFrame, peekOperand(jthread->currentStackFrame, 1, &tosType), tosType);
+    cell_t top = peekOperand(jthread->currentStackFrame, 0);
+    cell_t next = peekOperand(jthread->currentStackFrame, 1);
+    pushOperand(jthread->currentStackFrame, next);
+    pushOperand(jthread->currentStackFrame, top);
     return 1;
 }
 
 int handle_instr_dup2_x1(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-	uint8_t tosType;
-	uint8_t nextType;
-    uint8_t next2Type;
-	cell_t top = popOperand(jthread->currentStackFrame, &tosType);
-	cell_t next = popOperand(jthread->currentStackFrame, &nextType);
-    cell_t next2 = popOperand(jthread->currentStackFrame, &next2Type);
-    pushOperand(jthread->currentStackFrame, next, nextType);
-    pushOperand(jthread->currentStackFrame, top, tosType);
-    pushOperand(jthread->currentStackFrame, next2, next2Type);
-    pushOperand(jthread->currentStackFrame, next, nextType);
-    pushOperand(jthread->currentStackFrame, top, tosType);
+	cell_t top = popOperand(jthread->currentStackFrame);
+	cell_t next = popOperand(jthread->currentStackFrame);
+    cell_t next2 = popOperand(jthread->currentStackFrame);
+    pushOperand(jthread->currentStackFrame, next);
+    pushOperand(jthread->currentStackFrame, top);
+    pushOperand(jthread->currentStackFrame, next2);
+    pushOperand(jthread->currentStackFrame, next);
+    pushOperand(jthread->currentStackFrame, top);
     return 1;
 }
 
 int handle_instr_dup2_x2(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    uint8_t tosType;
-    uint8_t nextType;
-    uint8_t nextType2;
-    uint8_t nextType3;
-    cell_t top = popOperand(jthread->currentStackFrame, &tosType);
-    cell_t next = popOperand(jthread->currentStackFrame, &nextType);
-    cell_t next2 = popOperand(jthread->currentStackFrame, &nextType2);
-    cell_t next3 = popOperand(jthread->currentStackFrame, &nextType3);
-    pushOperand(jthread->currentStackFrame, next, nextType);
-    pushOperand(jthread->currentStackFrame, top, tosType);
-    pushOperand(jthread->currentStackFrame, next3, nextType3);
-    pushOperand(jthread->currentStackFrame, next2, nextType2);
-    pushOperand(jthread->currentStackFrame, next, nextType);
-    pushOperand(jthread->currentStackFrame, top, tosType);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    cell_t next = popOperand(jthread->currentStackFrame);
+    cell_t next2 = popOperand(jthread->currentStackFrame);
+    cell_t next3 = popOperand(jthread->currentStackFrame);
+    pushOperand(jthread->currentStackFrame, next);
+    pushOperand(jthread->currentStackFrame, top);
+    pushOperand(jthread->currentStackFrame, next3);
+    pushOperand(jthread->currentStackFrame, next2);
+    pushOperand(jthread->currentStackFrame, next);
+    pushOperand(jthread->currentStackFrame, top);
     return 1;
 }
 
 int handle_instr_swap(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    uint8_t tosType;
-    uint8_t nextType;
-    cell_t top = popOperand(jthread->currentStackFrame, &tosType);
-    cell_t next = popOperand(jthread->currentStackFrame, &nextType);
-    pushOperand(jthread->currentStackFrame, top, tosType);
-    pushOperand(jthread->currentStackFrame, next, nextType);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    cell_t next = popOperand(jthread->currentStackFrame);
+    pushOperand(jthread->currentStackFrame, top);
+    pushOperand(jthread->currentStackFrame, next);
     return 1;
 }
 
 int handle_instr_iadd(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-	cell_t top = popOperand(jthread->currentStackFrame, NULL);
-	cell_t next = popOperand(jthread->currentStackFrame, NULL);
+	cell_t top = popOperand(jthread->currentStackFrame);
+	cell_t next = popOperand(jthread->currentStackFrame);
 	top.i += next.i;
-	pushOperand(jthread->currentStackFrame, top, TYPE_INT);
+	pushOperand(jthread->currentStackFrame, top);
 	return 1;
 }
 
 int handle_instr_ladd(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    double_cell_t top = popOperand2(jthread->currentStackFrame, NULL);
-    double_cell_t next = popOperand2(jthread->currentStackFrame, NULL);
+    double_cell_t top = popOperand2(jthread->currentStackFrame);
+    double_cell_t next = popOperand2(jthread->currentStackFrame);
     top.l += next.l;
-    pushOperand2(jthread->currentStackFrame, top, TYPE_LONG);
+    pushOperand2(jthread->currentStackFrame, top);
     return 1;
 }
 
 int handle_instr_fadd(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    cell_t next = popOperand(jthread->currentStackFrame, NULL);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    cell_t next = popOperand(jthread->currentStackFrame);
     top.f += next.f;
-    pushOperand(jthread->currentStackFrame, top, TYPE_FLOAT);
+    pushOperand(jthread->currentStackFrame, top);
     return 1;
 }
 
 int handle_instr_dadd(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    double_cell_t top = popOperand2(jthread->currentStackFrame, NULL);
-    double_cell_t next = popOperand2(jthread->currentStackFrame, NULL);
+    double_cell_t top = popOperand2(jthread->currentStackFrame);
+    double_cell_t next = popOperand2(jthread->currentStackFrame);
     top.d += next.d;
-    pushOperand2(jthread->currentStackFrame, top, TYPE_DOUBLE);
+    pushOperand2(jthread->currentStackFrame, top);
     return 1;
 }
 
 int handle_instr_isub(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    cell_t next = popOperand(jthread->currentStackFrame, NULL);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    cell_t next = popOperand(jthread->currentStackFrame);
     next.i -= top.i;
-    pushOperand(jthread->currentStackFrame, next, TYPE_INT);
+    pushOperand(jthread->currentStackFrame, next);
     return 1;
 }
 
 int handle_instr_lsub(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    double_cell_t top = popOperand2(jthread->currentStackFrame, NULL);
-    double_cell_t next = popOperand2(jthread->currentStackFrame, NULL);
+    double_cell_t top = popOperand2(jthread->currentStackFrame);
+    double_cell_t next = popOperand2(jthread->currentStackFrame);
     next.l -= top.l;
-    pushOperand2(jthread->currentStackFrame, next, TYPE_LONG);
+    pushOperand2(jthread->currentStackFrame, next);
     return 1;
 }
 
 int handle_instr_fsub(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    cell_t next = popOperand(jthread->currentStackFrame, NULL);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    cell_t next = popOperand(jthread->currentStackFrame);
     next.f -= top.f;
-    pushOperand(jthread->currentStackFrame, next, TYPE_FLOAT);
+    pushOperand(jthread->currentStackFrame, next);
     return 1;
 }
 
 int handle_instr_dsub(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    double_cell_t top = popOperand2(jthread->currentStackFrame, NULL);
-    double_cell_t next = popOperand2(jthread->currentStackFrame, NULL);
+    double_cell_t top = popOperand2(jthread->currentStackFrame);
+    double_cell_t next = popOperand2(jthread->currentStackFrame);
     next.d -= top.d;
-    pushOperand2(jthread->currentStackFrame, next, TYPE_DOUBLE);
+    pushOperand2(jthread->currentStackFrame, next);
     return 1;
 }
 
 int handle_instr_imul(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    cell_t next = popOperand(jthread->currentStackFrame, NULL);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    cell_t next = popOperand(jthread->currentStackFrame);
     top.i *= next.i;
-    pushOperand(jthread->currentStackFrame, top, TYPE_INT);
+    pushOperand(jthread->currentStackFrame, top);
     return 1;
 }
 
 int handle_instr_lmul(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    double_cell_t top = popOperand2(jthread->currentStackFrame, NULL);
-    double_cell_t next = popOperand2(jthread->currentStackFrame, NULL);
+    double_cell_t top = popOperand2(jthread->currentStackFrame);
+    double_cell_t next = popOperand2(jthread->currentStackFrame);
     top.l *= next.l;
-    pushOperand2(jthread->currentStackFrame, top, TYPE_LONG);
+    pushOperand2(jthread->currentStackFrame, top);
     return 1;
 }
 
 int handle_instr_fmul(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    cell_t next = popOperand(jthread->currentStackFrame, NULL);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    cell_t next = popOperand(jthread->currentStackFrame);
     top.f *= next.f;
-    pushOperand(jthread->currentStackFrame, top, TYPE_FLOAT);
+    pushOperand(jthread->currentStackFrame, top);
     return 1;
 }
 
 int handle_instr_dmul(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    double_cell_t top = popOperand2(jthread->currentStackFrame, NULL);
-    double_cell_t next = popOperand2(jthread->currentStackFrame, NULL);
+    double_cell_t top = popOperand2(jthread->currentStackFrame);
+    double_cell_t next = popOperand2(jthread->currentStackFrame);
     top.d *= next.d;
-    pushOperand2(jthread->currentStackFrame, top, TYPE_DOUBLE);
+    pushOperand2(jthread->currentStackFrame, top);
     return 1;
 }
 
 int handle_instr_idiv(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    cell_t next = popOperand(jthread->currentStackFrame, NULL);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    cell_t next = popOperand(jthread->currentStackFrame);
     if(top.i == 0) {
         throwException(interpreter, "java/lang/ArithmeticException", "Cannot divide by 0");
         return 0;
     }
-    next.i /= top.i;
-    pushOperand(jthread->currentStackFrame, next, TYPE_INT);
+    // INT32_MIN / -1 traps on x86 so negate instead. Java defines the result as INT32_MIN
+    if(top.i == -1)
+        next.i = (int32_t) -(uint32_t) next.i;
+    else
+        next.i /= top.i;
+    pushOperand(jthread->currentStackFrame, next);
     return 1;
 }
 
 int handle_instr_ldiv(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    double_cell_t top = popOperand2(jthread->currentStackFrame, NULL);
-    double_cell_t next = popOperand2(jthread->currentStackFrame, NULL);
+    double_cell_t top = popOperand2(jthread->currentStackFrame);
+    double_cell_t next = popOperand2(jthread->currentStackFrame);
     if(top.l == 0) {
         throwException(interpreter, "java/lang/ArithmeticException", "Cannot divide by 0");
         return 0;
     }
-    next.l /= top.l;
-    pushOperand2(jthread->currentStackFrame, next, TYPE_LONG);
+    if(top.l == -1)
+        next.l = (int64_t) -(uint64_t) next.l;
+    else
+        next.l /= top.l;
+    pushOperand2(jthread->currentStackFrame, next);
     return 1;
 }
 
 int handle_instr_fdiv(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    cell_t next = popOperand(jthread->currentStackFrame, NULL);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    cell_t next = popOperand(jthread->currentStackFrame);
     next.f /= top.f;
-    pushOperand(jthread->currentStackFrame, next, TYPE_FLOAT);
+    pushOperand(jthread->currentStackFrame, next);
     return 1;
 }
 
 int handle_instr_ddiv(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    double_cell_t top = popOperand2(jthread->currentStackFrame, NULL);
-    double_cell_t next = popOperand2(jthread->currentStackFrame, NULL);
+    double_cell_t top = popOperand2(jthread->currentStackFrame);
+    double_cell_t next = popOperand2(jthread->currentStackFrame);
     next.d /= top.d;
-    pushOperand2(jthread->currentStackFrame, next, TYPE_DOUBLE);
+    pushOperand2(jthread->currentStackFrame, next);
     return 1;
 }
 
 int handle_instr_irem(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    cell_t next = popOperand(jthread->currentStackFrame, NULL);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    cell_t next = popOperand(jthread->currentStackFrame);
     if(top.i == 0) {
         throwException(interpreter, "java/lang/ArithmeticException", "Cannot divide by 0");
         return 0;
     }
-    next.i %= top.i;
-    pushOperand(jthread->currentStackFrame, next, TYPE_INT);
+    if(top.i == -1)
+        next.i = 0;
+    else
+        next.i %= top.i;
+    pushOperand(jthread->currentStackFrame, next);
     return 1;
 }
 
 int handle_instr_lrem(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    double_cell_t top = popOperand2(jthread->currentStackFrame, NULL);
-    double_cell_t next = popOperand2(jthread->currentStackFrame, NULL);
+    double_cell_t top = popOperand2(jthread->currentStackFrame);
+    double_cell_t next = popOperand2(jthread->currentStackFrame);
     if(top.l == 0) {
         throwException(interpreter, "java/lang/ArithmeticException", "Cannot divide by 0");
         return 0;
     }
-    next.l %= top.l;
-    pushOperand2(jthread->currentStackFrame, next, TYPE_LONG);
+    if(top.l == -1)
+        next.l = 0;
+    else
+        next.l %= top.l;
+    pushOperand2(jthread->currentStackFrame, next);
     return 1;
 }
 
 int handle_instr_frem(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    cell_t next = popOperand(jthread->currentStackFrame, NULL);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    cell_t next = popOperand(jthread->currentStackFrame);
     next.f = fmodf(next.f, top.f);
-    pushOperand(jthread->currentStackFrame, next, TYPE_FLOAT);
+    pushOperand(jthread->currentStackFrame, next);
     return 1;
 }
 
 int handle_instr_drem(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    double_cell_t top = popOperand2(jthread->currentStackFrame, NULL);
-    double_cell_t next = popOperand2(jthread->currentStackFrame, NULL);
+    double_cell_t top = popOperand2(jthread->currentStackFrame);
+    double_cell_t next = popOperand2(jthread->currentStackFrame);
     next.d = fmod(next.d, top.d);
-    pushOperand2(jthread->currentStackFrame, next, TYPE_DOUBLE);
+    pushOperand2(jthread->currentStackFrame, next);
     return 1;
 }
 
 int handle_instr_ineg(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-	cell_t top = popOperand(jthread->currentStackFrame, NULL);
+	cell_t top = popOperand(jthread->currentStackFrame);
 	top.i = -top.i;
-	pushOperand(jthread->currentStackFrame, top, TYPE_INT);
+	pushOperand(jthread->currentStackFrame, top);
 	return 1;
 }
 
 int handle_instr_lneg(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    double_cell_t top = popOperand2(jthread->currentStackFrame, NULL);
+    double_cell_t top = popOperand2(jthread->currentStackFrame);
     top.l = -top.l;
-    pushOperand2(jthread->currentStackFrame, top, TYPE_LONG);
+    pushOperand2(jthread->currentStackFrame, top);
     return 1;
 }
 
 int handle_instr_fneg(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
+    cell_t top = popOperand(jthread->currentStackFrame);
     top.f = -top.f;
-    pushOperand(jthread->currentStackFrame, top, TYPE_FLOAT);
+    pushOperand(jthread->currentStackFrame, top);
     return 1;
 }
 
 int handle_instr_dneg(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    double_cell_t top = popOperand2(jthread->currentStackFrame, NULL);
+    double_cell_t top = popOperand2(jthread->currentStackFrame);
     top.d = -top.d;
-    pushOperand2(jthread->currentStackFrame, top, TYPE_DOUBLE);
+    pushOperand2(jthread->currentStackFrame, top);
     return 1;
 }
 
 int handle_instr_ishl(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    cell_t next = popOperand(jthread->currentStackFrame, NULL);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    cell_t next = popOperand(jthread->currentStackFrame);
     next.i <<= top.i;
-    pushOperand(jthread->currentStackFrame, next, TYPE_INT);
+    pushOperand(jthread->currentStackFrame, next);
     return 1;
 }
 
 int handle_instr_lshl(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    double_cell_t next = popOperand2(jthread->currentStackFrame, NULL);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    double_cell_t next = popOperand2(jthread->currentStackFrame);
     next.l <<= top.i;
-    pushOperand2(jthread->currentStackFrame, next, TYPE_LONG);
+    pushOperand2(jthread->currentStackFrame, next);
     return 1;
 }
 
 int handle_instr_ishr(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    cell_t next = popOperand(jthread->currentStackFrame, NULL);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    cell_t next = popOperand(jthread->currentStackFrame);
     next.i >>= top.i;
-    pushOperand(jthread->currentStackFrame, next, TYPE_INT);
+    pushOperand(jthread->currentStackFrame, next);
     return 1;
 }
 
 int handle_instr_lshr(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    double_cell_t next = popOperand2(jthread->currentStackFrame, NULL);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    double_cell_t next = popOperand2(jthread->currentStackFrame);
     next.l >>= top.i;
-    pushOperand2(jthread->currentStackFrame, next, TYPE_LONG);
+    pushOperand2(jthread->currentStackFrame, next);
     return 1;
 }
 
 int handle_instr_iushr(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    cell_t next = popOperand(jthread->currentStackFrame, NULL);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    cell_t next = popOperand(jthread->currentStackFrame);
     next.i = ((uint32_t) next.i) >> top.i;
-    pushOperand(jthread->currentStackFrame, next, TYPE_INT);
+    pushOperand(jthread->currentStackFrame, next);
     return 1;
 }
 
 int handle_instr_lushr(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    double_cell_t next = popOperand2(jthread->currentStackFrame, NULL);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    double_cell_t next = popOperand2(jthread->currentStackFrame);
     next.l = ((uint64_t) next.l) >> top.i;
-    pushOperand2(jthread->currentStackFrame, next, TYPE_LONG);
+    pushOperand2(jthread->currentStackFrame, next);
     return 1;
 }
 
 int handle_instr_iand(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    cell_t next = popOperand(jthread->currentStackFrame, NULL);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    cell_t next = popOperand(jthread->currentStackFrame);
     top.i &= next.i;
-    pushOperand(jthread->currentStackFrame, top, TYPE_INT);
+    pushOperand(jthread->currentStackFrame, top);
     return 1;
 }
 
 int handle_instr_land(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    double_cell_t top = popOperand2(jthread->currentStackFrame, NULL);
-    double_cell_t next = popOperand2(jthread->currentStackFrame, NULL);
+    double_cell_t top = popOperand2(jthread->currentStackFrame);
+    double_cell_t next = popOperand2(jthread->currentStackFrame);
     top.l &= next.l;
-    pushOperand2(jthread->currentStackFrame, top, TYPE_LONG);
+    pushOperand2(jthread->currentStackFrame, top);
     return 1;
 }
 
 int handle_instr_ior(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    cell_t next = popOperand(jthread->currentStackFrame, NULL);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    cell_t next = popOperand(jthread->currentStackFrame);
     top.i |= next.i;
-    pushOperand(jthread->currentStackFrame, top, TYPE_INT);
+    pushOperand(jthread->currentStackFrame, top);
     return 1;
 }
 
 int handle_instr_lor(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    double_cell_t top = popOperand2(jthread->currentStackFrame, NULL);
-    double_cell_t next = popOperand2(jthread->currentStackFrame, NULL);
+    double_cell_t top = popOperand2(jthread->currentStackFrame);
+    double_cell_t next = popOperand2(jthread->currentStackFrame);
     top.l |= next.l;
-    pushOperand2(jthread->currentStackFrame, top, TYPE_LONG);
+    pushOperand2(jthread->currentStackFrame, top);
     return 1;
 }
 
 int handle_instr_ixor(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    cell_t next = popOperand(jthread->currentStackFrame, NULL);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    cell_t next = popOperand(jthread->currentStackFrame);
     top.i ^= next.i;
-    pushOperand(jthread->currentStackFrame, top, TYPE_INT);
+    pushOperand(jthread->currentStackFrame, top);
     return 1;
 }
 
 int handle_instr_lxor(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    double_cell_t top = popOperand2(jthread->currentStackFrame, NULL);
-    double_cell_t next = popOperand2(jthread->currentStackFrame, NULL);
+    double_cell_t top = popOperand2(jthread->currentStackFrame);
+    double_cell_t next = popOperand2(jthread->currentStackFrame);
     top.l ^= next.l;
-    pushOperand2(jthread->currentStackFrame, top, TYPE_LONG);
+    pushOperand2(jthread->currentStackFrame, top);
     return 1;
 }
 
 int handle_instr_iinc(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-	uint16_t index;
-	int16_t amt;
-	if(wide) {
-	    index = readShortOperand(jthread, 2);
-	    amt = readShortOperand(jthread, 4);
-	}
-	else {
-	    index = (uint8_t) readByteOperand(jthread, 1);
-	    amt = readByteOperand(jthread, 2);
-	}
+	uint16_t index = jthread->pc[1].u;
+	int32_t amt = jthread->pc[2].i;
 	cell_t cell = readLocal(jthread->currentStackFrame, index, NULL);
 	cell.i += amt;
-	writeLocal(jthread->currentStackFrame, index, cell, TYPE_INT);
-    return wide ? 6 : 3;
+	writeLocal(jthread->currentStackFrame, index, cell);
+    return 3;
 }
 
 int handle_instr_i2l(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-	cell_t cell = popOperand(jthread->currentStackFrame, NULL);
+	cell_t cell = popOperand(jthread->currentStackFrame);
 	double_cell_t dcell = {.l = cell.i};
-	pushOperand2(jthread->currentStackFrame, dcell, TYPE_LONG);
+	pushOperand2(jthread->currentStackFrame, dcell);
     return 1;
 }
 
 int handle_instr_i2f(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-	cell_t cell = popOperand(jthread->currentStackFrame, NULL);
+	cell_t cell = popOperand(jthread->currentStackFrame);
 	cell.f = cell.i;
-	pushOperand(jthread->currentStackFrame, cell, TYPE_FLOAT);
+	pushOperand(jthread->currentStackFrame, cell);
     return 1;
 }
 
 int handle_instr_i2d(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t cell = popOperand(jthread->currentStackFrame, NULL);
+    cell_t cell = popOperand(jthread->currentStackFrame);
     double_cell_t dcell = {.d = cell.i};
-    pushOperand2(jthread->currentStackFrame, dcell, TYPE_DOUBLE);
+    pushOperand2(jthread->currentStackFrame, dcell);
     return 1;
 }
 
 int handle_instr_l2i(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-	double_cell_t dcell = popOperand2(jthread->currentStackFrame, NULL);
+	double_cell_t dcell = popOperand2(jthread->currentStackFrame);
 	cell_t cell = {.i = dcell.l};
-	pushOperand(jthread->currentStackFrame, cell, TYPE_INT);
+	pushOperand(jthread->currentStackFrame, cell);
     return 1;
 }
 
 int handle_instr_l2f(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    double_cell_t dcell = popOperand2(jthread->currentStackFrame, NULL);
+    double_cell_t dcell = popOperand2(jthread->currentStackFrame);
     cell_t cell = {.f = dcell.l};
-    pushOperand(jthread->currentStackFrame, cell, TYPE_FLOAT);
+    pushOperand(jthread->currentStackFrame, cell);
     return 1;
 }
 
 int handle_instr_l2d(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    double_cell_t dcell = popOperand2(jthread->currentStackFrame, NULL);
+    double_cell_t dcell = popOperand2(jthread->currentStackFrame);
     dcell.d = dcell.l;
-    pushOperand2(jthread->currentStackFrame, dcell, TYPE_INT);
+    pushOperand2(jthread->currentStackFrame, dcell);
     return 1;
 }
 
 int handle_instr_f2i(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t cell = popOperand(jthread->currentStackFrame, NULL);
+    cell_t cell = popOperand(jthread->currentStackFrame);
     cell.i = cell.f;
-    pushOperand(jthread->currentStackFrame, cell, TYPE_INT);
+    pushOperand(jthread->currentStackFrame, cell);
     return 1;
 }
 
 int handle_instr_f2l(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t cell = popOperand(jthread->currentStackFrame, NULL);
+    cell_t cell = popOperand(jthread->currentStackFrame);
     double_cell_t dcell = {.l = cell.f};
-    pushOperand2(jthread->currentStackFrame, dcell, TYPE_LONG);
+    pushOperand2(jthread->currentStackFrame, dcell);
     return 1;
 }
 
 int handle_instr_f2d(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t cell = popOperand(jthread->currentStackFrame, NULL);
+    cell_t cell = popOperand(jthread->currentStackFrame);
     double_cell_t dcell = {.d = cell.f};
-    pushOperand2(jthread->currentStackFrame, dcell, TYPE_DOUBLE);
+    pushOperand2(jthread->currentStackFrame, dcell);
     return 1;
 }
 
 int handle_instr_d2i(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    double_cell_t dcell = popOperand2(jthread->currentStackFrame, NULL);
+    double_cell_t dcell = popOperand2(jthread->currentStackFrame);
     cell_t cell = {.i = dcell.d};
-    pushOperand(jthread->currentStackFrame, cell, TYPE_INT);
+    pushOperand(jthread->currentStackFrame, cell);
     return 1;
 }
 
 int handle_instr_d2l(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-	double_cell_t dcell = popOperand2(jthread->currentStackFrame, NULL);
+	double_cell_t dcell = popOperand2(jthread->currentStackFrame);
 	dcell.l = dcell.d;
-	pushOperand2(jthread->currentStackFrame, dcell, TYPE_LONG);
+	pushOperand2(jthread->currentStackFrame, dcell);
     return 1;
 }
 
 int handle_instr_d2f(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    double_cell_t dcell = popOperand2(jthread->currentStackFrame, NULL);
+    double_cell_t dcell = popOperand2(jthread->currentStackFrame);
     cell_t cell = {.f = dcell.d};
-    pushOperand(jthread->currentStackFrame, cell, TYPE_FLOAT);
+    pushOperand(jthread->currentStackFrame, cell);
     return 1;
 }
 
 int handle_instr_i2b(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t cell = popOperand(jthread->currentStackFrame, NULL);
+    cell_t cell = popOperand(jthread->currentStackFrame);
     cell.i = (int8_t) cell.i;
-    pushOperand(jthread->currentStackFrame, cell, TYPE_BYTE);
+    pushOperand(jthread->currentStackFrame, cell);
     return 1;
 }
 
 int handle_instr_i2c(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t cell = popOperand(jthread->currentStackFrame, NULL);
+    cell_t cell = popOperand(jthread->currentStackFrame);
     cell.i = cell.i & 0xFFFF;
-    pushOperand(jthread->currentStackFrame, cell, TYPE_CHAR);
+    pushOperand(jthread->currentStackFrame, cell);
     return 1;
 }
 
 int handle_instr_i2s(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t cell = popOperand(jthread->currentStackFrame, NULL);
+    cell_t cell = popOperand(jthread->currentStackFrame);
     cell.i = (int16_t) cell.i;
-    pushOperand(jthread->currentStackFrame, cell, TYPE_SHORT);
+    pushOperand(jthread->currentStackFrame, cell);
     return 1;
 }
 
 int handle_instr_lcmp(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-	double_cell_t top = popOperand2(jthread->currentStackFrame, NULL);
-    double_cell_t next = popOperand2(jthread->currentStackFrame, NULL);
+	double_cell_t top = popOperand2(jthread->currentStackFrame);
+    double_cell_t next = popOperand2(jthread->currentStackFrame);
     cell_t result = {.i = MAX(-1, MIN(1, next.l - top.l))};
-    pushOperand(jthread->currentStackFrame, result, TYPE_INT);
+    pushOperand(jthread->currentStackFrame, result);
     return 1;
 }
 
 int handle_instr_fcmpl(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-	cell_t top = popOperand(jthread->currentStackFrame, NULL);
-	cell_t next = popOperand(jthread->currentStackFrame, NULL);
+	cell_t top = popOperand(jthread->currentStackFrame);
+	cell_t next = popOperand(jthread->currentStackFrame);
 	if(isnanf(top.f) || isnanf(next.f))
 	    top.i = -1;
 	else if(next.f > top.f)
@@ -1452,14 +2615,14 @@ int handle_instr_fcmpl(bc_interpreter_t *interpreter, bool wide) {
 	    top.i = -1;
 	else
 	    top.i = 0;
-	pushOperand(jthread->currentStackFrame, top, TYPE_INT);
+	pushOperand(jthread->currentStackFrame, top);
 	return 1;
 }
 
 int handle_instr_fcmpg(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    cell_t next = popOperand(jthread->currentStackFrame, NULL);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    cell_t next = popOperand(jthread->currentStackFrame);
     if(isnanf(top.f) || isnanf(next.f))
         top.i = 1;
     else if(next.f > top.f)
@@ -1468,14 +2631,14 @@ int handle_instr_fcmpg(bc_interpreter_t *interpreter, bool wide) {
         top.i = -1;
     else
         top.i = 0;
-    pushOperand(jthread->currentStackFrame, top, TYPE_INT);
+    pushOperand(jthread->currentStackFrame, top);
     return 1;
 }
 
 int handle_instr_dcmpl(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    double_cell_t top = popOperand2(jthread->currentStackFrame, NULL);
-    double_cell_t next = popOperand2(jthread->currentStackFrame, NULL);
+    double_cell_t top = popOperand2(jthread->currentStackFrame);
+    double_cell_t next = popOperand2(jthread->currentStackFrame);
     cell_t result;
     if(isnan(top.d) || isnan(next.d))
         result.i = -1;
@@ -1485,14 +2648,14 @@ int handle_instr_dcmpl(bc_interpreter_t *interpreter, bool wide) {
         result.i = -1;
     else
         result.i = 0;
-    pushOperand(jthread->currentStackFrame, result, TYPE_INT);
+    pushOperand(jthread->currentStackFrame, result);
     return 1;
 }
 
 int handle_instr_dcmpg(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    double_cell_t top = popOperand2(jthread->currentStackFrame, NULL);
-    double_cell_t next = popOperand2(jthread->currentStackFrame, NULL);
+    double_cell_t top = popOperand2(jthread->currentStackFrame);
+    double_cell_t next = popOperand2(jthread->currentStackFrame);
     cell_t result;
     if(isnan(top.d) || isnan(next.d))
         result.i = 1;
@@ -1502,294 +2665,261 @@ int handle_instr_dcmpg(bc_interpreter_t *interpreter, bool wide) {
         result.i = -1;
     else
         result.i = 0;
-    pushOperand(jthread->currentStackFrame, result, TYPE_INT);
+    pushOperand(jthread->currentStackFrame, result);
     return 1;
 }
 
 int handle_instr_ifeq(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-	cell_t top = popOperand(jthread->currentStackFrame, NULL);
-	int16_t offset = readShortOperand(jthread, 1);
+	cell_t top = popOperand(jthread->currentStackFrame);
 	if(top.i == 0) {
-	    jthread->pc += offset;
+	    jthread->pc = jthread->pc[1].target;
 	    return 0;
 	}
-	return 3;
+	return 2;
 }
 
 int handle_instr_ifne(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    int16_t offset = readShortOperand(jthread, 1);
+    cell_t top = popOperand(jthread->currentStackFrame);
     if(top.i != 0) {
-        jthread->pc += offset;
+        jthread->pc = jthread->pc[1].target;
         return 0;
     }
-    return 3;
+    return 2;
 }
 
 int handle_instr_iflt(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    int16_t offset = readShortOperand(jthread, 1);
+    cell_t top = popOperand(jthread->currentStackFrame);
     if(top.i < 0) {
-        jthread->pc += offset;
+        jthread->pc = jthread->pc[1].target;
         return 0;
     }
-    return 3;
+    return 2;
 }
 
 int handle_instr_ifge(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    int16_t offset = readShortOperand(jthread, 1);
+    cell_t top = popOperand(jthread->currentStackFrame);
     if(top.i >= 0) {
-        jthread->pc += offset;
+        jthread->pc = jthread->pc[1].target;
         return 0;
     }
-    return 3;
+    return 2;
 }
 
 int handle_instr_ifgt(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    int16_t offset = readShortOperand(jthread, 1);
+    cell_t top = popOperand(jthread->currentStackFrame);
     if(top.i > 0) {
-        jthread->pc += offset;
+        jthread->pc = jthread->pc[1].target;
         return 0;
     }
-    return 3;
+    return 2;
 }
 
 int handle_instr_ifle(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    int16_t offset = readShortOperand(jthread, 1);
+    cell_t top = popOperand(jthread->currentStackFrame);
     if(top.i <= 0) {
-        jthread->pc += offset;
+        jthread->pc = jthread->pc[1].target;
         return 0;
     }
-    return 3;
+    return 2;
 }
 
 int handle_instr_if_icmpeq(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    cell_t next = popOperand(jthread->currentStackFrame, NULL);
-    int16_t offset = readShortOperand(jthread, 1);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    cell_t next = popOperand(jthread->currentStackFrame);
     if(next.i == top.i) {
-        jthread->pc += offset;
+        jthread->pc = jthread->pc[1].target;
         return 0;
     }
-    return 3;
+    return 2;
 }
 
 int handle_instr_if_icmpne(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    cell_t next = popOperand(jthread->currentStackFrame, NULL);
-    int16_t offset = readShortOperand(jthread, 1);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    cell_t next = popOperand(jthread->currentStackFrame);
     if(next.i != top.i) {
-        jthread->pc += offset;
+        jthread->pc = jthread->pc[1].target;
         return 0;
     }
-    return 3;
+    return 2;
 }
 
 int handle_instr_if_icmplt(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    cell_t next = popOperand(jthread->currentStackFrame, NULL);
-    int16_t offset = readShortOperand(jthread, 1);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    cell_t next = popOperand(jthread->currentStackFrame);
     if(next.i < top.i) {
-        jthread->pc += offset;
+        jthread->pc = jthread->pc[1].target;
         return 0;
     }
-    return 3;
+    return 2;
 }
 
 int handle_instr_if_icmpge(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    cell_t next = popOperand(jthread->currentStackFrame, NULL);
-    int16_t offset = readShortOperand(jthread, 1);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    cell_t next = popOperand(jthread->currentStackFrame);
     if(next.i >= top.i) {
-        jthread->pc += offset;
+        jthread->pc = jthread->pc[1].target;
         return 0;
     }
-    return 3;
+    return 2;
 }
 
 int handle_instr_if_icmpgt(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    cell_t next = popOperand(jthread->currentStackFrame, NULL);
-    int16_t offset = readShortOperand(jthread, 1);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    cell_t next = popOperand(jthread->currentStackFrame);
     if(next.i > top.i) {
-        jthread->pc += offset;
+        jthread->pc = jthread->pc[1].target;
         return 0;
     }
-    return 3;
+    return 2;
 }
 
 int handle_instr_if_icmple(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    cell_t next = popOperand(jthread->currentStackFrame, NULL);
-    int16_t offset = readShortOperand(jthread, 1);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    cell_t next = popOperand(jthread->currentStackFrame);
     if(next.i <= top.i) {
-        jthread->pc += offset;
+        jthread->pc = jthread->pc[1].target;
         return 0;
     }
-    return 3;
+    return 2;
 }
 
 int handle_instr_if_acmpeq(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    cell_t next = popOperand(jthread->currentStackFrame, NULL);
-    int16_t offset = readShortOperand(jthread, 1);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    cell_t next = popOperand(jthread->currentStackFrame);
     if(next.a == top.a) {
-        jthread->pc += offset;
+        jthread->pc = jthread->pc[1].target;
         return 0;
     }
-    return 3;
+    return 2;
 }
 
 int handle_instr_if_acmpne(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    cell_t next = popOperand(jthread->currentStackFrame, NULL);
-    int16_t offset = readShortOperand(jthread, 1);
+    cell_t top = popOperand(jthread->currentStackFrame);
+    cell_t next = popOperand(jthread->currentStackFrame);
     if(next.a != top.a) {
-        jthread->pc += offset;
+        jthread->pc = jthread->pc[1].target;
         return 0;
     }
-    return 3;
+    return 2;
 }
 
 int handle_instr_goto(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    int16_t offset = readShortOperand(jthread, 1);
-    jthread->pc += offset;
+    jthread->pc = jthread->pc[1].target;
     return 0;
 }
 
 int handle_instr_jsr(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    int16_t offset = readShortOperand(jthread, 1);
-    cell_t returnAddress =  {.r = jthread->pc + 1 - jthread->currentStackFrame->currentMethod->codeAttribute->code};
-    jthread->pc += offset;
-    pushOperand(jthread->currentStackFrame, returnAddress, TYPE_RETURN_ADDRESS);
+    cell_t returnAddress =  {.r = jthread->pc + 2 - getTranslatedCode(jthread->currentStackFrame->currentMethod)->code};
+    jthread->pc = jthread->pc[1].target;
+    pushOperand(jthread->currentStackFrame, returnAddress);
     return 0;
 }
 
 int handle_instr_ret(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-	uint16_t index;
-	if(wide)
-	    index = readShortOperand(jthread, 2);
-	else
-	    index = (uint8_t) readByteOperand(jthread, 1);
+	uint16_t index = jthread->pc[1].u;
 	cell_t returnAddress = readLocal(jthread->currentStackFrame, index, NULL);
-	jthread->pc = jthread->currentStackFrame->currentMethod->codeAttribute->code + returnAddress.r;
+	jthread->pc = getTranslatedCode(jthread->currentStackFrame->currentMethod)->code + returnAddress.r;
 	return 0;
 }
 
 int handle_instr_tableswitch(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    // calculate the offset of the integers stored in the tableswitch
-    int offset = (((intptr_t) jthread->pc & ~3) + 4) - (intptr_t) jthread->pc;
-    
-    int32_t defaultOffset = readIntOperand(jthread, offset);
-    int32_t low = readIntOperand(jthread, offset + 4);
-    int32_t high = readIntOperand(jthread, offset + 8);
-    cell_t index = popOperand(jthread->currentStackFrame, NULL);
-    if(index.i < low || index.i > high) {
-        jthread->pc += defaultOffset;
-    }
-    else {
-        int32_t addressOffset = readIntOperand(jthread, offset + 12 + index.i - low);
-        jthread->pc += addressOffset;
-    }
-    return 0;
-}
-
-int lookupswitch_binary_search(jthread_t *jthread, int base, int start, int end, int32_t key) {
-    if(start >= end)
-        return -1;
-    int mid = start + (end - start) / 2;
-    int32_t testKey = readIntOperand(jthread, base + 8 * mid);
-    if(testKey == key)
-        return mid;
-    else if(testKey < key)
-        return lookupswitch_binary_search(jthread, base, mid, end, key);
+    code_word_t *pc = jthread->pc;
+    int32_t low = pc[2].i;
+    int32_t high = pc[3].i;
+    cell_t index = popOperand(jthread->currentStackFrame);
+    if(index.i < low || index.i > high)
+        jthread->pc = pc[1].target;
     else
-        return lookupswitch_binary_search(jthread, base, start, mid, key);
+        jthread->pc = pc[4 + (index.i - low)].target;
+    return 0;
 }
 
 int handle_instr_lookupswitch(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    // calculate the offset of the integers stored in the tableswitch
-    int offset = (((intptr_t) jthread->pc & ~3) + 4) - (intptr_t) jthread->pc;
+    code_word_t *pc = jthread->pc;
+    int32_t npairs = pc[2].i;
+    cell_t key = popOperand(jthread->currentStackFrame);
     
-    int32_t defaultOffset = readIntOperand(jthread, offset);
-    int32_t npairs = readIntOperand(jthread, offset + 4);
-    cell_t key = popOperand(jthread->currentStackFrame, NULL);
-    int pairStart = offset + 8;
-    int location = lookupswitch_binary_search(jthread, pairStart, 0, npairs, key.i);
-    if(location < 0) {
-        jthread->pc += defaultOffset;
-    }
-    else {
-        int32_t addressOffset = readIntOperand(jthread, pairStart + 8 * location + 4);
-        jthread->pc += addressOffset;
+    // the pairs are sorted by match so binary search for the key
+    code_word_t *pairs = pc + 3;
+    int32_t start = 0;
+    int32_t end = npairs;
+    jthread->pc = pc[1].target;
+    while(start < end) {
+        int32_t mid = start + (end - start) / 2;
+        int32_t match = pairs[2 * mid].i;
+        if(match == key.i) {
+            jthread->pc = pairs[2 * mid + 1].target;
+            break;
+        }
+        else if(match < key.i)
+            start = mid + 1;
+        else
+            end = mid;
     }
     return 0;
 }
 
 int handle_instr_ireturn(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-	cell_t returnValue = popOperand(jthread->currentStackFrame, NULL);
+	cell_t returnValue = popOperand(jthread->currentStackFrame);
 	jthread->pc = jthread->currentStackFrame->prevFramePC;
 	jthread->currentStackFrame = jthread->currentStackFrame->previousStackFrame;
-	pushOperand(jthread->currentStackFrame, returnValue, TYPE_INT);
+	pushOperand(jthread->currentStackFrame, returnValue);
 	return 0;
 }
 
 int handle_instr_lreturn(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    double_cell_t returnValue = popOperand2(jthread->currentStackFrame, NULL);
+    double_cell_t returnValue = popOperand2(jthread->currentStackFrame);
     jthread->pc = jthread->currentStackFrame->prevFramePC;
     jthread->currentStackFrame = jthread->currentStackFrame->previousStackFrame;
-    pushOperand2(jthread->currentStackFrame, returnValue, TYPE_LONG);
+    pushOperand2(jthread->currentStackFrame, returnValue);
     return 0;
 }
 
 int handle_instr_freturn(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t returnValue = popOperand(jthread->currentStackFrame, NULL);
+    cell_t returnValue = popOperand(jthread->currentStackFrame);
     jthread->pc = jthread->currentStackFrame->prevFramePC;
     jthread->currentStackFrame = jthread->currentStackFrame->previousStackFrame;
-    pushOperand(jthread->currentStackFrame, returnValue, TYPE_FLOAT);
+    pushOperand(jthread->currentStackFrame, returnValue);
     return 0;
 }
 
 int handle_instr_dreturn(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    double_cell_t returnValue = popOperand2(jthread->currentStackFrame, NULL);
+    double_cell_t returnValue = popOperand2(jthread->currentStackFrame);
     jthread->pc = jthread->currentStackFrame->prevFramePC;
     jthread->currentStackFrame = jthread->currentStackFrame->previousStackFrame;
-    pushOperand2(jthread->currentStackFrame, returnValue, TYPE_DOUBLE);
+    pushOperand2(jthread->currentStackFrame, returnValue);
     return 0;
 }
 
 int handle_instr_areturn(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t returnValue = popOperand(jthread->currentStackFrame, NULL);
+    cell_t returnValue = popOperand(jthread->currentStackFrame);
     jthread->pc = jthread->currentStackFrame->prevFramePC;
     jthread->currentStackFrame = jthread->currentStackFrame->previousStackFrame;
-    pushOperand(jthread->currentStackFrame, returnValue, TYPE_REFERENCE);
+    pushOperand(jthread->currentStackFrame, returnValue);
     return 0;
 }
 
@@ -1802,233 +2932,211 @@ int handle_instr_return(bc_interpreter_t *interpreter, bool wide) {
     return -EJUST_RETURNED;
 }
 
-int handle_instr_getstatic(bc_interpreter_t *interpreter, bool wide) {
-    jthread_t *jthread = interpreter->jthread;
-	uint16_t fieldIndex = readShortOperand(jthread, 1);
-	field_t *field = resolveField(interpreter, fieldIndex, true);
-	if(!field)
-	    // exception was already thrown by resolveField
-	    return 0;
-	
-	void *data = field->class->staticFieldData + field->objectOffset;
-	cell_t cell;
-	double_cell_t dcell;
-	switch(field->descriptor[0]) {
-        case 'B':
-            cell.b = *(int8_t *) data;
-            pushOperand(jthread->currentStackFrame, cell, TYPE_BYTE);
-            break;
-        case 'C':
-            cell.c = *(uint16_t *) data;
-            pushOperand(jthread->currentStackFrame, cell, TYPE_CHAR);
-            break;
-        case 'D':
-            dcell.d = *(double *) data;
-            pushOperand2(jthread->currentStackFrame, dcell, TYPE_DOUBLE);
-            break;
-        case 'F':
-            cell.f = *(float *) data;
-            pushOperand(jthread->currentStackFrame, cell, TYPE_FLOAT);
-            break;
-        case 'I':
-            cell.i = *(int32_t *) data;
-            pushOperand(jthread->currentStackFrame, cell, TYPE_INT);
-            break;
-        case 'J':
-            dcell.l = *(int64_t *) data;
-            pushOperand2(jthread->currentStackFrame, dcell, TYPE_LONG);
-            break;
-        case 'S':
-            cell.s = *(int16_t *) data;
-            pushOperand(jthread->currentStackFrame, cell, TYPE_SHORT);
-            break;
-        case 'Z':
-            cell.z = *(uint8_t *) data;
-            pushOperand(jthread->currentStackFrame, cell, TYPE_BOOLEAN);
-            break;
-        case 'L':
-        case '[':
-        default:
-            cell.a = *(slot_t *) data;
-            pushOperand(jthread->currentStackFrame, cell, TYPE_REFERENCE);
-            break;
-	}
-	
-	return 3;
-}
+// quick versions of the field instructions indexed by the type of the field
+static const uint16_t getstaticQuickOpcodes[] = {
+    [TYPE_BOOLEAN] = OP_getstatic_quick_z,
+    [TYPE_CHAR] = OP_getstatic_quick_c,
+    [TYPE_BYTE] = OP_getstatic_quick_b,
+    [TYPE_SHORT] = OP_getstatic_quick_s,
+    [TYPE_INT] = OP_getstatic_quick_i,
+    [TYPE_LONG] = OP_getstatic_quick_j,
+    [TYPE_FLOAT] = OP_getstatic_quick_f,
+    [TYPE_DOUBLE] = OP_getstatic_quick_d,
+    [TYPE_REFERENCE] = OP_getstatic_quick_a
+};
+
+static const uint16_t putstaticQuickOpcodes[] = {
+    [TYPE_BOOLEAN] = OP_putstatic_quick_8,
+    [TYPE_CHAR] = OP_putstatic_quick_16,
+    [TYPE_BYTE] = OP_putstatic_quick_8,
+    [TYPE_SHORT] = OP_putstatic_quick_16,
+    [TYPE_INT] = OP_putstatic_quick_32,
+    [TYPE_LONG] = OP_putstatic_quick_64,
+    [TYPE_FLOAT] = OP_putstatic_quick_32,
+    [TYPE_DOUBLE] = OP_putstatic_quick_64,
+    [TYPE_REFERENCE] = OP_putstatic_quick_a
+};
+
+static const uint16_t getfieldQuickOpcodes[] = {
+    [TYPE_BOOLEAN] = OP_getfield_quick_z,
+    [TYPE_CHAR] = OP_getfield_quick_c,
+    [TYPE_BYTE] = OP_getfield_quick_b,
+    [TYPE_SHORT] = OP_getfield_quick_s,
+    [TYPE_INT] = OP_getfield_quick_i,
+    [TYPE_LONG] = OP_getfield_quick_j,
+    [TYPE_FLOAT] = OP_getfield_quick_f,
+    [TYPE_DOUBLE] = OP_getfield_quick_d,
+    [TYPE_REFERENCE] = OP_getfield_quick_a
+};
+
+static const uint16_t putfieldQuickOpcodes[] = {
+    [TYPE_BOOLEAN] = OP_putfield_quick_8,
+    [TYPE_CHAR] = OP_putfield_quick_16,
+    [TYPE_BYTE] = OP_putfield_quick_8,
+    [TYPE_SHORT] = OP_putfield_quick_16,
+    [TYPE_INT] = OP_putfield_quick_32,
+    [TYPE_LONG] = OP_putfield_quick_64,
+    [TYPE_FLOAT] = OP_putfield_quick_32,
+    [TYPE_DOUBLE] = OP_putfield_quick_64,
+    [TYPE_REFERENCE] = OP_putfield_quick_a
+};
 
-int handle_instr_putstatic(bc_interpreter_t *interpreter, bool wide) {
+/**
+ * Resolves the field used by a field instruction and rewrites the instruction into the quick version for the field's
+ * type. Static field instructions are only rewritten once the field's class is initialized since the quick versions
+ * don't check for it.
+ * @param interpreter
+ * @param quickOpcodes the quick versions of the instruction indexed by type
+ * @param isStatic
+ * @return the number of words to advance the pc by
+ */
+int quickenFieldInstruction(bc_interpreter_t *interpreter, const uint16_t *quickOpcodes, bool isStatic) {
     jthread_t *jthread = interpreter->jthread;
-    uint16_t fieldIndex = readShortOperand(jthread, 1);
-    field_t *field = resolveField(interpreter, fieldIndex, true);
+    code_word_t *pc = jthread->pc;
+    field_t *field = resolveField(interpreter, pc[1].u, isStatic);
     if(!field)
-        // exception has already been thrown by resolveField
+        // exception was already thrown by resolveField
         return 0;
     
-    void *data = field->class->staticFieldData + field->objectOffset;
-    switch(field->descriptor[0]) {
-        case 'B':
-            *(int8_t *) data = popOperand(jthread->currentStackFrame, NULL).b;
-            break;
-        case 'C':
-            *(uint16_t *) data = popOperand(jthread->currentStackFrame, NULL).c;
-            break;
-        case 'D':
-            *(double *) data = popOperand2(jthread->currentStackFrame, NULL).d;
-            break;
-        case 'F':
-            *(float *) data = popOperand(jthread->currentStackFrame, NULL).f;
-            break;
-        case 'I':
-            *(int32_t *) data = popOperand(jthread->currentStackFrame, NULL).i;
-            break;
-        case 'J':
-            *(int64_t *) data = popOperand2(jthread->currentStackFrame, NULL).l;
-            break;
-        case 'S':
-            *(int16_t *) data = popOperand(jthread->currentStackFrame, NULL).s;
-            break;
-        case 'Z':
-            *(uint8_t *) data = popOperand(jthread->currentStackFrame, NULL).z;
-            break;
-        case 'L':
-        case '[':
-        default:
-            *(slot_t *) data = popOperand(jthread->currentStackFrame, NULL).a;
-            break;
-    }
-    
-    return 3;
+    if(isStatic)
+        pc[2].ptr = field->class->staticFieldData + field->objectOffset;
+    else
+        pc[2].u = field->objectOffset;
+    uint16_t opcode = quickOpcodes[getTypeFromFieldDescriptor(field->descriptor)];
+    if(!isStatic || field->class->status == CLASS_STATUS_INITIALIZED)
+        rewriteInstruction(jthread->currentStackFrame->currentMethod, pc, opcode);
+    return instr_table[opcode](interpreter, false);
+}
+
+int handle_instr_getstatic(bc_interpreter_t *interpreter, bool wide) {
+    return quickenFieldInstruction(interpreter, getstaticQuickOpcodes, true);
+}
+
+int handle_instr_putstatic(bc_interpreter_t *interpreter, bool wide) {
+    return quickenFieldInstruction(interpreter, putstaticQuickOpcodes, true);
 }
 
 int handle_instr_getfield(bc_interpreter_t *interpreter, bool wide) {
-    jthread_t *jthread = interpreter->jthread;
-    object_t *obj = getObject(popOperand(jthread->currentStackFrame, NULL).a);
-    if(!obj) {
-        throwException(interpreter, "java/lang/NullPointerException", "Cannot retrieve field from null");
-        return 0;
-    }
-    
-    uint16_t fieldIndex = readShortOperand(jthread, 1);
-    field_t *field = resolveField(interpreter, fieldIndex, false);
-    if(!field)
-        // exception was already thrown by resolveField
-        return 0;
-    
-    void *data = obj + field->objectOffset;
-    cell_t cell;
-    double_cell_t dcell;
-    switch(field->descriptor[0]) {
-        case 'B':
-            cell.b = *(int8_t *) data;
-            pushOperand(jthread->currentStackFrame, cell, TYPE_BYTE);
-            break;
-        case 'C':
-            cell.c = *(uint16_t *) data;
-            pushOperand(jthread->currentStackFrame, cell, TYPE_CHAR);
-            break;
-        case 'D':
-            dcell.d = *(double *) data;
-            pushOperand2(jthread->currentStackFrame, dcell, TYPE_DOUBLE);
-            break;
-        case 'F':
-            cell.f = *(float *) data;
-            pushOperand(jthread->currentStackFrame, cell, TYPE_FLOAT);
-            break;
-        case 'I':
-            cell.i = *(int32_t *) data;
-            pushOperand(jthread->currentStackFrame, cell, TYPE_INT);
-            break;
-        case 'J':
-            dcell.l = *(int64_t *) data;
-            pushOperand2(jthread->currentStackFrame, dcell, TYPE_LONG);
-            break;
-        case 'S':
-            cell.s = *(int16_t *) data;
-            pushOperand(jthread->currentStackFrame, cell, TYPE_SHORT);
-            break;
-        case 'Z':
-            cell.z = *(uint8_t *) data;
-            pushOperand(jthread->currentStackFrame, cell, TYPE_BOOLEAN);
-            break;
-        case 'L':
-        case '[':
-        default:
-            cell.a = *(slot_t *) data;
-            pushOperand(jthread->currentStackFrame, cell, TYPE_REFERENCE);
-            break;
-    }
-    
-    return 3;
+    return quickenFieldInstruction(interpreter, getfieldQuickOpcodes, false);
 }
 
 int handle_instr_putfield(bc_interpreter_t *interpreter, bool wide) {
-    jthread_t *jthread = interpreter->jthread;
-    object_t *obj = getObject(popOperand(jthread->currentStackFrame, NULL).a);
-    if(!obj) {
-        throwException(interpreter, "java/lang/NullPointerException", "Cannot retrieve field from null");
-        return 0;
-    }
+    return quickenFieldInstruction(interpreter, putfieldQuickOpcodes, false);
+}
+
+/**
+ * Finds the method invoked by an invokevirtual or invokeinterface instruction for the class of the receiver. Classes
+ * missing from the call site's inline cache are looked up in the vtable or itable and added to the cache if it has room
+ * @param interpreter
+ * @param cache
+ * @param class the class of the receiver
+ * @param isInterface whether the method is looked up in the itable instead of the vtable
+ * @return the method or NULL in which case an exception is thrown
+ */
+method_t *lookupInlineCache(bc_interpreter_t *interpreter, inline_cache_t *cache, class_t *class, bool isInterface) {
+    method_t *method = findInInlineCache(cache, class);
+    if(method)
+        return method;
     
-    uint16_t fieldIndex = readShortOperand(jthread, 1);
-    field_t *field = resolveField(interpreter, fieldIndex, false);
-    if(!field)
-        // exception has already been thrown by resolveField
-        return 0;
+    COUNT(inlineCacheMisses);
+    if(isInterface)
+        method = selectInterfaceMethod(interpreter, class, cache->method);
+    else
+        method = class->vtable[cache->method->vtableIndex];
+    if(!method)
+        return NULL;
     
-    void *data = obj + field->objectOffset;
-    switch(field->descriptor[0]) {
-        case 'B':
-            *(int8_t *) data = popOperand(jthread->currentStackFrame, NULL).b;
-            break;
-        case 'C':
-            *(uint16_t *) data = popOperand(jthread->currentStackFrame, NULL).c;
-            break;
-        case 'D':
-            *(double *) data = popOperand2(jthread->currentStackFrame, NULL).d;
-            break;
-        case 'F':
-            *(float *) data = popOperand(jthread->currentStackFrame, NULL).f;
-            break;
-        case 'I':
-            *(int32_t *) data = popOperand(jthread->currentStackFrame, NULL).i;
-            break;
-        case 'J':
-            *(int64_t *) data = popOperand2(jthread->currentStackFrame, NULL).l;
-            break;
-        case 'S':
-            *(int16_t *) data = popOperand(jthread->currentStackFrame, NULL).s;
-            break;
-        case 'Z':
-            *(uint8_t *) data = popOperand(jthread->currentStackFrame, NULL).z;
-            break;
-        case 'L':
-        case '[':
-        default:
-            *(slot_t *) data = popOperand(jthread->currentStackFrame, NULL).a;
-            break;
+    // the entry is claimed before it's filled so that threads racing to add classes never share an entry
+    if(atomic_load_explicit(&cache->numEntries, memory_order_relaxed) < INLINE_CACHE_SIZE) {
+        unsigned int index = atomic_fetch_add_explicit(&cache->numEntries, 1, memory_order_relaxed);
+        if(index < INLINE_CACHE_SIZE) {
+            cache->entries[index].method = method;
+            atomic_store_explicit(&cache->entries[index].class, class, memory_order_release);
+        }
     }
-    
-    return 3;
+    else
+        COUNT(megamorphicLookups);
+    return method;
+}
+
+/**
+ * Rewrites a method instruction into the given quick version
+ * @param interpreter
+ * @param opcode
+ * @param quickData the method invoked or the inline cache of the call site
+ * @return the number of words to advance the pc by
+ */
+int quickenMethodInstruction(bc_interpreter_t *interpreter, uint16_t opcode, void *quickData) {
+    jthread_t *jthread = interpreter->jthread;
+    code_word_t *pc = jthread->pc;
+    pc[2].ptr = quickData;
+    rewriteInstruction(jthread->currentStackFrame->currentMethod, pc, opcode);
+    return instr_table[opcode](interpreter, false);
 }
 
 int handle_instr_invokevirtual(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    uint16_t methodIndex = readShortOperand(jthread, 1);
-	method_t *method = resolveMethod(interpreter, methodIndex, false);
-    return 3;
+    method_t *method = resolveMethod(interpreter, jthread->pc[1].u, false);
+    if(!method)
+        return 0;
+    
+    // methods that can't be overridden don't need to be looked up. Every thread makes the same choice for a call site so
+    // the inline cache is never replaced while another thread is using it
+    if(method->vtableIndex == NO_VTABLE_INDEX && !(method->class->flags & CLASS_ACC_INTERFACE))
+        return quickenMethodInstruction(interpreter, OP_invokespecial_quick, method);
+    if((method->flags & METHOD_ACC_FINAL) || (method->class->flags & CLASS_ACC_FINAL))
+        return quickenMethodInstruction(interpreter, OP_invokespecial_quick, method);
+    
+    inline_cache_t *cache = jthread->pc[2].ptr;
+    cache->method = method;
+    // methods inherited from an interface have a different vtable index in every class that implements it
+    if(method->class->flags & CLASS_ACC_INTERFACE)
+        return quickenMethodInstruction(interpreter, OP_invokeinterface_quick, cache);
+    return quickenMethodInstruction(interpreter, OP_invokevirtual_quick, cache);
 }
 
 int handle_instr_invokespecial(bc_interpreter_t *interpreter, bool wide) {
-    return 3;
+    jthread_t *jthread = interpreter->jthread;
+    method_t *method = resolveMethod(interpreter, jthread->pc[1].u, false);
+    if(!method)
+        return 0;
+    
+    // calls to an overridden method of a superclass use the version the superclass would call
+    class_t *currentClass = jthread->currentStackFrame->currentMethod->class;
+    if(method->vtableIndex != NO_VTABLE_INDEX && (currentClass->flags & CLASS_ACC_SUPER) && currentClass->superClass) {
+        for(class_t *class = currentClass->superClass; class; class = class->superClass) {
+            if(class == method->class) {
+                method = currentClass->superClass->vtable[method->vtableIndex];
+                break;
+            }
+        }
+    }
+    return quickenMethodInstruction(interpreter, OP_invokespecial_quick, method);
 }
 
 int handle_instr_invokestatic(bc_interpreter_t *interpreter, bool wide) {
-	return 3;
+    jthread_t *jthread = interpreter->jthread;
+    method_t *method = resolveMethod(interpreter, jthread->pc[1].u, true);
+    if(!method)
+        return 0;
+    
+    // the quick version doesn't initialize the class so it's only used once the class is initialized
+    if(method->class->status != CLASS_STATUS_INITIALIZED) {
+        invokeMethod(interpreter, method, 3);
+        return 0;
+    }
+    return quickenMethodInstruction(interpreter, OP_invokestatic_quick, method);
 }
 
 int handle_instr_invokeinterface(bc_interpreter_t *interpreter, bool wide) {
-	return 5;
+    jthread_t *jthread = interpreter->jthread;
+    method_t *method = resolveMethod(interpreter, jthread->pc[1].u, false);
+    if(!method)
+        return 0;
+    
+    inline_cache_t *cache = jthread->pc[2].ptr;
+    cache->method = method;
+    return quickenMethodInstruction(interpreter, OP_invokeinterface_quick, cache);
 }
 
 int handle_instr_invokedynamic(bc_interpreter_t *interpreter, bool wide) {
@@ -2038,7 +3146,7 @@ int handle_instr_invokedynamic(bc_interpreter_t *interpreter, bool wide) {
 
 int handle_instr_new(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    uint8_t classIndex = readShortOperand(jthread, 1);
+    uint16_t classIndex = jthread->pc[1].u;
     
     uint16_t nameIndex = jthread->currentStackFrame->currentMethod->class->constantPool[classIndex]->classInfo.nameIndex;
     char *className = jthread->currentStackFrame->currentMethod->class->constantPool[nameIndex]->utf8Info.chars;
@@ -2053,18 +3161,18 @@ int handle_instr_new(bc_interpreter_t *interpreter, bool wide) {
     }
     
     cell_t cell;
-    cell.a = newObject(class);
+    cell.a = newObject(jthread, class);
     if(!cell.a) {
         throwException(interpreter, "java/lang/OutOfMemoryError", "Failed to create array");
         return 0;
     }
-    pushOperand(jthread->currentStackFrame, cell, TYPE_REFERENCE);
-    return 3;
+    pushOperand(jthread->currentStackFrame, cell);
+    return 2;
 }
 
 int handle_instr_newarray(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    uint8_t arrayType = readByteOperand(jthread, 1);
+    uint8_t arrayType = jthread->pc[1].u;
     char c;
     switch(arrayType) {
         case TYPE_BOOLEAN:
@@ -2106,21 +3214,21 @@ int handle_instr_newarray(bc_interpreter_t *interpreter, bool wide) {
         return 0;
     }
     
-    int32_t size = popOperand(jthread->currentStackFrame, NULL).i;
+    int32_t size = popOperand(jthread->currentStackFrame).i;
     
     cell_t cell;
-    cell.a = newArray(1, &size, class);
+    cell.a = newArray(jthread, 1, &size, class);
     if(!cell.a) {
         throwException(interpreter, "java/lang/OutOfMemoryError", "Failed to create array");
         return 0;
     }
-    pushOperand(jthread->currentStackFrame, cell, TYPE_REFERENCE);
+    pushOperand(jthread->currentStackFrame, cell);
     return 2;
 }
 
 int handle_instr_anewarray(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    uint8_t classIndex = readShortOperand(jthread, 1);
+    uint16_t classIndex = jthread->pc[1].u;
     
     uint16_t nameIndex = jthread->currentStackFrame->currentMethod->class->constantPool[classIndex]->classInfo.nameIndex;
     char *className = jthread->currentStackFrame->currentMethod->class->constantPool[nameIndex]->utf8Info.chars;
@@ -2134,32 +3242,33 @@ int handle_instr_anewarray(bc_interpreter_t *interpreter, bool wide) {
         return 0;
     }
     
-    int32_t size = popOperand(jthread->currentStackFrame, NULL).i;
+    int32_t size = popOperand(jthread->currentStackFrame).i;
     
     cell_t cell;
-    cell.a = newArray(1, &size, class);
+    cell.a = newArray(jthread, 1, &size, class);
     if(!cell.a) {
         throwException(interpreter, "java/lang/OutOfMemoryError", "Failed to create array");
         return 0;
     }
-    pushOperand(jthread->currentStackFrame, cell, TYPE_REFERENCE);
-    return 3;
+    pushOperand(jthread->currentStackFrame, cell);
+    return 2;
 }
 
 int handle_instr_arraylength(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-	cell_t cell = popOperand(jthread->currentStackFrame, NULL);
+	cell_t cell = popOperand(jthread->currentStackFrame);
 	object_t *array = getObject(cell.a);
 	if(!array) {
 	    throwException(interpreter, "java/lang/NullPointerException", "Array cannot be null");
 	    return 0;
 	}
-	cell.i = array->length;
-	pushOperand(jthread->currentStackFrame, cell, TYPE_INT);
+	cell.i = ARRAY_LENGTH(array);
+	pushOperand(jthread->currentStackFrame, cell);
+	return 1;
 }
 
 int handle_instr_athrow(bc_interpreter_t *interpreter, bool wide) {
-    slot_t slot = popOperand(interpreter->jthread->currentStackFrame, NULL).a;
+    slot_t slot = popOperand(interpreter->jthread->currentStackFrame).a;
     if(!slot) {
         throwException(interpreter, "java/lang/NullPointerException", "Cannot throw null");
         return 0;
@@ -2180,39 +3289,40 @@ int handle_instr_instanceof(bc_interpreter_t *interpreter, bool wide) {
 }
 
 int handle_instr_monitorenter(bc_interpreter_t *interpreter, bool wide) {
-	slot_t slot = popOperand(interpreter->jthread->currentStackFrame, NULL).a;
+	slot_t slot = popOperand(interpreter->jthread->currentStackFrame).a;
 	if(!slot) {
 	    throwException(interpreter, "java/lang/NullPointerException", "Cannot enter a monitor on a null object");
 	    return 0;
 	}
 	object_t *obj = getObject(slot);
-	jlock_lock(interpreter->jthread->id, &obj->jlock);
+	lockObject(interpreter->jthread->id, obj);
 	return 1;
 }
 
 int handle_instr_monitorexit(bc_interpreter_t *interpreter, bool wide) {
-    slot_t slot = popOperand(interpreter->jthread->currentStackFrame, NULL).a;
+    slot_t slot = popOperand(interpreter->jthread->currentStackFrame).a;
     if(!slot) {
         throwException(interpreter, "java/lang/NullPointerException", "Cannot exit a monitor on a null object");
         return 0;
     }
     object_t *obj = getObject(slot);
-    if(interpreter->jthread->id != obj->jlock.owner) {
+    if(!unlockObject(interpreter->jthread->id, obj)) {
         throwException(interpreter, "java/lang/IllegalMonitorStateException", "Cannot exit a monitor that you do not own");
         return 0;
     }
-    jlock_unlock(interpreter->jthread->id, &obj->jlock);
     return 1;
 }
 
 int handle_instr_wide(bc_interpreter_t *interpreter, bool wide) {
-    return instr_table[(uint8_t) readByteOperand(interpreter->jthread, 1)](interpreter, true);
+    // wide is folded into the instruction it modifies when the method is translated so this is never executed
+    throwException(interpreter, "java/lang/InternalError", "Untranslated wide instruction");
+    return 0;
 }
 
 int handle_instr_multianewarray(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-	uint16_t classIndex = readShortOperand(jthread, 1);
-	uint8_t numDimensions = readByteOperand(jthread, 3);
+	uint16_t classIndex = jthread->pc[1].u;
+	uint8_t numDimensions = jthread->pc[2].u;
 	
 	uint16_t nameIndex = jthread->currentStackFrame->currentMethod->class->constantPool[classIndex]->classInfo.nameIndex;
 	char *className = jthread->currentStackFrame->currentMethod->class->constantPool[nameIndex]->utf8Info.chars;
@@ -2229,51 +3339,47 @@ int handle_instr_multianewarray(bc_interpreter_t *interpreter, bool wide) {
 	int32_t *sizes = (int32_t *) (jthread->currentStackFrame->operandStackBase + jthread->currentStackFrame->topOfStack - numDimensions);
 	
 	cell_t cell;
-	cell.a = newArray(numDimensions, sizes, class);
+	cell.a = newArray(jthread, numDimensions, sizes, class);
 	if(!cell.a) {
 	    throwException(interpreter, "java/lang/OutOfMemoryError", "Failed to create array");
 	    return 0;
 	}
 	jthread->currentStackFrame->topOfStack -= numDimensions;
-	pushOperand(jthread->currentStackFrame, cell, TYPE_REFERENCE);
-    return 4;
+	pushOperand(jthread->currentStackFrame, cell);
+    return 3;
 }
 
 int handle_instr_ifnull(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    int16_t offset = readShortOperand(jthread, 1);
+    cell_t top = popOperand(jthread->currentStackFrame);
     if(top.a == 0) {
-        jthread->pc += offset;
+        jthread->pc = jthread->pc[1].target;
         return 0;
     }
-    return 3;
+    return 2;
 }
 
 int handle_instr_ifnonnull(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    cell_t top = popOperand(jthread->currentStackFrame, NULL);
-    int16_t offset = readShortOperand(jthread, 1);
+    cell_t top = popOperand(jthread->currentStackFrame);
     if(top.a != 0) {
-        jthread->pc += offset;
+        jthread->pc = jthread->pc[1].target;
         return 0;
     }
-    return 3;
+    return 2;
 }
 
 int handle_instr_goto_w(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    int32_t offset = readIntOperand(jthread, 1);
-    jthread->pc += offset;
+    jthread->pc = jthread->pc[1].target;
     return 0;
 }
 
 int handle_instr_jsr_w(bc_interpreter_t *interpreter, bool wide) {
     jthread_t *jthread = interpreter->jthread;
-    int32_t offset = readIntOperand(jthread, 1);
-    cell_t returnAddress =  {.r = jthread->pc + 1 - jthread->currentStackFrame->currentMethod->codeAttribute->code};
-    jthread->pc += offset;
-    pushOperand(jthread->currentStackFrame, returnAddress, TYPE_RETURN_ADDRESS);
+    cell_t returnAddress =  {.r = jthread->pc + 2 - getTranslatedCode(jthread->currentStackFrame->currentMethod)->code};
+    jthread->pc = jthread->pc[1].target;
+    pushOperand(jthread->currentStackFrame, returnAddress);
     return 0;
 }
 
@@ -2291,3 +3397,238 @@ int handle_instr_impdep2(bc_interpreter_t *interpreter, bool wide) {
     throwException(interpreter, "java/lang/InternalError", "Unimplemented Instruction");
     return 0;
 }
+
+// The quick field instructions read the field's address (static) or offset (instance) from the operand written when
+// the instruction was quickened instead of resolving the field each time. Values smaller than an int are extended to
+// fill the whole cell.
+
+#define GETSTATIC_QUICK_HANDLER(name, dataType, field) \
+    int handle_instr_##name(bc_interpreter_t *interpreter, bool wide) { \
+        cell_t cell; \
+        cell.field = *(dataType *) interpreter->jthread->pc[2].ptr; \
+        pushOperand(interpreter->jthread->currentStackFrame, cell); \
+        return 3; \
+    }
+
+#define GETSTATIC2_QUICK_HANDLER(name, dataType, field) \
+    int handle_instr_##name(bc_interpreter_t *interpreter, bool wide) { \
+        double_cell_t cell; \
+        cell.field = *(dataType *) interpreter->jthread->pc[2].ptr; \
+        pushOperand2(interpreter->jthread->currentStackFrame, cell); \
+        return 3; \
+    }
+
+#define PUTSTATIC_QUICK_HANDLER(name, dataType, field, barrier) \
+    int handle_instr_##name(bc_interpreter_t *interpreter, bool wide) { \
+        barrier(interpreter->jthread, interpreter->jthread->pc[2].ptr); \
+        *(dataType *) interpreter->jthread->pc[2].ptr = popOperand(interpreter->jthread->currentStackFrame).field; \
+        return 3; \
+    }
+
+#define PUTSTATIC2_QUICK_HANDLER(name, dataType, field) \
+    int handle_instr_##name(bc_interpreter_t *interpreter, bool wide) { \
+        *(dataType *) interpreter->jthread->pc[2].ptr = popOperand2(interpreter->jthread->currentStackFrame).field; \
+        return 3; \
+    }
+
+#define GETFIELD_QUICK_HANDLER(name, dataType, field) \
+    int handle_instr_##name(bc_interpreter_t *interpreter, bool wide) { \
+        jthread_t *jthread = interpreter->jthread; \
+        object_t *obj = getObject(popOperand(jthread->currentStackFrame).a); \
+        if(!obj) { \
+            throwException(interpreter, "java/lang/NullPointerException", "Cannot retrieve field from null"); \
+            return 0; \
+        } \
+        cell_t cell; \
+        cell.field = *(dataType *) ((void *) obj + jthread->pc[2].u); \
+        pushOperand(jthread->currentStackFrame, cell); \
+        return 3; \
+    }
+
+#define GETFIELD2_QUICK_HANDLER(name, dataType, field) \
+    int handle_instr_##name(bc_interpreter_t *interpreter, bool wide) { \
+        jthread_t *jthread = interpreter->jthread; \
+        object_t *obj = getObject(popOperand(jthread->currentStackFrame).a); \
+        if(!obj) { \
+            throwException(interpreter, "java/lang/NullPointerException", "Cannot retrieve field from null"); \
+            return 0; \
+        } \
+        double_cell_t cell; \
+        cell.field = *(dataType *) ((void *) obj + jthread->pc[2].u); \
+        pushOperand2(jthread->currentStackFrame, cell); \
+        return 3; \
+    }
+
+#define PUTFIELD_QUICK_HANDLER(name, dataType, field, barrier) \
+    int handle_instr_##name(bc_interpreter_t *interpreter, bool wide) { \
+        jthread_t *jthread = interpreter->jthread; \
+        cell_t value = popOperand(jthread->currentStackFrame); \
+        object_t *obj = getObject(popOperand(jthread->currentStackFrame).a); \
+        if(!obj) { \
+            throwException(interpreter, "java/lang/NullPointerException", "Cannot set field of null"); \
+            return 0; \
+        } \
+        barrier(jthread, (void *) obj + jthread->pc[2].u); \
+        *(dataType *) ((void *) obj + jthread->pc[2].u) = value.field; \
+        return 3; \
+    }
+
+#define PUTFIELD2_QUICK_HANDLER(name, dataType, field) \
+    int handle_instr_##name(bc_interpreter_t *interpreter, bool wide) { \
+        jthread_t *jthread = interpreter->jthread; \
+        double_cell_t value = popOperand2(jthread->currentStackFrame); \
+        object_t *obj = getObject(popOperand(jthread->currentStackFrame).a); \
+        if(!obj) { \
+            throwException(interpreter, "java/lang/NullPointerException", "Cannot set field of null"); \
+            return 0; \
+        } \
+        *(dataType *) ((void *) obj + jthread->pc[2].u) = value.field; \
+        return 3; \
+    }
+
+GETSTATIC_QUICK_HANDLER(getstatic_quick_b, int8_t, i)
+GETSTATIC_QUICK_HANDLER(getstatic_quick_c, uint16_t, i)
+GETSTATIC_QUICK_HANDLER(getstatic_quick_s, int16_t, i)
+GETSTATIC_QUICK_HANDLER(getstatic_quick_z, uint8_t, i)
+GETSTATIC_QUICK_HANDLER(getstatic_quick_i, int32_t, i)
+GETSTATIC_QUICK_HANDLER(getstatic_quick_f, float, f)
+GETSTATIC2_QUICK_HANDLER(getstatic_quick_j, int64_t, l)
+GETSTATIC2_QUICK_HANDLER(getstatic_quick_d, double, d)
+GETSTATIC_QUICK_HANDLER(getstatic_quick_a, slot_t, a)
+
+PUTSTATIC_QUICK_HANDLER(putstatic_quick_8, uint8_t, z, NO_WRITE_BARRIER)
+PUTSTATIC_QUICK_HANDLER(putstatic_quick_16, uint16_t, c, NO_WRITE_BARRIER)
+PUTSTATIC_QUICK_HANDLER(putstatic_quick_32, uint32_t, i, NO_WRITE_BARRIER)
+PUTSTATIC2_QUICK_HANDLER(putstatic_quick_64, int64_t, l)
+PUTSTATIC_QUICK_HANDLER(putstatic_quick_a, slot_t, a, SATB_WRITE_BARRIER)
+
+GETFIELD_QUICK_HANDLER(getfield_quick_b, int8_t, i)
+GETFIELD_QUICK_HANDLER(getfield_quick_c, uint16_t, i)
+GETFIELD_QUICK_HANDLER(getfield_quick_s, int16_t, i)
+GETFIELD_QUICK_HANDLER(getfield_quick_z, uint8_t, i)
+GETFIELD_QUICK_HANDLER(getfield_quick_i, int32_t, i)
+GETFIELD_QUICK_HANDLER(getfield_quick_f, float, f)
+GETFIELD2_QUICK_HANDLER(getfield_quick_j, int64_t, l)
+GETFIELD2_QUICK_HANDLER(getfield_quick_d, double, d)
+GETFIELD_QUICK_HANDLER(getfield_quick_a, slot_t, a)
+
+PUTFIELD_QUICK_HANDLER(putfield_quick_8, uint8_t, z, NO_WRITE_BARRIER)
+PUTFIELD_QUICK_HANDLER(putfield_quick_16, uint16_t, c, NO_WRITE_BARRIER)
+PUTFIELD_QUICK_HANDLER(putfield_quick_32, uint32_t, i, NO_WRITE_BARRIER)
+PUTFIELD2_QUICK_HANDLER(putfield_quick_64, int64_t, l)
+PUTFIELD_QUICK_HANDLER(putfield_quick_a, slot_t, a, OBJECT_WRITE_BARRIER)
+
+/**
+ *
+ * @param interpreter
+ * @param method the resolved method. Used for finding the receiver
+ * @return the object the method is being invoked on or NULL in which case a NullPointerException is thrown
+ */
+object_t *getReceiver(bc_interpreter_t *interpreter, method_t *method) {
+    object_t *obj = getObject(peekOperand(interpreter->jthread->currentStackFrame, method->numParameters - 1).a);
+    if(!obj)
+        throwException(interpreter, "java/lang/NullPointerException", "Cannot invoke method on null");
+    return obj;
+}
+
+int handle_instr_invokevirtual_quick(bc_interpreter_t *interpreter, bool wide) {
+    inline_cache_t *cache = interpreter->jthread->pc[2].ptr;
+    object_t *obj = getReceiver(interpreter, cache->method);
+    if(obj)
+        invokeMethod(interpreter, lookupInlineCache(interpreter, cache, obj->class, false), 3);
+    return 0;
+}
+
+int handle_instr_invokespecial_quick(bc_interpreter_t *interpreter, bool wide) {
+    method_t *method = interpreter->jthread->pc[2].ptr;
+    if(getReceiver(interpreter, method))
+        invokeMethod(interpreter, method, 3);
+    return 0;
+}
+
+int handle_instr_invokestatic_quick(bc_interpreter_t *interpreter, bool wide) {
+    invokeMethod(interpreter, interpreter->jthread->pc[2].ptr, 3);
+    return 0;
+}
+
+int handle_instr_invokeinterface_quick(bc_interpreter_t *interpreter, bool wide) {
+    inline_cache_t *cache = interpreter->jthread->pc[2].ptr;
+    object_t *obj = getReceiver(interpreter, cache->method);
+    if(!obj)
+        return 0;
+    method_t *method = lookupInlineCache(interpreter, cache, obj->class, true);
+    if(method)
+        invokeMethod(interpreter, method, 3);
+    return 0;
+}
+
+/**
+ * Executes the instructions combined by a superinstruction one after another. This saves a trip through the interpreter
+ * loop for every instruction but the first.
+ * @param interpreter
+ * @param length the number of instructions in the superinstruction
+ * @return the number of words in the superinstruction or 0 if one of the instructions branched, returned, or threw an
+ * exception, in which case the pc is left where that instruction put it
+ */
+int handle_superinstruction(bc_interpreter_t *interpreter, int length) {
+    jthread_t *jthread = interpreter->jthread;
+    translated_code_t *translatedCode = getTranslatedCode(jthread->currentStackFrame->currentMethod);
+    code_word_t *start = jthread->pc;
+    for(int i = 0; i < length; ++i) {
+        int ret = instr_table[translatedCode->opcodes[jthread->pc - translatedCode->code]](interpreter, false);
+        if(ret <= 0)
+            return ret;
+        jthread->pc += ret;
+    }
+    int numWords = jthread->pc - start;
+    jthread->pc = start;
+    return numWords;
+}
+
+int handle_instr_iload_iload_iadd(bc_interpreter_t *interpreter, bool wide) {
+    return handle_superinstruction(interpreter, 3);
+}
+
+int handle_instr_iload_iload_if_icmpeq(bc_interpreter_t *interpreter, bool wide) {
+    return handle_superinstruction(interpreter, 3);
+}
+
+int handle_instr_iload_iload_if_icmpne(bc_interpreter_t *interpreter, bool wide) {
+    return handle_superinstruction(interpreter, 3);
+}
+
+int handle_instr_iload_iload_if_icmplt(bc_interpreter_t *interpreter, bool wide) {
+    return handle_superinstruction(interpreter, 3);
+}
+
+int handle_instr_iload_iload_if_icmpge(bc_interpreter_t *interpreter, bool wide) {
+    return handle_superinstruction(interpreter, 3);
+}
+
+int handle_instr_iload_iload_if_icmpgt(bc_interpreter_t *interpreter, bool wide) {
+    return handle_superinstruction(interpreter, 3);
+}
+
+int handle_instr_iload_iload_if_icmple(bc_interpreter_t *interpreter, bool wide) {
+    return handle_superinstruction(interpreter, 3);
+}
+
+int handle_instr_iload_iload(bc_interpreter_t *interpreter, bool wide) {
+    return handle_superinstruction(interpreter, 2);
+}
+
+int handle_instr_aload_getfield_quick_i(bc_interpreter_t *interpreter, bool wide) {
+    return handle_superinstruction(interpreter, 2);
+}
+
+int handle_instr_aload_getfield_quick_a(bc_interpreter_t *interpreter, bool wide) {
+    return handle_superinstruction(interpreter, 2);
+}
+
+int handle_instr_iinc_goto(bc_interpreter_t *interpreter, bool wide) {
+    return handle_superinstruction(interpreter, 2);
+}
+
+int handle_instr_iadd_istore(bc_interpreter_t *interpreter, bool wide) {
+    return handle_superinstruction(interpreter, 2);
+}
@@ -20,6 +20,29 @@ typedef struct bc_interpreter {
 
 int run(bc_interpreter_t *interpreter);
 
+#ifdef DIRECT_THREADED_INTERPRETER
+/**
+ *
+ * @return the addresses of the direct threaded interpreter's instruction implementations indexed by opcode
+ */
+const void *const *getDispatchTable();
+#endif
+
+#ifdef INLINE_CACHE_STATISTICS
+/**
+ * prints the total number of inline cache hits, misses, and lookups done by call sites whose inline cache is full
+ */
+void printInlineCacheStatistics();
+#endif
+
+#ifdef OPCODE_PROFILING
+/**
+ * prints the pairs and triples of adjacent instructions that were executed the most. These are the candidates for
+ * superinstructions
+ */
+void printOpcodeProfile();
+#endif
+
 /**
  * used for throwing exceptions that were not caused by the throw instruction
  * @param interpreter
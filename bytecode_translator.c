@@ -0,0 +1,581 @@
+#include "bytecode_translator.h"
+#include "opcodes.h"
+#include "stack_map.h"
+#ifdef BASELINE_JIT
+#include "jit.h"
+#endif
+#include <stdlib.h>
+#include <string.h>
+
+static uint16_t readu2(uint8_t *code) {
+    return (uint16_t) ((code[0] << 8u) | code[1]);
+}
+
+static int32_t reads4(uint8_t *code) {
+    return (int32_t) (((uint32_t) code[0] << 24u) | ((uint32_t) code[1] << 16u) | ((uint32_t) code[2] << 8u) | code[3]);
+}
+
+uint32_t instructionSize(uint8_t *code, uint32_t offset, uint32_t codeLength, uint32_t *numWords) {
+    uint32_t numBytes;
+    switch(code[offset]) {
+        case OP_bipush:
+        case OP_ldc:
+        case OP_iload:
+        case OP_lload:
+        case OP_fload:
+        case OP_dload:
+        case OP_aload:
+        case OP_istore:
+        case OP_lstore:
+        case OP_fstore:
+        case OP_dstore:
+        case OP_astore:
+        case OP_ret:
+        case OP_newarray:
+            numBytes = 2;
+            *numWords = 2;
+            break;
+        case OP_sipush:
+        case OP_ldc_w:
+        case OP_ldc2_w:
+        case OP_ifeq:
+        case OP_ifne:
+        case OP_iflt:
+        case OP_ifge:
+        case OP_ifgt:
+        case OP_ifle:
+        case OP_if_icmpeq:
+        case OP_if_icmpne:
+        case OP_if_icmplt:
+        case OP_if_icmpge:
+        case OP_if_icmpgt:
+        case OP_if_icmple:
+        case OP_if_acmpeq:
+        case OP_if_acmpne:
+        case OP_goto:
+        case OP_jsr:
+        case OP_new:
+        case OP_anewarray:
+        case OP_checkcast:
+        case OP_instanceof:
+        case OP_ifnull:
+        case OP_ifnonnull:
+            numBytes = 3;
+            *numWords = 2;
+            break;
+        case OP_iinc:
+        case OP_getstatic:
+        case OP_putstatic:
+        case OP_getfield:
+        case OP_putfield:
+        case OP_invokevirtual:
+        case OP_invokespecial:
+        case OP_invokestatic:
+            // field and method instructions have room for the data used by the quick version of the instruction
+            numBytes = 3;
+            *numWords = 3;
+            break;
+        case OP_multianewarray:
+            numBytes = 4;
+            *numWords = 3;
+            break;
+        case OP_invokeinterface:
+            numBytes = 5;
+            *numWords = 3;
+            break;
+        case OP_invokedynamic:
+            numBytes = 5;
+            *numWords = 2;
+            break;
+        case OP_goto_w:
+        case OP_jsr_w:
+            numBytes = 5;
+            *numWords = 2;
+            break;
+        case OP_iload_0:
+        case OP_iload_1:
+        case OP_iload_2:
+        case OP_iload_3:
+        case OP_lload_0:
+        case OP_lload_1:
+        case OP_lload_2:
+        case OP_lload_3:
+        case OP_fload_0:
+        case OP_fload_1:
+        case OP_fload_2:
+        case OP_fload_3:
+        case OP_dload_0:
+        case OP_dload_1:
+        case OP_dload_2:
+        case OP_dload_3:
+        case OP_aload_0:
+        case OP_aload_1:
+        case OP_aload_2:
+        case OP_aload_3:
+        case OP_istore_0:
+        case OP_istore_1:
+        case OP_istore_2:
+        case OP_istore_3:
+        case OP_lstore_0:
+        case OP_lstore_1:
+        case OP_lstore_2:
+        case OP_lstore_3:
+        case OP_fstore_0:
+        case OP_fstore_1:
+        case OP_fstore_2:
+        case OP_fstore_3:
+        case OP_dstore_0:
+        case OP_dstore_1:
+        case OP_dstore_2:
+        case OP_dstore_3:
+        case OP_astore_0:
+        case OP_astore_1:
+        case OP_astore_2:
+        case OP_astore_3:
+            // the implicit index is kept as an operand so that these instructions look the same as the long forms
+            numBytes = 1;
+            *numWords = 2;
+            break;
+        case OP_tableswitch: {
+            // the operands are aligned to a multiple of 4 bytes from the start of the code
+            uint32_t operands = (offset + 4) & ~3u;
+            if(operands + 12 > codeLength)
+                return 0;
+            int32_t low = reads4(code + operands + 4);
+            int32_t high = reads4(code + operands + 8);
+            if(high < low)
+                return 0;
+            uint64_t numTargets = (uint64_t) ((int64_t) high - low + 1);
+            if(operands + 12 + 4 * numTargets > codeLength)
+                return 0;
+            numBytes = operands + 12 + 4 * numTargets - offset;
+            *numWords = 4 + numTargets;
+            break;
+        }
+        case OP_lookupswitch: {
+            uint32_t operands = (offset + 4) & ~3u;
+            if(operands + 8 > codeLength)
+                return 0;
+            int32_t npairs = reads4(code + operands + 4);
+            if(npairs < 0 || operands + 8 + 8 * (uint64_t) npairs > codeLength)
+                return 0;
+            numBytes = operands + 8 + 8 * npairs - offset;
+            *numWords = 3 + 2 * npairs;
+            break;
+        }
+        case OP_wide:
+            if(offset + 1 >= codeLength)
+                return 0;
+            if(code[offset + 1] == OP_iinc) {
+                numBytes = 6;
+                *numWords = 3;
+            }
+            else {
+                numBytes = 4;
+                *numWords = 2;
+            }
+            break;
+        default:
+            numBytes = 1;
+            *numWords = 1;
+            break;
+    }
+    if(offset + numBytes > codeLength)
+        return 0;
+    return numBytes;
+}
+
+/**
+ *
+ * @param translatedCode
+ * @param bytecodeOffset
+ * @return the translated instruction starting at the bytecode offset or NULL if no instruction starts there
+ */
+static code_word_t *translateTarget(translated_code_t *translatedCode, uint32_t codeLength, int64_t bytecodeOffset) {
+    if(bytecodeOffset < 0 || bytecodeOffset >= codeLength)
+        return NULL;
+    uint32_t wordOffset = translatedCode->wordOffsets[bytecodeOffset];
+    if(wordOffset == NOT_AN_INSTRUCTION)
+        return NULL;
+    return translatedCode->code + wordOffset;
+}
+
+uint16_t canonicalOpcode(uint16_t opcode) {
+    if(opcode >= OP_iload_0 && opcode <= OP_aload_3)
+        return OP_iload + (opcode - OP_iload_0) / 4;
+    if(opcode >= OP_istore_0 && opcode <= OP_astore_3)
+        return OP_istore + (opcode - OP_istore_0) / 4;
+    if(opcode == OP_goto_w)
+        return OP_goto;
+    return opcode;
+}
+
+/**
+ * Finds the longest superinstruction starting with the instruction at the word index
+ * @param method
+ * @param translatedCode
+ * @param wordIndex
+ * @return the opcode of the superinstruction or the opcode of the instruction itself if no superinstruction starts there
+ */
+static uint16_t selectOpcode(method_t *method, translated_code_t *translatedCode, uint32_t wordIndex) {
+    // profiles are taken without superinstructions so they count the instructions that could be combined
+#ifndef OPCODE_PROFILING
+    code_attribute_t *codeAttribute = method->codeAttribute;
+    for(int i = 0; i < NUM_SUPERINSTRUCTIONS; ++i) {
+        const superinstruction_t *superinstruction = superinstructions + i;
+        uint32_t instruction = wordIndex;
+        uint16_t matched = 0;
+        while(matched < superinstruction->length && instruction < translatedCode->length) {
+            if(canonicalOpcode(translatedCode->opcodes[instruction]) != superinstruction->instructions[matched])
+                break;
+            uint32_t numWords;
+            instructionSize(codeAttribute->code, translatedCode->bytecodeOffsets[instruction], codeAttribute->codeLength, &numWords);
+            instruction += numWords;
+            ++matched;
+        }
+        if(matched == superinstruction->length)
+            return superinstruction->opcode;
+    }
+#endif
+    return translatedCode->opcodes[wordIndex];
+}
+
+/**
+ * Points the handler word of the instruction at its handler or at the handler of the superinstruction it starts.
+ * Superinstructions only replace the handler word of their first instruction and opcodes keeps the opcode of the
+ * instruction, so the instructions they combine can still be executed individually, for example by a branch into the
+ * middle of a superinstruction or when a superinstruction can't finish inline.
+ * @param method
+ * @param translatedCode
+ * @param wordIndex
+ */
+static void installHandler(method_t *method, translated_code_t *translatedCode, uint32_t wordIndex) {
+    uint16_t opcode = selectOpcode(method, translatedCode, wordIndex);
+    code_word_t *pc = translatedCode->code + wordIndex;
+    // the release store keeps the operands written by the caller from being reordered after the new handler
+#ifdef DIRECT_THREADED_INTERPRETER
+    __atomic_store_n(&pc->label, getDispatchTable()[opcode], __ATOMIC_RELEASE);
+#else
+    __atomic_store_n(&pc->handler, instr_table[opcode], __ATOMIC_RELEASE);
+#endif
+}
+
+static translated_code_t *translateMethod(method_t *method) {
+    code_attribute_t *codeAttribute = method->codeAttribute;
+    uint8_t *code = codeAttribute->code;
+    uint32_t codeLength = codeAttribute->codeLength;
+
+    translated_code_t *translatedCode = malloc(sizeof(translated_code_t));
+    if(!translatedCode)
+        return NULL;
+    translatedCode->wordOffsets = malloc(codeLength * sizeof(uint32_t));
+    if(!translatedCode->wordOffsets)
+        goto fail1;
+    for(uint32_t i = 0; i < codeLength; ++i)
+        translatedCode->wordOffsets[i] = NOT_AN_INSTRUCTION;
+
+    // first pass finds where every instruction starts so branch targets can be translated
+    uint32_t length = 0;
+    uint32_t numInlineCaches = 0;
+    for(uint32_t offset = 0; offset < codeLength;) {
+        uint32_t numWords;
+        uint32_t numBytes = instructionSize(code, offset, codeLength, &numWords);
+        if(!numBytes)
+            goto fail2;
+        if(code[offset] == OP_invokevirtual || code[offset] == OP_invokeinterface)
+            ++numInlineCaches;
+        translatedCode->wordOffsets[offset] = length;
+        offset += numBytes;
+        length += numWords;
+    }
+
+    translatedCode->length = length;
+    translatedCode->code = malloc(length * sizeof(code_word_t));
+    if(!translatedCode->code)
+        goto fail2;
+    translatedCode->opcodes = calloc(length, sizeof(uint16_t));
+    if(!translatedCode->opcodes)
+        goto fail3;
+    translatedCode->bytecodeOffsets = malloc(length * sizeof(uint32_t));
+    if(!translatedCode->bytecodeOffsets)
+        goto fail4;
+    translatedCode->inlineCaches = calloc(numInlineCaches, sizeof(inline_cache_t));
+    if(!translatedCode->inlineCaches && numInlineCaches)
+        goto fail5;
+    inline_cache_t *nextInlineCache = translatedCode->inlineCaches;
+    translatedCode->stackMap = NULL;
+#ifdef BASELINE_JIT
+    translatedCode->hotness = 0;
+    translatedCode->compilationStarted = false;
+    translatedCode->compiledCode = NULL;
+#endif
+
+#ifdef DIRECT_THREADED_INTERPRETER
+    const void *const *dispatchTable = getDispatchTable();
+#endif
+
+    for(uint32_t offset = 0; offset < codeLength;) {
+        uint32_t numWords;
+        uint32_t numBytes = instructionSize(code, offset, codeLength, &numWords);
+        code_word_t *words = translatedCode->code + translatedCode->wordOffsets[offset];
+        uint8_t *instr = code + offset;
+        uint8_t opcode = instr[0];
+
+        // wide is folded into the instruction it modifies since the operands are no longer limited to a single byte
+        bool wide = opcode == OP_wide;
+        if(wide)
+            opcode = instr[1];
+
+        translatedCode->opcodes[words - translatedCode->code] = opcode;
+        translatedCode->bytecodeOffsets[words - translatedCode->code] = offset;
+#ifdef DIRECT_THREADED_INTERPRETER
+        words[0].label = dispatchTable[opcode];
+#else
+        words[0].handler = instr_table[opcode];
+#endif
+
+        switch(opcode) {
+            case OP_bipush:
+                words[1].i = (int8_t) instr[1];
+                break;
+            case OP_sipush:
+                words[1].i = (int16_t) readu2(instr + 1);
+                break;
+            case OP_ldc:
+            case OP_newarray:
+                words[1].u = instr[1];
+                break;
+            case OP_iload:
+            case OP_lload:
+            case OP_fload:
+            case OP_dload:
+            case OP_aload:
+            case OP_istore:
+            case OP_lstore:
+            case OP_fstore:
+            case OP_dstore:
+            case OP_astore:
+            case OP_ret:
+                words[1].u = wide ? readu2(instr + 2) : instr[1];
+                break;
+            case OP_iload_0:
+            case OP_iload_1:
+            case OP_iload_2:
+            case OP_iload_3:
+            case OP_lload_0:
+            case OP_lload_1:
+            case OP_lload_2:
+            case OP_lload_3:
+            case OP_fload_0:
+            case OP_fload_1:
+            case OP_fload_2:
+            case OP_fload_3:
+            case OP_dload_0:
+            case OP_dload_1:
+            case OP_dload_2:
+            case OP_dload_3:
+            case OP_aload_0:
+            case OP_aload_1:
+            case OP_aload_2:
+            case OP_aload_3:
+                words[1].u = (opcode - OP_iload_0) % 4;
+                break;
+            case OP_istore_0:
+            case OP_istore_1:
+            case OP_istore_2:
+            case OP_istore_3:
+            case OP_lstore_0:
+            case OP_lstore_1:
+            case OP_lstore_2:
+            case OP_lstore_3:
+            case OP_fstore_0:
+            case OP_fstore_1:
+            case OP_fstore_2:
+            case OP_fstore_3:
+            case OP_dstore_0:
+            case OP_dstore_1:
+            case OP_dstore_2:
+            case OP_dstore_3:
+            case OP_astore_0:
+            case OP_astore_1:
+            case OP_astore_2:
+            case OP_astore_3:
+                words[1].u = (opcode - OP_istore_0) % 4;
+                break;
+            case OP_iinc:
+                if(wide) {
+                    words[1].u = readu2(instr + 2);
+                    words[2].i = (int16_t) readu2(instr + 4);
+                }
+                else {
+                    words[1].u = instr[1];
+                    words[2].i = (int8_t) instr[2];
+                }
+                break;
+            case OP_ldc_w:
+            case OP_ldc2_w:
+            case OP_invokedynamic:
+            case OP_new:
+            case OP_anewarray:
+            case OP_checkcast:
+            case OP_instanceof:
+                words[1].u = readu2(instr + 1);
+                break;
+            case OP_getstatic:
+            case OP_putstatic:
+            case OP_getfield:
+            case OP_putfield:
+            case OP_invokespecial:
+            case OP_invokestatic:
+                words[1].u = readu2(instr + 1);
+                words[2].ptr = NULL;
+                break;
+            case OP_invokevirtual:
+            case OP_invokeinterface:
+                // the count operand of invokeinterface is redundant with the method descriptor so it isn't kept
+                words[1].u = readu2(instr + 1);
+                words[2].ptr = nextInlineCache++;
+                break;
+            case OP_multianewarray:
+                words[1].u = readu2(instr + 1);
+                words[2].u = instr[3];
+                break;
+            case OP_ifeq:
+            case OP_ifne:
+            case OP_iflt:
+            case OP_ifge:
+            case OP_ifgt:
+            case OP_ifle:
+            case OP_if_icmpeq:
+            case OP_if_icmpne:
+            case OP_if_icmplt:
+            case OP_if_icmpge:
+            case OP_if_icmpgt:
+            case OP_if_icmple:
+            case OP_if_acmpeq:
+            case OP_if_acmpne:
+            case OP_goto:
+            case OP_jsr:
+            case OP_ifnull:
+            case OP_ifnonnull:
+                words[1].target = translateTarget(translatedCode, codeLength, (int64_t) offset + (int16_t) readu2(instr + 1));
+                if(!words[1].target)
+                    goto fail6;
+                break;
+            case OP_goto_w:
+            case OP_jsr_w:
+                words[1].target = translateTarget(translatedCode, codeLength, (int64_t) offset + reads4(instr + 1));
+                if(!words[1].target)
+                    goto fail6;
+                break;
+            case OP_tableswitch: {
+                uint8_t *operands = code + ((offset + 4) & ~3u);
+                words[1].target = translateTarget(translatedCode, codeLength, (int64_t) offset + reads4(operands));
+                if(!words[1].target)
+                    goto fail6;
+                words[2].i = reads4(operands + 4);
+                words[3].i = reads4(operands + 8);
+                for(uint32_t i = 4; i < numWords; ++i) {
+                    words[i].target = translateTarget(translatedCode, codeLength, (int64_t) offset + reads4(operands + 12 + 4 * (i - 4)));
+                    if(!words[i].target)
+                        goto fail6;
+                }
+                break;
+            }
+            case OP_lookupswitch: {
+                uint8_t *operands = code + ((offset + 4) & ~3u);
+                words[1].target = translateTarget(translatedCode, codeLength, (int64_t) offset + reads4(operands));
+                if(!words[1].target)
+                    goto fail6;
+                words[2].i = reads4(operands + 4);
+                for(int32_t i = 0; i < words[2].i; ++i) {
+                    words[3 + 2 * i].i = reads4(operands + 8 + 8 * i);
+                    if(i > 0 && words[3 + 2 * i].i <= words[1 + 2 * i].i)
+                        goto fail6;
+                    words[4 + 2 * i].target = translateTarget(translatedCode, codeLength, (int64_t) offset + reads4(operands + 12 + 8 * i));
+                    if(!words[4 + 2 * i].target)
+                        goto fail6;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+
+        offset += numBytes;
+    }
+
+    // exception handlers are looked up by bytecode offset so they must line up with translated instructions
+    for(int i = 0; i < codeAttribute->exceptionTableLength; ++i) {
+        if(!translateTarget(translatedCode, codeLength, codeAttribute->exceptionHandlers[i].handlerPC))
+            goto fail6;
+    }
+
+    // superinstructions are selected once every instruction has its operands
+    for(uint32_t offset = 0; offset < codeLength; ++offset) {
+        if(translatedCode->wordOffsets[offset] != NOT_AN_INSTRUCTION)
+            installHandler(method, translatedCode, translatedCode->wordOffsets[offset]);
+    }
+
+    return translatedCode;
+
+    fail6: free(translatedCode->inlineCaches);
+    fail5: free(translatedCode->bytecodeOffsets);
+    fail4: free(translatedCode->opcodes);
+    fail3: free(translatedCode->code);
+    fail2: free(translatedCode->wordOffsets);
+    fail1: free(translatedCode);
+    return NULL;
+}
+
+translated_code_t *getTranslatedCode(method_t *method) {
+    code_attribute_t *codeAttribute = method->codeAttribute;
+    if(!codeAttribute)
+        return NULL;
+
+    translated_code_t *translatedCode = atomic_load_explicit(&codeAttribute->translatedCode, memory_order_acquire);
+    if(translatedCode)
+        return translatedCode;
+
+    translated_code_t *newCode = translateMethod(method);
+    if(!newCode)
+        return NULL;
+
+    // another thread may have finished translating the method first in which case its translation is used instead
+    if(atomic_compare_exchange_strong_explicit(&codeAttribute->translatedCode, &translatedCode, newCode, memory_order_acq_rel, memory_order_acquire))
+        return newCode;
+    freeTranslatedCode(newCode);
+    return translatedCode;
+}
+
+void rewriteInstruction(method_t *method, code_word_t *pc, uint16_t opcode) {
+    translated_code_t *translatedCode = getTranslatedCode(method);
+    uint32_t wordIndex = pc - translatedCode->code;
+    translatedCode->opcodes[wordIndex] = opcode;
+    installHandler(method, translatedCode, wordIndex);
+
+    // the new instruction may complete a superinstruction starting at one of the instructions before it. Superinstructions
+    // only contain instructions that are never rewritten so ones that already matched stay valid
+    uint32_t offset = translatedCode->bytecodeOffsets[wordIndex];
+    for(int i = 1; i < MAX_SUPERINSTRUCTION_LENGTH && offset > 0; ++i) {
+        do {
+            --offset;
+        } while(translatedCode->wordOffsets[offset] == NOT_AN_INSTRUCTION);
+        installHandler(method, translatedCode, translatedCode->wordOffsets[offset]);
+    }
+}
+
+void freeTranslatedCode(translated_code_t *translatedCode) {
+    if(!translatedCode)
+        return;
+    freeStackMap(translatedCode->stackMap);
+#ifdef BASELINE_JIT
+    freeCompiledCode(translatedCode->compiledCode);
+#endif
+    free(translatedCode->inlineCaches);
+    free(translatedCode->bytecodeOffsets);
+    free(translatedCode->opcodes);
+    free(translatedCode->code);
+    free(translatedCode->wordOffsets);
+    free(translatedCode);
+}
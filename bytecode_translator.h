@@ -0,0 +1,120 @@
+#ifndef JVM_BYTECODE_TRANSLATOR_H
+#define JVM_BYTECODE_TRANSLATOR_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "bytecode_interpreter.h"
+
+// marks bytecode offsets which are not the start of an instruction
+#define NOT_AN_INSTRUCTION  UINT32_MAX
+
+/**
+ * A single word of a translated method. The first word of every instruction holds the address of its handler and is
+ * followed by the decoded operands of the instruction.
+ */
+typedef union code_word {
+    int (*handler)(bc_interpreter_t *interpreter, bool wide);
+    const void *label; // used by the direct threaded interpreter
+    int32_t i;
+    uint32_t u;
+    union code_word *target;
+    void *ptr;
+} code_word_t;
+
+#define INLINE_CACHE_SIZE 4
+
+typedef struct inline_cache_entry {
+    _Atomic(class_t *) class; // NULL until the entry is filled
+    method_t *method;
+} inline_cache_entry_t;
+
+/**
+ * The classes of the receivers seen by an invokevirtual or invokeinterface instruction along with the method invoked for
+ * each of them. Entries are filled in order and never change once filled. Call sites that see more receiver classes
+ * than fit in the cache are megamorphic and do a full lookup for every uncached class.
+ */
+typedef struct inline_cache {
+    method_t *method; // the resolved method
+    inline_cache_entry_t entries[INLINE_CACHE_SIZE];
+    atomic_uint numEntries;
+} inline_cache_t;
+
+/**
+ * Method bodies are translated into an array of code words with all operands decoded into native endian words, wide
+ * instructions folded into the instruction they modify, and branch offsets replaced by pointers to the target
+ * instruction. Handlers return the number of words they consumed instead of the number of bytes.
+ *
+ * Common sequences of instructions are executed by superinstructions (see superinstructions.csv). A superinstruction
+ * replaces the handler of the first instruction in the sequence while every instruction keeps its own operands and its
+ * entry in opcodes.
+ *
+ * Layout of the operands following the handler word:
+ *   bipush, sipush                     value
+ *   ldc, ldc_w, ldc2_w                 constant pool index
+ *   loads, stores, ret                 local variable index. Also kept for the forms with an implicit index
+ *   iinc                               local variable index, increment
+ *   branches, goto_w, jsr_w            target
+ *   tableswitch                        default target, low, high, targets[high - low + 1]
+ *   lookupswitch                       default target, npairs, {match, target}[npairs] sorted by match
+ *   field instructions                 constant pool index, quick data
+ *   method instructions                constant pool index
+ *   invokeinterface                    constant pool index, count
+ *   new, anewarray, checkcast,
+ *   instanceof                         constant pool index
+ *   newarray                           array type
+ *   multianewarray                     constant pool index, dimensions
+ */
+struct translated_code {
+    code_word_t *code;
+    uint16_t *opcodes; // opcode of the instruction starting at each word. Includes quick opcodes but not superinstructions
+    uint32_t *bytecodeOffsets; // bytecode offset of the instruction starting at each word
+    uint32_t *wordOffsets; // word index of the instruction starting at each bytecode offset
+    inline_cache_t *inlineCaches; // one for each invokevirtual and invokeinterface instruction
+    _Atomic(struct stack_map *) stackMap; // computed the first time the garbage collector scans a frame of the method
+    uint32_t length;
+#ifdef BASELINE_JIT
+    atomic_uint hotness; // calls and taken branches counted while the method is interpreted. See jit.h
+    atomic_bool compilationStarted;
+    _Atomic(struct compiled_code *) compiledCode; // NULL until the method is compiled
+#endif
+};
+
+/**
+ * Translates the method's bytecode the first time it's called and returns the cached translation afterwards. Multiple
+ * threads may race to translate the same method in which case only one translation is kept.
+ * @param method
+ * @return the translated code or NULL if the method has no code, contains malformed bytecode, or memory ran out
+ */
+translated_code_t *getTranslatedCode(method_t *method);
+
+/**
+ * Calculates the sizes of the instruction at the offset in both bytes and translated words
+ * @param code
+ * @param offset
+ * @param codeLength
+ * @param numWords set to the number of words the translated instruction takes up
+ * @return the number of bytes the instruction takes up or 0 if the instruction runs past the end of the code
+ */
+uint32_t instructionSize(uint8_t *code, uint32_t offset, uint32_t codeLength, uint32_t *numWords);
+
+/**
+ * Short forms of loads and stores and goto_w are treated as the general form of the instruction when matching
+ * superinstructions
+ * @param opcode
+ * @return the opcode superinstructions refer to the instruction by
+ */
+uint16_t canonicalOpcode(uint16_t opcode);
+
+/**
+ * Replaces the instruction at pc with another instruction that takes the same operands, usually a quickened version of
+ * it. Any operands the new instruction reads must be written before calling this since other threads may execute the
+ * instruction as soon as the handler is replaced. Superinstructions including the new instruction are selected again.
+ * @param method the method containing the instruction
+ * @param pc
+ * @param opcode
+ */
+void rewriteInstruction(method_t *method, code_word_t *pc, uint16_t opcode);
+
+void freeTranslatedCode(translated_code_t *translatedCode);
+
+#endif //JVM_BYTECODE_TRANSLATOR_H
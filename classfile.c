@@ -20,7 +20,8 @@ int isArrayClass(class_t *class) {
  * @return 1 if the class represents a primitive type, otherwise 0
  */
 int isPrimitiveClass(class_t *class) {
-    return strlen(class->name) == 1;
+    // classes in the default package can also have single character names but they always have a superclass
+    return !class->superClass && strlen(class->name) == 1;
 }
 
 /**
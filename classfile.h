@@ -6,6 +6,7 @@
 #define JVM_CLASSFILE_H
 
 #include <stdint.h>
+#include <stdatomic.h>
 #include "jlock.h"
 
 typedef struct class_info {
@@ -92,6 +93,8 @@ typedef struct exception_table {
     uint16_t catchType;
 } exception_table_t;
 
+typedef struct translated_code translated_code_t;
+
 typedef struct code_attribute {
     char *name;
     uint16_t maxStack;
@@ -102,6 +105,7 @@ typedef struct code_attribute {
     exception_table_t *exceptionHandlers;
     uint16_t attributeCount;
     attribute_info_t **attributes;
+    _Atomic(translated_code_t *) translatedCode; // created the first time the method is invoked
 } code_attribute_t;
 
 // This attribute represents any skipped attribute
@@ -145,9 +149,17 @@ typedef struct method {
     attribute_info_t **attributes;
     uint16_t numAttributes;
     uint16_t flags;
+    uint16_t vtableIndex; // NO_VTABLE_INDEX for static, private, constructor, and interface methods
     uint8_t numParameters;
 } method_t;
 
+#define NO_VTABLE_INDEX UINT16_MAX
+
+typedef struct itable_entry {
+    class_t *interface;
+    method_t **methods; // the implementation of each of the interface's methods indexed the same as interface->methods. NULL for interfaces
+} itable_entry_t;
+
 #define CLASS_STATUS_LOADING 0
 #define CLASS_STATUS_LOADED 1
 #define CLASS_STATUS_INITIALIZING 2
@@ -163,12 +175,19 @@ struct class {
     field_t *fields;
     attribute_info_t **attributes;
     void *staticFieldData;
+    _Atomic(void *) *resolvedReferences; // the field_t or method_t each field or method ref resolved to, indexed the same as the constant pool
+    method_t **vtable; // the implementation of each virtual method. Inherited methods keep the index they have in the superclass
+    itable_entry_t *itable; // one entry for each interface implemented directly or indirectly by the class
+    uint16_t *referenceOffsets; // offsets of the instance fields holding references, including inherited ones
     jlock_t jlock;
     uint16_t numConstants;
     uint16_t numInterfaces;
     uint16_t numMethods;
     uint16_t numFields;
     uint16_t numAttributes;
+    uint16_t vtableLength;
+    uint16_t itableLength;
+    uint16_t numReferenceFields;
     uint16_t objectSize;
     uint16_t staticDataSize;
     uint16_t flags;
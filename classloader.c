@@ -6,12 +6,15 @@
 #include <stdlib.h>
 #include "hashmap.h"
 #include <pthread.h>
+#include <stdatomic.h>
 #include "stringutils.h"
 #include "constantpool.h"
 #include <stdio.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <string.h>
+#include <strings.h>
+#include <unistd.h>
 #include "utils.h"
 #include "flags.h"
 #include "dataTypes.h"
@@ -19,15 +22,74 @@
 #include "object.h"
 #include "jthread.h"
 #include "jvmSettings.h"
+#include "zip.h"
+#include "classpath_index.h"
 
-char **classpath = NULL;
+typedef struct classpath_entry {
+    char *path;
+    zip_archive_t *archive; // NULL if the entry is a directory
+} classpath_entry_t;
+
+classpath_entry_t *classpath = NULL;
 int classpathLength = 0;
 int classpathUsed = 0;
-size_t maxClassPathLen = 0;
 
+typedef struct class_location {
+    int classpathIndex;
+    zip_entry_t *zipEntry; // NULL if the class file is in a directory
+    // whether no classpath entry before this one can have the class. Classes of archives are indexed before the
+    // directories in front of them are listed
+    _Atomic bool isFirst;
+    char name[];
+} class_location_t;
+
+// class name -> class_location_t of the class file which is found for it on the classpath. The classes of an archive
+// are indexed when it's added, while a package of a directory is only listed once a class of the package is looked up,
+// so large directories aren't read as a whole. Never removed from, so it's read without taking a lock
+hashmap_t *classIndex;
+// package name -> number of classpath entries the directories of which were listed for the package
+hashmap_t *indexedPackages;
+// serializes the modifications of classIndex and indexedPackages
+pthread_mutex_t classIndexLock = PTHREAD_MUTEX_INITIALIZER;
+
+// only holds classes which finished loading. Classes are never removed, so it's read without taking a lock
 hashmap_t *loadedClasses;
+// class name -> class_loading_t of every class which is being loaded by some thread
+hashmap_t *loadingClasses;
+
+// serializes the modifications of loadedClasses and loadingClasses. It isn't held while a class is parsed, so threads
+// load unrelated classes in parallel
+pthread_mutex_t classTableLock = PTHREAD_MUTEX_INITIALIZER;
+// broadcast whenever a thread finished loading a class, whether it succeeded or not
+pthread_cond_t classLoadedCondition = PTHREAD_COND_INITIALIZER;
+
+typedef struct class_loading {
+    // the name of the class the loading thread is waiting for another thread to load, which is how cyclic dependencies
+    // between classes loaded by different threads are found
+    char **ownerAwaits;
+} class_loading_t;
+
+// the name of the class the current thread is waiting for another thread to load or NULL. Only accessed with
+// classTableLock held
+static _Thread_local char *awaitedClass = NULL;
+
+typedef struct prefetch_request {
+    char *className;
+    struct prefetch_request *next;
+} prefetch_request_t;
 
-pthread_mutex_t classLoadingLock = PTHREAD_MUTEX_INITIALIZER;
+size_t numClassLoaderThreads = 0;
+// classes which are waiting to be prefetched in the order they were requested
+static prefetch_request_t *prefetchQueueHead = NULL;
+static prefetch_request_t *prefetchQueueTail = NULL;
+// names of every class which was ever queued, so each class is only prefetched once
+static hashmap_t *prefetchedClasses;
+static pthread_mutex_t prefetchQueueMutex = PTHREAD_MUTEX_INITIALIZER;
+// signalled when a class is queued
+static pthread_cond_t prefetchQueuedCondition = PTHREAD_COND_INITIALIZER;
+// whether the current thread is a class loader thread. These don't report classes they fail to load since whichever
+// thread actually needs the class loads it again
+static _Thread_local bool isPrefetching = false;
 
 size_t str_hash_fn(char *str) {
     // modified djb2 hash algorithm from http://www.cse.yorku.ca/~oz/hash.html
@@ -43,7 +105,7 @@ bool str_equality_fn(char *str1, char *str2) {
 }
 
 bool initClassLoader() {
-    classpath = malloc(8 * sizeof(char *));
+    classpath = malloc(8 * sizeof(classpath_entry_t));
     if(!classpath)
         return false;
     // char * is the same size as void * so this cast just gets rid of the warning
@@ -52,29 +114,212 @@ bool initClassLoader() {
         free(classpath);
         return false;
     }
+    loadingClasses = ht_createHashmap((size_t (*)(void *)) &str_hash_fn, (bool (*)(void *, void *)) &str_equality_fn, 0.75f);
+    if(!loadingClasses) {
+        ht_destroyHashmap(loadedClasses);
+        free(classpath);
+        return false;
+    }
+    prefetchedClasses = ht_createHashmap((size_t (*)(void *)) &str_hash_fn, (bool (*)(void *, void *)) &str_equality_fn, 0.75f);
+    if(!prefetchedClasses) {
+        ht_destroyHashmap(loadingClasses);
+        ht_destroyHashmap(loadedClasses);
+        free(classpath);
+        return false;
+    }
+    classIndex = ht_createHashmap((size_t (*)(void *)) &str_hash_fn, (bool (*)(void *, void *)) &str_equality_fn, 0.75f);
+    if(!classIndex) {
+        ht_destroyHashmap(prefetchedClasses);
+        ht_destroyHashmap(loadingClasses);
+        ht_destroyHashmap(loadedClasses);
+        free(classpath);
+        return false;
+    }
+    indexedPackages = ht_createHashmap((size_t (*)(void *)) &str_hash_fn, (bool (*)(void *, void *)) &str_equality_fn, 0.75f);
+    if(!indexedPackages) {
+        ht_destroyHashmap(classIndex);
+        ht_destroyHashmap(prefetchedClasses);
+        ht_destroyHashmap(loadingClasses);
+        ht_destroyHashmap(loadedClasses);
+        free(classpath);
+        return false;
+    }
     
     // default class paths
-    classpath[0] = "./";
-    classpath[1] = "runtime";
+    classpath[0] = (classpath_entry_t) {"./", NULL};
+    classpath[1] = (classpath_entry_t) {"runtime", NULL};
     classpathLength = 8;
     classpathUsed = 2;
-    for(int i = 0; i < classpathUsed; ++i)
-        maxClassPathLen = MAX(maxClassPathLen, strlen(classpath[i]));
+    return true;
+}
+
+/**
+ * Indexes a class file unless a classpath entry before it has the same class. Must be called with classIndexLock held
+ * @param packagePrefix the package of the class followed by a slash, or an empty string
+ * @param prefixLength
+ * @param name the rest of the name of the class file without .class. Neither has to be null terminated
+ * @param nameLength
+ * @param classpathIndex
+ * @param zipEntry the entry of the class file or NULL if it's in a directory
+ * @return false if memory ran out
+ */
+static bool indexClassFile(const char *packagePrefix, size_t prefixLength, const char *name, size_t nameLength, int classpathIndex, zip_entry_t *zipEntry) {
+    class_location_t *location = malloc(sizeof(class_location_t) + prefixLength + nameLength + 1);
+    if(!location)
+        return false;
+    memcpy(location->name, packagePrefix, prefixLength);
+    memcpy(location->name + prefixLength, name, nameLength);
+    location->name[prefixLength + nameLength] = '\0';
+    class_location_t *other = ht_get(classIndex, location->name);
+    if(other && other->classpathIndex < classpathIndex) {
+        free(location);
+        return true;
+    }
+    location->classpathIndex = classpathIndex;
+    location->zipEntry = zipEntry;
+    // directories are listed in the order of the classpath
+    atomic_init(&location->isFirst, !zipEntry);
+    // a location which is replaced stays the key
+    if(!ht_put(classIndex, location->name, location, NULL)) {
+        free(location);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Indexes the class files of an archive. Must be called with classIndexLock held
+ * @return false if memory ran out
+ */
+static bool indexArchive(int classpathIndex) {
+    zip_archive_t *archive = classpath[classpathIndex].archive;
+    for(uint32_t slot = 0; slot <= archive->indexMask; ++slot) {
+        if(!archive->index[slot])
+            continue;
+        zip_entry_t *entry = archive->entries + archive->index[slot] - 1;
+        if(entry->nameLength > 6 && memcmp(entry->name + entry->nameLength - 6, ".class", 6) == 0 && !indexClassFile("", 0, entry->name, entry->nameLength - 6, classpathIndex, entry))
+            return false;
+    }
     return true;
 }
 
 bool addToClasspath(char *classpathLocation) {
     if(classpathUsed == classpathLength) {
-        char **newClasspath = realloc(classpath, classpathLength * sizeof(char *) * 2);
+        classpath_entry_t *newClasspath = realloc(classpath, classpathLength * sizeof(classpath_entry_t) * 2);
         if(!newClasspath)
             return false;
         classpath = newClasspath;
         classpathLength *= 2;
     }
     
-    classpath[classpathUsed++] = classpathLocation;
-    maxClassPathLen = MAX(maxClassPathLen, strlen(classpathLocation));
-    return true;
+    // anything which exists but isn't a directory has to be a jar or zip file
+    zip_archive_t *archive = NULL;
+    struct stat s;
+    if(stat(classpathLocation, &s) == 0 && !S_ISDIR(s.st_mode)) {
+        archive = zip_open(classpathLocation);
+        if(!archive)
+            return false;
+    }
+    
+    pthread_mutex_lock(&classIndexLock);
+    classpath[classpathUsed] = (classpath_entry_t) {classpathLocation, archive};
+    bool success = !archive || indexArchive(classpathUsed);
+    if(success)
+        ++classpathUsed;
+    pthread_mutex_unlock(&classIndexLock);
+    return success;
+}
+
+/**
+ * Finds the Main-Class attribute in the main section of a manifest. Its value can be continued on following lines which
+ * start with a space
+ * @param manifest
+ * @param size
+ * @return the value with slashes instead of dots or NULL if there is no such attribute
+ */
+char *readMainClassAttribute(const char *manifest, size_t size) {
+    const char *attribute = "Main-Class:";
+    size_t attributeLength = strlen(attribute);
+    char *mainClass = NULL;
+    size_t mainClassLength = 0;
+    bool isMainClassLine = false;
+    for(size_t position = 0; position < size;) {
+        const char *line = manifest + position;
+        size_t lineLength = 0;
+        while(position + lineLength < size && line[lineLength] != '\r' && line[lineLength] != '\n')
+            ++lineLength;
+        position += lineLength;
+        if(position < size && manifest[position] == '\r')
+            ++position;
+        if(position < size && manifest[position] == '\n')
+            ++position;
+        
+        // an empty line ends the main section
+        if(!lineLength)
+            break;
+        size_t valueStart;
+        if(line[0] == ' ') {
+            if(!isMainClassLine)
+                continue;
+            valueStart = 1;
+        }
+        else if(lineLength >= attributeLength && strncasecmp(line, attribute, attributeLength) == 0) {
+            isMainClassLine = true;
+            valueStart = attributeLength;
+            while(valueStart < lineLength && line[valueStart] == ' ')
+                ++valueStart;
+        }
+        else {
+            // the value of the attribute is complete once another attribute starts
+            if(isMainClassLine)
+                break;
+            continue;
+        }
+        
+        char *newMainClass = realloc(mainClass, mainClassLength + lineLength - valueStart + 1);
+        if(!newMainClass) {
+            free(mainClass);
+            return NULL;
+        }
+        mainClass = newMainClass;
+        memcpy(mainClass + mainClassLength, line + valueStart, lineLength - valueStart);
+        mainClassLength += lineLength - valueStart;
+        mainClass[mainClassLength] = '\0';
+    }
+    
+    if(!mainClass)
+        return NULL;
+    while(mainClassLength && mainClass[mainClassLength - 1] == ' ')
+        mainClass[--mainClassLength] = '\0';
+    for(size_t i = 0; i < mainClassLength; ++i) {
+        if(mainClass[i] == '.')
+            mainClass[i] = '/';
+    }
+    return mainClass;
+}
+
+char *addJarToClasspath(char *jarFile) {
+    // a jar which doesn't exist would be added as a directory
+    if(!addToClasspath(jarFile) || !classpath[classpathUsed - 1].archive) {
+        printf("Failed to open jar: %s\n", jarFile);
+        return NULL;
+    }
+    zip_archive_t *archive = classpath[classpathUsed - 1].archive;
+    zip_entry_t *entry = zip_findEntry(archive, "META-INF/MANIFEST.MF");
+    if(!entry) {
+        printf("Jar doesn't have a manifest: %s\n", jarFile);
+        return NULL;
+    }
+    const uint8_t *manifest = zip_readEntry(archive, entry);
+    if(!manifest) {
+        printf("Failed to read the manifest of jar: %s\n", jarFile);
+        return NULL;
+    }
+    char *mainClass = readMainClassAttribute((const char *) manifest, entry->size);
+    zip_releaseEntry(entry, manifest);
+    if(!mainClass)
+        printf("Jar doesn't specify a Main-Class in its manifest: %s\n", jarFile);
+    return mainClass;
 }
 
 void combinePath(char *dest, char *dir, char *subpath) {
@@ -86,40 +331,135 @@ void combinePath(char *dest, char *dir, char *subpath) {
     strcat(dest, subpath);
 }
 
-FILE *findClassFile(char *className) {
-    size_t subPathLen = strlen(className) + 7;
-    size_t maxPathLen = maxClassPathLen + subPathLen + 2;
-    
-    char *classSubPath = malloc(subPathLen);
-    if(!classSubPath)
-        return NULL;
+typedef struct class_file {
+    void *data;
+    size_t size;
+    zip_entry_t *zipEntry; // the entry the class file was read from or NULL if it's mapped from a file
+} class_file_t;
+
+/**
+ * Lists a package in the directories on the classpath which weren't listed for it yet
+ * @param className the name of a class in the package
+ * @return false if memory ran out
+ */
+static bool indexPackage(char *className) {
+    char *lastSlash = strrchr(className, '/');
+    char *package = strndup(className, lastSlash ? lastSlash - className : 0);
+    if(!package)
+        return false;
+    // the number of entries is only read once, so classpath entries which are added meanwhile are listed later
+    int numEntries = classpathUsed;
+    if((uintptr_t) ht_get(indexedPackages, package) == (uintptr_t) numEntries) {
+        free(package);
+        return true;
+    }
     
-    char *classLoc = malloc(maxPathLen);
-    if(!classLoc) {
-        free(classSubPath);
+    pthread_mutex_lock(&classIndexLock);
+    int listed = (int) (uintptr_t) ht_get(indexedPackages, package);
+    bool success = true;
+    for(int i = listed; i < numEntries && success; ++i) {
+        if(classpath[i].archive)
+            continue;
+        char *path = malloc(strlen(classpath[i].path) + strlen(package) + 2);
+        if(!path) {
+            success = false;
+            break;
+        }
+        combinePath(path, classpath[i].path, package);
+        package_listing_t *listing = listPackageDirectory(path);
+        free(path);
+        if(!listing)
+            continue;
+        
+        const char *classNames = listing->classNames;
+        for(uint32_t j = 0; j < listing->numClasses && success; ++j) {
+            size_t nameLength = strlen(classNames);
+            success = indexClassFile(className, lastSlash ? lastSlash - className + 1 : 0, classNames, nameLength, i, NULL);
+            classNames += nameLength + 1;
+        }
+    }
+    if(success && listed < numEntries) {
+        success = ht_put(indexedPackages, package, (void *) (uintptr_t) numEntries, NULL);
+        // the package stays the key if it was listed before
+        if(listed || !success)
+            free(package);
+    }
+    else
+        free(package);
+    pthread_mutex_unlock(&classIndexLock);
+    return success;
+}
+
+/**
+ * Finds the class file of a class on the classpath
+ * @return the location of the class file or NULL if the class isn't on the classpath
+ */
+static class_location_t *findClassLocation(char *className) {
+    class_location_t *location = ht_get(classIndex, className);
+    if(location && atomic_load_explicit(&location->isFirst, memory_order_acquire))
+        return location;
+    // either the class isn't indexed or it's in an archive, so the directories before it need to be listed
+    if(!indexPackage(className))
         return NULL;
+    location = ht_get(classIndex, className);
+    if(location)
+        atomic_store_explicit(&location->isFirst, true, memory_order_release);
+    return location;
+}
+
+/**
+ * Finds the class file of a class on the classpath with a single lookup in the class index. Files in directories are
+ * mapped, stored entries of jar files are used in place, and deflated entries are decompressed
+ * @param className
+ * @param classFile receives the contents of the class file, or NULL as its data if it was found but couldn't be read
+ * @return false if the class isn't on the classpath
+ */
+bool findClassFile(char *className, class_file_t *classFile) {
+    class_location_t *location = findClassLocation(className);
+    if(!location)
+        return false;
+    classpath_entry_t *entry = classpath + location->classpathIndex;
+    classFile->zipEntry = location->zipEntry;
+    if(location->zipEntry) {
+        classFile->data = (void *) zip_readEntry(entry->archive, location->zipEntry);
+        classFile->size = location->zipEntry->size;
+        return true;
     }
     
-    strcpy(classSubPath, className);
-    strcat(classSubPath, ".class");
-    
-    for(int i = 0; i < classpathUsed; i++) {
-        combinePath(classLoc, classpath[i], classSubPath);
-        FILE *f = fopen(classLoc, "r");
-        if(f) {
-            free(classLoc);
-            free(classSubPath);
-            return f;
+    char *classLoc = malloc(strlen(entry->path) + strlen(className) + 8);
+    if(!classLoc)
+        return false;
+    combinePath(classLoc, entry->path, className);
+    strcat(classLoc, ".class");
+    FILE *f = fopen(classLoc, "r");
+    free(classLoc);
+    // the class file was removed since its directory was listed
+    if(!f)
+        return false;
+    struct stat s;
+    classFile->data = NULL;
+    classFile->size = 0;
+    if(fstat(fileno(f), &s) != -1) {
+        void *data = mmap(NULL, s.st_size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+        if(data != MAP_FAILED) {
+            classFile->data = data;
+            classFile->size = s.st_size;
         }
     }
-    free(classLoc);
-    free(classSubPath);
-    return NULL;
+    fclose(f);
+    return true;
 }
 
-// declared above loadArrayClass since both functions call each other
-class_t *loadClass0(char *className);
+void releaseClassFile(class_file_t *classFile) {
+    if(classFile->zipEntry)
+        zip_releaseEntry(classFile->zipEntry, classFile->data);
+    else
+        munmap(classFile->data, classFile->size);
+}
 
+/**
+ * Creates a primitive class unless it exists already. Must be called with classTableLock held
+ */
 class_t *loadPrimitiveClass0(char primitive) {
     char className[2] = {'\0', '\0'};
     className[0] = primitive;
@@ -140,20 +480,31 @@ class_t *loadPrimitiveClass0(char primitive) {
     class->thisClass = class;
     class->flags = CLASS_ACC_FINAL | CLASS_ACC_PUBLIC | CLASS_ACC_SYNTHETIC;
     jlock_init(&class->jlock);
-    ht_put(loadedClasses, class->name, class);
+    if(!ht_put(loadedClasses, class->name, class, NULL)) {
+        free(class->name);
+        free(class);
+        return NULL;
+    }
     return class;
 }
 
 // Used specifically when parsing field, method parameter, and method return types
 class_t *loadPrimitiveClass(char className) {
-    pthread_mutex_lock(&classLoadingLock);
-    class_t *class = loadPrimitiveClass0(className);
-    pthread_mutex_unlock(&classLoadingLock);
+    char name[2] = {className, '\0'};
+    class_t *class = ht_get(loadedClasses, name);
+    if(class)
+        return class;
+    pthread_mutex_lock(&classTableLock);
+    class = loadPrimitiveClass0(className);
+    pthread_mutex_unlock(&classTableLock);
     return class;
 }
 
+/**
+ * Creates an array class. It's published by loadClass
+ */
 class_t *loadArrayClass(char *className) {
-    class_t *superclass = loadClass0("java/lang/Object");
+    class_t *superclass = loadClass("java/lang/Object");
     if(!superclass)
         return NULL;
     class_t *class = calloc(1, sizeof(class_t));
@@ -168,18 +519,281 @@ class_t *loadArrayClass(char *className) {
     class->status = CLASS_STATUS_INITIALIZED;
     class->thisClass = class;
     class->superClass = superclass;
-    class->objectSize = sizeof(object_t);
+    // arrays don't declare any methods so they share the vtable of Object
+    class->vtable = superclass->vtable;
+    class->vtableLength = superclass->vtableLength;
+    class->objectSize = sizeof(array_object_t);
     class->flags = CLASS_ACC_FINAL | CLASS_ACC_PUBLIC | CLASS_ACC_SYNTHETIC;
     jlock_init(&class->jlock);
-    ht_put(loadedClasses, class->name, class);
     return class;
 }
 
+/**
+ * Queues a class for the class loader threads unless it's loaded already or was queued before
+ * @param className
+ */
+void prefetchClass(char *className) {
+    // array classes don't need to be parsed
+    if(className[0] == '[' || ht_get(loadedClasses, className))
+        return;
+    pthread_mutex_lock(&prefetchQueueMutex);
+    if(!ht_contains(prefetchedClasses, className)) {
+        // the name is copied since the constant pool it's from is freed if its class fails to load
+        prefetch_request_t *request = malloc(sizeof(prefetch_request_t));
+        char *name = strdup(className);
+        if(request && name && ht_put(prefetchedClasses, name, name, NULL)) {
+            request->className = name;
+            request->next = NULL;
+            if(prefetchQueueTail)
+                prefetchQueueTail->next = request;
+            else
+                prefetchQueueHead = request;
+            prefetchQueueTail = request;
+            pthread_cond_signal(&prefetchQueuedCondition);
+        }
+        else {
+            // prefetching is only an optimization, so the class is simply loaded when it's needed
+            free(request);
+            free(name);
+        }
+    }
+    pthread_mutex_unlock(&prefetchQueueMutex);
+}
+
+/**
+ * Queues the classes a class refers to, so the class loader threads parse them while the class is parsed and linked.
+ * The superclass isn't queued since it's loaded right away. Classes which are prefetched themselves only queue their
+ * interfaces, so prefetching doesn't load everything which is reachable through the constant pools
+ * @param class a class whose constant pool was parsed
+ * @param classData the class file following the constant pool
+ */
+void prefetchReferencedClasses(class_t *class, void *classData) {
+    if(!numClassLoaderThreads)
+        return;
+    uint16_t superClassIndex = readu2(classData + 4);
+    uint16_t numInterfaces = readu2(classData + 6);
+    for(uint16_t i = 0; i < numInterfaces; ++i) {
+        uint16_t index = class->constantPool[readu2(classData + 8 + 2 * i)]->classInfo.nameIndex;
+        prefetchClass(class->constantPool[index]->utf8Info.chars);
+    }
+    if(isPrefetching)
+        return;
+    
+    // the first index is never used and the class itself is the class being parsed
+    uint16_t thisIndex = readu2(classData + 2);
+    for(uint16_t i = 1; i < class->numConstants; ++i) {
+        constant_info_t *constant = class->constantPool[i];
+        if(constant && constant->classInfo.tag == CONSTANT_Class && i != thisIndex && i != superClassIndex)
+            prefetchClass(class->constantPool[constant->classInfo.nameIndex]->utf8Info.chars);
+    }
+}
+
+void *classLoaderThread(void *arg) {
+    isPrefetching = true;
+    while(true) {
+        pthread_mutex_lock(&prefetchQueueMutex);
+        while(!prefetchQueueHead)
+            pthread_cond_wait(&prefetchQueuedCondition, &prefetchQueueMutex);
+        prefetch_request_t *request = prefetchQueueHead;
+        prefetchQueueHead = request->next;
+        if(!prefetchQueueHead)
+            prefetchQueueTail = NULL;
+        pthread_mutex_unlock(&prefetchQueueMutex);
+        
+        // the name stays in prefetchedClasses
+        loadClass(request->className);
+        free(request);
+    }
+    return NULL;
+}
+
+bool startClassLoaderThreads() {
+    // set before the threads start since they read it
+    numClassLoaderThreads = classLoaderThreads ? classLoaderThreads : (size_t) MAX(sysconf(_SC_NPROCESSORS_ONLN), 1);
+    for(size_t i = 0; i < numClassLoaderThreads; ++i) {
+        pthread_t thread;
+        if(pthread_create(&thread, NULL, classLoaderThread, NULL))
+            return false;
+        pthread_detach(thread);
+    }
+    return true;
+}
+
 int fieldCompare(const void *a, const void *b) {
     // comparison is done as b - a so that qsort sorts them in descending order
     return ((field_t *) b)->dataSize - ((field_t *) a)->dataSize;
 }
 
+/**
+ *
+ * @param method
+ * @return true if the method can be overridden and is therefore given a vtable entry
+ */
+bool isVirtualMethod(method_t *method) {
+    return (method->flags & (METHOD_ACC_STATIC | METHOD_ACC_PRIVATE)) == 0 && method->name[0] != '<';
+}
+
+/**
+ *
+ * @return the index of the method with the given name and descriptor or -1 if there isn't one
+ */
+int findMethodInTable(method_t **table, uint16_t length, char *name, char *descriptor) {
+    for(int i = 0; i < length; ++i) {
+        if(strcmp(table[i]->name, name) == 0 && strcmp(table[i]->descriptor, descriptor) == 0)
+            return i;
+    }
+    return -1;
+}
+
+/**
+ * Adds the interface to the class's itable if it isn't there already. The itable must have room for it
+ */
+void addToITable(class_t *class, class_t *interface) {
+    for(int i = 0; i < class->itableLength; ++i) {
+        if(class->itable[i].interface == interface)
+            return;
+    }
+    class->itable[class->itableLength].interface = interface;
+    class->itable[class->itableLength++].methods = NULL;
+}
+
+/**
+ * Collects the offsets of the instance fields holding references so that the garbage collector can scan objects
+ * without looking at field descriptors. The offsets of the superclass come first
+ * @param class a class whose instance fields were laid out
+ * @return true on success, otherwise false
+ */
+bool findReferenceFields(class_t *class) {
+    uint16_t numReferenceFields = class->superClass ? class->superClass->numReferenceFields : 0;
+    for(int i = 0; i < class->numFields; ++i) {
+        field_t *field = class->fields + i;
+        if(!(field->flags & FIELD_ACC_STATIC) && (field->descriptor[0] == 'L' || field->descriptor[0] == '['))
+            ++numReferenceFields;
+    }
+    class->referenceOffsets = malloc(MAX(numReferenceFields, 1) * sizeof(uint16_t));
+    if(!class->referenceOffsets)
+        return false;
+    
+    class->numReferenceFields = 0;
+    if(class->superClass) {
+        memcpy(class->referenceOffsets, class->superClass->referenceOffsets, class->superClass->numReferenceFields * sizeof(uint16_t));
+        class->numReferenceFields = class->superClass->numReferenceFields;
+    }
+    for(int i = 0; i < class->numFields; ++i) {
+        field_t *field = class->fields + i;
+        if(!(field->flags & FIELD_ACC_STATIC) && (field->descriptor[0] == 'L' || field->descriptor[0] == '['))
+            class->referenceOffsets[class->numReferenceFields++] = field->objectOffset;
+    }
+    return true;
+}
+
+/**
+ * Builds the vtable and itable of a class whose superclass and interfaces are already linked. The vtable starts as a
+ * copy of the superclass's vtable with overridden methods replaced and new virtual methods appended. Interface methods
+ * which aren't implemented by the class or a superclass are appended as well so that invokevirtual can reach default
+ * methods and abstract classes can be invoked through methods they only inherit from an interface.
+ * @param class
+ * @return true on success, otherwise false
+ */
+bool linkMethods(class_t *class) {
+    class_t *superClass = class->superClass;
+    
+    // the itable lists every interface implemented by the class, its superclasses, and its superinterfaces
+    size_t maxITableLength = superClass ? superClass->itableLength : 0;
+    for(int i = 0; i < class->numInterfaces; ++i)
+        maxITableLength += class->interfaces[i]->itableLength + 1;
+    class->itable = malloc(sizeof(itable_entry_t) * maxITableLength);
+    if(!class->itable && maxITableLength)
+        return false;
+    class->itableLength = 0;
+    if(superClass) {
+        for(int i = 0; i < superClass->itableLength; ++i)
+            addToITable(class, superClass->itable[i].interface);
+    }
+    for(int i = 0; i < class->numInterfaces; ++i) {
+        class_t *interface = class->interfaces[i];
+        addToITable(class, interface);
+        for(int j = 0; j < interface->itableLength; ++j)
+            addToITable(class, interface->itable[j].interface);
+    }
+    
+    for(int i = 0; i < class->numMethods; ++i)
+        class->methods[i].vtableIndex = NO_VTABLE_INDEX;
+    
+    // interfaces are never the class of an object so they don't need a vtable or any method implementations
+    if(class->flags & CLASS_ACC_INTERFACE) {
+        class->vtable = NULL;
+        class->vtableLength = 0;
+        return true;
+    }
+    
+    size_t maxVTableLength = superClass ? superClass->vtableLength : 0;
+    maxVTableLength += class->numMethods;
+    for(int i = 0; i < class->itableLength; ++i)
+        maxVTableLength += class->itable[i].interface->numMethods;
+    if(maxVTableLength > NO_VTABLE_INDEX) {
+        printf("Class has too many virtual methods: %s\n", class->name);
+        goto fail1;
+    }
+    class->vtable = malloc(sizeof(method_t *) * maxVTableLength);
+    if(!class->vtable && maxVTableLength)
+        goto fail1;
+    class->vtableLength = 0;
+    if(superClass) {
+        memcpy(class->vtable, superClass->vtable, sizeof(method_t *) * superClass->vtableLength);
+        class->vtableLength = superClass->vtableLength;
+    }
+    
+    for(int i = 0; i < class->numMethods; ++i) {
+        method_t *method = class->methods + i;
+        if(!isVirtualMethod(method))
+            continue;
+        int index = findMethodInTable(class->vtable, class->vtableLength, method->name, method->descriptor);
+        if(index < 0)
+            index = class->vtableLength++;
+        class->vtable[index] = method;
+        method->vtableIndex = index;
+    }
+    
+    for(int i = 0; i < class->itableLength; ++i) {
+        class_t *interface = class->itable[i].interface;
+        for(int j = 0; j < interface->numMethods; ++j) {
+            method_t *method = interface->methods + j;
+            if(!isVirtualMethod(method))
+                continue;
+            int index = findMethodInTable(class->vtable, class->vtableLength, method->name, method->descriptor);
+            if(index < 0)
+                class->vtable[class->vtableLength++] = method;
+            // a default method replaces an abstract interface method inherited from the superclass
+            else if((class->vtable[index]->class->flags & CLASS_ACC_INTERFACE) && (class->vtable[index]->flags & METHOD_ACC_ABSTRACT) && !(method->flags & METHOD_ACC_ABSTRACT))
+                class->vtable[index] = method;
+        }
+    }
+    
+    // every interface method can now be found in the vtable
+    for(int i = 0; i < class->itableLength; ++i) {
+        class_t *interface = class->itable[i].interface;
+        method_t **methods = calloc(interface->numMethods, sizeof(method_t *));
+        if(!methods && interface->numMethods)
+            goto fail2;
+        for(int j = 0; j < interface->numMethods; ++j) {
+            method_t *method = interface->methods + j;
+            if(isVirtualMethod(method))
+                methods[j] = class->vtable[findMethodInTable(class->vtable, class->vtableLength, method->name, method->descriptor)];
+        }
+        class->itable[i].methods = methods;
+    }
+    
+    return true;
+    
+    fail2:
+    for(int i = 0; i < class->itableLength; ++i)
+        free(class->itable[i].methods);
+    free(class->vtable);
+    fail1: free(class->itable);
+    return false;
+}
+
 class_t *parseClassFile(void *classData) {
     if(readu4(classData) != 0xCAFEBABEu) {
         printf("Invalid class magic: %X\n", readu4(classData));
@@ -203,6 +817,7 @@ class_t *parseClassFile(void *classData) {
     classData = parseConstantPool(class, classData);
     if(!classData)
         goto fail1;
+    prefetchReferencedClasses(class, classData);
     
     // ============================================
     // parse flags, this class, and super class
@@ -220,8 +835,6 @@ class_t *parseClassFile(void *classData) {
         classData += 2;
     }
     
-    ht_put(loadedClasses, class->name, class);
-    
     uint16_t superClassIndex = readu2(classData);
     if(superClassIndex == 0) {
         class->superClass = NULL;
@@ -229,7 +842,7 @@ class_t *parseClassFile(void *classData) {
     else {
         superClassIndex = class->constantPool[superClassIndex]->classInfo.nameIndex;
         char *superClassName = class->constantPool[superClassIndex]->utf8Info.chars;
-        class->superClass = loadClass0(superClassName);
+        class->superClass = loadClass(superClassName);
         if(!class->superClass)
             goto fail2;
     }
@@ -248,7 +861,7 @@ class_t *parseClassFile(void *classData) {
         uint16_t index = readu2(classData + 2 * i);
         index = class->constantPool[index]->classInfo.nameIndex;
         char *interfaceName = class->constantPool[index]->utf8Info.chars;
-        class->interfaces[i] = loadClass0(interfaceName);
+        class->interfaces[i] = loadClass(interfaceName);
         if(!class->interfaces[i])
             goto fail3;
     }
@@ -348,13 +961,23 @@ class_t *parseClassFile(void *classData) {
             class->objectSize += field->dataSize;
         }
     }
+    if(!findReferenceFields(class))
+        goto fail6;
     class->staticFieldData = calloc(1, class->staticDataSize);
     if(!class->staticFieldData)
-        goto fail6;
+        goto fail7;
+    class->resolvedReferences = calloc(class->numConstants, sizeof(*class->resolvedReferences));
+    if(!class->resolvedReferences)
+        goto fail8;
+    if(!linkMethods(class))
+        goto fail9;
     
     class->status = CLASS_STATUS_LOADED;
     return class;
     
+    fail9: free(class->resolvedReferences);
+    fail8: free(class->staticFieldData);
+    fail7: free(class->referenceOffsets);
     fail6:
     for(int i = 0; i < class->numAttributes; ++i) {
         if(!class->attributes[i])
@@ -389,8 +1012,10 @@ class_t *parseClassFile(void *classData) {
     }
     free(class->fields);
     fail3: free(class->interfaces);
-    fail2: ht_delete(loadedClasses, class->name);
+    fail2:
     for(int i = 0; i < class->numConstants; i++) {
+        if(!class->constantPool[i])
+            continue;
         if(class->constantPool[i]->utf8Info.tag == CONSTANT_utf8)
             free(class->constantPool[i]->utf8Info.chars);
         free(class->constantPool[i]);
@@ -400,49 +1025,136 @@ class_t *parseClassFile(void *classData) {
     return NULL;
 }
 
-class_t *loadClass0(char *className) {
-    // check if class is loaded
-    class_t *class = ht_get(loadedClasses, className);
-    if(class) {
-        if(class->status != CLASS_STATUS_LOADING)
-            return class;
-        // the class was already partially loaded. This means cyclic classes
-        printf("Failed to load class due to a cyclic dependency: %s\n", className);
+/**
+ * Reads and parses a class file from the classpath. The class is published by loadClass
+ */
+class_t *loadClassFile(char *className) {
+    class_file_t classFile;
+    if(!findClassFile(className, &classFile)) {
+        if(!isPrefetching)
+            printf("Failed to find class: %s\n", className);
+        return NULL;
+    }
+    if(!classFile.data) {
+        if(!isPrefetching)
+            printf("Failed to load class: %s\n", className);
         return NULL;
     }
+    class_t *class = parseClassFile(classFile.data);
     
-    // check if we're loading an array class
-    if(className[0] == '[')
-        return loadArrayClass(className);
+    // I forget if I copied all relevant data out of the class file or not, so I might not need it mapped anymore, but just in case, I'll keep it.
+    if(!class)
+        releaseClassFile(&classFile);
+    else
+        jlock_init(&class->jlock);
     
-    FILE *file = findClassFile(className);
-    struct stat s;
-    if(fstat(fileno(file), &s) == -1) {
-        printf("Failed to load class: %s\n", className);
-        fclose(file);
-        return NULL;
+    return class;
+}
+
+/**
+ * @param loading
+ * @return the class the thread loading a class is waiting for or NULL. Must be called with classTableLock held
+ */
+class_loading_t *awaitedByOwner(class_loading_t *loading) {
+    // the awaited class might have finished loading before its waiter woke up, in which case the chain ends
+    char *className = *loading->ownerAwaits;
+    return className ? ht_get(loadingClasses, className) : NULL;
+}
+
+/**
+ * Checks whether waiting for a class would deadlock since the thread loading it waits for the current thread, possibly
+ * through other threads waiting for each other. Must be called with classTableLock held
+ * @param loading the class the current thread would wait for
+ * @return true if the classes depend on each other
+ */
+bool isCyclicDependency(class_loading_t *loading) {
+    // the chain can also lead into a cycle of other threads, which give up once one of them wakes up and notices it.
+    // Such a cycle is found by comparing against a checkpoint which is moved ahead at powers of 2
+    class_loading_t *checkpoint = loading;
+    size_t stepsSinceCheckpoint = 0;
+    size_t checkpointInterval = 1;
+    while(loading) {
+        if(loading->ownerAwaits == &awaitedClass)
+            return true;
+        loading = awaitedByOwner(loading);
+        if(loading == checkpoint)
+            return false;
+        if(++stepsSinceCheckpoint == checkpointInterval) {
+            checkpoint = loading;
+            stepsSinceCheckpoint = 0;
+            checkpointInterval *= 2;
+        }
     }
+    return false;
+}
+
+class_t *loadClass(char *className) {
+    // check if class is loaded
+    class_t *class = ht_get(loadedClasses, className);
+    if(class)
+        return class;
     
-    void *classData = mmap(NULL, s.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
-    fclose(file);
-    if(classData == MAP_FAILED) {
-        printf("Failed to load class: %s\n", className);
+    // wait if another thread is loading the class
+    pthread_mutex_lock(&classTableLock);
+    class_loading_t *loading;
+    while(!(class = ht_get(loadedClasses, className)) && (loading = ht_get(loadingClasses, className))) {
+        if(isCyclicDependency(loading)) {
+            pthread_mutex_unlock(&classTableLock);
+            if(!isPrefetching)
+                printf("Failed to load class due to a cyclic dependency: %s\n", className);
+            return NULL;
+        }
+        awaitedClass = className;
+        pthread_cond_wait(&classLoadedCondition, &classTableLock);
+        awaitedClass = NULL;
+    }
+    if(class) {
+        pthread_mutex_unlock(&classTableLock);
+        return class;
+    }
+    class_loading_t thisLoading = {&awaitedClass};
+    if(!ht_put(loadingClasses, className, &thisLoading, NULL)) {
+        pthread_mutex_unlock(&classTableLock);
+        if(!isPrefetching)
+            printf("Failed to load class: %s\n", className);
         return NULL;
     }
-    class_t *classFile = parseClassFile(classData);
+    pthread_mutex_unlock(&classTableLock);
     
-    // I forget if I copied all relevant data out of the class file or not, so I might not need it mapped anymore, but just in case, I'll keep it.
-    if(!classFile)
-        munmap(classData, s.st_size);
+    // check if we're loading an array class
+    if(className[0] == '[')
+        class = loadArrayClass(className);
     else
-        jlock_init(&classFile->jlock);
+        class = loadClassFile(className);
     
-    return classFile;
+    // the class is only published once it's completely loaded
+    pthread_mutex_lock(&classTableLock);
+    ht_delete(loadingClasses, className);
+    // a class which can't be published fails to load, so the threads waiting for it don't wait forever
+    bool published = class && ht_put(loadedClasses, class->name, class, NULL);
+    pthread_cond_broadcast(&classLoadedCondition);
+    pthread_mutex_unlock(&classTableLock);
+    if(class && !published) {
+        if(!isPrefetching)
+            printf("Failed to load class: %s\n", className);
+        return NULL;
+    }
+    return class;
 }
 
-class_t *loadClass(char *className) {
-    pthread_mutex_lock(&classLoadingLock);
-    class_t *class = loadClass0(className);
-    pthread_mutex_unlock(&classLoadingLock);
-    return class;
+typedef struct class_visitor {
+    void (*visitor)(class_t *class, void *arg);
+    void *arg;
+} class_visitor_t;
+
+void visitClassEntry(void *className, void *class, void *visitor) {
+    ((class_visitor_t *) visitor)->visitor(class, ((class_visitor_t *) visitor)->arg);
+}
+
+void visitLoadedClasses(void (*visitor)(class_t *class, void *arg), void *arg) {
+    class_visitor_t classVisitor = {visitor, arg};
+    // class loader threads keep loading classes while java threads are stopped
+    pthread_mutex_lock(&classTableLock);
+    ht_forEach(loadedClasses, visitClassEntry, &classVisitor);
+    pthread_mutex_unlock(&classTableLock);
 }
\ No newline at end of file
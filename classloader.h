@@ -7,14 +7,55 @@
 
 #include "classfile.h"
 #include <stdbool.h>
+#include <stddef.h>
+
+size_t str_hash_fn(char *str);
+
+bool str_equality_fn(char *str1, char *str2);
 
 bool initClassLoader();
 
+/**
+ * Adds a directory, jar file, or zip file to the end of the classpath. Jar and zip files are opened right away
+ * @param classpathLocation
+ * @return false if a jar or zip file couldn't be opened or memory ran out
+ */
 bool addToClasspath(char *classpathLocation);
 
+/**
+ * Adds a jar file to the classpath and finds the class it's run with
+ * @param jarFile
+ * @return the name of the main class from the jar's manifest or NULL if the jar couldn't be opened or doesn't have one
+ */
+char *addJarToClasspath(char *jarFile);
+
+// number of threads which parse classes in the background before they're needed. 0 until they are started
+extern size_t numClassLoaderThreads;
+
+/**
+ * Starts the threads which load the classes referenced by the classes which are being loaded, so they're parsed in
+ * parallel and are often loaded by the time they're needed. Must be called after the classpath is complete
+ * @return false if a thread couldn't be started
+ */
+bool startClassLoaderThreads();
+
 // Used specifically when parsing field, method parameter, and method return types
 class_t *loadPrimitiveClass(char className);
 
+/**
+ * Loads a class unless it's loaded already. Loaded classes are found without taking a lock. A class is parsed by only
+ * one thread while other threads which need it wait, but different classes are loaded in parallel
+ * @param className
+ * @return the class or NULL if it couldn't be loaded
+ */
 class_t *loadClass(char *className);
 
+/**
+ * Calls the visitor with every class which finished loading. Classes which class loader threads finish meanwhile
+ * might not be visited, which doesn't matter while java threads are stopped since none of them used those classes yet
+ * @param visitor
+ * @param arg passed through to the visitor
+ */
+void visitLoadedClasses(void (*visitor)(class_t *class, void *arg), void *arg);
+
 #endif //JVM_CLASSLOADER_H
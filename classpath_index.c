@@ -0,0 +1,255 @@
+#include "classpath_index.h"
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "classloader.h"
+#include "hashmap.h"
+#include "utils.h"
+
+// the first line of an index file. Each directory follows as a line with the seconds and nanoseconds of its
+// modification time, its number of classes, and its path, followed by a line for each class
+#define INDEX_HEADER "jvm classpath index 1\n"
+#define MIN_NAMES_CAPACITY 256
+
+// path -> package_listing_t of every directory which was listed or read from the index file
+static hashmap_t *listings = NULL;
+// whether a directory was read, so the index file is out of date
+static bool needsSaving = false;
+static pthread_mutex_t listingsLock = PTHREAD_MUTEX_INITIALIZER;
+
+static bool createListings() {
+    if(!listings)
+        listings = ht_createHashmap((size_t (*)(void *)) &str_hash_fn, (bool (*)(void *, void *)) &str_equality_fn, 0.75f);
+    return listings != NULL;
+}
+
+static void freeListing(package_listing_t *listing) {
+    if(listing->ownsClassNames)
+        free(listing->classNames);
+    free(listing);
+}
+
+/**
+ * Parses a number which is followed by a space
+ * @return false if there is no such number
+ */
+static bool parseNumber(char **position, char *end, uint64_t *value) {
+    char *digit = *position;
+    *value = 0;
+    while(digit < end && *digit >= '0' && *digit <= '9')
+        *value = *value * 10 + (*digit++ - '0');
+    if(digit == *position || digit == end || *digit != ' ')
+        return false;
+    *position = digit + 1;
+    return true;
+}
+
+/**
+ * Terminates the line at position
+ * @return the start of the next line or NULL if the line doesn't end
+ */
+static char *endLine(char *position, char *end) {
+    char *newline = memchr(position, '\n', end - position);
+    if(!newline)
+        return NULL;
+    *newline = '\0';
+    return newline + 1;
+}
+
+bool loadClasspathIndex(char *file) {
+    pthread_mutex_lock(&listingsLock);
+    if(!createListings()) {
+        pthread_mutex_unlock(&listingsLock);
+        return false;
+    }
+    FILE *f = fopen(file, "r");
+    if(!f) {
+        pthread_mutex_unlock(&listingsLock);
+        return true;
+    }
+    struct stat s;
+    char *contents = NULL;
+    if(fstat(fileno(f), &s) != -1)
+        contents = malloc(s.st_size + 1);
+    if(!contents || fread(contents, 1, s.st_size, f) != (size_t) s.st_size) {
+        bool success = contents != NULL;
+        free(contents);
+        fclose(f);
+        pthread_mutex_unlock(&listingsLock);
+        return success;
+    }
+    fclose(f);
+    contents[s.st_size] = '\0';
+    
+    // the listings point into the contents, so they're never freed
+    char *end = contents + s.st_size;
+    char *position = contents + strlen(INDEX_HEADER);
+    if(s.st_size < (off_t) strlen(INDEX_HEADER) || memcmp(contents, INDEX_HEADER, strlen(INDEX_HEADER)) != 0)
+        position = end;
+    while(position < end) {
+        uint64_t seconds, nanoseconds, numClasses;
+        if(!parseNumber(&position, end, &seconds) || !parseNumber(&position, end, &nanoseconds) || !parseNumber(&position, end, &numClasses) || numClasses > UINT32_MAX)
+            break;
+        char *path = position;
+        char *classNames = position = endLine(position, end);
+        for(uint64_t i = 0; i < numClasses && position; ++i)
+            position = endLine(position, end);
+        // a malformed or truncated record ends the index
+        if(!position)
+            break;
+        
+        package_listing_t *listing = malloc(sizeof(package_listing_t));
+        if(!listing) {
+            pthread_mutex_unlock(&listingsLock);
+            return false;
+        }
+        listing->modified = (struct timespec) {(time_t) seconds, (long) nanoseconds};
+        listing->numClasses = numClasses;
+        listing->classNames = classNames;
+        listing->ownsClassNames = false;
+        listing->isSaved = true;
+        package_listing_t *previous;
+        if(!ht_put(listings, path, listing, (void **) &previous)) {
+            free(listing);
+            pthread_mutex_unlock(&listingsLock);
+            return false;
+        }
+        if(previous)
+            freeListing(previous);
+    }
+    pthread_mutex_unlock(&listingsLock);
+    return true;
+}
+
+/**
+ * Reads the names of the class files in a directory
+ * @return the listing or NULL if the directory couldn't be read or memory ran out
+ */
+static package_listing_t *readDirectory(char *path, struct timespec modified) {
+    DIR *dir = opendir(path);
+    if(!dir)
+        return NULL;
+    size_t capacity = MIN_NAMES_CAPACITY;
+    size_t size = 0;
+    uint32_t numClasses = 0;
+    char *classNames = malloc(capacity);
+    struct dirent *dirEntry;
+    while(classNames && (dirEntry = readdir(dir))) {
+        size_t length = strlen(dirEntry->d_name);
+        if(length <= 6 || strcmp(dirEntry->d_name + length - 6, ".class") != 0 || dirEntry->d_type == DT_DIR)
+            continue;
+        // the name loses .class but gains a null terminator
+        if(size + length - 5 > capacity) {
+            capacity = MAX(capacity * 2, size + length - 5);
+            char *newClassNames = realloc(classNames, capacity);
+            if(!newClassNames) {
+                free(classNames);
+                classNames = NULL;
+                break;
+            }
+            classNames = newClassNames;
+        }
+        memcpy(classNames + size, dirEntry->d_name, length - 6);
+        classNames[size + length - 6] = '\0';
+        size += length - 5;
+        ++numClasses;
+    }
+    closedir(dir);
+    
+    package_listing_t *listing = classNames ? malloc(sizeof(package_listing_t)) : NULL;
+    if(!listing) {
+        free(classNames);
+        return NULL;
+    }
+    listing->modified = modified;
+    listing->numClasses = numClasses;
+    listing->classNames = classNames;
+    listing->ownsClassNames = true;
+    // a directory which changes again within the granularity of its timestamps keeps its modification time, so
+    // directories which were just modified aren't saved
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    listing->isSaved = modified.tv_sec < now.tv_sec - 1;
+    return listing;
+}
+
+package_listing_t *listPackageDirectory(char *path) {
+    pthread_mutex_lock(&listingsLock);
+    if(!createListings()) {
+        pthread_mutex_unlock(&listingsLock);
+        return NULL;
+    }
+    struct stat s;
+    bool exists = stat(path, &s) == 0 && S_ISDIR(s.st_mode);
+    package_listing_t *listing = ht_get(listings, path);
+    if(listing && exists && listing->modified.tv_sec == s.st_mtim.tv_sec && listing->modified.tv_nsec == s.st_mtim.tv_nsec) {
+        pthread_mutex_unlock(&listingsLock);
+        return listing;
+    }
+    
+    package_listing_t *newListing = exists ? readDirectory(path, s.st_mtim) : NULL;
+    if(newListing) {
+        // the path stays the key if the directory was listed before
+        char *key = listing ? path : strdup(path);
+        if(!key || !ht_put(listings, key, newListing, NULL)) {
+            if(key != path)
+                free(key);
+            freeListing(newListing);
+            newListing = NULL;
+        }
+    }
+    else if(listing)
+        ht_delete(listings, path);
+    if(listing)
+        freeListing(listing);
+    needsSaving = needsSaving || newListing || listing;
+    pthread_mutex_unlock(&listingsLock);
+    return newListing;
+}
+
+static void writeListing(char *path, package_listing_t *listing, FILE *f) {
+    // relative paths would name other directories when the JVM is run from somewhere else
+    if(!listing->isSaved || path[0] != '/' || strchr(path, '\n'))
+        return;
+    fprintf(f, "%lld %ld %u %s\n", (long long) listing->modified.tv_sec, listing->modified.tv_nsec, listing->numClasses, path);
+    char *className = listing->classNames;
+    for(uint32_t i = 0; i < listing->numClasses; ++i) {
+        fprintf(f, "%s\n", className);
+        className += strlen(className) + 1;
+    }
+}
+
+bool saveClasspathIndex(char *file) {
+    pthread_mutex_lock(&listingsLock);
+    if(!listings || !needsSaving) {
+        pthread_mutex_unlock(&listingsLock);
+        return true;
+    }
+    
+    // written next to the index file first, so it's replaced by a rename
+    char *tempFile = malloc(strlen(file) + 5);
+    if(!tempFile) {
+        pthread_mutex_unlock(&listingsLock);
+        return false;
+    }
+    strcpy(tempFile, file);
+    strcat(tempFile, ".tmp");
+    FILE *f = fopen(tempFile, "w");
+    bool success = f != NULL;
+    if(f) {
+        fputs(INDEX_HEADER, f);
+        ht_forEach(listings, (void (*)(void *, void *, void *)) &writeListing, f);
+        success = !ferror(f);
+        success &= fclose(f) == 0;
+        success = success && rename(tempFile, file) == 0;
+        if(!success)
+            remove(tempFile);
+    }
+    free(tempFile);
+    needsSaving = !success;
+    pthread_mutex_unlock(&listingsLock);
+    return success;
+}
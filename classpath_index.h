@@ -0,0 +1,41 @@
+#ifndef JVM_CLASSPATH_INDEX_H
+#define JVM_CLASSPATH_INDEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+// the class files in one package directory of the classpath
+typedef struct package_listing {
+    struct timespec modified; // modification time of the directory when it was listed
+    uint32_t numClasses;
+    char *classNames; // names of the class files without .class, one after another and each null terminated
+    bool ownsClassNames; // false if the names point into the contents of the index file
+    bool isSaved; // false if the directory might still change without its modification time changing
+} package_listing_t;
+
+/**
+ * Reads the listings saved by an earlier run. A missing or malformed index file is treated as an empty one
+ * @param file
+ * @return false if memory ran out
+ */
+bool loadClasspathIndex(char *file);
+
+/**
+ * Lists the class files in a directory. A listing read from the index file is used as long as the modification time of
+ * the directory didn't change, so only a single stat is needed. Otherwise the directory is read
+ * @param path
+ * @return the listing, which stays valid until the same directory is listed again after it changed, or NULL if the
+ * directory doesn't exist or couldn't be read
+ */
+package_listing_t *listPackageDirectory(char *path);
+
+/**
+ * Writes every listing to the index file if any directory was read since it was loaded. The file is replaced
+ * atomically, so JVMs which run at the same time read either the old or the new index
+ * @param file
+ * @return false if the file couldn't be written
+ */
+bool saveClasspathIndex(char *file);
+
+#endif //JVM_CLASSPATH_INDEX_H
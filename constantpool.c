@@ -22,6 +22,8 @@ void *parseConstantPool(class_t *class, void *classData) {
         if(!constantPoolEntry) {
             fail: // this label is used by the CONSTANT_utf8 case and default case from the switch statement below
             while(--i > 0) {
+                if(!constantPool[i])
+                    continue;
                 if(constantPool[i]->utf8Info.tag == CONSTANT_utf8)
                     free(constantPool[i]->utf8Info.chars);
                 free(constantPool[i]);
@@ -53,6 +55,8 @@ void *parseConstantPool(class_t *class, void *classData) {
                 constantPoolEntry->longDoubleInfo.tag = tag;
                 constantPoolEntry->longDoubleInfo.bytes = readu8(classData);
                 classData += 8;
+                // long and double constants take up two entries in the constant pool
+                constantPool[++i] = NULL;
                 break;
             case CONSTANT_Class:
                 constantPoolEntry->classInfo.tag = tag;
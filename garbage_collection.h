@@ -13,14 +13,6 @@ typedef struct CompactionResultNode {
     slot_t newSlot;
 } compact_res_t;
 
-/**
- * Do not call this function while holding the GC locks. Doing so will cause a deadlock
- *
- * This function cleans up the free list and returns any extra pages to the OS
- * @param addrInfo
- */
-void rebuildFreeList(addr_ind_info_t * addrInfo);
-
 /**
  * If running in a multi-threaded context, you must acquire the GC locks before calling this function
  *
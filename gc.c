@@ -3,7 +3,17 @@
 //
 
 #include "gc.h"
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
 #include "heap.h"
+#include "gc_workers.h"
+#include "classloader.h"
+#include "flags.h"
+#include "stack_map.h"
 #include "indirection_impl.h"
 #include "garbage_collection.h"
 #include "jvmSettings.h"
@@ -14,38 +24,268 @@ volatile bool gcWantsToRun = false;
 volatile atomic_uint_fast32_t numThreads = 0;
 volatile atomic_uint_fast32_t numThreadsWaiting = 0;
 pthread_mutex_t gcRunningMutex = PTHREAD_MUTEX_INITIALIZER;
+// polls read a byte which is never protected until initGC maps the real page
+static uint8_t unusedPollByte;
+volatile uint8_t *safepointPollPage = &unusedPollByte;
+
+// signalled under gcRunningMutex when a thread stops at a safepoint or unregisters
+pthread_cond_t threadStoppedCondition = PTHREAD_COND_INITIALIZER;
+// broadcast under gcRunningMutex when the gc is done and stopped threads can continue
+pthread_cond_t gcFinishedCondition = PTHREAD_COND_INITIALIZER;
+size_t pageSize;
 
 pthread_mutex_t threadRegistrationMutex = PTHREAD_MUTEX_INITIALIZER;
 jthread_t **jthreads = NULL;
 size_t maxNumThreads = 0;
 
 size_t gcCycle = 0;
-volatile clock_t lastGC;
+uint64_t lastGC;
+uint64_t lastPauseTime = 0;
 
 enum gcMode requestedMode = GC_MODE_NORMAL;
 
+// roots pushed by threads which aren't java threads
+pthread_mutex_t globalRootsMutex = PTHREAD_MUTEX_INITIALIZER;
+root_stack_t globalRoots = {.numSlots = 0};
+// references overwritten by threads which aren't java threads. Guarded by globalRootsMutex
+satb_buffer_t globalSATBBuffer = {.numSlots = 0};
+
+// part of the active survivor half which only one gc worker copies objects into
+typedef struct survivor_buffer {
+    _Alignas(64) void *top;
+    void *end;
+} survivor_buffer_t;
+
+survivor_buffer_t *survivorBuffers = NULL;
+
+// visitors get the location of a reference so that they can update it when the gc moves objects referenced directly
+typedef void (*slot_visitor_t)(size_t worker, slot_t *slot, void *state);
+
+// state shared by the gc workers during a young gc
+typedef struct scavenge {
+    size_t numAddresses; // slots allocated after the gc started can't refer to anything yet. Unused with DIRECT_REFERENCES
+    size_t oldGenerationTop; // objects copied into the old generation past this point are scanned when they're copied
+    atomic_size_t nextRootTask;
+    atomic_size_t nextCard;
+    atomic_size_t nextSweepSlot;
+} scavenge_t;
+
+// part of the old generation whose objects are moved by one gc worker during compaction
+typedef struct compaction_region {
+    void *firstObject; // the first live object starting in the region or NULL if there is none
+    void *sourceEnd; // the end of the last live object starting in the region
+    void *destination; // where the first live object is moved to
+    atomic_bool moved;
+} compaction_region_t;
+
+// state shared by the gc workers during an old gc
+typedef struct mark {
+    size_t numAddresses; // slots allocated after marking started belong to objects which are live
+    _Atomic uint64_t *bits; // one bit for each slot of a live object, or with DIRECT_REFERENCES each reference
+    compaction_region_t *regions;
+    size_t numRegions;
+    atomic_size_t nextRootTask;
+    atomic_size_t nextGreySlot;
+    atomic_size_t nextRegion;
+#ifdef DIRECT_REFERENCES
+    atomic_bool youngObjectsClaimed; // whether a worker took the young objects when updating references
+#endif
+} mark_t;
+
+// slots of objects which were marked but whose references weren't marked yet while marking concurrently
+typedef struct mark_stack {
+    slot_t *slots;
+    size_t numSlots;
+    size_t capacity;
+} mark_stack_t;
+
+// a full satb buffer a thread handed to the gc thread
+typedef struct satb_chunk {
+    struct satb_chunk *next;
+    satb_buffer_t buffer;
+} satb_chunk_t;
+
+volatile bool concurrentMarkActive = false;
+// the old gc which is in progress while concurrentMarkActive is set
+mark_t concurrentMark;
+mark_stack_t markStack = {NULL, 0, 0};
+pthread_mutex_t satbMutex = PTHREAD_MUTEX_INITIALIZER;
+satb_chunk_t *fullSATBChunks = NULL;
+// set by the gc thread once it ran out of objects to mark, so that marking is finished by the next gc
+bool remarkRequested = false;
+
+// The gc thread sleeps on gcScheduleCondition until a thread requests a gc, enough has been allocated since the last
+// gc to reach allocationTrigger, or gcInterval runs out
+pthread_mutex_t gcSchedulerMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t gcScheduleCondition;
+atomic_size_t bytesAllocatedSinceGC = 0;
+atomic_size_t allocationTrigger = 0;
+
 void runGC();
 
+/**
+ * @return the time of a monotonic clock in nanoseconds
+ */
+static uint64_t currentTime() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t) time.tv_sec * 1000000000u + time.tv_nsec;
+}
+
+static bool shouldRunGC(uint64_t now) {
+    size_t allocated = atomic_load_explicit(&bytesAllocatedSinceGC, memory_order_relaxed);
+    if(gcWantsToRun || remarkRequested || allocated >= atomic_load_explicit(&allocationTrigger, memory_order_relaxed))
+        return true;
+    // an idle heap is never collected because of the interval
+    return gcInterval && allocated && now - lastGC >= gcInterval * 1000000u;
+}
+
+static bool markConcurrently();
+
 void *gcLoop(void *arg) {
     while(true) {
-        // Run a full GC every gcInterval milliseconds
-        if((clock() - lastGC) * 1000 / CLOCKS_PER_SEC >= gcInterval || gcWantsToRun)
-            runGC();
-        else
-            sched_yield();
+        pthread_mutex_lock(&gcSchedulerMutex);
+        uint64_t now = currentTime();
+        while(!shouldRunGC(now)) {
+            if(concurrentMarkActive) {
+                // marking goes on in small steps so that it doesn't hold up a young gc
+                pthread_mutex_unlock(&gcSchedulerMutex);
+                remarkRequested = markConcurrently();
+                pthread_mutex_lock(&gcSchedulerMutex);
+            }
+            else if(gcInterval) {
+                uint64_t deadline = lastGC + gcInterval * 1000000u;
+                struct timespec wakeTime = {.tv_sec = deadline / 1000000000u, .tv_nsec = deadline % 1000000000u};
+                pthread_cond_timedwait(&gcScheduleCondition, &gcSchedulerMutex, &wakeTime);
+            }
+            else {
+                pthread_cond_wait(&gcScheduleCondition, &gcSchedulerMutex);
+            }
+            now = currentTime();
+        }
+        pthread_mutex_unlock(&gcSchedulerMutex);
+        
+        runGC();
     }
 }
 
+static void wakeGCThread() {
+    // taking the mutex makes sure the gc thread is either waiting or will see the new state before it waits
+    pthread_mutex_lock(&gcSchedulerMutex);
+    pthread_cond_signal(&gcScheduleCondition);
+    pthread_mutex_unlock(&gcSchedulerMutex);
+}
+
+void countAllocation(size_t numBytes) {
+    size_t allocated = atomic_fetch_add_explicit(&bytesAllocatedSinceGC, numBytes, memory_order_relaxed) + numBytes;
+    size_t trigger = atomic_load_explicit(&allocationTrigger, memory_order_relaxed);
+    // only the allocation which crosses the trigger wakes the gc thread
+    if(allocated >= trigger && allocated - numBytes < trigger)
+        wakeGCThread();
+}
+
+/**
+ * Calculates how much can be allocated before the next gc is started. The gc is started early enough that the eden
+ * space left over lasts for twice the time the last gc took at the allocation rate since the previous gc, so that
+ * threads rarely have to stop because the eden space ran out.
+ * @param allocated the number of bytes allocated since the previous gc
+ * @param elapsed the time in nanoseconds since the previous gc
+ * @return the new allocation trigger in bytes
+ */
+static size_t calculateAllocationTrigger(size_t allocated, uint64_t elapsed) {
+    size_t freeSpace = getFreeEdenSpace();
+    size_t minTrigger = MAX(getEdenSize() / GC_MIN_TRIGGER_DIVISOR, 1);
+    double bytesPerNano = elapsed ? (double) allocated / elapsed : 0;
+    double reserved = bytesPerNano * lastPauseTime * 2;
+    if(reserved >= freeSpace)
+        return minTrigger;
+    return MAX(freeSpace - (size_t) reserved, minTrigger);
+}
+
 void savePoint() {
-    if(gcWantsToRun)
-        ++numThreadsWaiting;
-    while(gcWantsToRun)
-        sched_yield();
     pthread_mutex_lock(&gcRunningMutex);
-    numThreadsWaiting--;
+    // threads only count as waiting while they are actually stopped for a gc
+    if(gcWantsToRun) {
+        ++numThreadsWaiting;
+        pthread_cond_signal(&threadStoppedCondition);
+        while(gcWantsToRun)
+            pthread_cond_wait(&gcFinishedCondition, &gcRunningMutex);
+        --numThreadsWaiting;
+    }
     pthread_mutex_unlock(&gcRunningMutex);
 }
 
+/**
+ * Stops threads which polled the safepoint page while it is protected. The fault happens synchronously at a poll site
+ * where the thread doesn't hold any locks, so it can wait for the gc right inside the handler. The poll is repeated
+ * once the handler returns, which succeeds since the page is readable again after the gc.
+ */
+static void safepointHandler(int signal, siginfo_t *info, void *context) {
+    if((uint8_t *) info->si_addr >= safepointPollPage && (uint8_t *) info->si_addr < safepointPollPage + pageSize) {
+        savePoint();
+        return;
+    }
+    // any other fault is a real crash. Returning retries the access which now faults with the default action
+    struct sigaction action = {.sa_handler = SIG_DFL};
+    sigemptyset(&action.sa_mask);
+    sigaction(signal, &action, NULL);
+}
+
+/**
+ * Maps the page which threads poll at safepoints and installs the handler for the faults caused by polling it while it
+ * is protected
+ * @return false if the page couldn't be mapped or the handler couldn't be installed
+ */
+static bool initSafepoints() {
+    pageSize = sysconf(_SC_PAGESIZE);
+    void *page = mmap(NULL, pageSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(page == MAP_FAILED)
+        return false;
+    
+    struct sigaction action = {.sa_sigaction = safepointHandler, .sa_flags = SA_SIGINFO};
+    sigemptyset(&action.sa_mask);
+    if(sigaction(SIGSEGV, &action, NULL)) {
+        munmap(page, pageSize);
+        return false;
+    }
+    
+    safepointPollPage = page;
+    return true;
+}
+
+/**
+ * Hands the references in a buffer to the gc thread and empties the buffer
+ * @param buffer
+ */
+static void handOverSATBBuffer(satb_buffer_t *buffer) {
+    satb_chunk_t *chunk = malloc(sizeof(satb_chunk_t));
+    if(!chunk) {
+        printf("OutOfMemoryError: Failed to hand overwritten references to the gc\n");
+        exit(1);
+    }
+    chunk->buffer = *buffer;
+    buffer->numSlots = 0;
+    pthread_mutex_lock(&satbMutex);
+    chunk->next = fullSATBChunks;
+    fullSATBChunks = chunk;
+    pthread_mutex_unlock(&satbMutex);
+}
+
+void logOverwrittenReference(jthread_t *jthread, slot_t slot) {
+    if(!jthread) {
+        pthread_mutex_lock(&globalRootsMutex);
+        if(globalSATBBuffer.numSlots == SATB_BUFFER_SIZE)
+            handOverSATBBuffer(&globalSATBBuffer);
+        globalSATBBuffer.slots[globalSATBBuffer.numSlots++] = slot;
+        pthread_mutex_unlock(&globalRootsMutex);
+        return;
+    }
+    satb_buffer_t *buffer = &jthread->satbBuffer;
+    if(buffer->numSlots == SATB_BUFFER_SIZE)
+        handOverSATBBuffer(buffer);
+    buffer->slots[buffer->numSlots++] = slot;
+}
+
 bool registerThread(jthread_t *jthread) {
     pthread_mutex_lock(&threadRegistrationMutex);
     if(numThreads == maxNumThreads) {
@@ -74,11 +314,42 @@ void unregisterThread(jthread_t *jthread) {
         jthreads[i] = jthreads[numThreads - 1];
         --numThreads;
     }
+    // the gc only empties the buffers of registered threads
+    if(jthread->satbBuffer.numSlots)
+        handOverSATBBuffer(&jthread->satbBuffer);
     pthread_mutex_unlock(&threadRegistrationMutex);
+    releaseSlotCache(addrIndInfo, &jthread->slotCache);
+    
+    // the gc might be waiting for this thread to stop
+    pthread_mutex_lock(&gcRunningMutex);
+    pthread_cond_signal(&threadStoppedCondition);
+    pthread_mutex_unlock(&gcRunningMutex);
 }
 
 pthread_t *initGC() {
-    lastGC = clock();
+    if(!initSafepoints())
+        return NULL;
+    
+    size_t numWorkers = gcThreads ? gcThreads : (size_t) MAX(sysconf(_SC_NPROCESSORS_ONLN), 1);
+    survivorBuffers = aligned_alloc(_Alignof(survivor_buffer_t), numWorkers * sizeof(survivor_buffer_t));
+    if(!survivorBuffers)
+        return NULL;
+    for(size_t i = 0; i < numWorkers; i++) {
+        survivorBuffers[i].top = NULL;
+        survivorBuffers[i].end = NULL;
+    }
+    if(!initGCWorkers(numWorkers))
+        return NULL;
+    
+    pthread_condattr_t conditionAttributes;
+    pthread_condattr_init(&conditionAttributes);
+    // timed waits measure wall time which isn't affected by changes to the system clock
+    pthread_condattr_setclock(&conditionAttributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&gcScheduleCondition, &conditionAttributes);
+    pthread_condattr_destroy(&conditionAttributes);
+    
+    lastGC = currentTime();
+    atomic_store(&allocationTrigger, calculateAllocationTrigger(0, 0));
     jthreads = malloc(sizeof(jthread_t *) * 4);
     if(!jthreads)
         return NULL;
@@ -102,83 +373,809 @@ void requestGC(enum gcMode gcMode) {
     gcWantsToRun = true;
     requestedMode = MAX(requestedMode, gcMode);
     pthread_mutex_unlock(&gcRunningMutex);
+    wakeGCThread();
 }
 
-void _youngHeapGC(size_t numObjs, object_t **obj) {
-    // TODO swap active side
-    // TODO move eden to active side and update indirection table
-    // TODO move inactive side to active side and update indirection table (promote oldest objects if no room in active side)
+void pushRoot(jthread_t *jthread, slot_t slot) {
+    root_stack_t *roots = jthread ? &jthread->roots : &globalRoots;
+    if(!jthread)
+        pthread_mutex_lock(&globalRootsMutex);
+    if(roots->numSlots == MAX_ROOTS) {
+        printf("InternalError: Too many objects are only referenced by the jvm itself\n");
+        exit(1);
+    }
+    roots->slots[roots->numSlots++] = slot;
+    if(!jthread)
+        pthread_mutex_unlock(&globalRootsMutex);
 }
 
-void _oldHeapGC(size_t numObjs, object_t **obj) {
-    // TODO compact objects and update indirection table
+slot_t peekRoot(jthread_t *jthread) {
+    if(jthread)
+        return jthread->roots.slots[jthread->roots.numSlots - 1];
+    pthread_mutex_lock(&globalRootsMutex);
+    slot_t slot = globalRoots.slots[globalRoots.numSlots - 1];
+    pthread_mutex_unlock(&globalRootsMutex);
+    return slot;
 }
 
-void runGC() {
-    gcWantsToRun = true;
-    pthread_mutex_lock(&gcRunningMutex);
-    while(numThreads != numThreadsWaiting) {
-        pthread_mutex_unlock(&gcRunningMutex);
-        sched_yield();
-        pthread_mutex_lock(&gcRunningMutex);
+slot_t popRoot(jthread_t *jthread) {
+    if(jthread)
+        return jthread->roots.slots[--jthread->roots.numSlots];
+    pthread_mutex_lock(&globalRootsMutex);
+    slot_t slot = globalRoots.slots[--globalRoots.numSlots];
+    pthread_mutex_unlock(&globalRootsMutex);
+    return slot;
+}
+
+#ifndef DIRECT_REFERENCES
+/**
+ * Adds slots to the free list at once
+ * @param first
+ * @param last the slot at the end of the list starting at first
+ */
+static void addFreeSlots(slot_t first, slot_t last) {
+    if(first)
+        freeSlotList(addrIndInfo, first, last);
+}
+
+/**
+ * Frees a slot and prepends it to a list of free slots which is later added to the free list with addFreeSlots. The
+ * list is linked through the entries of the slots
+ * @param slot
+ * @param freeSlots the first slot of the list or 0 if it's empty
+ * @param lastFreeSlot set to the first slot prepended
+ */
+static void freeSlotInto(slot_t slot, slot_t *freeSlots, slot_t *lastFreeSlot) {
+    addrIndInfo->addressTable[slot] = FREE_ENTRY(*freeSlots);
+    *freeSlots = slot;
+    if(!*lastFreeSlot)
+        *lastFreeSlot = slot;
+}
+#endif
+
+/**
+ * Calls visit with every reference the object holds
+ * @param worker
+ * @param obj
+ * @param visit
+ * @param state passed through to visit
+ */
+static void visitReferences(size_t worker, object_t *obj, slot_visitor_t visit, void *state) {
+    class_t *class = obj->class;
+    if(isArrayClass(class)) {
+        if(class->name[1] == 'L' || class->name[1] == '[') {
+            slot_t *elements = ARRAY_ELEMENTS(obj);
+            for(int32_t i = 0; i < ARRAY_LENGTH(obj); ++i)
+                visit(worker, elements + i, state);
+        }
+        return;
     }
+    for(uint16_t i = 0; i < class->numReferenceFields; ++i)
+        visit(worker, (void *) obj + class->referenceOffsets[i], state);
+}
+
+typedef struct root_visitor {
+    size_t worker;
+    slot_visitor_t visit;
+    void *state;
+} root_visitor_t;
+
+static void visitRoot(slot_t *slot, void *visitor) {
+    root_visitor_t *rootVisitor = visitor;
+    rootVisitor->visit(rootVisitor->worker, slot, rootVisitor->state);
+}
+
+static void visitStaticFields(class_t *class, void *visitor) {
+    if(!class->staticFieldData)
+        return;
+    for(uint16_t i = 0; i < class->numFields; ++i) {
+        field_t *field = class->fields + i;
+        if((field->flags & FIELD_ACC_STATIC) && (field->descriptor[0] == 'L' || field->descriptor[0] == '['))
+            visitRoot(class->staticFieldData + field->objectOffset, visitor);
+    }
+}
+
+/**
+ * Calls the visitor with the roots of the tasks the worker claims. The roots are split into tasks which the workers
+ * claim one at a time: one task for the stack and roots of each java thread, followed by the global roots, the static
+ * fields of every class, and the objects waiting to be scanned by concurrent marking.
+ * @param nextRootTask the counter the workers claim tasks from, which starts at 0
+ * @param visitor
+ */
+static void visitRoots(atomic_size_t *nextRootTask, root_visitor_t *visitor) {
+    size_t task;
+    while((task = atomic_fetch_add(nextRootTask, 1)) < numThreads + 3) {
+        if(task < numThreads) {
+            jthread_t *jthread = jthreads[task];
+            visitStackReferences(jthread, visitRoot, visitor);
+            for(uint16_t i = 0; i < jthread->roots.numSlots; ++i)
+                visitRoot(jthread->roots.slots + i, visitor);
+        }
+        else if(task == numThreads) {
+            for(uint16_t i = 0; i < globalRoots.numSlots; ++i)
+                visitRoot(globalRoots.slots + i, visitor);
+        }
+        else if(task == numThreads + 1) {
+            visitLoadedClasses(visitStaticFields, visitor);
+        }
+        else {
+            // they were live when marking started, so they're kept until they're scanned
+            for(size_t i = 0; i < markStack.numSlots; ++i)
+                visitRoot(markStack.slots + i, visitor);
+        }
+    }
+}
+
+#ifdef DIRECT_REFERENCES
+/**
+ * Gives the copy of an object the mark bit of the original while the old generation is marked concurrently. Marks
+ * belong to addresses when references are pointers, so the bit of the copy might still be set by an object which used
+ * to be there
+ * @param from the reference to the original
+ * @param to the reference to the copy
+ */
+static void moveMark(slot_t from, slot_t to) {
+    uint64_t bit = (uint64_t) 1 << (to % 64u);
+    if(atomic_load_explicit(concurrentMark.bits + from / 64u, memory_order_relaxed) & ((uint64_t) 1 << (from % 64u)))
+        atomic_fetch_or_explicit(concurrentMark.bits + to / 64u, bit, memory_order_relaxed);
+    else
+        atomic_fetch_and_explicit(concurrentMark.bits + to / 64u, ~bit, memory_order_relaxed);
+}
+#endif
+
+/**
+ * Copies an object out of the eden space or the inactive survivor half and updates its slot to point at the copy. The
+ * copy is pushed to the deque of the worker so that the objects it references get copied too. Objects which survived
+ * tenuringThreshold young gcs are moved to the old generation. Several workers can reach the same object at once, in
+ * which case only the copy of the worker which updates the slot first is used. With DIRECT_REFERENCES the reference
+ * itself is pointed at the copy, and the reference to the copy is stored in the slot field of the original, which
+ * forwards the other references to it.
+ * @param worker
+ * @param slot the reference. Values which aren't handles of objects that need to be copied are ignored
+ * @param arg the scavenge_t of the gc
+ */
+static void evacuate(size_t worker, slot_t *slot, void *arg) {
+#ifdef DIRECT_REFERENCES
+    object_t *obj = getObject(*slot);
+    if(!obj || !isInYoungFromSpace(obj))
+        return;
+    _Atomic slot_t *forwardingSlot = (_Atomic slot_t *) &obj->slot;
+    slot_t forwarded = atomic_load_explicit(forwardingSlot, memory_order_relaxed);
+    if(forwarded) {
+        *slot = forwarded;
+        return;
+    }
+#else
+    scavenge_t *scavenge = arg;
+    if(*slot == 0 || *slot >= scavenge->numAddresses)
+        return;
+    _Atomic(object_t *) *address = (_Atomic(object_t *) *) &addrIndInfo->addressTable[*slot];
+    object_t *obj = atomic_load_explicit(address, memory_order_relaxed);
+    // the slot is free, the object isn't set yet, or it was already copied
+    if(!IS_OBJECT_ENTRY(obj) || !isInYoungFromSpace(obj))
+        return;
+#endif
     
-    enum gcMode gcMode = requestedMode;
-    gcCycle++;
+    size_t size = getObjectSize(obj);
+    uint32_t age = GET_AGE(obj) < MAX_AGE ? GET_AGE(obj) + 1 : MAX_AGE;
+    survivor_buffer_t *buffer = survivorBuffers + worker;
+    object_t *copy = NULL;
+    bool inSurvivorBuffer = false;
+    if(age < tenuringThreshold) {
+        if((size_t) (buffer->end - buffer->top) < size && size <= SURVIVOR_BUFFER_SIZE / 2) {
+            // the rest of the old buffer is abandoned
+            fillGap(buffer->top, buffer->end - buffer->top);
+            size_t bufferSize;
+            buffer->top = allocateInActiveHalf(size, SURVIVOR_BUFFER_SIZE, &bufferSize);
+            buffer->end = buffer->top ? buffer->top + bufferSize : NULL;
+        }
+        if((size_t) (buffer->end - buffer->top) >= size) {
+            copy = buffer->top;
+            buffer->top += size;
+            inSurvivorBuffer = true;
+        }
+        else {
+            size_t allocatedSize;
+            copy = allocateInActiveHalf(size, size, &allocatedSize);
+        }
+    }
+    // objects which don't fit in the survivor half are promoted early
+    if(!copy)
+        copy = allocateInOldGeneration(size);
+    if(!copy && age >= tenuringThreshold) {
+        size_t allocatedSize;
+        copy = allocateInActiveHalf(size, size, &allocatedSize);
+    }
+    if(!copy) {
+        printf("OutOfMemoryError: No room left for the objects which survived a gc\n");
+        exit(1);
+    }
+    
+    memcpy(copy, obj, size);
+    SET_AGE(copy, age);
+#ifdef DIRECT_REFERENCES
+    copy->slot = 0;
+    slot_t copySlot = getReference(copy);
+    if(atomic_compare_exchange_strong_explicit(forwardingSlot, &forwarded, copySlot, memory_order_relaxed, memory_order_relaxed)) {
+        if(concurrentMarkActive)
+            moveMark(*slot, copySlot);
+        *slot = copySlot;
+        pushWork(worker, copy);
+        return;
+    }
+    *slot = forwarded;
+#else
+    if(atomic_compare_exchange_strong_explicit(address, &obj, copy, memory_order_relaxed, memory_order_relaxed)) {
+        pushWork(worker, copy);
+        return;
+    }
+#endif
+    if(inSurvivorBuffer && buffer->top == (void *) copy + size)
+        buffer->top = copy;
+    else
+        fillGap(copy, size);
+}
+
+/**
+ * Copies the object a reference on a dirty card refers to. The card stays dirty while the reference points to a young
+ * object, which is until the object is promoted
+ * @param worker
+ * @param field
+ * @param scavenge
+ */
+static void evacuateFromCard(size_t worker, slot_t *field, scavenge_t *scavenge) {
+    evacuate(worker, field, scavenge);
+    slot_t slot = *field;
+#ifdef DIRECT_REFERENCES
+    bool young = isInYoungGeneration(getObject(slot));
+#else
+    bool young = slot != 0 && slot < scavenge->numAddresses && isInYoungGeneration(addrIndInfo->addressTable[slot]);
+#endif
+    if(young)
+        MARK_CARD(field);
+}
+
+/**
+ * Copies the young objects referenced by the fields or elements of an old object which are on a dirty card
+ * @param obj
+ * @param start the start of the card
+ * @param end the end of the card
+ * @param visitor the root_visitor_t of the worker
+ */
+static void scanCardObject(object_t *obj, void *start, void *end, void *visitor) {
+    root_visitor_t *rootVisitor = visitor;
+    // copies which lost the race to copy an object are filled
+    if(IS_FILLER(obj))
+        return;
+#ifndef DIRECT_REFERENCES
+    // dead objects stay in the old generation until it's collected. Their slot is free or used by another object. With
+    // DIRECT_REFERENCES they are scanned like live objects, which keeps their references valid until they're collected
+    if(obj->slot >= addrIndInfo->numAddresses || addrIndInfo->addressTable[obj->slot] != obj)
+        return;
+#endif
+    class_t *class = obj->class;
+    if(isArrayClass(class)) {
+        if(class->name[1] == 'L' || class->name[1] == '[') {
+            slot_t *elements = ARRAY_ELEMENTS(obj);
+            slot_t *first = MAX(elements, (slot_t *) start);
+            slot_t *last = MIN(elements + ARRAY_LENGTH(obj), (slot_t *) end);
+            for(slot_t *element = first; element < last; ++element)
+                evacuateFromCard(rootVisitor->worker, element, rootVisitor->state);
+        }
+        return;
+    }
+    for(uint16_t i = 0; i < class->numReferenceFields; ++i) {
+        void *field = (void *) obj + class->referenceOffsets[i];
+        if(field >= start && field < end)
+            evacuateFromCard(rootVisitor->worker, field, rootVisitor->state);
+    }
+}
+
+/**
+ * Copies every object reachable from the roots. Objects in the old generation are only scanned if they're on a dirty
+ * card, which the write barrier dirties whenever a reference is stored into an object. The workers claim chunks of
+ * cards once the roots are taken.
+ */
+static void scavengeTask(size_t worker, void *arg) {
+    scavenge_t *scavenge = arg;
+    root_visitor_t visitor = {worker, evacuate, scavenge};
+    visitRoots(&scavenge->nextRootTask, &visitor);
     
-    size_t numLiveObjects = 0;
-    object_t **liveObjects = NULL;
+    size_t numCards = (scavenge->oldGenerationTop + CARD_SIZE - 1) >> CARD_SHIFT;
+    size_t firstCard;
+    while((firstCard = atomic_fetch_add(&scavenge->nextCard, CARD_CHUNK_SIZE)) < numCards)
+        visitDirtyCards(firstCard, MIN(firstCard + CARD_CHUNK_SIZE, numCards), scavenge->oldGenerationTop, scanCardObject, &visitor);
     
-    // TODO build live object list
-    // TODO sort live object list
+    // a worker only runs out of work once no worker scans roots anymore
+    object_t *obj;
+    while((obj = nextWork(worker)))
+        visitReferences(worker, obj, evacuate, scavenge);
+}
+
+#ifndef DIRECT_REFERENCES
+/**
+ * Frees the slots of the objects which weren't copied. Every worker claims chunks of the address table and adds the
+ * slots it freed to the free list at once.
+ */
+static void sweepTask(size_t worker, void *arg) {
+    scavenge_t *scavenge = arg;
+    slot_t freeSlots = 0;
+    slot_t lastFreeSlot = 0;
+    size_t start;
+    while((start = atomic_fetch_add(&scavenge->nextSweepSlot, SWEEP_CHUNK_SIZE)) < scavenge->numAddresses) {
+        size_t end = MIN(start + SWEEP_CHUNK_SIZE, scavenge->numAddresses);
+        for(size_t slot = MAX(start, 1); slot < end; ++slot) {
+            void *obj = addrIndInfo->addressTable[slot];
+            if(IS_OBJECT_ENTRY(obj) && isInYoungFromSpace(obj))
+                freeSlotInto(slot, &freeSlots, &lastFreeSlot);
+        }
+    }
+    addFreeSlots(freeSlots, lastFreeSlot);
+}
+#endif
+
+/**
+ * Copies the live objects in the eden space and the active survivor half into the other survivor half or the old
+ * generation, then frees the slots of the objects left behind, which have none with DIRECT_REFERENCES. Must be called while all java threads are stopped and
+ * threadRegistrationMutex is held
+ */
+void _youngHeapGC() {
+    switchActiveHalf();
+    
+    scavenge_t scavenge = {
+        .numAddresses = addrIndInfo->numAddresses,
+        .oldGenerationTop = getOldGenerationTop(),
+        .nextRootTask = 0,
+        .nextCard = 0,
+        .nextSweepSlot = 0
+    };
+    runInParallel(scavengeTask, &scavenge);
+    // the promoted objects might reference objects in the survivor half. Their cards are dirtied once the workers are
+    // done since a worker might be scanning the card the first promoted object starts on
+    dirtyCards(getOldGeneration() + scavenge.oldGenerationTop, getOldGenerationTop() - scavenge.oldGenerationTop);
+#ifndef DIRECT_REFERENCES
+    runInParallel(sweepTask, &scavenge);
+#endif
+    
+    for(size_t i = 0; i < numGCWorkers; i++) {
+        fillGap(survivorBuffers[i].top, survivorBuffers[i].end - survivorBuffers[i].top);
+        survivorBuffers[i].top = NULL;
+        survivorBuffers[i].end = NULL;
+    }
+    emptyEden();
+}
+
+/**
+ * Sets the mark bit of a slot. Marks are kept per slot rather than per object, so they stay valid when a young gc moves
+ * objects while marking runs concurrently. With DIRECT_REFERENCES they are kept per reference instead, and the young
+ * gc moves the mark along with the object.
+ * @param mark
+ * @param slot any value. Values which aren't handles of objects are ignored
+ * @return true if the slot wasn't marked before
+ */
+static bool tryMark(mark_t *mark, slot_t slot) {
+#ifdef DIRECT_REFERENCES
+    if(slot == 0)
+        return false;
+#else
+    if(slot == 0 || slot >= mark->numAddresses)
+        return false;
+    object_t *obj = addrIndInfo->addressTable[slot];
+    if(!IS_OBJECT_ENTRY(obj))
+        return false;
+#endif
+    _Atomic uint64_t *word = mark->bits + slot / 64u;
+    uint64_t bit = (uint64_t) 1 << (slot % 64u);
+    // most objects are reached more than once, and reading first avoids writing to the cache line again
+    if(atomic_load_explicit(word, memory_order_relaxed) & bit)
+        return false;
+    return !(atomic_fetch_or_explicit(word, bit, memory_order_relaxed) & bit);
+}
+
+static bool isMarked(mark_t *mark, slot_t slot) {
+    return atomic_load_explicit(mark->bits + slot / 64u, memory_order_relaxed) & ((uint64_t) 1 << (slot % 64u));
+}
+
+/**
+ * Marks a live object and pushes it so that the objects it references get marked too
+ * @param worker
+ * @param slot
+ * @param arg the mark_t of the gc
+ */
+static void markSlot(size_t worker, slot_t *slot, void *arg) {
+    if(tryMark(arg, *slot))
+        pushWork(worker, getObject(*slot));
+}
+
+/**
+ * Marks a live object while marking concurrently. The gc thread scans it later, which might be after a young gc moved
+ * it, so the slot is pushed instead of the object
+ * @param worker
+ * @param slot
+ * @param arg the mark_t of the gc
+ */
+static void greySlot(size_t worker, slot_t *slot, void *arg) {
+    if(!tryMark(arg, *slot))
+        return;
+    if(markStack.numSlots == markStack.capacity) {
+        size_t capacity = MAX(markStack.capacity * 2, INITIAL_WORK_DEQUE_CAPACITY);
+        slot_t *slots = realloc(markStack.slots, capacity * sizeof(slot_t));
+        if(!slots) {
+            printf("OutOfMemoryError: Failed to grow the mark stack\n");
+            exit(1);
+        }
+        markStack.slots = slots;
+        markStack.capacity = capacity;
+    }
+    markStack.slots[markStack.numSlots++] = *slot;
+}
+
+/**
+ * Marks the references in a buffer filled by the write barrier
+ * @param buffer
+ */
+static void greySATBBuffer(satb_buffer_t *buffer) {
+    for(uint16_t i = 0; i < buffer->numSlots; ++i)
+        greySlot(0, buffer->slots + i, &concurrentMark);
+    buffer->numSlots = 0;
+}
+
+/**
+ * Marks the references in the buffers threads handed over
+ */
+static void greyFullSATBChunks() {
+    pthread_mutex_lock(&satbMutex);
+    satb_chunk_t *chunk = fullSATBChunks;
+    fullSATBChunks = NULL;
+    pthread_mutex_unlock(&satbMutex);
+    while(chunk) {
+        greySATBBuffer(&chunk->buffer);
+        satb_chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
+
+/**
+ * Marks the references in the buffers of every thread. Must be called while all java threads are stopped and
+ * threadRegistrationMutex is held
+ */
+static void greyAllSATBBuffers() {
+    for(size_t i = 0; i < numThreads; i++)
+        greySATBBuffer(&jthreads[i]->satbBuffer);
+    pthread_mutex_lock(&globalRootsMutex);
+    greySATBBuffer(&globalSATBBuffer);
+    pthread_mutex_unlock(&globalRootsMutex);
+    greyFullSATBChunks();
+}
+
+void markAllocatedObject(slot_t slot) {
+    if(concurrentMarkActive && slot < concurrentMark.numAddresses)
+        atomic_fetch_or_explicit(concurrentMark.bits + slot / 64u, (uint64_t) 1 << (slot % 64u), memory_order_relaxed);
+}
+
+/**
+ * Marks every object reachable from the roots, including young objects since they might reference old ones
+ */
+static void markTask(size_t worker, void *arg) {
+    mark_t *mark = arg;
+    root_visitor_t visitor = {worker, markSlot, mark};
+    visitRoots(&mark->nextRootTask, &visitor);
     
-    // every 8 gc cycles run gc on the old heap
-    if(gcMode != GC_MODE_MINOR_ONLY && (gcMode == GC_MODE_FORCE_MAJOR || (gcCycle & 0x7u) == 0))
-        _oldHeapGC(numLiveObjects, liveObjects);
-    _youngHeapGC(numLiveObjects, liveObjects);
+    object_t *obj;
+    while((obj = nextWork(worker)))
+        visitReferences(worker, obj, markSlot, mark);
+}
+
+/**
+ * Marks everything reachable from the objects concurrent marking didn't get to. The roots don't need to be scanned
+ * again since everything they referenced when marking started was marked, and the write barrier logged every reference
+ * which was overwritten since.
+ */
+static void remarkTask(size_t worker, void *arg) {
+    mark_t *mark = arg;
+    size_t index;
+    while((index = atomic_fetch_add(&mark->nextGreySlot, 1)) < markStack.numSlots)
+        visitReferences(worker, getObject(markStack.slots[index]), markSlot, mark);
     
-    if(addrIndInfo->numFragmentedFree >= 8192) {
-        // get rid of any extra free nodes
-        rebuildFreeList(addrIndInfo);
+    object_t *obj;
+    while((obj = nextWork(worker)))
+        visitReferences(worker, obj, markSlot, mark);
+}
+
+/**
+ * Slides the live objects of the regions the worker claims to their new address. A region's objects may only be moved
+ * once every object whose old location they are moved over was moved, which is only true for objects in earlier
+ * regions since objects only move towards the start of the old generation.
+ */
+static void compactTask(size_t worker, void *arg) {
+    mark_t *mark = arg;
+    size_t index;
+    while((index = atomic_fetch_add(&mark->nextRegion, 1)) < mark->numRegions) {
+        compaction_region_t *region = mark->regions + index;
+        if(region->firstObject) {
+            // the last objects of the earlier regions end in increasing order
+            for(size_t i = index; i-- > 0;) {
+                compaction_region_t *previous = mark->regions + i;
+                if(!previous->firstObject)
+                    continue;
+                if(previous->sourceEnd <= region->destination)
+                    break;
+                while(!atomic_load_explicit(&previous->moved, memory_order_acquire))
+                    sched_yield();
+            }
+            
+            void *destination = region->destination;
+            void *pos = region->firstObject;
+            while(pos < region->sourceEnd) {
+                object_t *obj = pos;
+                size_t size = getObjectSize(obj);
+                pos += size;
+                // the slot of dead objects was cleared when the new addresses were computed
+                if(!IS_FILLER(obj) && obj->slot) {
+                    memmove(destination, obj, size);
+#ifdef DIRECT_REFERENCES
+                    // the slot field only forwards references while the gc moves objects
+                    ((object_t *) destination)->slot = 0;
+#endif
+                    destination += size;
+                }
+            }
+        }
+        atomic_store_explicit(&region->moved, true, memory_order_release);
+    }
+}
+
+#ifdef DIRECT_REFERENCES
+/**
+ * Points a reference to an old object at the address compaction moves the object to, which is stored in the slot field
+ * of the object until it's moved. References to dead objects are cleared, which only dead objects hold
+ * @param worker
+ * @param slot
+ * @param arg
+ */
+static void updateReference(size_t worker, slot_t *slot, void *arg) {
+    object_t *obj = getObject(*slot);
+    if(obj && !isInYoungGeneration(obj))
+        *slot = obj->slot;
+}
+
+static void updateYoungObject(object_t *obj, void *arg) {
+    visitReferences(0, obj, updateReference, arg);
+}
+
+/**
+ * Updates the references to old objects before compaction moves them: the roots, the references of the live old objects
+ * in the regions the worker claims, and the references of every young object, which one worker takes since the young
+ * generation can only be walked from the start.
+ */
+static void updateReferencesTask(size_t worker, void *arg) {
+    mark_t *mark = arg;
+    root_visitor_t visitor = {worker, updateReference, mark};
+    visitRoots(&mark->nextRootTask, &visitor);
+    if(!atomic_exchange(&mark->youngObjectsClaimed, true))
+        visitYoungObjects(updateYoungObject, mark);
+    
+    size_t index;
+    while((index = atomic_fetch_add(&mark->nextRegion, 1)) < mark->numRegions) {
+        compaction_region_t *region = mark->regions + index;
+        void *pos = region->firstObject;
+        while(pos && pos < region->sourceEnd) {
+            object_t *obj = pos;
+            pos += getObjectSize(obj);
+            if(!IS_FILLER(obj) && obj->slot)
+                visitReferences(worker, obj, updateReference, mark);
+        }
+    }
+}
+#endif
+
+/**
+ * Slides the live objects in the old generation towards its start and frees the slots of the dead ones. Since every
+ * reference goes through the address table, only the slot of a moved object needs to be updated. The new addresses are
+ * computed in one pass over the old generation before the objects are moved by the workers, one region at a time.
+ * With DIRECT_REFERENCES the new address of each object is stored in its slot field instead, and every reference to
+ * an old object is updated before the objects are moved.
+ * Frees the mark bits. Must be called while all java threads are stopped and threadRegistrationMutex is held
+ * @param mark the marks of every live object
+ */
+static void compactOldGeneration(mark_t *mark) {
+    size_t oldGenerationTop = getOldGenerationTop();
+    mark->numRegions = (oldGenerationTop + COMPACTION_REGION_SIZE - 1) / COMPACTION_REGION_SIZE;
+    mark->regions = calloc(MAX(mark->numRegions, 1), sizeof(compaction_region_t));
+    // nothing is collected without memory to keep track of it, but the young gc still works
+    if(!mark->regions)
+        goto cleanup;
+    
+    void *oldGeneration = getOldGeneration();
+    void *destination = oldGeneration;
+#ifndef DIRECT_REFERENCES
+    slot_t freeSlots = 0;
+    slot_t lastFreeSlot = 0;
+#endif
+    void *pos = oldGeneration;
+    while(pos < oldGeneration + oldGenerationTop) {
+        object_t *obj = pos;
+        size_t size = getObjectSize(obj);
+        pos += size;
+        if(IS_FILLER(obj))
+            continue;
         
-        // this commented out section allows the jvm to compact the indirection table, but since that adds unneeded complexity, I'm not using it.
-        // The compaction code is also not completed
+#ifdef DIRECT_REFERENCES
+        bool live = isMarked(mark, getReference(obj));
+#else
+        slot_t slot = obj->slot;
+        bool ownsSlot = slot != 0 && slot < addrIndInfo->numAddresses && addrIndInfo->addressTable[slot] == obj;
+        bool live = ownsSlot && (slot >= mark->numAddresses || isMarked(mark, slot));
+        if(ownsSlot && !live)
+            freeSlotInto(slot, &freeSlots, &lastFreeSlot);
+#endif
+        if(!live) {
+            obj->slot = 0;
+            continue;
+        }
         
-        //compact_res_t * compactionResult = compactAddressTable(addrIndInfo);
-        //while(compactionResult) {
-        //    ((object_t *) addrIndInfo->addressTable[compactionResult->newSlot])->slot = compactionResult->newSlot;
-        //    for(size_t i = 0; i < numLiveObjects; i++) {
-        //        object_t *obj = liveObjects[i];
-        //        size_t numFields = obj->class->numFields;
-        //        field_t *fields = obj->class->fields;
-        //        for(size_t j = 0; j < numFields; j++) {
-        //            field_t *fieldInfo = fields + j;
-        //            if(fieldInfo->type.type == TYPE_REFERENCE) {
-        //                uint32_t offset = fieldInfo->objectOffset;
-        //                slot_t *field;
-        //                if(fields[j].flags & FIELD_ACC_STATIC)
-        //                    field = obj->class->staticFieldData + offset;
-        //                else
-        //                    field = ((void *) obj) + offset;
-        //
-        //                if(*field == compactionResult->oldSlot)
-        //                    *field = compactionResult->newSlot;
-        //            }
-        //        }
-        //    }
-        //
-        //    // TODO update static fields in all classes
-        //    // TODO update stack for each thread
-        //
-        //    compact_res_t * temp = compactionResult;
-        //    compactionResult = temp->next;
-        //    free(temp);
-        //}
-    }
-    
-    lastGC = clock();
+        compaction_region_t *region = mark->regions + ((void *) obj - oldGeneration) / COMPACTION_REGION_SIZE;
+        if(!region->firstObject) {
+            region->firstObject = obj;
+            region->destination = destination;
+        }
+        region->sourceEnd = pos;
+#ifdef DIRECT_REFERENCES
+        obj->slot = getReference(destination);
+#else
+        addrIndInfo->addressTable[slot] = destination;
+#endif
+        recordOldObject(destination, size);
+        destination += size;
+    }
+#ifdef DIRECT_REFERENCES
+    // the workers took every root task and region while marking
+    mark->nextRootTask = 0;
+    runInParallel(updateReferencesTask, mark);
+    mark->nextRegion = 0;
+#else
+    addFreeSlots(freeSlots, lastFreeSlot);
+#endif
+    
+    runInParallel(compactTask, mark);
+    setOldGenerationTop(destination - oldGeneration);
+    
+    cleanup:
+    free(mark->regions);
+    free(mark->bits);
+}
+
+/**
+ * @return the number of mark bits an old gc needs
+ */
+static size_t getNumMarkBits() {
+#ifdef DIRECT_REFERENCES
+    // one past the reference of the last word of the heap
+    return maxHeap / 8 + 1;
+#else
+    return addrIndInfo->numAddresses;
+#endif
+}
+
+/**
+ * Marks the live objects in parallel and then compacts the old generation. Must be called while all java threads are
+ * stopped and threadRegistrationMutex is held
+ */
+void _oldHeapGC() {
+    mark_t mark = {
+        .numAddresses = getNumMarkBits(),
+        .bits = calloc((getNumMarkBits() + 63u) / 64u, sizeof(uint64_t)),
+        .regions = NULL,
+        .nextRootTask = 0,
+        .nextGreySlot = 0,
+        .nextRegion = 0
+    };
+    if(!mark.bits)
+        return;
+    runInParallel(markTask, &mark);
+    compactOldGeneration(&mark);
+}
+
+/**
+ * Marks the roots and turns on the write barrier, after which the gc thread marks the rest while the java threads run.
+ * Must be called while all java threads are stopped and threadRegistrationMutex is held
+ */
+static void startConcurrentMark() {
+    concurrentMark = (mark_t) {
+        .numAddresses = getNumMarkBits(),
+        .bits = calloc((getNumMarkBits() + 63u) / 64u, sizeof(uint64_t)),
+        .regions = NULL,
+        .nextRootTask = 0,
+        .nextGreySlot = 0,
+        .nextRegion = 0
+    };
+    // the old generation is collected the next time a major gc is due instead
+    if(!concurrentMark.bits)
+        return;
+    root_visitor_t visitor = {0, greySlot, &concurrentMark};
+    visitRoots(&concurrentMark.nextRootTask, &visitor);
+    concurrentMarkActive = true;
+}
+
+/**
+ * Marks the objects which are referenced by objects that were marked before, up to CONCURRENT_MARK_STEP of them. Only
+ * called by the gc thread while the java threads run
+ * @return true if there was nothing left to mark, so marking can be finished in a short pause
+ */
+static bool markConcurrently() {
+    greyFullSATBChunks();
+    for(int i = 0; i < CONCURRENT_MARK_STEP && markStack.numSlots; i++) {
+        slot_t slot = markStack.slots[--markStack.numSlots];
+        visitReferences(0, getObject(slot), greySlot, &concurrentMark);
+    }
+    return markStack.numSlots == 0;
+}
+
+/**
+ * Marks whatever concurrent marking didn't get to in parallel, turns off the write barrier, and compacts the old
+ * generation. Must be called while all java threads are stopped and threadRegistrationMutex is held
+ */
+static void finishConcurrentMark() {
+    greyAllSATBBuffers();
+    runInParallel(remarkTask, &concurrentMark);
+    markStack.numSlots = 0;
+    concurrentMarkActive = false;
+    remarkRequested = false;
+    compactOldGeneration(&concurrentMark);
+}
+
+void runGC() {
+    uint64_t startTime = currentTime();
+    pthread_mutex_lock(&gcRunningMutex);
+    gcWantsToRun = true;
+    // every poll faults from now on and stops the thread in savePoint
+    mprotect((void *) safepointPollPage, pageSize, PROT_NONE);
+    while(numThreadsWaiting < numThreads)
+        pthread_cond_wait(&threadStoppedCondition, &gcRunningMutex);
+    
+    enum gcMode gcMode = requestedMode;
+    gcCycle++;
+    
+    // the stacks of the threads are roots, so no thread may start or exit during the gc
+    pthread_mutex_lock(&threadRegistrationMutex);
+    // the old gc walks eden with DIRECT_REFERENCES, which needs the rest of every buffer filled
+    for(size_t i = 0; i < numThreads; i++)
+        retireTLAB(jthreads[i]);
+    // every 8 gc cycles run gc on the old heap. It also runs whenever the young gc might not be able to promote every
+    // live object, which can't be skipped since the young gc fails otherwise
+    bool promotionMightFail = getFreeOldSpace() < getUsedYoungSpace();
+    bool majorGCDue = gcMode != GC_MODE_MINOR_ONLY && (gcMode == GC_MODE_FORCE_MAJOR || (gcCycle & 0x7u) == 0);
+    bool oldGenerationCollected = false;
+    if(concurrentMarkActive) {
+        if(remarkRequested || promotionMightFail || gcMode == GC_MODE_FORCE_MAJOR) {
+            finishConcurrentMark();
+            oldGenerationCollected = true;
+        }
+        else {
+            // the objects the threads unlinked are kept alive by the young gc until they're scanned
+            greyAllSATBBuffers();
+        }
+    }
+    else if(promotionMightFail || (majorGCDue && (!concurrentMarking || gcMode == GC_MODE_FORCE_MAJOR))) {
+        _oldHeapGC();
+        oldGenerationCollected = true;
+    }
+    _youngHeapGC();
+    if(majorGCDue && concurrentMarking && !concurrentMarkActive && !oldGenerationCollected)
+        startConcurrentMark();
+    pthread_mutex_unlock(&threadRegistrationMutex);
+    
+    // all other threads are stopped so nothing is allocated until the counter is reset
+    uint64_t now = currentTime();
+    lastPauseTime = now - startTime;
+    size_t allocated = atomic_exchange_explicit(&bytesAllocatedSinceGC, 0, memory_order_relaxed);
+    atomic_store_explicit(&allocationTrigger, calculateAllocationTrigger(allocated, now - lastGC), memory_order_relaxed);
+    lastGC = now;
     
+    mprotect((void *) safepointPollPage, pageSize, PROT_READ);
     gcWantsToRun = false;
     requestedMode = GC_MODE_NORMAL;
+    pthread_cond_broadcast(&gcFinishedCondition);
     pthread_mutex_unlock(&gcRunningMutex);
 }
\ No newline at end of file
@@ -10,6 +10,36 @@
 #include <stdbool.h>
 #include <stdatomic.h>
 #include "jthread.h"
+#include "heap.h"
+
+// the gc is started after at least 1/GC_MIN_TRIGGER_DIVISOR of the eden space was allocated since the last gc
+#ifndef GC_MIN_TRIGGER_DIVISOR
+#define GC_MIN_TRIGGER_DIVISOR 16
+#endif
+
+// size of the part of the survivor space a gc worker copies objects into without synchronizing with other workers
+#ifndef SURVIVOR_BUFFER_SIZE
+#define SURVIVOR_BUFFER_SIZE KIBIBYTES((size_t) 32)
+#endif
+// number of slots a gc worker frees at a time after a young gc
+#ifndef SWEEP_CHUNK_SIZE
+#define SWEEP_CHUNK_SIZE 4096
+#endif
+
+// size of the parts of the old generation the gc workers split compaction into
+#ifndef COMPACTION_REGION_SIZE
+#define COMPACTION_REGION_SIZE KIBIBYTES((size_t) 256)
+#endif
+
+// number of objects the gc thread marks between checks whether a young gc should run while marking concurrently
+#ifndef CONCURRENT_MARK_STEP
+#define CONCURRENT_MARK_STEP 1024
+#endif
+
+// number of cards a gc worker scans at a time for references from the old generation during a young gc
+#ifndef CARD_CHUNK_SIZE
+#define CARD_CHUNK_SIZE 256
+#endif
 
 enum gcMode {
     GC_MODE_NORMAL,
@@ -21,7 +51,19 @@ extern volatile bool gcWantsToRun;
 extern volatile atomic_uint_fast32_t numThreads;
 extern volatile atomic_uint_fast32_t numThreadsWaiting;
 extern pthread_mutex_t gcRunningMutex;
+extern volatile uint8_t *safepointPollPage;
+extern volatile bool concurrentMarkActive;
+
+/**
+ * Polls for a safepoint by reading the safepoint page. The gc protects the page while it waits for threads to stop, so
+ * the read faults and the thread waits in savePoint until the gc is done. The pc and top of stack of the thread must
+ * be synced to its stack frame before polling. The fence keeps the compiler from moving those stores past the read.
+ */
+#define SAFEPOINT_POLL() do { atomic_signal_fence(memory_order_seq_cst); (void) *safepointPollPage; } while(0)
 
+/**
+ * Stops the thread until the gc is done if the gc wants to run. Must be called without holding any locks the gc needs
+ */
 void savePoint();
 
 bool registerThread(jthread_t *jthread);
@@ -31,4 +73,69 @@ pthread_t *initGC();
 
 void requestGC(enum gcMode gcMode);
 
+/**
+ * Keeps an object alive while only C code references it. Roots are popped in the reverse order they were pushed. With
+ * DIRECT_REFERENCES the gc updates the root when it moves the object, so the reference has to be read back from the root
+ * with peekRoot or popRoot after anything which can run the gc
+ * @param jthread the current thread or NULL if it isn't a java thread
+ * @param slot
+ */
+void pushRoot(jthread_t *jthread, slot_t slot);
+
+/**
+ * @param jthread the current thread or NULL if it isn't a java thread
+ * @return the current reference of the root pushed last
+ */
+slot_t peekRoot(jthread_t *jthread);
+
+/**
+ * @param jthread the current thread or NULL if it isn't a java thread
+ * @return the current reference of the root
+ */
+slot_t popRoot(jthread_t *jthread);
+
+/**
+ * Snapshot at the beginning write barrier, which must run before a reference field, static field, or array element is
+ * overwritten. While the old generation is marked concurrently the overwritten reference is logged, so every object
+ * which was reachable when marking started is marked even if the java threads unlink it in the meantime
+ * @param jthread the current thread or NULL if it isn't a java thread
+ * @param field the reference which is about to be overwritten
+ */
+#define SATB_WRITE_BARRIER(jthread, field) do { \
+        if(concurrentMarkActive && *(slot_t *) (field)) \
+            logOverwrittenReference((jthread), *(slot_t *) (field)); \
+    } while(0)
+
+/**
+ * Write barrier of reference fields and array elements of objects, which runs SATB_WRITE_BARRIER and dirties the card
+ * of the field. Static fields only need SATB_WRITE_BARRIER since they aren't in the heap and every young gc scans them
+ * @param jthread the current thread or NULL if it isn't a java thread
+ * @param field the reference which is about to be overwritten
+ */
+#define OBJECT_WRITE_BARRIER(jthread, field) do { \
+        SATB_WRITE_BARRIER(jthread, field); \
+        MARK_CARD(field); \
+    } while(0)
+
+/**
+ * Adds a reference to the buffer of the thread and hands the buffer to the gc thread once it's full. Only called by
+ * SATB_WRITE_BARRIER
+ * @param jthread the current thread or NULL if it isn't a java thread
+ * @param slot
+ */
+void logOverwrittenReference(jthread_t *jthread, slot_t slot);
+
+/**
+ * Marks a new object as live if the old generation is being marked concurrently, since nothing allocated after marking
+ * started can be garbage by the time marking finishes. Must be called before the object can be stored anywhere
+ * @param slot
+ */
+void markAllocatedObject(slot_t slot);
+
+/**
+ * Counts memory allocated in the eden space and wakes the gc thread once enough was allocated since the last gc
+ * @param numBytes
+ */
+void countAllocation(size_t numBytes);
+
 #endif //JVM_GC_H
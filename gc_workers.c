@@ -0,0 +1,221 @@
+#include "gc_workers.h"
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+
+typedef struct gc_worker {
+    // each deque gets its own cache line since stealers write to the top of other deques
+    _Alignas(64) work_deque_t deque;
+    pthread_t thread;
+} gc_worker_t;
+
+size_t numGCWorkers = 0;
+static gc_worker_t *workers = NULL;
+
+static pthread_mutex_t taskMutex = PTHREAD_MUTEX_INITIALIZER;
+// broadcast when a new task is started
+static pthread_cond_t taskStartedCondition = PTHREAD_COND_INITIALIZER;
+// signalled when the last helper finishes the current task
+static pthread_cond_t taskFinishedCondition = PTHREAD_COND_INITIALIZER;
+static void (*currentTask)(size_t worker, void *arg);
+static void *currentTaskArg;
+static uint64_t taskGeneration = 0;
+static size_t numHelpersFinished;
+// workers which might still push work. A parallel task runs out of work once this reaches 0
+static atomic_size_t numActiveWorkers;
+
+static work_array_t *createWorkArray(int64_t capacity) {
+    work_array_t *array = malloc(sizeof(work_array_t) + capacity * sizeof(void *));
+    if(!array)
+        return NULL;
+    array->capacity = capacity;
+    array->previous = NULL;
+    return array;
+}
+
+static bool initWorkDeque(work_deque_t *deque) {
+    work_array_t *array = createWorkArray(INITIAL_WORK_DEQUE_CAPACITY);
+    if(!array)
+        return false;
+    atomic_init(&deque->top, 0);
+    atomic_init(&deque->bottom, 0);
+    atomic_init(&deque->array, array);
+    return true;
+}
+
+/**
+ * Frees the arrays a deque outgrew. Must only be called while no worker steals
+ * @param deque
+ */
+static void freePreviousWorkArrays(work_deque_t *deque) {
+    work_array_t *array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    work_array_t *previous = array->previous;
+    array->previous = NULL;
+    while(previous) {
+        work_array_t *next = previous->previous;
+        free(previous);
+        previous = next;
+    }
+}
+
+static void pushToDeque(work_deque_t *deque, void *item) {
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    work_array_t *array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    if(bottom - top >= array->capacity) {
+        work_array_t *newArray = createWorkArray(array->capacity * 2);
+        if(!newArray) {
+            printf("OutOfMemoryError: Failed to grow the work deque of a gc worker\n");
+            exit(1);
+        }
+        for(int64_t i = top; i < bottom; i++) {
+            void *oldItem = atomic_load_explicit(&array->items[i & (array->capacity - 1)], memory_order_relaxed);
+            atomic_store_explicit(&newArray->items[i & (newArray->capacity - 1)], oldItem, memory_order_relaxed);
+        }
+        newArray->previous = array;
+        atomic_store_explicit(&deque->array, newArray, memory_order_release);
+        array = newArray;
+    }
+    atomic_store_explicit(&array->items[bottom & (array->capacity - 1)], item, memory_order_relaxed);
+    // stealers which see the new bottom also see the item and the object it points to
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_release);
+}
+
+static void *popFromDeque(work_deque_t *deque) {
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    work_array_t *array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+    if(top > bottom) {
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return NULL;
+    }
+    void *item = atomic_load_explicit(&array->items[bottom & (array->capacity - 1)], memory_order_relaxed);
+    if(top == bottom) {
+        // the last item might be stolen at the same time
+        if(!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed))
+            item = NULL;
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    }
+    return item;
+}
+
+static void *stealFromDeque(work_deque_t *deque) {
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if(top >= bottom)
+        return NULL;
+    work_array_t *array = atomic_load_explicit(&deque->array, memory_order_acquire);
+    void *item = atomic_load_explicit(&array->items[top & (array->capacity - 1)], memory_order_relaxed);
+    // losing the race to the owner or another stealer counts as finding nothing
+    if(!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed))
+        return NULL;
+    return item;
+}
+
+static void *workerLoop(void *arg) {
+    size_t worker = (size_t) arg;
+    uint64_t generation = 0;
+    pthread_mutex_lock(&taskMutex);
+    while(true) {
+        while(taskGeneration == generation)
+            pthread_cond_wait(&taskStartedCondition, &taskMutex);
+        generation = taskGeneration;
+        void (*task)(size_t, void *) = currentTask;
+        void *taskArg = currentTaskArg;
+        pthread_mutex_unlock(&taskMutex);
+
+        task(worker, taskArg);
+
+        pthread_mutex_lock(&taskMutex);
+        if(++numHelpersFinished == numGCWorkers - 1)
+            pthread_cond_signal(&taskFinishedCondition);
+    }
+    return NULL;
+}
+
+bool initGCWorkers(size_t numWorkers) {
+    workers = aligned_alloc(_Alignof(gc_worker_t), numWorkers * sizeof(gc_worker_t));
+    if(!workers)
+        return false;
+    for(size_t i = 0; i < numWorkers; i++) {
+        if(!initWorkDeque(&workers[i].deque))
+            return false;
+    }
+    numGCWorkers = numWorkers;
+    // worker 0 is the gc thread itself
+    for(size_t i = 1; i < numWorkers; i++) {
+        if(pthread_create(&workers[i].thread, NULL, workerLoop, (void *) i))
+            return false;
+    }
+    return true;
+}
+
+void runInParallel(void (*task)(size_t worker, void *arg), void *arg) {
+    atomic_store(&numActiveWorkers, numGCWorkers);
+    pthread_mutex_lock(&taskMutex);
+    currentTask = task;
+    currentTaskArg = arg;
+    numHelpersFinished = 0;
+    ++taskGeneration;
+    pthread_cond_broadcast(&taskStartedCondition);
+    pthread_mutex_unlock(&taskMutex);
+
+    task(0, arg);
+
+    pthread_mutex_lock(&taskMutex);
+    while(numHelpersFinished < numGCWorkers - 1)
+        pthread_cond_wait(&taskFinishedCondition, &taskMutex);
+    pthread_mutex_unlock(&taskMutex);
+
+    for(size_t i = 0; i < numGCWorkers; i++)
+        freePreviousWorkArrays(&workers[i].deque);
+}
+
+void pushWork(size_t worker, void *item) {
+    pushToDeque(&workers[worker].deque, item);
+}
+
+/**
+ * @param worker
+ * @return an item stolen from another worker or NULL if none was found
+ */
+static void *stealWork(size_t worker) {
+    for(size_t i = 1; i < numGCWorkers; i++) {
+        void *item = stealFromDeque(&workers[(worker + i) % numGCWorkers].deque);
+        if(item)
+            return item;
+    }
+    return NULL;
+}
+
+static bool isWorkAvailable() {
+    for(size_t i = 0; i < numGCWorkers; i++) {
+        work_deque_t *deque = &workers[i].deque;
+        if(atomic_load_explicit(&deque->bottom, memory_order_relaxed) > atomic_load_explicit(&deque->top, memory_order_relaxed))
+            return true;
+    }
+    return false;
+}
+
+void *nextWork(size_t worker) {
+    void *item = popFromDeque(&workers[worker].deque);
+    if(item)
+        return item;
+    while(true) {
+        item = stealWork(worker);
+        if(item)
+            return item;
+
+        // idle workers have empty deques, so once every worker is idle there is nothing left to do
+        atomic_fetch_sub(&numActiveWorkers, 1);
+        while(!isWorkAvailable()) {
+            if(atomic_load(&numActiveWorkers) == 0)
+                return NULL;
+            sched_yield();
+        }
+        atomic_fetch_add(&numActiveWorkers, 1);
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef JVM_GC_WORKERS_H
+#define JVM_GC_WORKERS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+// number of items a work deque starts out with room for
+#define INITIAL_WORK_DEQUE_CAPACITY 1024
+
+typedef struct work_array {
+    int64_t capacity; // a power of two
+    struct work_array *previous; // the array this one replaced, which a stealer might still be reading from
+    _Atomic(void *) items[];
+} work_array_t;
+
+/**
+ * Chase-Lev work stealing deque. Only the owning worker pushes and pops at the bottom while any worker may steal from
+ * the top, so the owner works depth first through the items it found and stealers take the oldest ones.
+ */
+typedef struct work_deque {
+    _Atomic int64_t top;
+    _Atomic int64_t bottom;
+    _Atomic(work_array_t *) array;
+} work_deque_t;
+
+// number of threads gc work is split between, including the gc thread itself
+extern size_t numGCWorkers;
+
+/**
+ * Starts the threads which help the gc thread with parallel tasks
+ * @param numWorkers the total number of workers including the gc thread
+ * @return false if memory ran out or a thread couldn't be started
+ */
+bool initGCWorkers(size_t numWorkers);
+
+/**
+ * Runs the task on every worker and waits until all of them are done. The gc thread runs it as worker 0
+ * @param task called with the index of the worker and arg
+ * @param arg
+ */
+void runInParallel(void (*task)(size_t worker, void *arg), void *arg);
+
+/**
+ * Adds an item to the deque of the worker. Must only be called by that worker during a parallel task
+ * @param worker
+ * @param item must not be NULL
+ */
+void pushWork(size_t worker, void *item);
+
+/**
+ * Takes an item from the deque of the worker or steals one from another worker once it's empty. Waits for work while
+ * other workers might still push some
+ * @param worker
+ * @return the item or NULL once every worker ran out of work
+ */
+void *nextWork(size_t worker);
+
+#endif //JVM_GC_WORKERS_H
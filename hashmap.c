@@ -3,174 +3,259 @@
 //
 
 #include "hashmap.h"
+#include <stdint.h>
+#include <stdatomic.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
-typedef struct entry_node {
-    struct entry_node *prev;
-    struct entry_node *next;
+// number of control bytes which are compared at once while probing
+#define GROUP_SIZE 16
+#define MIN_CAPACITY 16
+
+// control bytes of slots which don't hold an entry. Slots which hold one have the lowest 7 bits of its hash instead
+#define CONTROL_EMPTY 0x80u
+#define CONTROL_DELETED 0xFEu
+
+typedef struct ht_slot {
+    size_t hash;
     void *key;
-    void *value;
-} entry_node_t;
+    _Atomic(void *) value;
+} ht_slot_t;
+
+// the table is split into groups of GROUP_SIZE slots whose control bytes are matched at once. An entry is only ever
+// put into an empty slot and its slot isn't reused after it's deleted, so readers never see a slot change its key.
+// Deleted slots become empty when the table is rebuilt
+typedef struct ht_table {
+    size_t capacity; // a power of 2 and a multiple of GROUP_SIZE
+    uint8_t *controls;
+    ht_slot_t *slots;
+    struct ht_table *previous; // replaced tables are kept until the hashmap is destroyed since readers might use them
+} ht_table_t;
 
 struct hashmap {
-    entry_node_t **data;
+    _Atomic(ht_table_t *) table;
     size_t (*hash_fn)(void *);
-    size_t length;
+    bool (*equality_fn)(void *, void *);
     size_t numEntries;
+    size_t numUsed; // entries and deleted slots in the current table
     float loadFactor;
-    bool (*equality_fn)(void *, void *);
 };
 
+/**
+ * Spreads the bits of a hash, so the group and the control byte depend on all of them
+ */
+static inline size_t mixHash(size_t hash) {
+    hash *= (size_t) 0x9E3779B97F4A7C15u;
+    return hash ^ hash >> (sizeof(size_t) * 4);
+}
+
+static inline uint8_t controlByte(size_t mixed) {
+    return mixed >> (sizeof(size_t) * 8 - 7);
+}
+
+/**
+ * @param group the first control byte of a group
+ * @param value
+ * @return a mask with bit i set if control byte i of the group equals value
+ */
+static inline uint32_t matchGroup(const uint8_t *group, uint8_t value) {
+#ifdef __SSE2__
+    __m128i controls = _mm_load_si128((const __m128i *) group);
+    return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(controls, _mm_set1_epi8((char) value)));
+#else
+    uint32_t mask = 0;
+    for(uint32_t i = 0; i < GROUP_SIZE; ++i)
+        mask |= (uint32_t) (group[i] == value) << i;
+    return mask;
+#endif
+}
+
+static ht_table_t *createTable(size_t capacity) {
+    ht_table_t *table = malloc(sizeof(ht_table_t));
+    if(!table)
+        return NULL;
+    table->controls = aligned_alloc(GROUP_SIZE, capacity);
+    table->slots = malloc(capacity * sizeof(ht_slot_t));
+    if(!table->controls || !table->slots) {
+        free(table->controls);
+        free(table->slots);
+        free(table);
+        return NULL;
+    }
+    for(size_t i = 0; i < capacity; ++i)
+        table->controls[i] = CONTROL_EMPTY;
+    table->capacity = capacity;
+    table->previous = NULL;
+    return table;
+}
+
+/**
+ * Finds the slot of a key
+ * @return the slot or NULL if the key isn't in the table
+ */
+static ht_slot_t *findSlot(hashmap_t *hashmap, ht_table_t *table, void *key, size_t hash) {
+    size_t mixed = mixHash(hash);
+    uint8_t control = controlByte(mixed);
+    size_t groupMask = table->capacity / GROUP_SIZE - 1;
+    size_t group = mixed & groupMask;
+    for(size_t probe = 1; ; ++probe) {
+        const uint8_t *controls = table->controls + group * GROUP_SIZE;
+        uint32_t matches = matchGroup(controls, control);
+        uint32_t empty = matchGroup(controls, CONTROL_EMPTY);
+        // pairs with the fence before a control byte is set, so the slots are read after the control bytes
+        atomic_thread_fence(memory_order_acquire);
+        while(matches) {
+            ht_slot_t *slot = table->slots + group * GROUP_SIZE + __builtin_ctz(matches);
+            if(slot->hash == hash && hashmap->equality_fn(slot->key, key))
+                return slot;
+            matches &= matches - 1;
+        }
+        // the key would have been put into the first group with an empty slot
+        if(empty)
+            return NULL;
+        group = (group + probe) & groupMask;
+    }
+}
+
+/**
+ * Puts an entry into the first empty slot of its probe sequence. Only called by the thread modifying the hashmap
+ */
+static void insertSlot(ht_table_t *table, void *key, void *value, size_t hash) {
+    size_t mixed = mixHash(hash);
+    size_t groupMask = table->capacity / GROUP_SIZE - 1;
+    size_t group = mixed & groupMask;
+    uint32_t empty;
+    for(size_t probe = 1; !(empty = matchGroup(table->controls + group * GROUP_SIZE, CONTROL_EMPTY)); ++probe)
+        group = (group + probe) & groupMask;
+    size_t index = group * GROUP_SIZE + __builtin_ctz(empty);
+    ht_slot_t *slot = table->slots + index;
+    slot->hash = hash;
+    slot->key = key;
+    // the value is released on its own too, so readers which acquire it see everything written before it was put
+    atomic_store_explicit(&slot->value, value, memory_order_release);
+    // readers which see the control byte see the slot
+    atomic_thread_fence(memory_order_release);
+    table->controls[index] = controlByte(mixed);
+}
+
+/**
+ * Moves the entries into a new table, which is twice as large if they would fill more than half of the current one
+ * @return false if the new table couldn't be allocated
+ */
+static bool rebuildTable(hashmap_t *hashmap) {
+    ht_table_t *table = atomic_load_explicit(&hashmap->table, memory_order_relaxed);
+    size_t capacity = table->capacity;
+    if(hashmap->numEntries * 2 >= capacity * hashmap->loadFactor)
+        capacity *= 2;
+    ht_table_t *newTable = createTable(capacity);
+    if(!newTable)
+        return false;
+    for(size_t i = 0; i < table->capacity; ++i) {
+        if(table->controls[i] < CONTROL_EMPTY) {
+            ht_slot_t *slot = table->slots + i;
+            insertSlot(newTable, slot->key, atomic_load_explicit(&slot->value, memory_order_relaxed), slot->hash);
+        }
+    }
+    newTable->previous = table;
+    atomic_store_explicit(&hashmap->table, newTable, memory_order_release);
+    hashmap->numUsed = hashmap->numEntries;
+    return true;
+}
+
 hashmap_t *ht_createHashmap(size_t (*hash_fn)(void *), bool (*equality_fn)(void *, void *), float loadFactor) {
     if(!hash_fn)
         return NULL;
-    hashmap_t *hashmap = malloc(sizeof(hashmap_t *));
+    hashmap_t *hashmap = malloc(sizeof(hashmap_t));
     if(!hashmap)
         return NULL;
 
-    hashmap->data = calloc(16, sizeof(entry_node_t *));
-    if(!hashmap->data) {
+    ht_table_t *table = createTable(MIN_CAPACITY);
+    if(!table) {
         free(hashmap);
         return NULL;
     }
 
+    atomic_init(&hashmap->table, table);
     hashmap->hash_fn = hash_fn;
-    hashmap->length = 16;
+    hashmap->equality_fn = equality_fn;
     hashmap->numEntries = 0;
+    hashmap->numUsed = 0;
     hashmap->loadFactor = loadFactor;
-    hashmap->equality_fn = equality_fn;
     return hashmap;
 }
 
 void ht_destroyHashmap(hashmap_t *hashmap) {
     if(!hashmap)
         return;
-    size_t length = hashmap->length;
-    entry_node_t **data = hashmap->data;
-    for(size_t i = 0; i < length; ++i) {
-        entry_node_t *entry = data[i];
-        while(entry) {
-            entry_node_t *temp = entry;
-            entry = entry->next;
-            free(temp);
-        }
+    ht_table_t *table = atomic_load_explicit(&hashmap->table, memory_order_relaxed);
+    while(table) {
+        ht_table_t *previous = table->previous;
+        free(table->controls);
+        free(table->slots);
+        free(table);
+        table = previous;
     }
-    free(hashmap->data);
     free(hashmap);
 }
 
-void expandHashmap(hashmap_t *hashmap) {
-    size_t newLength = hashmap->length * 2;
-    entry_node_t **newData = calloc(newLength, sizeof(entry_node_t *));
-    if(!newData)
-        return;
-
-    size_t length = hashmap->length;
-    entry_node_t **data = hashmap->data;
-    for(size_t i = 0; i < length; ++i) {
-        entry_node_t *entry = data[i];
-        while(entry) {
-            entry_node_t *temp = entry;
-            entry = entry->next;
-            size_t newLocation = hashmap->hash_fn(entry->key) & (newLength - 1);
-            temp->next = newData[newLocation];
-            if(temp->next)
-                temp->next->prev = temp;
-            newData[newLocation] = temp;
-        }
-    }
-    free(hashmap->data);
-    hashmap->data = newData;
-    hashmap->length = newLength;
-}
-
-void *ht_put(hashmap_t *hashmap, void *key, void *value) {
+bool ht_put(hashmap_t *hashmap, void *key, void *value, void **previous) {
+    if(previous)
+        *previous = NULL;
     if(!hashmap)
-        return NULL;
-
-    if(hashmap->numEntries >= hashmap->length * hashmap->loadFactor)
-        expandHashmap(hashmap);
+        return false;
 
     size_t hash = hashmap->hash_fn(key);
-    size_t index = hash & (hashmap->length - 1);
-    entry_node_t **data = hashmap->data;
-    entry_node_t *entry = data[index];
+    ht_table_t *table = atomic_load_explicit(&hashmap->table, memory_order_relaxed);
 
     // try to update existing key
-    while(entry) {
-        if(hashmap->equality_fn(entry->key, key)) {
-            void *oldValue = entry->value;
-            entry->value = value;
-            return oldValue;
-        }
-        entry = entry->next;
+    ht_slot_t *slot = findSlot(hashmap, table, key, hash);
+    if(slot) {
+        void *oldValue = atomic_exchange_explicit(&slot->value, value, memory_order_release);
+        if(previous)
+            *previous = oldValue;
+        return true;
     }
 
-    // create new key
-    entry = malloc(sizeof(entry_node_t));
-    if(entry) {
-        entry->key = key;
-        entry->value = value;
-        entry->prev = NULL;
-        entry->next = data[index];
-        if(entry->next)
-            entry->next->prev = entry;
-        data[index] = entry;
-        ++hashmap->numEntries;
-    }
-    return NULL;
+    // create new key. The table always keeps an empty slot, which ends every probe sequence
+    if(hashmap->numUsed + 1 > table->capacity * hashmap->loadFactor && rebuildTable(hashmap))
+        table = atomic_load_explicit(&hashmap->table, memory_order_relaxed);
+    if(hashmap->numUsed + 1 >= table->capacity)
+        return false;
+    insertSlot(table, key, value, hash);
+    ++hashmap->numEntries;
+    ++hashmap->numUsed;
+    return true;
 }
 
 void *ht_delete(hashmap_t *hashmap, void *key) {
     if(!hashmap)
         return NULL;
 
-    size_t index = hashmap->hash_fn(key) & (hashmap->length - 1);
-    entry_node_t *entry = hashmap->data[index];
-
-    while(entry) {
-        if(hashmap->equality_fn(entry->key, key)) {
-            if(entry->prev)
-                entry->prev->next = entry->next;
-            if(entry->next)
-                entry->next->prev = entry->prev;
-            void *value = entry->value;
-            free(entry);
-            --hashmap->numEntries;
-            return value;
-        }
-        entry = entry->next;
-    }
-    return NULL;
+    ht_table_t *table = atomic_load_explicit(&hashmap->table, memory_order_relaxed);
+    ht_slot_t *slot = findSlot(hashmap, table, key, hashmap->hash_fn(key));
+    if(!slot)
+        return NULL;
+    table->controls[slot - table->slots] = CONTROL_DELETED;
+    --hashmap->numEntries;
+    return atomic_load_explicit(&slot->value, memory_order_relaxed);
 }
 
 void *ht_get(hashmap_t *hashmap, void *key) {
     if(!hashmap)
         return NULL;
 
-    size_t index = hashmap->hash_fn(key) & (hashmap->length - 1);
-    entry_node_t *entry = hashmap->data[index];
-
-    while(entry) {
-        if(hashmap->equality_fn(entry->key, key))
-            return entry->value;
-        entry = entry->next;
-    }
-    return NULL;
+    ht_table_t *table = atomic_load_explicit(&hashmap->table, memory_order_acquire);
+    ht_slot_t *slot = findSlot(hashmap, table, key, hashmap->hash_fn(key));
+    return slot ? atomic_load_explicit(&slot->value, memory_order_acquire) : NULL;
 }
 
 bool ht_contains(hashmap_t *hashmap, void *key) {
     if(!hashmap)
         return false;
 
-    size_t index = hashmap->hash_fn(key) & (hashmap->length - 1);
-    entry_node_t *entry = hashmap->data[index];
-
-    while(entry) {
-        if(hashmap->equality_fn(entry->key, key))
-            return true;
-        entry = entry->next;
-    }
-    return false;
+    ht_table_t *table = atomic_load_explicit(&hashmap->table, memory_order_acquire);
+    return findSlot(hashmap, table, key, hashmap->hash_fn(key)) != NULL;
 }
 
 entry_t *ht_entries(hashmap_t *hashmap, size_t *numEntries) {
@@ -183,17 +268,25 @@ entry_t *ht_entries(hashmap_t *hashmap, size_t *numEntries) {
 
     *numEntries = hashmap->numEntries;
     size_t index = 0;
-    size_t length = hashmap->length;
-    entry_node_t **data = hashmap->data;
-    for(size_t i = 0; i < length; ++i) {
-        entry_node_t *entry = data[i];
-        while(entry) {
-            entries[index].key = entry->key;
-            entries[index].value = entry->value;
+    ht_table_t *table = atomic_load_explicit(&hashmap->table, memory_order_relaxed);
+    for(size_t i = 0; i < table->capacity; ++i) {
+        if(table->controls[i] < CONTROL_EMPTY) {
+            entries[index].key = table->slots[i].key;
+            entries[index].value = atomic_load_explicit(&table->slots[i].value, memory_order_relaxed);
             ++index;
-            entry = entry->next;
         }
     }
-    
+
     return entries;
 }
+
+void ht_forEach(hashmap_t *hashmap, void (*fn)(void *key, void *value, void *arg), void *arg) {
+    if(!hashmap)
+        return;
+
+    ht_table_t *table = atomic_load_explicit(&hashmap->table, memory_order_relaxed);
+    for(size_t i = 0; i < table->capacity; ++i) {
+        if(table->controls[i] < CONTROL_EMPTY)
+            fn(table->slots[i].key, atomic_load_explicit(&table->slots[i].value, memory_order_relaxed), arg);
+    }
+}
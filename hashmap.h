@@ -14,14 +14,33 @@ typedef struct ht_entry {
     void *value;
 } entry_t;
 
+// An open addressing hash table. Any number of threads may call ht_get and ht_contains without locking while another
+// thread modifies the hashmap, but modifications have to be serialized by the caller. The caller also has to keep
+// deleted keys and values alive until no reader can still be looking at them
 hashmap_t *ht_createHashmap(size_t (*hash_fn)(void *), bool (*equality_fn)(void *, void *), float loadFactor);
 void ht_destroyHashmap(hashmap_t *hashmap);
 
-void *ht_put(hashmap_t *hashmap, void *key, void *value);
+/**
+ * Puts an entry into the hashmap or replaces the value of its key. A replaced entry keeps its key
+ * @param hashmap
+ * @param key
+ * @param value
+ * @param previous receives the value the key had before or NULL if it was new. Can be NULL
+ * @return false if the entry couldn't be put since the table couldn't grow
+ */
+bool ht_put(hashmap_t *hashmap, void *key, void *value, void **previous);
 void *ht_delete(hashmap_t *hashmap, void *key);
 void *ht_get(hashmap_t *hashmap, void *key);
 bool ht_contains(hashmap_t *hashmap, void *key);
 
 entry_t *ht_entries(hashmap_t *hashmap, size_t *numEntries);
 
+/**
+ * Calls fn with every entry without allocating any memory. The hashmap must not be modified during the iteration
+ * @param hashmap
+ * @param fn
+ * @param arg passed through to fn
+ */
+void ht_forEach(hashmap_t *hashmap, void (*fn)(void *key, void *value, void *arg), void *arg);
+
 #endif //JVM_HASHMAP_H
@@ -4,34 +4,81 @@ import sys, csv
 
 # csv file found here https://raw.githubusercontent.com/kpmiller/emulator101/master/6502Disassembler/6502ops.csv
 
-def main():
-	if len(sys.argv) < 3:
-		print('Usage: python3 header-gen.py CSV_FILE PATH_TO_GENERATED_HEADER_FILE')
-		exit(0)
-	
-	mnemonics = ['unknown'] * 256
+def read_instructions(path):
+	instructions = []
+	with open(path) as csvfile:
+		instr_reader = csv.reader(csvfile)
+		next(instr_reader)
+		for row in instr_reader:
+			if len(row) == 0:
+				continue
+			instructions.append((row[0], int(row[1], 16)))
+	return instructions
 
-	with open(sys.argv[1]) as csvfile:
+# each row names a superinstruction, its opcode, and the space separated instructions it combines
+def read_superinstructions(path):
+	superinstructions = []
+	with open(path) as csvfile:
 		instr_reader = csv.reader(csvfile)
 		next(instr_reader)
 		for row in instr_reader:
 			if len(row) == 0:
 				continue
-			mnemonic = row[0]
-			opcode = int(row[1], 16)
+			superinstructions.append((row[0], int(row[1], 16), row[2].split()))
+	return superinstructions
 
-			mnemonics[opcode] = mnemonic
+def main():
+	if len(sys.argv) < 5:
+		print('Usage: python3 header-gen.py CSV_FILE INTERNAL_CSV_FILE SUPERINSTRUCTION_CSV_FILE PATH_TO_GENERATED_HEADER_FILE')
+		exit(0)
+	
+	# internal opcodes are only used by translated methods and are numbered after the opcodes from the specification
+	internal_rows = read_instructions(sys.argv[2])
+	superinstructions = read_superinstructions(sys.argv[3])
+	internal_rows += [(mnemonic, opcode) for mnemonic, opcode, _ in superinstructions]
+	num_opcodes = max([256] + [opcode + 1 for _, opcode in internal_rows])
+	mnemonics = ['unknown'] * num_opcodes
+
+	for mnemonic, opcode in read_instructions(sys.argv[1]) + internal_rows:
+		mnemonics[opcode] = mnemonic
+
+	for mnemonic, _, instructions in superinstructions:
+		for instruction in instructions:
+			if instruction not in mnemonics:
+				print(f'Superinstruction {mnemonic} contains unknown instruction {instruction}')
+				exit(1)
+	# the translator uses the first superinstruction that matches so longer ones have to come first
+	superinstructions.sort(key=lambda superinstruction: -len(superinstruction[2]))
+	max_length = max([1] + [len(instructions) for _, _, instructions in superinstructions])
 
 	unknown_opcode_function = 'int handle_instr_unknown(bc_interpreter_t *interpreter, bool wide);'
 	function_headers = [f'int handle_instr_{m}(bc_interpreter_t *interpreter, bool wide);' for m in mnemonics if m != "unknown"]
 
-	gen_file = open(sys.argv[2], 'w')
+	gen_file = open(sys.argv[4], 'w')
 	gen_file.write('// DO NOT EDIT THIS FILE. ALL CHANGES WILL BE ERASED WHEN THIS FILE IS REGENERATED\n\n')
 	gen_file.write('#include <stdbool.h>\n#include "jthread.h"\n\n')
-	gen_file.write('static const char *instr_names[256] = {\n')
+	gen_file.write('enum opcode {\n')
+	for opcode, m in enumerate(mnemonics):
+		if m != 'unknown':
+			gen_file.write(f'\tOP_{m} = 0x{opcode:02X},\n')
+	gen_file.write(f'\tNUM_OPCODES = 0x{num_opcodes:02X}\n')
+	gen_file.write('};\n\n')
+	gen_file.write('static const char *instr_names[NUM_OPCODES] = {\n')
 	for m in mnemonics:
 		gen_file.write('\t"' + m + '",\n')
 	gen_file.write('};\n\n')
+	gen_file.write(f'#define MAX_SUPERINSTRUCTION_LENGTH {max_length}\n')
+	gen_file.write(f'#define NUM_SUPERINSTRUCTIONS {len(superinstructions)}\n\n')
+	gen_file.write('typedef struct superinstruction {\n')
+	gen_file.write('\tuint16_t opcode;\n')
+	gen_file.write('\tuint16_t length;\n')
+	gen_file.write('\tuint16_t instructions[MAX_SUPERINSTRUCTION_LENGTH];\n')
+	gen_file.write('} superinstruction_t;\n\n')
+	gen_file.write('static const superinstruction_t superinstructions[NUM_SUPERINSTRUCTIONS] = {\n')
+	for mnemonic, _, instructions in superinstructions:
+		operands = ', '.join(f'OP_{instruction}' for instruction in instructions)
+		gen_file.write(f'\t{{OP_{mnemonic}, {len(instructions)}, {{{operands}}}}},\n')
+	gen_file.write('};\n\n')
 	gen_file.write(unknown_opcode_function)
 	gen_file.write('\n')
 	for f in function_headers:
@@ -42,7 +89,7 @@ def main():
 	for m in mnemonics:
 		opcode_handle_map.append(f'handle_instr_{m}')
 
-	gen_file.write('\nstatic int (* const instr_table[256])(bc_interpreter_t *interpreter, bool wide) = {\n')
+	gen_file.write('\nstatic int (* const instr_table[NUM_OPCODES])(bc_interpreter_t *interpreter, bool wide) = {\n')
 	for handle in opcode_handle_map:
 		gen_file.write(f'\t{handle},\n')
 	gen_file.write('};')
@@ -6,12 +6,17 @@
 #include <sys/mman.h>
 #include <pthread.h>
 #include <string.h>
+#include <stdatomic.h>
+#include <stdio.h>
 #include "gc.h"
 #include "utils.h"
 
 pthread_mutex_t allocationMutex = PTHREAD_MUTEX_INITIALIZER;
 
 addr_ind_info_t *addrIndInfo = NULL;
+#ifdef DIRECT_REFERENCES
+void *referenceBase = NULL;
+#endif
 
 void *eden, *young1, *young2, *old, *endHeap;
 size_t edenSize = 0;
@@ -20,13 +25,34 @@ size_t oldSize = 0;
 
 bool usingFirstYoung = true;
 size_t edenNextPos = 0;
-size_t youngNextPos = 0;
-size_t oldNextPos = 0;
+// the gc workers copy objects into the active half and the old generation in parallel
+atomic_size_t youngNextPos = 0;
+atomic_size_t oldNextPos = 0;
+
+uint8_t *cardTable = NULL;
+static uint8_t *cards = NULL;
+// for each card of the old generation, the number of 8 byte words from the start of the object covering the first byte
+// of the card to the start of the card
+static uint32_t *cardObjectOffsets = NULL;
 
 bool initHeap() {
+#ifdef DIRECT_REFERENCES
+    // the reference past the end of the heap has to fit in a slot_t too
+    if(maxHeap / 8 >= UINT32_MAX) {
+        printf("Error: The heap can be at most 32 GiB when references are compressed pointers\n");
+        return false;
+    }
+#endif
     eden = mmap(NULL, maxHeap, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
     if(eden == MAP_FAILED)
         return false;
+    cards = mmap(NULL, maxHeap >> CARD_SHIFT, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(cards == MAP_FAILED)
+        return false;
+    cardTable = cards - ((uintptr_t) eden >> CARD_SHIFT);
+#ifdef DIRECT_REFERENCES
+    referenceBase = eden - 8;
+#endif
     
     edenSize = maxHeap >> 2u;
     youngSize = edenSize >> 1u;
@@ -37,6 +63,10 @@ bool initHeap() {
     old = young2 + youngSize;
     endHeap = old + oldSize;
     
+    cardObjectOffsets = mmap(NULL, (oldSize >> CARD_SHIFT) * sizeof(uint32_t), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(cardObjectOffsets == MAP_FAILED)
+        return false;
+    
     addrIndInfo = createAddressIndirectionInfo();
     if(!addrIndInfo)
         return false;
@@ -45,116 +75,305 @@ bool initHeap() {
 
 void destroyHeap() {
     munmap(eden, maxHeap);
+    munmap(cards, maxHeap >> CARD_SHIFT);
+    munmap(cardObjectOffsets, (oldSize >> CARD_SHIFT) * sizeof(uint32_t));
 }
 
-object_t *allocateObject(class_t *class) {
+/**
+ * Allocates memory in the shared part of eden, running the gc if there isn't enough space left
+ * @param minSize the smallest acceptable amount of memory
+ * @param maxSize the amount of memory wanted
+ * @param size set to the amount of memory allocated which is between minSize and maxSize
+ * @return the memory or NULL if not even minSize bytes could be freed
+ */
+static void *allocateInEden(size_t minSize, size_t maxSize, size_t *size) {
     pthread_mutex_lock(&allocationMutex);
-    if(edenSize - edenNextPos < class->objectSize) {
+    if(edenSize - edenNextPos < minSize) {
+        // the lock is released while waiting for the gc so that other threads can reach a safepoint
+        pthread_mutex_unlock(&allocationMutex);
         // try a minor gc
         requestGC(GC_MODE_MINOR_ONLY);
         savePoint();
-        if(edenSize - edenNextPos < class->objectSize) {
+        pthread_mutex_lock(&allocationMutex);
+        if(edenSize - edenNextPos < minSize) {
+            pthread_mutex_unlock(&allocationMutex);
             // force a full gc
             requestGC(GC_MODE_FORCE_MAJOR);
             savePoint();
-            if(edenSize - edenNextPos < class->objectSize) {
+            pthread_mutex_lock(&allocationMutex);
+            if(edenSize - edenNextPos < minSize) {
                 // We weren't able to get any memory to allocate the object
+                pthread_mutex_unlock(&allocationMutex);
                 return NULL;
             }
         }
     }
     
-    void *obj = eden + edenNextPos;
-    edenNextPos += ALIGN(class->objectSize);
+    *size = MIN(maxSize, edenSize - edenNextPos);
+    void *memory = eden + edenNextPos;
+    edenNextPos += *size;
     
     pthread_mutex_unlock(&allocationMutex);
     
-    memset(obj, 0, class->objectSize);
+    countAllocation(*size);
     
-    return obj;
+    return memory;
 }
 
-object_t *allocateArrayObject(class_t *class, int elementSize, int32_t numElements, bool fillZero) {
-    size_t objectSize = class->objectSize + elementSize * numElements;
-    pthread_mutex_lock(&allocationMutex);
-    if(edenSize - edenNextPos < objectSize) {
-        // try a minor gc
-        requestGC(GC_MODE_MINOR_ONLY);
-        savePoint();
-        if(edenSize - edenNextPos < objectSize) {
-            // force a full gc
-            requestGC(GC_MODE_FORCE_MAJOR);
-            savePoint();
-            if(edenSize - edenNextPos < objectSize) {
-                // We weren't able to get any memory to allocate the object
-                return NULL;
-            }
-        }
+/**
+ * Replaces the allocation buffer of the thread with a new one that has room for the object. The buffer size follows
+ * the allocation rate of the thread so that threads which allocate a lot take the allocation lock less often. Objects
+ * too large for a buffer are allocated directly in eden and leave the buffer alone.
+ * @param jthread
+ * @param size the aligned size of the object
+ * @return the memory for the object or NULL if eden is full even after a gc
+ */
+static void *refillTLAB(jthread_t *jthread, size_t size) {
+    tlab_t *tlab = &jthread->tlab;
+    size_t maxTLABSize = MAX(edenSize / TLAB_MAX_FRACTION, TLAB_MIN_SIZE);
+    size_t tlabSize = ALIGN(MIN(MAX(tlab->allocated / TLAB_REFILL_DIVISOR, TLAB_MIN_SIZE), maxTLABSize));
+    size_t allocatedSize;
+    if(size > tlabSize / 2) {
+        void *obj = allocateInEden(size, size, &allocatedSize);
+        if(obj)
+            tlab->allocated += size;
+        return obj;
     }
     
-    void *obj = eden + edenNextPos;
-    edenNextPos += ALIGN(objectSize);
-    
-    pthread_mutex_unlock(&allocationMutex);
+    // the rest of the old buffer is abandoned. It is at most half of the new buffer size
+    fillGap(tlab->top, tlab->end - tlab->top);
+    void *buffer = allocateInEden(size, tlabSize, &allocatedSize);
+    if(!buffer)
+        return NULL;
+    tlab->allocated += allocatedSize;
+    tlab->top = buffer + size;
+    tlab->end = buffer + allocatedSize;
+    return buffer;
+}
+
+/**
+ * @param jthread the current thread or NULL if it isn't a java thread
+ * @param size
+ * @return memory for an object of the given size or NULL if eden is full even after a gc
+ */
+static void *allocate(jthread_t *jthread, size_t size) {
+    size = ALIGN(size);
+    if(!jthread) {
+        size_t allocatedSize;
+        return allocateInEden(size, size, &allocatedSize);
+    }
     
-    if(fillZero)
+    tlab_t *tlab = &jthread->tlab;
+    if((size_t) (tlab->end - tlab->top) >= size) {
+        void *obj = tlab->top;
+        tlab->top += size;
+        return obj;
+    }
+    return refillTLAB(jthread, size);
+}
+
+object_t *allocateObject(jthread_t *jthread, class_t *class) {
+    object_t *obj = allocate(jthread, class->objectSize);
+    if(obj)
+        memset(obj, 0, class->objectSize);
+    return obj;
+}
+
+object_t *allocateArrayObject(jthread_t *jthread, class_t *class, int elementSize, int32_t numElements, bool fillZero) {
+    size_t objectSize = class->objectSize + elementSize * numElements;
+    object_t *obj = allocate(jthread, objectSize);
+    if(obj && fillZero)
         memset(obj, 0, objectSize);
-    
     return obj;
 }
 
+void retireTLAB(jthread_t *jthread) {
+    tlab_t *tlab = &jthread->tlab;
+    fillGap(tlab->top, tlab->end - tlab->top);
+    tlab->top = NULL;
+    tlab->end = NULL;
+    // older allocations count less so the buffer size follows changes in the allocation rate
+    tlab->allocated /= 2;
+}
+
 void switchActiveHalf() {
     usingFirstYoung = !usingFirstYoung;
     youngNextPos = 0;
 }
 
+void emptyEden() {
+    edenNextPos = 0;
+}
+
+size_t getEdenSize() {
+    return edenSize;
+}
+
+size_t getFreeEdenSpace() {
+    return edenSize - edenNextPos;
+}
+
+size_t getObjectSize(object_t *obj) {
+    if(IS_FILLER(obj))
+        return (uintptr_t) obj->class & ~(uintptr_t) 1u;
+    size_t objectSize = obj->class->objectSize;
+    if(isArrayClass(obj->class))
+        objectSize += ARRAY_LENGTH(obj) * arrayElementSize(obj->class);
+    return ALIGN(objectSize);
+}
+
+void fillGap(void *start, size_t size) {
+    if(size)
+        *(uintptr_t *) start = size | 1u;
+}
+
+bool isInYoungFromSpace(void *address) {
+    if(address >= eden && address < eden + edenSize)
+        return true;
+    void *fromSpace = usingFirstYoung ? young2 : young1;
+    return address >= fromSpace && address < fromSpace + youngSize;
+}
+
+bool isInYoungGeneration(void *address) {
+    return address >= eden && address < old;
+}
+
 bool isInYoungHeap(object_t *obj) {
     size_t objectSize = obj->class->objectSize;
     if(obj->class->name[0] == '[')
-        objectSize += obj->length * arrayElementSize(obj->class);
+        objectSize += ARRAY_LENGTH(obj) * arrayElementSize(obj->class);
     return (void *) obj >= young1 && (void *) obj + objectSize < old;
 }
 
 bool isInOldHeap(object_t *obj) {
     size_t objectSize = obj->class->objectSize;
     if(obj->class->name[0] == '[')
-        objectSize += obj->length * arrayElementSize(obj->class);
+        objectSize += ARRAY_LENGTH(obj) * arrayElementSize(obj->class);
     return (void *) obj >= old && (void *) obj + objectSize < endHeap;
 }
 
 bool isInHeap(object_t *obj) {
     size_t objectSize = obj->class->objectSize;
     if(obj->class->name[0] == '[')
-        objectSize += obj->length * arrayElementSize(obj->class);
+        objectSize += ARRAY_LENGTH(obj) * arrayElementSize(obj->class);
     return (void *) obj >= eden  && (void *) obj + objectSize < endHeap;
 }
 
+void *allocateInActiveHalf(size_t minSize, size_t maxSize, size_t *size) {
+    void *activeHalf = usingFirstYoung ? young1 : young2;
+    size_t pos = atomic_load_explicit(&youngNextPos, memory_order_relaxed);
+    do {
+        if(youngSize - pos < minSize)
+            return NULL;
+        *size = MIN(maxSize, youngSize - pos);
+    } while(!atomic_compare_exchange_weak_explicit(&youngNextPos, &pos, pos + *size, memory_order_relaxed, memory_order_relaxed));
+    return activeHalf + pos;
+}
+
+void *allocateInOldGeneration(size_t size) {
+    size_t pos = atomic_load_explicit(&oldNextPos, memory_order_relaxed);
+    do {
+        if(oldSize - pos < size)
+            return NULL;
+    } while(!atomic_compare_exchange_weak_explicit(&oldNextPos, &pos, pos + size, memory_order_relaxed, memory_order_relaxed));
+    recordOldObject(old + pos, size);
+    return old + pos;
+}
+
+size_t getOldGenerationTop() {
+    return oldNextPos;
+}
+
+void setOldGenerationTop(size_t top) {
+    oldNextPos = top;
+    dirtyCards(old, top);
+    size_t firstCleanCard = (top + CARD_SIZE - 1) >> CARD_SHIFT;
+    memset(cardTable + ((uintptr_t) old >> CARD_SHIFT) + firstCleanCard, CARD_CLEAN, (oldSize >> CARD_SHIFT) - firstCleanCard);
+}
+
+void recordOldObject(void *obj, size_t size) {
+    // the cards which start inside the object
+    size_t firstCard = (obj - old + CARD_SIZE - 1) >> CARD_SHIFT;
+    size_t endCard = (obj + size - old + CARD_SIZE - 1) >> CARD_SHIFT;
+    for(size_t card = firstCard; card < endCard; ++card)
+        cardObjectOffsets[card] = (old + (card << CARD_SHIFT) - obj) / 8;
+}
+
+void dirtyCards(void *start, size_t size) {
+    if(!size)
+        return;
+    size_t firstCard = (uintptr_t) start >> CARD_SHIFT;
+    size_t lastCard = ((uintptr_t) start + size - 1) >> CARD_SHIFT;
+    memset(cardTable + firstCard, CARD_DIRTY, lastCard - firstCard + 1);
+}
+
+void *getOldGeneration() {
+    return old;
+}
+
+size_t getFreeOldSpace() {
+    return oldSize - oldNextPos;
+}
+
+size_t getUsedYoungSpace() {
+    return edenNextPos + youngNextPos;
+}
+
+void visitDirtyCards(size_t firstCard, size_t endCard, size_t end, void (*visitor)(object_t *obj, void *start, void *end, void *arg), void *arg) {
+    uint8_t *oldCards = cardTable + ((uintptr_t) old >> CARD_SHIFT);
+    for(size_t card = firstCard; card < endCard; ++card) {
+        if(oldCards[card] == CARD_CLEAN)
+            continue;
+        oldCards[card] = CARD_CLEAN;
+        void *cardStart = old + (card << CARD_SHIFT);
+        void *cardEnd = MIN(cardStart + CARD_SIZE, old + end);
+        // the first object might start on an earlier card
+        void *pos = cardStart - (size_t) cardObjectOffsets[card] * 8;
+        while(pos < cardEnd) {
+            object_t *obj = pos;
+            pos += getObjectSize(obj);
+            visitor(obj, cardStart, cardEnd, arg);
+        }
+    }
+}
+
+/**
+ * Calls the visitor with every object between start and end which isn't a filler
+ * @param start
+ * @param end
+ * @param visitor
+ * @param arg
+ */
+static void visitObjects(void *start, void *end, void (*visitor)(object_t *obj, void *arg), void *arg) {
+    void *pos = start;
+    while(pos < end) {
+        object_t *obj = pos;
+        pos += getObjectSize(obj);
+        if(!IS_FILLER(obj))
+            visitor(obj, arg);
+    }
+}
+
+void visitYoungObjects(void (*visitor)(object_t *obj, void *arg), void *arg) {
+    visitObjects(eden, eden + edenNextPos, visitor, arg);
+    void *activeHalf = usingFirstYoung ? young1 : young2;
+    visitObjects(activeHalf, activeHalf + youngNextPos, visitor, arg);
+}
+
 /**
  *
  * @param obj
  * @return the new pointer to the object or the old one if it didn't change
  */
 object_t *moveToActiveHalf(object_t *obj) {
-    size_t objSize = obj->class->objectSize;
-    if(isArrayClass(obj->class))
-        objSize += obj->length * arrayElementSize(obj->class);
-    object_t *newObjPointer = obj;
-    
-    if(usingFirstYoung) {
-        if((void *) obj + objSize < young1 || (void *) obj >= young2) {
-            newObjPointer = young1 + youngNextPos;
-            memcpy(newObjPointer, obj, objSize);
-            youngNextPos += objSize;
-        }
-    }
-    else {
-        if((void *) obj + objSize < young2 || (void *) obj >= old) {
-            newObjPointer = young2 + youngNextPos;
-            memcpy(newObjPointer, obj, objSize);
-            youngNextPos += objSize;
-        }
-    }
-    
+    if(!isInYoungFromSpace(obj))
+        return obj;
+    size_t objSize = getObjectSize(obj);
+    size_t allocatedSize;
+    object_t *newObjPointer = allocateInActiveHalf(objSize, objSize, &allocatedSize);
+    if(!newObjPointer)
+        return obj;
+    memcpy(newObjPointer, obj, objSize);
     return newObjPointer;
 }
 
@@ -164,22 +383,13 @@ object_t *moveToActiveHalf(object_t *obj) {
  * @return the new pointer to the object or the old one if it didn't change
  */
 object_t *moveToOldGeneration(object_t *obj) {
-    size_t objSize = obj->class->objectSize;
-    if(isArrayClass(obj->class))
-        objSize += obj->length * arrayElementSize(obj->class);
-    object_t *newObjPointer = obj;
-    
-    if(!isInOldHeap(obj)) {
-        if(oldSize - oldNextPos >= objSize) {
-            newObjPointer = old + oldNextPos;
-            memcpy(newObjPointer, obj, objSize);
-            oldNextPos += objSize;
-        }
-        else {
-            // TODO
-            // There isn't enough room in the old generation. Is it full? Do we need to GC it?
-        }
-    }
-    
+    if((void *) obj >= old && (void *) obj < endHeap)
+        return obj;
+    size_t objSize = getObjectSize(obj);
+    object_t *newObjPointer = allocateInOldGeneration(objSize);
+    // There isn't enough room in the old generation until it's compacted by the next old gc
+    if(!newObjPointer)
+        return obj;
+    memcpy(newObjPointer, obj, objSize);
     return newObjPointer;
-}
\ No newline at end of file
+}
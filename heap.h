@@ -9,21 +9,193 @@
 #include "object.h"
 #include "jvmSettings.h"
 #include "indirection.h"
+#include "jthread.h"
+
+// smallest thread local allocation buffer handed to a thread
+#ifndef TLAB_MIN_SIZE
+#define TLAB_MIN_SIZE KIBIBYTES((size_t) 4)
+#endif
+// a thread gets buffers of 1/TLAB_REFILL_DIVISOR of what it recently allocated
+#ifndef TLAB_REFILL_DIVISOR
+#define TLAB_REFILL_DIVISOR 8
+#endif
+// no buffer is larger than 1/TLAB_MAX_FRACTION of eden
+#ifndef TLAB_MAX_FRACTION
+#define TLAB_MAX_FRACTION 64
+#endif
+
+// each card covers 2^CARD_SHIFT bytes of the heap
+#ifndef CARD_SHIFT
+#define CARD_SHIFT 9
+#endif
+#define CARD_SIZE ((size_t) 1 << CARD_SHIFT)
+
+#define CARD_CLEAN 0
+#define CARD_DIRTY 1
 
 extern addr_ind_info_t *addrIndInfo;
+#ifdef DIRECT_REFERENCES
+// references hold the distance of an object from referenceBase in 8 byte words, which covers heaps of up to 32 GiB. The
+// base is 8 bytes before the heap so that no object has the reference 0
+extern void *referenceBase;
+#endif
+// one byte for each card of the heap, indexed by the address shifted right by CARD_SHIFT rather than by the offset
+// into the heap, so marking a card takes a single shift
+extern uint8_t *cardTable;
+
+/**
+ * Dirties the card of a reference field or array element a reference is stored into. The young gc only scans
+ * the old objects on dirty cards for references to young objects
+ * @param field
+ */
+#define MARK_CARD(field) (cardTable[(uintptr_t) (field) >> CARD_SHIFT] = CARD_DIRTY)
 
 bool initHeap();
 
 void destroyHeap();
 
-object_t *allocateObject(class_t *class);
-object_t *allocateArrayObject(class_t *class, int elementSize, int32_t numElements, bool fillZero);
+/**
+ * Allocates a zeroed object. Java threads allocate from their own part of eden without locking
+ * @param jthread the current thread or NULL if it isn't a java thread
+ * @param class
+ * @return the object or NULL if eden is full even after a gc
+ */
+object_t *allocateObject(jthread_t *jthread, class_t *class);
+object_t *allocateArrayObject(jthread_t *jthread, class_t *class, int elementSize, int32_t numElements, bool fillZero);
+
+/**
+ * Drops the allocation buffer of a thread since the young gc empties eden. The unused part of the buffer is filled so
+ * that eden can be walked. Must be called while the thread is stopped for a gc
+ * @param jthread
+ */
+void retireTLAB(jthread_t *jthread);
+/**
+ * Swaps the survivor halves. The objects in the previously active half are copied out of it by the next young gc
+ */
 void switchActiveHalf();
 
+/**
+ * Frees the whole eden space once the young gc copied every live object out of it
+ */
+void emptyEden();
+
+size_t getEdenSize();
+
+/**
+ * @return the number of bytes which can still be allocated in the eden space
+ */
+size_t getFreeEdenSpace();
+
+/**
+ * @param obj
+ * @return the aligned size the object takes up in the heap
+ */
+size_t getObjectSize(object_t *obj);
+
+/**
+ * Whether the memory is a filler rather than an object. The first word of a filler holds its size with the lowest bit
+ * set where an object holds its class, so fillers can be as small as 8 bytes
+ */
+#define IS_FILLER(obj) ((uintptr_t) ((object_t *) (obj))->class & 1u)
+
+/**
+ * Puts a filler into memory no object uses, so that the objects after it can still be found by walking the heap
+ * @param start
+ * @param size a multiple of 8 bytes, which may be 0
+ */
+void fillGap(void *start, size_t size);
+
+/**
+ * @param address
+ * @return true if the address is in the eden space or the inactive survivor half, which the young gc empties
+ */
+bool isInYoungFromSpace(void *address);
+
+/**
+ * @param address
+ * @return true if the address is in the eden space or either survivor half
+ */
+bool isInYoungGeneration(void *address);
+
 bool isInYoungHeap(object_t *obj);
 bool isInOldHeap(object_t *obj);
 bool isInHeap(object_t *obj);
 
+/**
+ * Allocates memory in the active survivor half. Safe to call from several gc workers at once
+ * @param minSize the smallest acceptable amount of memory
+ * @param maxSize the amount of memory wanted
+ * @param size set to the amount of memory allocated which is between minSize and maxSize
+ * @return the memory or NULL if less than minSize bytes are left
+ */
+void *allocateInActiveHalf(size_t minSize, size_t maxSize, size_t *size);
+
+/**
+ * Allocates memory in the old generation. Safe to call from several gc workers at once
+ * @param size
+ * @return the memory or NULL if the old generation is full
+ */
+void *allocateInOldGeneration(size_t size);
+
+/**
+ * @return the offset of the end of the last object in the old generation
+ */
+size_t getOldGenerationTop();
+
+/**
+ * Frees everything in the old generation past the offset once the old gc moved the live objects before it. The cards
+ * before it are dirtied since the moved objects might hold references to young objects on any of them
+ * @param top
+ */
+void setOldGenerationTop(size_t top);
+
+/**
+ * Records where an object starts for the cards of the old generation it covers, so that the objects on a card can be
+ * found. Objects allocated with allocateInOldGeneration are recorded already; this is for objects the old gc moves
+ * @param obj
+ * @param size
+ */
+void recordOldObject(void *obj, size_t size);
+
+/**
+ * Dirties every card the memory overlaps
+ * @param start
+ * @param size
+ */
+void dirtyCards(void *start, size_t size);
+
+void *getOldGeneration();
+
+/**
+ * @return the number of bytes which can still be allocated in the old generation
+ */
+size_t getFreeOldSpace();
+
+/**
+ * @return the number of bytes allocated in the eden space and the active survivor half, which is the most the next
+ * young gc can move into the old generation
+ */
+size_t getUsedYoungSpace();
+
+/**
+ * Cleans the dirty cards in a range of cards of the old generation and calls the visitor with every object on them,
+ * including dead ones. The visitor dirties the card again if it should still be scanned by the next young gc
+ * @param firstCard the index of the first card, counted from the start of the old generation
+ * @param endCard the index past the last card
+ * @param end only objects before this offset are visited
+ * @param visitor called with the object and the part of the card it's visited for
+ * @param arg passed through to the visitor
+ */
+void visitDirtyCards(size_t firstCard, size_t endCard, size_t end, void (*visitor)(object_t *obj, void *start, void *end, void *arg), void *arg);
+
+/**
+ * Calls the visitor with every object in the eden space and the active survivor half, including dead ones. The unused
+ * parts of allocation buffers must have been filled with fillGap
+ * @param visitor
+ * @param arg passed through to the visitor
+ */
+void visitYoungObjects(void (*visitor)(object_t *obj, void *arg), void *arg);
+
 /**
  *
  * @param obj
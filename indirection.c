@@ -2,13 +2,13 @@
 #include "indirection_impl.h"
 #include "garbage_collection.h"
 #include <stdlib.h>
+#include <stdbool.h>
 #include <pthread.h>
 #include <unistd.h>
 #include <sys/mman.h>
 
 inline void * getRawAddress(addr_ind_info_t * addrInfo, slot_t slot) {
-    if(!addrInfo || slot >= maxNumAddresses(addrInfo))
-        return NULL;
+    // every slot handed out is accessible since the table only grows, and slot 0 is always NULL
     return addrInfo->addressTable[slot];
 }
 
@@ -18,23 +18,34 @@ inline void setRawAddress(addr_ind_info_t * addrInfo, slot_t slot, void * addres
     addrInfo->addressTable[slot] = address;
 }
 
+/**
+ * @return the size of the address space reserved for the address table
+ */
+static size_t reservedTableSize() {
+    return (MAX_NUM_ADDRESSES * sizeof(void *) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+}
+
 addr_ind_info_t * createAddressIndirectionInfo() {
     addr_ind_info_t * addrInfo = malloc(sizeof(addr_ind_info_t));
     if(addrInfo == NULL)
         return NULL;
 
-    addrInfo->addressTable = mmap(NULL, PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    // only address space is reserved until pages are made accessible
+    addrInfo->addressTable = mmap(NULL, reservedTableSize(), PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
     if(addrInfo->addressTable == MAP_FAILED) {
         free(addrInfo);
         return NULL;
     }
-    addrInfo->freeSlot = NULL;
-    addrInfo->numFragmentedFree = 0;
-    addrInfo->numPages = 1;
-    addrInfo->numAddresses = 1;
+    if(mprotect(addrInfo->addressTable, ADDRESS_TABLE_COMMIT_PAGES * PAGE_SIZE, PROT_READ | PROT_WRITE)) {
+        munmap(addrInfo->addressTable, reservedTableSize());
+        free(addrInfo);
+        return NULL;
+    }
+    atomic_init(&addrInfo->freeList, 0);
+    atomic_init(&addrInfo->numPages, ADDRESS_TABLE_COMMIT_PAGES);
+    atomic_init(&addrInfo->numAddresses, 1);
     addrInfo->addressTable[0] = NULL;
     
-    pthread_mutex_init(&addrInfo->freeListMutex, NULL);
     pthread_mutex_init(&addrInfo->slotAllocationMutex, NULL);
 
     return addrInfo;
@@ -43,15 +54,8 @@ addr_ind_info_t * createAddressIndirectionInfo() {
 void destroyAndFreeAddressIndirectionInfo(addr_ind_info_t * addrInfo) {
     if(!addrInfo)
         return;
-    pthread_mutex_destroy(&addrInfo->freeListMutex);
     pthread_mutex_destroy(&addrInfo->slotAllocationMutex);
-    munmap(addrInfo->addressTable, addrInfo->numPages * PAGE_SIZE);
-    free_slot_t * freeSlot = addrInfo->freeSlot;
-    while(freeSlot) {
-        free_slot_t * temp = freeSlot;
-        freeSlot = freeSlot->next;
-        free(temp);
-    }
+    munmap(addrInfo->addressTable, reservedTableSize());
     free(addrInfo);
 }
 
@@ -63,151 +67,156 @@ void destroyAndFreeAddressIndirectionInfo(addr_ind_info_t * addrInfo) {
 size_t maxNumAddresses(addr_ind_info_t * addrInfo) {
     if(!addrInfo)
         return 0;
-    return addrInfo->numPages * ADDR_PER_PAGE;
+    return atomic_load_explicit(&addrInfo->numPages, memory_order_acquire) * ADDR_PER_PAGE;
+}
+
+static inline _Atomic(void *) * getEntry(addr_ind_info_t * addrInfo, slot_t slot) {
+    return (_Atomic(void *) *) addrInfo->addressTable + slot;
 }
 
 /**
- *
+ * Grows the address table until it has room for the given number of addresses by making more of the reserved address
+ * space accessible. Existing entries never move, so other threads can keep using the table while it grows
  * @param addrInfo
- * @return if 0 is returned, then no slot was allocated. This indicates a failure to expand the indirection mapping or that we ran out of slots
+ * @param numAddresses
+ * @return false if the address table couldn't be expanded
  */
-slot_t allocateSlot(addr_ind_info_t * addrInfo) {
-    if(!addrInfo || addrInfo->numAddresses == ((size_t) 1 << sizeof(slot_t)) - 1)
-        return 0;
-
-    pthread_mutex_lock(&addrInfo->freeListMutex);
-    if(addrInfo->freeSlot != NULL) {
-        --addrInfo->numFragmentedFree;
-        free_slot_t * freeSlot = addrInfo->freeSlot;
-        addrInfo->freeSlot = freeSlot->next;
-        pthread_mutex_unlock(&addrInfo->freeListMutex);
-        slot_t slot = freeSlot->slot;
-        free(freeSlot);
-        // prevent automatic freeing
-        addrInfo->addressTable[slot] = (void *) -1;
-        return slot;
-    }
-    pthread_mutex_unlock(&addrInfo->freeListMutex);
+static bool growAddressTable(addr_ind_info_t * addrInfo, size_t numAddresses) {
+    bool grown = true;
     pthread_mutex_lock(&addrInfo->slotAllocationMutex);
-    if(addrInfo->numAddresses == maxNumAddresses(addrInfo)) {
-        size_t size = addrInfo->numPages * PAGE_SIZE;
-        void ** newAddressTable = mremap(addrInfo->addressTable, size, size + PAGE_SIZE, MREMAP_MAYMOVE);
-        if(newAddressTable == MAP_FAILED)
-            return 0;
-        addrInfo->addressTable = newAddressTable;
-        ++addrInfo->numPages;
+    size_t numPages = atomic_load_explicit(&addrInfo->numPages, memory_order_relaxed);
+    if(numPages * ADDR_PER_PAGE < numAddresses) {
+        size_t newNumPages = (numAddresses + ADDR_PER_PAGE - 1) / ADDR_PER_PAGE;
+        newNumPages = (newNumPages + ADDRESS_TABLE_COMMIT_PAGES - 1) / ADDRESS_TABLE_COMMIT_PAGES * ADDRESS_TABLE_COMMIT_PAGES;
+        if(newNumPages * PAGE_SIZE > reservedTableSize())
+            newNumPages = reservedTableSize() / PAGE_SIZE;
+        grown = !mprotect(addrInfo->addressTable + numPages * ADDR_PER_PAGE, (newNumPages - numPages) * PAGE_SIZE, PROT_READ | PROT_WRITE);
+        // threads which see the new size can use the new entries
+        if(grown)
+            atomic_store_explicit(&addrInfo->numPages, newNumPages, memory_order_release);
     }
-    slot_t slot = addrInfo->numAddresses++;
-    // prevent automatic freeing
-    addrInfo->addressTable[slot] = (void *) -1;
     pthread_mutex_unlock(&addrInfo->slotAllocationMutex);
-    return slot;
+    return grown;
 }
 
 /**
- *
+ * Pops up to maxSlots slots off the free list with a single compare exchange
  * @param addrInfo
- * @param slot
- * @return returns -1 if it failed to append the slot to a free list, otherwise returns 0
- * Even if freeSlot returns -1, the slot no longer points to a valid address
+ * @param slots
+ * @param maxSlots
+ * @return the number of slots popped
  */
-int freeSlot(addr_ind_info_t * addrInfo, slot_t slot) {
-    if(!addrInfo)
-        return 0;
-    if(slot == 0)
-        return 0;
-    setRawAddress(addrInfo, slot, NULL);
-    pthread_mutex_lock(&addrInfo->slotAllocationMutex);
-    if(slot + 1 == addrInfo->numAddresses) {
-        --addrInfo->numAddresses;
-        pthread_mutex_unlock(&addrInfo->slotAllocationMutex);
-        return 0;
+static uint32_t popFreeSlots(addr_ind_info_t * addrInfo, slot_t * slots, uint32_t maxSlots) {
+    uint64_t head = atomic_load_explicit(&addrInfo->freeList, memory_order_acquire);
+    while((slot_t) head) {
+        slot_t slot = (slot_t) head;
+        uint32_t numSlots = 0;
+        // The slots might be popped by another thread while following the list, in which case their entries are no
+        // longer free. The head changed in that case, so the compare exchange fails and the slots are never used
+        while(slot && numSlots < maxSlots && slot < addrInfo->numAddresses) {
+            void * entry = atomic_load_explicit(getEntry(addrInfo, slot), memory_order_relaxed);
+            if(!IS_FREE_ENTRY(entry))
+                break;
+            slots[numSlots++] = slot;
+            slot = FREE_ENTRY_NEXT(entry);
+        }
+        uint64_t newHead = ((head >> 32u) + 1) << 32u | slot;
+        if(atomic_compare_exchange_weak_explicit(&addrInfo->freeList, &head, newHead, memory_order_acquire, memory_order_acquire))
+            return numSlots;
     }
-    ++addrInfo->numFragmentedFree;
-    pthread_mutex_unlock(&addrInfo->slotAllocationMutex);
-    free_slot_t * freeSlot = malloc(sizeof(free_slot_t));
-    if(freeSlot == NULL)
-        return -1;
-    freeSlot->slot = slot;
-    pthread_mutex_lock(&addrInfo->freeListMutex);
-    freeSlot->next = addrInfo->freeSlot;
-    addrInfo->freeSlot = freeSlot;
-    pthread_mutex_unlock(&addrInfo->freeListMutex);
     return 0;
 }
 
+void freeSlotList(addr_ind_info_t * addrInfo, slot_t first, slot_t last) {
+    uint64_t head = atomic_load_explicit(&addrInfo->freeList, memory_order_relaxed);
+    do {
+        atomic_store_explicit(getEntry(addrInfo, last), FREE_ENTRY((slot_t) head), memory_order_relaxed);
+    } while(!atomic_compare_exchange_weak_explicit(&addrInfo->freeList, &head, ((head >> 32u) + 1) << 32u | first, memory_order_release, memory_order_relaxed));
+}
+
 /**
- * This function cleans up the free list and returns any extra pages to the OS
+ * Takes slots which were never used from the end of the address table
  * @param addrInfo
+ * @param slots
+ * @param maxSlots
+ * @return the number of slots taken. If 0 is returned, the address table couldn't be expanded or we ran out of slots
  */
-void rebuildFreeList(addr_ind_info_t * addrInfo) {
-    pthread_mutex_lock(&addrInfo->freeListMutex);
-    pthread_mutex_lock(&addrInfo->slotAllocationMutex);
-
-    // trim free slots at the end of the addressTable
-    while(addrInfo->addressTable[addrInfo->numAddresses - 1] == NULL && addrInfo->numAddresses > 1)
-        --addrInfo->numAddresses;
-
-    // release unneeded pages
-    size_t tableSize = addrInfo->numPages * PAGE_SIZE;
-    size_t newSize = (addrInfo->numAddresses * sizeof(void *) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
-    if(newSize < tableSize)
-        mremap(addrInfo->addressTable, tableSize, newSize, 0);
-
-    // rebuild free list
-    slot_t curSlot = 1;
-    free_slot_t * prevSlot = NULL;
-    free_slot_t * freeSlot = addrInfo->freeSlot;
-    size_t numFragmentedFree = 0;
-    while(freeSlot) {
-        while(curSlot < addrInfo->numAddresses && addrInfo->addressTable[curSlot])
-            ++curSlot;
+static uint32_t takeNewSlots(addr_ind_info_t * addrInfo, slot_t * slots, uint32_t maxSlots) {
+    size_t numAddresses = atomic_load_explicit(&addrInfo->numAddresses, memory_order_relaxed);
+    size_t numSlots;
+    do {
+        size_t numLeft = MAX_NUM_ADDRESSES - numAddresses;
+        numSlots = numLeft < maxSlots ? numLeft : maxSlots;
+        if(numSlots == 0)
+            return 0;
+        if(numAddresses + numSlots > maxNumAddresses(addrInfo) && !growAddressTable(addrInfo, numAddresses + numSlots))
+            return 0;
+    } while(!atomic_compare_exchange_weak_explicit(&addrInfo->numAddresses, &numAddresses, numAddresses + numSlots, memory_order_relaxed, memory_order_relaxed));
+    // slot caches hand out slots from the end, so they're stored in reverse to be handed out in order
+    for(size_t i = 0; i < numSlots; ++i)
+        slots[i] = numAddresses + numSlots - 1 - i;
+    return numSlots;
+}
 
-        if(curSlot < addrInfo->numAddresses) {
-            freeSlot->slot = curSlot;
-            prevSlot = freeSlot;
-            freeSlot = freeSlot->next;
-            ++numFragmentedFree;
-        }
-        else {
-            if(prevSlot)
-                prevSlot->next = NULL;
-            else // this should never happen, but might as well take care of it anyway
-                addrInfo->freeSlot = NULL;
+/**
+ * Takes slots from the free list, or from the end of the address table if the free list is empty
+ * @param addrInfo
+ * @param slots
+ * @param maxSlots
+ * @return the number of slots taken
+ */
+static uint32_t takeSlots(addr_ind_info_t * addrInfo, slot_t * slots, uint32_t maxSlots) {
+    uint32_t numSlots = popFreeSlots(addrInfo, slots, maxSlots);
+    if(!numSlots)
+        numSlots = takeNewSlots(addrInfo, slots, maxSlots);
+    // prevent automatic freeing
+    for(uint32_t i = 0; i < numSlots; ++i)
+        atomic_store_explicit(getEntry(addrInfo, slots[i]), RESERVED_ENTRY, memory_order_relaxed);
+    return numSlots;
+}
 
-            // free the extra free_slot_t instances
-            while(freeSlot) {
-                free_slot_t * temp = freeSlot;
-                freeSlot = freeSlot->next;
-                free(temp);
-            }
-        }
+/**
+ *
+ * @param addrInfo
+ * @param cache the slot cache of the current thread or NULL if it doesn't have one
+ * @return if 0 is returned, then no slot was allocated. This indicates a failure to expand the indirection mapping or that we ran out of slots
+ */
+slot_t allocateSlot(addr_ind_info_t * addrInfo, slot_cache_t * cache) {
+    if(!addrInfo)
+        return 0;
+    
+    if(!cache) {
+        slot_t slot;
+        return takeSlots(addrInfo, &slot, 1) ? slot : 0;
     }
-
-    // Maybe we ran out of free blocks before finishing rebuilding the free list
-    while(curSlot < addrInfo->numAddresses) {
-        if(addrInfo->addressTable[curSlot]) {
-            ++curSlot;
-        }
-        else {
-            freeSlot = malloc(sizeof(free_slot_t));
-            if(!freeSlot) {
-                // Oh well, some items aren't in the free list because we couldn't allocate memory
-                break;
-            }
-            else {
-                freeSlot->slot = curSlot;
-                freeSlot->next = addrInfo->freeSlot;
-                addrInfo->freeSlot = freeSlot;
-                ++numFragmentedFree;
-            }
-        }
+    if(!cache->numSlots) {
+        cache->numSlots = takeSlots(addrInfo, cache->slots, SLOT_CACHE_SIZE);
+        if(!cache->numSlots)
+            return 0;
     }
-    
-    addrInfo->numFragmentedFree = numFragmentedFree;
+    return cache->slots[--cache->numSlots];
+}
 
-    pthread_mutex_unlock(&addrInfo->slotAllocationMutex);
-    pthread_mutex_unlock(&addrInfo->freeListMutex);
+/**
+ *
+ * @param addrInfo
+ * @param slot
+ */
+void freeSlot(addr_ind_info_t * addrInfo, slot_t slot) {
+    if(!addrInfo)
+        return;
+    if(slot == 0)
+        return;
+    freeSlotList(addrInfo, slot, slot);
+}
+
+void releaseSlotCache(addr_ind_info_t * addrInfo, slot_cache_t * cache) {
+    if(!addrInfo || !cache->numSlots)
+        return;
+    for(uint32_t i = 0; i + 1 < cache->numSlots; ++i)
+        atomic_store_explicit(getEntry(addrInfo, cache->slots[i]), FREE_ENTRY(cache->slots[i + 1]), memory_order_relaxed);
+    freeSlotList(addrInfo, cache->slots[0], cache->slots[cache->numSlots - 1]);
+    cache->numSlots = 0;
 }
 
 /**
@@ -221,52 +230,39 @@ compact_res_t * compactAddressTable(addr_ind_info_t * addrInfo) {
     if(!addrInfo)
         return NULL;
     
-    size_t numFragmentedFree = addrInfo->numFragmentedFree;
     // Move allocations at the end of the table to the front
     compact_res_t * compactionResult = NULL;
     void ** addressTable = addrInfo->addressTable;
     slot_t start = 1;
     slot_t end = addrInfo->numAddresses - 1;
     while(1) {
-        while(start < end && addressTable[start] != NULL)
+        while(start < end && !IS_FREE_ENTRY(addressTable[start]))
             ++start;
-        while(start < end && addressTable[end] == NULL) {
+        while(start < end && IS_FREE_ENTRY(addressTable[end]))
             --end;
-            --numFragmentedFree;
-        }
-        if(start < end && addressTable[start] == NULL && addressTable[end] != NULL) {
+        if(start < end && IS_FREE_ENTRY(addressTable[start]) && !IS_FREE_ENTRY(addressTable[end])) {
             compact_res_t * newResult = malloc(sizeof(compact_res_t));
             if(newResult == NULL)
                 break;
             addressTable[start] = addressTable[end];
-            addressTable[end] = NULL;
             newResult->next = compactionResult;
             newResult->oldSlot = end;
             newResult->newSlot = start;
             compactionResult = newResult;
             addrInfo->numAddresses = end;
-            --numFragmentedFree;
         }
         else
             break;
     }
     
-    addrInfo->numFragmentedFree = numFragmentedFree;
-
-    // release unneeded pages
+    // release unneeded pages. They stay accessible and are filled with zeros again when they're used
     size_t tableSize = addrInfo->numPages * PAGE_SIZE;
     size_t newSize = (addrInfo->numAddresses * sizeof(void *) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
     if(newSize < tableSize)
-        mremap(addressTable, tableSize, newSize, 0);
+        madvise((void *) addressTable + newSize, tableSize - newSize, MADV_DONTNEED);
 
-    // free the free list since everything is compacted (unless a compact_res_t failed to malloc)
-    free_slot_t * freeSlot = addrInfo->freeSlot;
-    addrInfo->freeSlot = NULL;
-    while(freeSlot != NULL) {
-        free_slot_t * temp = freeSlot;
-        freeSlot = freeSlot->next;
-        free(temp);
-    }
+    // empty the free list since everything is compacted (unless a compact_res_t failed to malloc)
+    addrInfo->freeList = ((addrInfo->freeList >> 32u) + 1) << 32u;
 
     return compactionResult;
 }
\ No newline at end of file
@@ -6,6 +6,20 @@
 
 typedef struct AddressIndirectionInfo addr_ind_info_t;
 
+// number of slots a thread takes from the address table at a time
+#ifndef SLOT_CACHE_SIZE
+#define SLOT_CACHE_SIZE 64
+#endif
+
+/**
+ * Slots a thread took from the address table in a batch, which it hands out to its objects without synchronizing with
+ * other threads
+ */
+typedef struct SlotCache {
+    slot_t slots[SLOT_CACHE_SIZE];
+    uint32_t numSlots;
+} slot_cache_t;
+
 void * getRawAddress(addr_ind_info_t * addrInfo, slot_t slot);
 void setRawAddress(addr_ind_info_t * addrInfo, slot_t slot, void * address);
 
@@ -14,19 +28,25 @@ addr_ind_info_t * createAddressIndirectionInfo();
 void destroyAndFreeAddressIndirectionInfo(addr_ind_info_t * addrInfo);
 
 /**
- *
+ * Never blocks unless the address table has to grow
  * @param addrInfo
+ * @param cache the slot cache of the current thread or NULL if it doesn't have one
  * @return if 0 is returned, then no slot was allocated
  */
-slot_t allocateSlot(addr_ind_info_t * addrInfo);
+slot_t allocateSlot(addr_ind_info_t * addrInfo, slot_cache_t * cache);
 
 /**
  *
  * @param addrInfo
  * @param slot
- * @return returns -1 if it failed to append the slot to a free list, otherwise returns 0
- * Even if freeSlot does return -1, the slot no longer points to a valid address
  */
-int freeSlot(addr_ind_info_t * addrInfo, slot_t slot);
+void freeSlot(addr_ind_info_t * addrInfo, slot_t slot);
+
+/**
+ * Returns the slots in a cache to the free list, which must be done before the thread owning it exits
+ * @param addrInfo
+ * @param cache
+ */
+void releaseSlotCache(addr_ind_info_t * addrInfo, slot_cache_t * cache);
 
 #endif //ADDRESSINDIRECTION_INDRECTION_H
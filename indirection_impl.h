@@ -7,19 +7,33 @@
 
 #define PAGE_SIZE ((size_t) getpagesize())
 #define ADDR_PER_PAGE (PAGE_SIZE / sizeof(void *))
+// slot 0 is never allocated, so this many addresses fit every slot_t
+#define MAX_NUM_ADDRESSES (((size_t) 1 << (sizeof(slot_t) * 8u)) - 1)
+// number of pages of the address table that are made accessible at a time
+#ifndef ADDRESS_TABLE_COMMIT_PAGES
+#define ADDRESS_TABLE_COMMIT_PAGES 16
+#endif
 
-typedef struct FreeSlotNode {
-    struct FreeSlotNode * next;
-    slot_t slot;
-} free_slot_t;
+// entry of a slot which was allocated but whose object isn't set yet
+#define RESERVED_ENTRY ((void *) -1)
+// entries of free slots link the free list. They hold the next free slot tagged with the lowest bit, which is never set
+// in the address of an object
+#define FREE_ENTRY(next) ((void *) ((uintptr_t) (next) << 1u | 1u))
+#define FREE_ENTRY_NEXT(entry) ((slot_t) ((uintptr_t) (entry) >> 1u))
+#define IS_FREE_ENTRY(entry) (((uintptr_t) (entry) & 1u) && (entry) != RESERVED_ENTRY)
+// whether the entry holds the address of an object rather than nothing, a reserved slot, or a free slot
+#define IS_OBJECT_ENTRY(entry) ((entry) && !((uintptr_t) (entry) & 1u))
 
 struct AddressIndirectionInfo {
+	// reserved for MAX_NUM_ADDRESSES addresses up front so that it never moves. Only the first numPages pages are
+	// accessible
 	void ** addressTable;
-	free_slot_t * freeSlot;
-	atomic_size_t numFragmentedFree;
-	size_t numPages;
-	size_t numAddresses;
-	pthread_mutex_t freeListMutex;
+	// the first slot of the free list in the lower 32 bits and a counter in the upper 32 bits which changes whenever the
+	// list does, so a thread can't pop slots off a list which changed since it read the head
+	_Atomic uint64_t freeList;
+	atomic_size_t numPages;
+	atomic_size_t numAddresses;
+	// only taken to make more of the address table accessible
 	pthread_mutex_t slotAllocationMutex;
 };
 
@@ -30,4 +44,13 @@ struct AddressIndirectionInfo {
  */
 size_t maxNumAddresses(addr_ind_info_t * addrInfo);
 
+/**
+ * Adds a list of free slots to the free list at once. The entry of each slot but the last must already be set to
+ * FREE_ENTRY of the next slot in the list
+ * @param addrInfo
+ * @param first
+ * @param last
+ */
+void freeSlotList(addr_ind_info_t * addrInfo, slot_t first, slot_t last);
+
 #endif //ADDRESSINDIRECTION_INDIRECTION_IMPL_H
@@ -0,0 +1,319 @@
+#include "inflate.h"
+#include <string.h>
+
+#define MAX_CODE_LENGTH 15
+// codes of up to this many bits are decoded with a single table lookup, longer ones bit by bit
+#define FAST_BITS 9
+#define NUM_LITERAL_CODES 288
+#define NUM_DISTANCE_CODES 30
+#define NUM_CODE_LENGTH_CODES 19
+#define END_OF_BLOCK 256
+
+typedef struct huffman {
+    // indexed by the next FAST_BITS bits of the stream. Holds the symbol << 4 | the length of its code, or 0 if the
+    // code is longer
+    uint16_t fast[1 << FAST_BITS];
+    uint16_t counts[MAX_CODE_LENGTH + 1]; // number of codes of each length
+    uint16_t symbols[NUM_LITERAL_CODES]; // symbols in the order of their codes
+} huffman_t;
+
+typedef struct bit_reader {
+    const uint8_t *in;
+    const uint8_t *end;
+    uint64_t bits; // the next bits of the stream, starting at the lowest one. Bits past numBits are 0 or also valid
+    uint32_t numBits;
+    size_t overread; // zero bytes which were read past the end of the input
+} bit_reader_t;
+
+static const uint16_t lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83,
+                                        99, 115, 131, 163, 195, 227, 258};
+static const uint8_t lengthExtraBits[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5,
+                                            5, 5, 0};
+static const uint16_t distanceBase[NUM_DISTANCE_CODES] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257,
+                                                          385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193,
+                                                          12289, 16385, 24577};
+static const uint8_t distanceExtraBits[NUM_DISTANCE_CODES] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8,
+                                                              9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+// order in which the lengths of the code length codes are stored
+static const uint8_t codeLengthOrder[NUM_CODE_LENGTH_CODES] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2,
+                                                               14, 1, 15};
+
+/**
+ * Fills the bit buffer up to at least 56 bits, which is enough for a length and distance pair with their extra bits
+ */
+static inline void refill(bit_reader_t *reader) {
+    if(reader->end - reader->in >= 8) {
+        // loads 8 bytes at once. Bytes which don't fit completely are loaded again by the next refill
+        uint64_t word;
+        memcpy(&word, reader->in, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        word = __builtin_bswap64(word);
+#endif
+        reader->bits |= word << reader->numBits;
+        reader->in += (63 - reader->numBits) >> 3;
+        reader->numBits |= 56;
+        return;
+    }
+    while(reader->numBits <= 56) {
+        uint64_t byte = 0;
+        if(reader->in < reader->end)
+            byte = *reader->in++;
+        else
+            ++reader->overread;
+        reader->bits |= byte << reader->numBits;
+        reader->numBits += 8;
+    }
+}
+
+static inline void consumeBits(bit_reader_t *reader, uint32_t numBits) {
+    reader->bits >>= numBits;
+    reader->numBits -= numBits;
+}
+
+/**
+ * Reads bits which are already in the bit buffer
+ */
+static inline uint32_t takeBits(bit_reader_t *reader, uint32_t numBits) {
+    uint32_t value = reader->bits & ((1u << numBits) - 1);
+    consumeBits(reader, numBits);
+    return value;
+}
+
+static inline uint32_t readBits(bit_reader_t *reader, uint32_t numBits) {
+    if(reader->numBits < numBits)
+        refill(reader);
+    return takeBits(reader, numBits);
+}
+
+/**
+ * Builds the decoding tables of a canonical huffman code
+ * @param huffman
+ * @param lengths the length of the code of each symbol or 0 if the symbol doesn't occur
+ * @param numSymbols
+ * @return false if there are more codes of some length than fit
+ */
+static bool buildHuffman(huffman_t *huffman, const uint8_t *lengths, uint32_t numSymbols) {
+    memset(huffman->counts, 0, sizeof(huffman->counts));
+    for(uint32_t i = 0; i < numSymbols; ++i)
+        ++huffman->counts[lengths[i]];
+    huffman->counts[0] = 0;
+    
+    // incomplete codes are allowed since a code which isn't assigned simply fails to decode
+    int32_t left = 1;
+    for(uint32_t length = 1; length <= MAX_CODE_LENGTH; ++length) {
+        left = (left << 1) - huffman->counts[length];
+        if(left < 0)
+            return false;
+    }
+    
+    uint16_t offsets[MAX_CODE_LENGTH + 1];
+    offsets[1] = 0;
+    for(uint32_t length = 1; length < MAX_CODE_LENGTH; ++length)
+        offsets[length + 1] = offsets[length] + huffman->counts[length];
+    for(uint32_t i = 0; i < numSymbols; ++i) {
+        if(lengths[i])
+            huffman->symbols[offsets[lengths[i]]++] = i;
+    }
+    
+    // huffman codes are packed starting with their highest bit, so the table is indexed by the reversed codes
+    memset(huffman->fast, 0, sizeof(huffman->fast));
+    uint32_t code = 0;
+    uint32_t index = 0;
+    for(uint32_t length = 1; length <= FAST_BITS; ++length) {
+        for(uint32_t i = 0; i < huffman->counts[length]; ++i) {
+            uint32_t reversed = 0;
+            for(uint32_t bit = 0; bit < length; ++bit)
+                reversed |= ((code >> bit) & 1u) << (length - 1 - bit);
+            uint16_t entry = huffman->symbols[index++] << 4 | length;
+            for(uint32_t fill = reversed; fill < (1u << FAST_BITS); fill += 1u << length)
+                huffman->fast[fill] = entry;
+            ++code;
+        }
+        code <<= 1;
+    }
+    return true;
+}
+
+/**
+ * Decodes a code which is longer than FAST_BITS one bit at a time. The bit buffer must hold at least
+ * MAX_CODE_LENGTH bits
+ * @return the symbol or -1 if no symbol has the code
+ */
+static int decodeSlow(bit_reader_t *reader, const huffman_t *huffman) {
+    int32_t code = 0; // the code read so far
+    int32_t first = 0; // the first code of the current length
+    int32_t index = 0; // the index of the first symbol of the current length
+    for(uint32_t length = 1; length <= MAX_CODE_LENGTH; ++length) {
+        code |= (reader->bits >> (length - 1)) & 1u;
+        int32_t count = huffman->counts[length];
+        if(code - first < count) {
+            consumeBits(reader, length);
+            return huffman->symbols[index + code - first];
+        }
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+static inline int decodeSymbol(bit_reader_t *reader, const huffman_t *huffman) {
+    uint16_t entry = huffman->fast[reader->bits & ((1u << FAST_BITS) - 1)];
+    if(entry) {
+        consumeBits(reader, entry & 15u);
+        return entry >> 4;
+    }
+    return decodeSlow(reader, huffman);
+}
+
+/**
+ * Reads the code lengths of a block with dynamic huffman codes and builds its codes
+ * @return false if the code lengths are malformed
+ */
+static bool readDynamicCodes(bit_reader_t *reader, huffman_t *literals, huffman_t *distances) {
+    uint32_t numLiteralCodes = readBits(reader, 5) + 257;
+    uint32_t numDistanceCodes = readBits(reader, 5) + 1;
+    uint32_t numCodeLengthCodes = readBits(reader, 4) + 4;
+    if(numLiteralCodes > 286 || numDistanceCodes > NUM_DISTANCE_CODES)
+        return false;
+    
+    uint8_t lengths[NUM_LITERAL_CODES + NUM_DISTANCE_CODES] = {0};
+    for(uint32_t i = 0; i < numCodeLengthCodes; ++i)
+        lengths[codeLengthOrder[i]] = readBits(reader, 3);
+    huffman_t codeLengths;
+    if(!buildHuffman(&codeLengths, lengths, NUM_CODE_LENGTH_CODES))
+        return false;
+    
+    // the lengths of both codes form a single sequence, so a repeat can continue from one into the other
+    uint32_t numLengths = numLiteralCodes + numDistanceCodes;
+    memset(lengths, 0, sizeof(lengths));
+    for(uint32_t i = 0; i < numLengths;) {
+        refill(reader);
+        int symbol = decodeSymbol(reader, &codeLengths);
+        if(symbol < 0)
+            return false;
+        if(symbol < 16) {
+            lengths[i++] = symbol;
+            continue;
+        }
+        uint8_t length = 0;
+        uint32_t repeat;
+        if(symbol == 16) {
+            if(i == 0)
+                return false;
+            length = lengths[i - 1];
+            repeat = 3 + takeBits(reader, 2);
+        }
+        else if(symbol == 17)
+            repeat = 3 + takeBits(reader, 3);
+        else
+            repeat = 11 + takeBits(reader, 7);
+        if(repeat > numLengths - i)
+            return false;
+        while(repeat--)
+            lengths[i++] = length;
+    }
+    
+    // a block without an end of block code couldn't end
+    if(!lengths[END_OF_BLOCK])
+        return false;
+    return buildHuffman(literals, lengths, numLiteralCodes) && buildHuffman(distances, lengths + numLiteralCodes, numDistanceCodes);
+}
+
+static void buildFixedCodes(huffman_t *literals, huffman_t *distances) {
+    uint8_t lengths[NUM_LITERAL_CODES];
+    memset(lengths, 8, 144);
+    memset(lengths + 144, 9, 256 - 144);
+    memset(lengths + 256, 7, 280 - 256);
+    memset(lengths + 280, 8, NUM_LITERAL_CODES - 280);
+    buildHuffman(literals, lengths, NUM_LITERAL_CODES);
+    memset(lengths, 5, NUM_DISTANCE_CODES);
+    buildHuffman(distances, lengths, NUM_DISTANCE_CODES);
+}
+
+/**
+ * Copies a stored block, which starts at the next byte boundary
+ * @return the new position in the output or SIZE_MAX if the block is malformed
+ */
+static size_t copyStoredBlock(bit_reader_t *reader, uint8_t *out, size_t position, size_t outSize) {
+    consumeBits(reader, reader->numBits & 7u);
+    uint32_t length = readBits(reader, 16);
+    uint32_t complement = readBits(reader, 16);
+    if(length != (~complement & 0xFFFFu) || length > outSize - position)
+        return SIZE_MAX;
+    
+    // the bytes left in the bit buffer are given back to the input, so the block is copied straight from the input
+    size_t buffered = reader->numBits / 8;
+    if(buffered < reader->overread)
+        return SIZE_MAX;
+    reader->in -= buffered - reader->overread;
+    reader->bits = 0;
+    reader->numBits = 0;
+    reader->overread = 0;
+    if((size_t) (reader->end - reader->in) < length)
+        return SIZE_MAX;
+    memcpy(out + position, reader->in, length);
+    reader->in += length;
+    return position + length;
+}
+
+bool inflateData(const uint8_t *in, size_t inSize, uint8_t *out, size_t outSize) {
+    bit_reader_t reader = {in, in + inSize, 0, 0, 0};
+    size_t position = 0;
+    huffman_t literals;
+    huffman_t distances;
+    bool isLastBlock;
+    do {
+        refill(&reader);
+        isLastBlock = takeBits(&reader, 1);
+        uint32_t type = takeBits(&reader, 2);
+        if(type == 0) {
+            position = copyStoredBlock(&reader, out, position, outSize);
+            if(position == SIZE_MAX)
+                return false;
+            continue;
+        }
+        if(type == 1)
+            buildFixedCodes(&literals, &distances);
+        else if(type != 2 || !readDynamicCodes(&reader, &literals, &distances))
+            return false;
+        
+        while(true) {
+            refill(&reader);
+            int symbol = decodeSymbol(&reader, &literals);
+            if(symbol < END_OF_BLOCK) {
+                if(symbol < 0 || position == outSize)
+                    return false;
+                out[position++] = symbol;
+                continue;
+            }
+            if(symbol == END_OF_BLOCK)
+                break;
+            
+            symbol -= END_OF_BLOCK + 1;
+            if(symbol >= 29)
+                return false;
+            uint32_t length = lengthBase[symbol] + takeBits(&reader, lengthExtraBits[symbol]);
+            int distanceSymbol = decodeSymbol(&reader, &distances);
+            if(distanceSymbol < 0 || distanceSymbol >= NUM_DISTANCE_CODES)
+                return false;
+            size_t distance = distanceBase[distanceSymbol] + takeBits(&reader, distanceExtraBits[distanceSymbol]);
+            if(distance > position || length > outSize - position)
+                return false;
+            
+            uint8_t *dest = out + position;
+            const uint8_t *src = dest - distance;
+            if(distance >= length)
+                memcpy(dest, src, length);
+            else {
+                // the copy overlaps the bytes it produces, which repeats them
+                for(uint32_t i = 0; i < length; ++i)
+                    dest[i] = src[i];
+            }
+            position += length;
+        }
+    } while(!isLastBlock);
+    
+    // bits past the end of the input were decoded if the padding was consumed
+    return reader.overread * 8 <= reader.numBits && position == outSize;
+}
@@ -0,0 +1,19 @@
+#ifndef JVM_INFLATE_H
+#define JVM_INFLATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Decompresses a raw deflate stream (RFC 1951), as stored in zip archives. The blocks are decoded in a single pass
+ * straight into the output, which also serves as the window back references copy from
+ * @param in the compressed data
+ * @param inSize
+ * @param out receives the decompressed data
+ * @param outSize the exact size of the decompressed data
+ * @return false if the stream is malformed or doesn't decompress to exactly outSize bytes
+ */
+bool inflateData(const uint8_t *in, size_t inSize, uint8_t *out, size_t outSize);
+
+#endif //JVM_INFLATE_H
@@ -0,0 +1,809 @@
+#ifdef BASELINE_JIT
+
+#include "jit.h"
+#include "stack_map.h"
+#include "opcodes.h"
+#include "gc.h"
+#include "heap.h"
+#include "indirection_impl.h"
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+// size of the executable memory compiled code is placed in. Methods that don't fit stay interpreted
+#define CODE_CACHE_SIZE (32u * 1024u * 1024u)
+// upper bound on the size of the machine code emitted for a single instruction
+#define MAX_TEMPLATE_SIZE 256
+
+enum { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+// registers holding the interpreter state while compiled code runs. They are callee saved so calls to handlers keep them
+#define JTHREAD RBX
+#define CALLER_FRAME RBP
+#define LOCALS R12
+#define STACK R13
+#define INTERPRETER R14
+#define FRAME R15
+
+// condition codes of jcc and setcc. Flipping the lowest bit negates the condition
+#define CC_E 0x4
+#define CC_NE 0x5
+#define CC_L 0xC
+#define CC_GE 0xD
+#define CC_LE 0xE
+#define CC_G 0xF
+// passed instead of a condition code for an unconditional jump
+#define CC_ALWAYS (-1)
+
+// displacement of a local variable or operand stack slot from the start of the local variables or operand stack
+#define SLOT(index) ((int32_t) ((index) * sizeof(cell_t)))
+
+#define EMIT(as, ...) emitBytes((as), (const uint8_t[]) {__VA_ARGS__}, sizeof((const uint8_t[]) {__VA_ARGS__}))
+#define LOAD32(reg, base, disp) emitMemory(as, 0, false, 0x8B, (reg), (base), (disp))
+#define STORE32(base, disp, reg) emitMemory(as, 0, false, 0x89, (reg), (base), (disp))
+#define LOAD64(reg, base, disp) emitMemory(as, 0, true, 0x8B, (reg), (base), (disp))
+#define STORE64(base, disp, reg) emitMemory(as, 0, true, 0x89, (reg), (base), (disp))
+
+typedef struct assembler {
+    uint8_t *pos;
+    uint8_t *end;
+} assembler_t;
+
+typedef struct compilation {
+    assembler_t as;
+    translated_code_t *translatedCode;
+    stack_map_t *stackMap;
+    compiled_code_t *compiledCode;
+    // jumps to other instructions of the method are patched once every instruction has an address
+    uint8_t **branchFields; // the rel32 field of each jump
+    uint32_t *branchTargets; // the word index each jump goes to
+    uint32_t numBranches;
+} compilation_t;
+
+static pthread_mutex_t codeCacheMutex = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t *codeCache; // NULL until the first method is compiled
+static uint8_t *codeCacheTop; // start of the unused part of the code cache
+static int (*enterCompiledCode)(bc_interpreter_t *interpreter, stack_frame_t *callerFrame);
+// continues at the thread's pc with the status returned by a handler in eax, which must not be positive
+static uint8_t *dispatchStub;
+
+static void emitBytes(assembler_t *as, const uint8_t *bytes, size_t length) {
+    memcpy(as->pos, bytes, length);
+    as->pos += length;
+}
+
+static void emit8(assembler_t *as, uint8_t value) {
+    *as->pos++ = value;
+}
+
+static void emit16(assembler_t *as, uint16_t value) {
+    emitBytes(as, (uint8_t *) &value, sizeof(value));
+}
+
+static void emit32(assembler_t *as, uint32_t value) {
+    emitBytes(as, (uint8_t *) &value, sizeof(value));
+}
+
+static void emit64(assembler_t *as, uint64_t value) {
+    emitBytes(as, (uint8_t *) &value, sizeof(value));
+}
+
+/**
+ * Emits an instruction with a register operand and a [base + disp32] memory operand
+ * @param as
+ * @param prefix a mandatory prefix such as 0x66, 0xF2, or 0xF3 or 0 for none
+ * @param wide whether the operation is 64 bits
+ * @param opcode a one byte opcode or a two byte opcode starting with 0x0F
+ * @param reg the register operand or the opcode extension
+ * @param base
+ * @param disp
+ */
+static void emitMemory(assembler_t *as, uint8_t prefix, bool wide, uint16_t opcode, int reg, int base, int32_t disp) {
+    if(prefix)
+        emit8(as, prefix);
+    uint8_t rex = 0x40 | (wide ? 8 : 0) | (reg >= R8 ? 4 : 0) | (base >= R8 ? 1 : 0);
+    if(rex != 0x40)
+        emit8(as, rex);
+    if(opcode > 0xFF)
+        emit8(as, opcode >> 8);
+    emit8(as, opcode & 0xFF);
+    emit8(as, 0x80 | (reg & 7) << 3 | (base & 7));
+    // rsp and r12 can only be used as a base with a SIB byte
+    if((base & 7) == RSP)
+        emit8(as, 0x24);
+    emit32(as, disp);
+}
+
+static void emitLoadImmediate(assembler_t *as, int reg, uint64_t value) {
+    emit8(as, reg >= R8 ? 0x49 : 0x48);
+    emit8(as, 0xB8 + (reg & 7));
+    emit64(as, value);
+}
+
+static void emitStoreImmediate(assembler_t *as, int base, int32_t disp, uint32_t value) {
+    emitMemory(as, 0, false, 0xC7, 0, base, disp);
+    emit32(as, value);
+}
+
+static void patchJump(uint8_t *field, uint8_t *target) {
+    int32_t offset = (int32_t) (target - (field + 4));
+    memcpy(field, &offset, sizeof(offset));
+}
+
+/**
+ * @param as
+ * @param cc the condition the jump is taken under or CC_ALWAYS
+ * @param target the destination or NULL if it's patched later
+ * @return the rel32 field of the jump for patching
+ */
+static uint8_t *emitJump(assembler_t *as, int cc, uint8_t *target) {
+    if(cc == CC_ALWAYS)
+        emit8(as, 0xE9);
+    else
+        EMIT(as, 0x0F, 0x80 + cc);
+    uint8_t *field = as->pos;
+    emit32(as, 0);
+    if(target)
+        patchJump(field, target);
+    return field;
+}
+
+/**
+ * Writes the pc and top of stack of the instruction to the thread so that handlers and the garbage collector see them
+ * @param c
+ * @param wordIndex
+ */
+static void emitSyncState(compilation_t *c, uint32_t wordIndex) {
+    assembler_t *as = &c->as;
+    int32_t depth = c->stackMap->depths[wordIndex];
+    if(depth >= 0) {
+        emitMemory(as, 0x66, false, 0xC7, 0, FRAME, offsetof(stack_frame_t, topOfStack));
+        emit16(as, depth);
+    }
+    emitLoadImmediate(as, RAX, (uintptr_t) (c->translatedCode->code + wordIndex));
+    STORE64(JTHREAD, offsetof(jthread_t, pc), RAX);
+}
+
+/**
+ * Reads the safepoint page, which stops the thread until the garbage collector is done if it wants to run. The pc and
+ * top of stack must be synced before.
+ * @param as
+ * @param reg the register clobbered by the poll. Must be one of rax, rcx, rdx, or rbx
+ */
+static void emitSafepointPoll(assembler_t *as, int reg) {
+    emitLoadImmediate(as, reg, (uintptr_t) &safepointPollPage);
+    LOAD64(reg, reg, 0);
+    emitMemory(as, 0, false, 0x84, reg, reg, 0); // test [reg], reg8
+}
+
+/**
+ * Executes the instruction by calling its handler. Execution falls through to the next instruction if the handler
+ * advanced the pc and otherwise continues wherever the handler left the thread. The handler is looked up when the
+ * instruction executes since it may be quickened after the method is compiled.
+ * @param c
+ * @param wordIndex
+ */
+static void emitCallHandler(compilation_t *c, uint32_t wordIndex) {
+    assembler_t *as = &c->as;
+    emitSyncState(c, wordIndex);
+    emitLoadImmediate(as, RAX, (uintptr_t) (c->translatedCode->opcodes + wordIndex));
+    emitMemory(as, 0, false, 0x0FB7, RAX, RAX, 0); // movzx eax, word [rax]
+    emitLoadImmediate(as, RCX, (uintptr_t) instr_table);
+    EMIT(as, 0x48, 0x8B, 0x04, 0xC1); // mov rax, [rcx + rax * 8]
+    EMIT(as, 0x4C, 0x89, 0xF7); // mov rdi, r14
+    EMIT(as, 0x31, 0xF6); // xor esi, esi
+    EMIT(as, 0xFF, 0xD0); // call rax
+    EMIT(as, 0x85, 0xC0); // test eax, eax
+    emitJump(as, CC_LE, dispatchStub);
+}
+
+/**
+ * Jumps to another instruction of the method if the condition holds. Backward jumps are safepoints since loops in
+ * compiled code don't reach one otherwise.
+ * @param c
+ * @param cc
+ * @param wordIndex the word index of the branch instruction
+ * @param target the word index of the destination
+ */
+static void emitBranch(compilation_t *c, int cc, uint32_t wordIndex, uint32_t target) {
+    assembler_t *as = &c->as;
+    if(target > wordIndex) {
+        c->branchFields[c->numBranches] = emitJump(as, cc, NULL);
+        c->branchTargets[c->numBranches++] = target;
+        return;
+    }
+    uint8_t *notTaken = cc == CC_ALWAYS ? NULL : emitJump(as, cc ^ 1, NULL);
+    emitSyncState(c, target);
+    emitSafepointPoll(as, RAX);
+    c->branchFields[c->numBranches] = emitJump(as, CC_ALWAYS, NULL);
+    c->branchTargets[c->numBranches++] = target;
+    if(notTaken)
+        patchJump(notTaken, as->pos);
+}
+
+/**
+ * Loads the address of the object in the operand stack slot into rax. The address table never moves, so its address is
+ * part of the code. With DIRECT_REFERENCES the address is computed from the reference and the base of the heap instead
+ * @param as
+ * @param disp the displacement of the slot from the operand stack base
+ * @return the rel32 field of the jump taken for null references
+ */
+static uint8_t *emitLoadObject(assembler_t *as, int32_t disp) {
+    LOAD32(RAX, STACK, disp);
+#ifdef DIRECT_REFERENCES
+    EMIT(as, 0x85, 0xC0); // test eax, eax
+    uint8_t *nullJump = emitJump(as, CC_E, NULL);
+    emitLoadImmediate(as, RCX, (uintptr_t) referenceBase);
+    EMIT(as, 0x48, 0x8D, 0x04, 0xC1); // lea rax, [rcx + rax * 8]
+    return nullJump;
+#else
+    emitLoadImmediate(as, RCX, (uintptr_t) addrIndInfo->addressTable);
+    EMIT(as, 0x48, 0x8B, 0x04, 0xC1); // mov rax, [rcx + rax * 8]
+    EMIT(as, 0x48, 0x85, 0xC0); // test rax, rax
+    return emitJump(as, CC_E, NULL);
+#endif
+}
+
+/**
+ * Emits the integer and floating point binary operations which take their operands from the stack and replace the lower
+ * one with the result
+ * @param as
+ * @param depth the stack depth before the instruction
+ * @param prefix the mandatory prefix of the instructions
+ * @param wide whether the integer operation is 64 bits
+ * @param size the number of slots each operand takes up
+ * @param load the opcode that loads the lower operand into rax or xmm0
+ * @param operation the opcode that combines rax or xmm0 with the upper operand
+ * @param store the opcode that stores rax or xmm0
+ */
+static void emitBinary(assembler_t *as, int32_t depth, uint8_t prefix, bool wide, int32_t size, uint16_t load, uint16_t operation, uint16_t store) {
+    emitMemory(as, prefix, wide, load, RAX, STACK, SLOT(depth - 2 * size));
+    emitMemory(as, prefix, wide, operation, RAX, STACK, SLOT(depth - size));
+    emitMemory(as, prefix, wide, store, RAX, STACK, SLOT(depth - 2 * size));
+}
+
+/**
+ * Emits integer division or remainder. A divisor of -1 is handled separately since x86 traps on the most negative value
+ * divided by -1 where Java defines the result.
+ * @param as
+ * @param depth the stack depth before the instruction
+ * @param wide whether the operands are longs
+ * @param remainder
+ * @return the rel32 field of the jump taken for division by zero
+ */
+static uint8_t *emitDivide(assembler_t *as, int32_t depth, bool wide, bool remainder) {
+    int32_t size = wide ? 2 : 1;
+    uint8_t rex = wide ? 0x48 : 0x40;
+    emitMemory(as, 0, wide, 0x8B, RCX, STACK, SLOT(depth - size));
+    EMIT(as, rex, 0x85, 0xC9); // test rcx, rcx
+    uint8_t *divideByZero = emitJump(as, CC_E, NULL);
+    emitMemory(as, 0, wide, 0x8B, RAX, STACK, SLOT(depth - 2 * size));
+    EMIT(as, rex, 0x83, 0xF9, 0xFF); // cmp rcx, -1
+    uint8_t *divide = emitJump(as, CC_NE, NULL);
+    if(remainder)
+        EMIT(as, 0x31, 0xD2); // xor edx, edx
+    else
+        EMIT(as, rex, 0xF7, 0xD8); // neg rax
+    uint8_t *done = emitJump(as, CC_ALWAYS, NULL);
+    patchJump(divide, as->pos);
+    EMIT(as, rex, 0x99, rex, 0xF7, 0xF9); // cdq or cqo then idiv rcx
+    patchJump(done, as->pos);
+    emitMemory(as, 0, wide, 0x89, remainder ? RDX : RAX, STACK, SLOT(depth - 2 * size));
+    return divideByZero;
+}
+
+// loads that extend each type of quick field to a full register, in the order of the getstatic and getfield quick opcodes
+static const uint16_t fieldLoadOpcodes[] = {0x0FBE, 0x0FB7, 0x0FBF, 0x0FB6, 0x8B, 0x8B, 0x8B, 0x8B, 0x8B};
+// stores of each size of quick field, in the order of the putstatic and putfield quick opcodes
+static const struct {
+    uint8_t prefix;
+    uint16_t opcode;
+    bool wide;
+} fieldStores[] = {{0, 0x88, false}, {0x66, 0x89, false}, {0, 0x89, false}, {0, 0x89, true}, {0, 0x89, false}};
+
+/**
+ * Emits a jump which is taken while the old generation is marked concurrently, so that reference stores run through
+ * their handler, which contains the write barrier
+ * @param as
+ * @return the rel32 field of the jump for patching
+ */
+static uint8_t *emitWriteBarrierCheck(assembler_t *as) {
+    emitLoadImmediate(as, RCX, (uintptr_t) &concurrentMarkActive);
+    emitMemory(as, 0, false, 0x80, 7, RCX, 0); // cmp byte [rcx], imm8
+    emit8(as, 0);
+    return emitJump(as, CC_NE, NULL);
+}
+
+/**
+ * Dirties the card of a reference field of the object in rax. Clobbers rax and rcx
+ * @param as
+ * @param disp the offset of the field in the object
+ */
+static void emitCardMark(assembler_t *as, int32_t disp) {
+    emitMemory(as, 0, true, 0x8D, RAX, RAX, disp); // lea rax, [rax + disp]
+    EMIT(as, 0x48, 0xC1, 0xE8, CARD_SHIFT); // shr rax, CARD_SHIFT
+    emitLoadImmediate(as, RCX, (uintptr_t) cardTable);
+    EMIT(as, 0xC6, 0x04, 0x01, CARD_DIRTY); // mov byte [rcx + rax], CARD_DIRTY
+}
+
+/**
+ * Emits the template of an instruction. The stack depth before each instruction is known from the stack map so operand
+ * stack slots are addressed at fixed displacements and the top of stack is only written back when leaving the template.
+ * @param c
+ * @param wordIndex
+ */
+static void compileInstruction(compilation_t *c, uint32_t wordIndex) {
+    assembler_t *as = &c->as;
+    code_word_t *words = c->translatedCode->code + wordIndex;
+    uint16_t opcode = c->translatedCode->opcodes[wordIndex];
+    int32_t depth = c->stackMap->depths[wordIndex];
+    // jump to the handler when the template can't complete the instruction itself
+    uint8_t *slowPath = NULL;
+    uint8_t *barrierPath = NULL;
+    // instructions that are never reached still need an entry but only run through their handler
+    if(depth < 0) {
+        emitCallHandler(c, wordIndex);
+        return;
+    }
+
+    switch(canonicalOpcode(opcode)) {
+        case OP_nop:
+        case OP_pop:
+        case OP_pop2:
+        case OP_l2i:
+            break;
+        case OP_aconst_null:
+            emitStoreImmediate(as, STACK, SLOT(depth), 0);
+            break;
+        case OP_iconst_m1:
+        case OP_iconst_0:
+        case OP_iconst_1:
+        case OP_iconst_2:
+        case OP_iconst_3:
+        case OP_iconst_4:
+        case OP_iconst_5:
+            emitStoreImmediate(as, STACK, SLOT(depth), (uint32_t) (opcode - OP_iconst_0));
+            break;
+        case OP_fconst_0:
+        case OP_fconst_1:
+        case OP_fconst_2: {
+            float value = (float) (opcode - OP_fconst_0);
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            emitStoreImmediate(as, STACK, SLOT(depth), bits);
+            break;
+        }
+        case OP_lconst_0:
+        case OP_lconst_1:
+        case OP_dconst_0:
+        case OP_dconst_1: {
+            double_cell_t cell;
+            if(opcode == OP_lconst_0 || opcode == OP_lconst_1)
+                cell.l = opcode - OP_lconst_0;
+            else
+                cell.d = opcode - OP_dconst_0;
+            uint32_t halves[2];
+            memcpy(halves, &cell, sizeof(halves));
+            emitStoreImmediate(as, STACK, SLOT(depth), halves[0]);
+            emitStoreImmediate(as, STACK, SLOT(depth + 1), halves[1]);
+            break;
+        }
+        case OP_bipush:
+        case OP_sipush:
+            emitStoreImmediate(as, STACK, SLOT(depth), (uint32_t) words[1].i);
+            break;
+        case OP_iload:
+        case OP_fload:
+        case OP_aload:
+            LOAD32(RAX, LOCALS, SLOT(words[1].u));
+            STORE32(STACK, SLOT(depth), RAX);
+            break;
+        case OP_lload:
+        case OP_dload:
+            LOAD64(RAX, LOCALS, SLOT(words[1].u));
+            STORE64(STACK, SLOT(depth), RAX);
+            break;
+        case OP_istore:
+        case OP_fstore:
+        case OP_astore:
+            LOAD32(RAX, STACK, SLOT(depth - 1));
+            STORE32(LOCALS, SLOT(words[1].u), RAX);
+            break;
+        case OP_lstore:
+        case OP_dstore:
+            LOAD64(RAX, STACK, SLOT(depth - 2));
+            STORE64(LOCALS, SLOT(words[1].u), RAX);
+            break;
+        case OP_iinc:
+            emitMemory(as, 0, false, 0x81, 0, LOCALS, SLOT(words[1].u)); // add dword [local], imm32
+            emit32(as, (uint32_t) words[2].i);
+            break;
+        case OP_dup:
+            LOAD32(RAX, STACK, SLOT(depth - 1));
+            STORE32(STACK, SLOT(depth), RAX);
+            break;
+        case OP_dup_x1:
+            LOAD32(RAX, STACK, SLOT(depth - 1));
+            LOAD32(RCX, STACK, SLOT(depth - 2));
+            STORE32(STACK, SLOT(depth - 2), RAX);
+            STORE32(STACK, SLOT(depth - 1), RCX);
+            STORE32(STACK, SLOT(depth), RAX);
+            break;
+        case OP_dup2:
+            LOAD64(RAX, STACK, SLOT(depth - 2));
+            STORE64(STACK, SLOT(depth), RAX);
+            break;
+        case OP_swap:
+            LOAD32(RAX, STACK, SLOT(depth - 1));
+            LOAD32(RCX, STACK, SLOT(depth - 2));
+            STORE32(STACK, SLOT(depth - 2), RAX);
+            STORE32(STACK, SLOT(depth - 1), RCX);
+            break;
+        case OP_iadd: emitBinary(as, depth, 0, false, 1, 0x8B, 0x03, 0x89); break;
+        case OP_isub: emitBinary(as, depth, 0, false, 1, 0x8B, 0x2B, 0x89); break;
+        case OP_imul: emitBinary(as, depth, 0, false, 1, 0x8B, 0x0FAF, 0x89); break;
+        case OP_iand: emitBinary(as, depth, 0, false, 1, 0x8B, 0x23, 0x89); break;
+        case OP_ior: emitBinary(as, depth, 0, false, 1, 0x8B, 0x0B, 0x89); break;
+        case OP_ixor: emitBinary(as, depth, 0, false, 1, 0x8B, 0x33, 0x89); break;
+        case OP_ladd: emitBinary(as, depth, 0, true, 2, 0x8B, 0x03, 0x89); break;
+        case OP_lsub: emitBinary(as, depth, 0, true, 2, 0x8B, 0x2B, 0x89); break;
+        case OP_lmul: emitBinary(as, depth, 0, true, 2, 0x8B, 0x0FAF, 0x89); break;
+        case OP_land: emitBinary(as, depth, 0, true, 2, 0x8B, 0x23, 0x89); break;
+        case OP_lor: emitBinary(as, depth, 0, true, 2, 0x8B, 0x0B, 0x89); break;
+        case OP_lxor: emitBinary(as, depth, 0, true, 2, 0x8B, 0x33, 0x89); break;
+        case OP_fadd: emitBinary(as, depth, 0xF3, false, 1, 0x0F10, 0x0F58, 0x0F11); break;
+        case OP_fsub: emitBinary(as, depth, 0xF3, false, 1, 0x0F10, 0x0F5C, 0x0F11); break;
+        case OP_fmul: emitBinary(as, depth, 0xF3, false, 1, 0x0F10, 0x0F59, 0x0F11); break;
+        case OP_fdiv: emitBinary(as, depth, 0xF3, false, 1, 0x0F10, 0x0F5E, 0x0F11); break;
+        case OP_dadd: emitBinary(as, depth, 0xF2, false, 2, 0x0F10, 0x0F58, 0x0F11); break;
+        case OP_dsub: emitBinary(as, depth, 0xF2, false, 2, 0x0F10, 0x0F5C, 0x0F11); break;
+        case OP_dmul: emitBinary(as, depth, 0xF2, false, 2, 0x0F10, 0x0F59, 0x0F11); break;
+        case OP_ddiv: emitBinary(as, depth, 0xF2, false, 2, 0x0F10, 0x0F5E, 0x0F11); break;
+        case OP_idiv: slowPath = emitDivide(as, depth, false, false); break;
+        case OP_irem: slowPath = emitDivide(as, depth, false, true); break;
+        case OP_ldiv: slowPath = emitDivide(as, depth, true, false); break;
+        case OP_lrem: slowPath = emitDivide(as, depth, true, true); break;
+        case OP_ineg:
+            emitMemory(as, 0, false, 0xF7, 3, STACK, SLOT(depth - 1));
+            break;
+        case OP_lneg:
+            emitMemory(as, 0, true, 0xF7, 3, STACK, SLOT(depth - 2));
+            break;
+        case OP_fneg:
+        case OP_dneg:
+            // flips the sign bit, which is in the upper slot of a double
+            emitMemory(as, 0, false, 0x81, 6, STACK, SLOT(depth - 1));
+            emit32(as, 0x80000000u);
+            break;
+        case OP_ishl:
+        case OP_ishr:
+        case OP_iushr: {
+            // x86 masks the shift distance the same way Java does
+            uint8_t modrm = opcode == OP_ishl ? 0xE0 : (opcode == OP_ishr ? 0xF8 : 0xE8);
+            LOAD32(RCX, STACK, SLOT(depth - 1));
+            LOAD32(RAX, STACK, SLOT(depth - 2));
+            EMIT(as, 0xD3, modrm);
+            STORE32(STACK, SLOT(depth - 2), RAX);
+            break;
+        }
+        case OP_lshl:
+        case OP_lshr:
+        case OP_lushr: {
+            uint8_t modrm = opcode == OP_lshl ? 0xE0 : (opcode == OP_lshr ? 0xF8 : 0xE8);
+            LOAD32(RCX, STACK, SLOT(depth - 1));
+            LOAD64(RAX, STACK, SLOT(depth - 3));
+            EMIT(as, 0x48, 0xD3, modrm);
+            STORE64(STACK, SLOT(depth - 3), RAX);
+            break;
+        }
+        case OP_lcmp:
+            LOAD64(RAX, STACK, SLOT(depth - 4));
+            emitMemory(as, 0, true, 0x3B, RAX, STACK, SLOT(depth - 2));
+            EMIT(as, 0x0F, 0x9F, 0xC0); // setg al
+            EMIT(as, 0x0F, 0x9C, 0xC1); // setl cl
+            EMIT(as, 0x28, 0xC8); // sub al, cl
+            EMIT(as, 0x0F, 0xBE, 0xC0); // movsx eax, al
+            STORE32(STACK, SLOT(depth - 4), RAX);
+            break;
+        case OP_i2l:
+            emitMemory(as, 0, true, 0x63, RAX, STACK, SLOT(depth - 1)); // movsxd
+            STORE64(STACK, SLOT(depth - 1), RAX);
+            break;
+        case OP_i2b:
+        case OP_i2c:
+        case OP_i2s:
+            emitMemory(as, 0, false, opcode == OP_i2b ? 0x0FBE : (opcode == OP_i2c ? 0x0FB7 : 0x0FBF), RAX, STACK, SLOT(depth - 1));
+            STORE32(STACK, SLOT(depth - 1), RAX);
+            break;
+        // conversions between floating point types and from integers. Conversions to integers are left to the handlers
+        // since Java saturates out of range values where x86 doesn't
+        case OP_i2f:
+            emitMemory(as, 0xF3, false, 0x0F2A, 0, STACK, SLOT(depth - 1));
+            emitMemory(as, 0xF3, false, 0x0F11, 0, STACK, SLOT(depth - 1));
+            break;
+        case OP_i2d:
+            emitMemory(as, 0xF2, false, 0x0F2A, 0, STACK, SLOT(depth - 1));
+            emitMemory(as, 0xF2, false, 0x0F11, 0, STACK, SLOT(depth - 1));
+            break;
+        case OP_l2f:
+            emitMemory(as, 0xF3, true, 0x0F2A, 0, STACK, SLOT(depth - 2));
+            emitMemory(as, 0xF3, false, 0x0F11, 0, STACK, SLOT(depth - 2));
+            break;
+        case OP_l2d:
+            emitMemory(as, 0xF2, true, 0x0F2A, 0, STACK, SLOT(depth - 2));
+            emitMemory(as, 0xF2, false, 0x0F11, 0, STACK, SLOT(depth - 2));
+            break;
+        case OP_f2d:
+            emitMemory(as, 0xF3, false, 0x0F5A, 0, STACK, SLOT(depth - 1));
+            emitMemory(as, 0xF2, false, 0x0F11, 0, STACK, SLOT(depth - 1));
+            break;
+        case OP_d2f:
+            emitMemory(as, 0xF2, false, 0x0F5A, 0, STACK, SLOT(depth - 2));
+            emitMemory(as, 0xF3, false, 0x0F11, 0, STACK, SLOT(depth - 2));
+            break;
+        case OP_ifeq:
+        case OP_ifne:
+        case OP_iflt:
+        case OP_ifge:
+        case OP_ifgt:
+        case OP_ifle:
+        case OP_ifnull:
+        case OP_ifnonnull: {
+            static const int conditions[] = {CC_E, CC_NE, CC_L, CC_GE, CC_G, CC_LE};
+            emitMemory(as, 0, false, 0x83, 7, STACK, SLOT(depth - 1)); // cmp dword [top], 0
+            emit8(as, 0);
+            int cc = opcode == OP_ifnull ? CC_E : (opcode == OP_ifnonnull ? CC_NE : conditions[opcode - OP_ifeq]);
+            emitBranch(c, cc, wordIndex, words[1].target - c->translatedCode->code);
+            break;
+        }
+        case OP_if_icmpeq:
+        case OP_if_icmpne:
+        case OP_if_icmplt:
+        case OP_if_icmpge:
+        case OP_if_icmpgt:
+        case OP_if_icmple:
+        case OP_if_acmpeq:
+        case OP_if_acmpne: {
+            static const int conditions[] = {CC_E, CC_NE, CC_L, CC_GE, CC_G, CC_LE, CC_E, CC_NE};
+            LOAD32(RAX, STACK, SLOT(depth - 2));
+            emitMemory(as, 0, false, 0x3B, RAX, STACK, SLOT(depth - 1));
+            emitBranch(c, conditions[opcode - OP_if_icmpeq], wordIndex, words[1].target - c->translatedCode->code);
+            break;
+        }
+        case OP_goto:
+            emitBranch(c, CC_ALWAYS, wordIndex, words[1].target - c->translatedCode->code);
+            break;
+        case OP_getstatic_quick_b:
+        case OP_getstatic_quick_c:
+        case OP_getstatic_quick_s:
+        case OP_getstatic_quick_z:
+        case OP_getstatic_quick_i:
+        case OP_getstatic_quick_f:
+        case OP_getstatic_quick_j:
+        case OP_getstatic_quick_d:
+        case OP_getstatic_quick_a: {
+            bool wide = opcode == OP_getstatic_quick_j || opcode == OP_getstatic_quick_d;
+            emitLoadImmediate(as, RAX, (uintptr_t) words[2].ptr);
+            emitMemory(as, 0, wide, fieldLoadOpcodes[opcode - OP_getstatic_quick_b], RCX, RAX, 0);
+            emitMemory(as, 0, wide, 0x89, RCX, STACK, SLOT(depth));
+            break;
+        }
+        case OP_putstatic_quick_8:
+        case OP_putstatic_quick_16:
+        case OP_putstatic_quick_32:
+        case OP_putstatic_quick_64:
+        case OP_putstatic_quick_a: {
+            uint32_t kind = opcode - OP_putstatic_quick_8;
+            if(opcode == OP_putstatic_quick_a)
+                barrierPath = emitWriteBarrierCheck(as);
+            emitMemory(as, 0, fieldStores[kind].wide, 0x8B, RDX, STACK, SLOT(depth - (fieldStores[kind].wide ? 2 : 1)));
+            emitLoadImmediate(as, RAX, (uintptr_t) words[2].ptr);
+            emitMemory(as, fieldStores[kind].prefix, fieldStores[kind].wide, fieldStores[kind].opcode, RDX, RAX, 0);
+            break;
+        }
+        case OP_getfield_quick_b:
+        case OP_getfield_quick_c:
+        case OP_getfield_quick_s:
+        case OP_getfield_quick_z:
+        case OP_getfield_quick_i:
+        case OP_getfield_quick_f:
+        case OP_getfield_quick_j:
+        case OP_getfield_quick_d:
+        case OP_getfield_quick_a: {
+            bool wide = opcode == OP_getfield_quick_j || opcode == OP_getfield_quick_d;
+            slowPath = emitLoadObject(as, SLOT(depth - 1));
+            emitMemory(as, 0, wide, fieldLoadOpcodes[opcode - OP_getfield_quick_b], RCX, RAX, (int32_t) words[2].u);
+            emitMemory(as, 0, wide, 0x89, RCX, STACK, SLOT(depth - 1));
+            break;
+        }
+        case OP_putfield_quick_8:
+        case OP_putfield_quick_16:
+        case OP_putfield_quick_32:
+        case OP_putfield_quick_64:
+        case OP_putfield_quick_a: {
+            uint32_t kind = opcode - OP_putfield_quick_8;
+            int32_t size = fieldStores[kind].wide ? 2 : 1;
+            if(opcode == OP_putfield_quick_a)
+                barrierPath = emitWriteBarrierCheck(as);
+            slowPath = emitLoadObject(as, SLOT(depth - 1 - size));
+            emitMemory(as, 0, fieldStores[kind].wide, 0x8B, RDX, STACK, SLOT(depth - size));
+            emitMemory(as, fieldStores[kind].prefix, fieldStores[kind].wide, fieldStores[kind].opcode, RDX, RAX, (int32_t) words[2].u);
+            if(opcode == OP_putfield_quick_a)
+                emitCardMark(as, (int32_t) words[2].u);
+            break;
+        }
+        // invokes, returns, and everything else run through their handlers. Calls between compiled methods continue
+        // in the callee's compiled code through the dispatch stub without going back to the interpreter
+        default:
+            emitCallHandler(c, wordIndex);
+            return;
+    }
+
+    if(slowPath || barrierPath) {
+        uint8_t *done = emitJump(as, CC_ALWAYS, NULL);
+        if(slowPath)
+            patchJump(slowPath, as->pos);
+        if(barrierPath)
+            patchJump(barrierPath, as->pos);
+        emitCallHandler(c, wordIndex);
+        patchJump(done, as->pos);
+    }
+}
+
+/**
+ * Maps the code cache and emits the stubs shared by all compiled methods. Must be called with the code cache lock held.
+ * @return false if the memory couldn't be mapped
+ */
+static bool initCodeCache() {
+    void *memory = mmap(NULL, CODE_CACHE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if(memory == MAP_FAILED)
+        return false;
+    assembler_t stubs = {memory, (uint8_t *) memory + CODE_CACHE_SIZE};
+    assembler_t *as = &stubs;
+
+    // int enterCompiledCode(bc_interpreter_t *interpreter, stack_frame_t *callerFrame)
+    enterCompiledCode = (void *) as->pos;
+    EMIT(as, 0x53, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57); // push rbx, rbp, r12, r13, r14, r15
+    EMIT(as, 0x48, 0x83, 0xEC, 0x08); // sub rsp, 8 to keep the stack aligned for calls
+    EMIT(as, 0x49, 0x89, 0xFE); // mov r14, rdi
+    EMIT(as, 0x48, 0x89, 0xF5); // mov rbp, rsi
+    LOAD64(JTHREAD, RDI, offsetof(bc_interpreter_t, jthread));
+    uint8_t *enter = emitJump(as, CC_ALWAYS, NULL);
+
+    // returning to a frame other than the caller of the interpreter continues in that frame. Handlers that set the pc
+    // branched, invoked, or returned, so this is a safepoint
+    dispatchStub = as->pos;
+    EMIT(as, 0x85, 0xC0); // test eax, eax
+    uint8_t *poll = emitJump(as, CC_E, NULL);
+    EMIT(as, 0x83, 0xF8, (uint8_t) -EJUST_RETURNED); // cmp eax, -EJUST_RETURNED
+    uint8_t *exitOtherStatus = emitJump(as, CC_NE, NULL);
+    emitMemory(as, 0, true, 0x39, CALLER_FRAME, JTHREAD, offsetof(jthread_t, currentStackFrame)); // cmp [rbx + currentStackFrame], rbp
+    uint8_t *exitReturned = emitJump(as, CC_E, NULL);
+    patchJump(poll, as->pos);
+    emitSafepointPoll(as, RCX);
+
+    // switches to the current frame and jumps to the entry for the pc if the frame runs compiled code
+    patchJump(enter, as->pos);
+    LOAD64(FRAME, JTHREAD, offsetof(jthread_t, currentStackFrame));
+    LOAD64(RDX, FRAME, offsetof(stack_frame_t, compiledCode));
+    EMIT(as, 0x48, 0x85, 0xD2); // test rdx, rdx
+    uint8_t *exitInterpreted = emitJump(as, CC_E, NULL);
+    LOAD64(LOCALS, FRAME, offsetof(stack_frame_t, localVariableBase));
+    LOAD64(STACK, FRAME, offsetof(stack_frame_t, operandStackBase));
+    LOAD64(RAX, JTHREAD, offsetof(jthread_t, pc));
+    emitMemory(as, 0, true, 0x2B, RAX, RDX, offsetof(compiled_code_t, words)); // sub rax, [rdx + words]
+    LOAD64(RDX, RDX, offsetof(compiled_code_t, entries));
+    // code words and entries are both 8 bytes so the byte offset of the pc indexes the entries
+    _Static_assert(sizeof(code_word_t) == sizeof(void *), "code words must be pointer sized");
+    EMIT(as, 0xFF, 0x24, 0x02); // jmp [rdx + rax]
+
+    patchJump(exitInterpreted, as->pos);
+    EMIT(as, 0x31, 0xC0); // xor eax, eax
+    patchJump(exitOtherStatus, as->pos);
+    patchJump(exitReturned, as->pos);
+    EMIT(as, 0x48, 0x83, 0xC4, 0x08); // add rsp, 8
+    EMIT(as, 0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5D, 0x5B, 0xC3); // pop r15, r14, r13, r12, rbp, rbx and ret
+
+    codeCache = memory;
+    codeCacheTop = as->pos;
+    return true;
+}
+
+/**
+ * Compiles every instruction of the method into the code cache
+ * @param method
+ * @param translatedCode
+ * @return the compiled code or NULL if the method has no stack map or the code cache or memory ran out
+ */
+static compiled_code_t *compileMethod(method_t *method, translated_code_t *translatedCode) {
+    // stack depths come from the stack map
+    stack_map_t *stackMap = getStackMap(method);
+    if(!stackMap)
+        return NULL;
+
+    uint32_t length = translatedCode->length;
+    compiled_code_t *compiledCode = malloc(sizeof(compiled_code_t));
+    if(!compiledCode)
+        return NULL;
+    compiledCode->words = translatedCode->code;
+    compiledCode->entries = calloc(length, sizeof(void *));
+    if(!compiledCode->entries)
+        goto fail1;
+    compilation_t c = {.translatedCode = translatedCode, .stackMap = stackMap, .compiledCode = compiledCode};
+    // every instruction has at most one jump to another instruction
+    c.branchFields = malloc(length * sizeof(uint8_t *));
+    if(!c.branchFields)
+        goto fail2;
+    c.branchTargets = malloc(length * sizeof(uint32_t));
+    if(!c.branchTargets)
+        goto fail3;
+
+    pthread_mutex_lock(&codeCacheMutex);
+    if(!codeCache && !initCodeCache())
+        goto fail4;
+    c.as.pos = codeCacheTop;
+    c.as.end = codeCache + CODE_CACHE_SIZE;
+
+    code_attribute_t *codeAttribute = method->codeAttribute;
+    for(uint32_t wordIndex = 0; wordIndex < length;) {
+        if(c.as.end - c.as.pos < MAX_TEMPLATE_SIZE)
+            goto fail4;
+        uint32_t numWords;
+        instructionSize(codeAttribute->code, translatedCode->bytecodeOffsets[wordIndex], codeAttribute->codeLength, &numWords);
+        compiledCode->entries[wordIndex] = c.as.pos;
+        compileInstruction(&c, wordIndex);
+        wordIndex += numWords;
+    }
+    // verified code doesn't fall off the end of the method
+    EMIT(&c.as, 0x0F, 0x0B); // ud2
+    for(uint32_t i = 0; i < c.numBranches; ++i)
+        patchJump(c.branchFields[i], compiledCode->entries[c.branchTargets[i]]);
+    codeCacheTop = c.as.pos;
+    pthread_mutex_unlock(&codeCacheMutex);
+
+    free(c.branchTargets);
+    free(c.branchFields);
+    return compiledCode;
+
+    // nothing is kept in the code cache since the top isn't moved
+    fail4: pthread_mutex_unlock(&codeCacheMutex);
+    free(c.branchTargets);
+    fail3: free(c.branchFields);
+    fail2: free(compiledCode->entries);
+    fail1: free(compiledCode);
+    return NULL;
+}
+
+bool compileHotMethod(stack_frame_t *frame) {
+    translated_code_t *translatedCode = getTranslatedCode(frame->currentMethod);
+    compiled_code_t *compiledCode = atomic_load_explicit(&translatedCode->compiledCode, memory_order_acquire);
+    if(!compiledCode) {
+        bool started = false;
+        if(atomic_compare_exchange_strong(&translatedCode->compilationStarted, &started, true))
+            compiledCode = compileMethod(frame->currentMethod, translatedCode);
+        if(!compiledCode) {
+            // another thread is compiling the method or it can't be compiled. Counting starts over so that this isn't
+            // checked again on every branch
+            atomic_store_explicit(&translatedCode->hotness, 0, memory_order_relaxed);
+            return false;
+        }
+        atomic_store_explicit(&translatedCode->compiledCode, compiledCode, memory_order_release);
+    }
+    frame->compiledCode = compiledCode;
+    return true;
+}
+
+int runCompiledCode(bc_interpreter_t *interpreter, stack_frame_t *callerFrame) {
+    return enterCompiledCode(interpreter, callerFrame);
+}
+
+void freeCompiledCode(compiled_code_t *compiledCode) {
+    if(!compiledCode)
+        return;
+    // the machine code stays in the code cache
+    free(compiledCode->entries);
+    free(compiledCode);
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef JVM_JIT_H
+#define JVM_JIT_H
+
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "bytecode_interpreter.h"
+#include "bytecode_translator.h"
+#include "classfile.h"
+
+// number of calls and taken branches after which a method is compiled
+#ifndef JIT_COMPILE_THRESHOLD
+#define JIT_COMPILE_THRESHOLD 10000
+#endif
+
+/**
+ * Machine code for a translated method. Every instruction gets a template of x86-64 code which works directly on the
+ * local variables and operand stack of the method's stack frame, so compiled and interpreted frames look the same and
+ * execution can switch between them at any instruction. Instructions without a template call their handler from
+ * instr_table.
+ */
+typedef struct compiled_code {
+    code_word_t *words; // the translated code the method was compiled from
+    void **entries; // address of the machine code for each word. NULL for words that don't start an instruction
+} compiled_code_t;
+
+/**
+ * Compiles the method of the frame if no other thread is already compiling it and switches the frame over to the
+ * compiled code
+ * @param frame
+ * @return true if the frame runs compiled code from now on
+ */
+bool compileHotMethod(stack_frame_t *frame);
+
+/**
+ * Counts a call or taken branch in the method of the frame and compiles the method once it becomes hot
+ * @param frame a frame that doesn't run compiled code yet
+ * @return true if the frame runs compiled code from now on
+ */
+static inline bool countHotness(stack_frame_t *frame) {
+    translated_code_t *translatedCode = atomic_load_explicit(&frame->currentMethod->codeAttribute->translatedCode, memory_order_relaxed);
+    // racing threads may lose counts which only delays compilation
+    uint32_t hotness = atomic_load_explicit(&translatedCode->hotness, memory_order_relaxed) + 1;
+    atomic_store_explicit(&translatedCode->hotness, hotness, memory_order_relaxed);
+    return hotness >= JIT_COMPILE_THRESHOLD && compileHotMethod(frame);
+}
+
+/**
+ * Runs compiled code starting at the thread's pc until execution reaches a frame without compiled code or an
+ * instruction returns to the caller of the interpreter or throws off the thread. Compiled code polls for safepoints at
+ * backward branches and after every handler that sets the pc. The pc
+ * and top of stack are synced to the thread whenever it returns.
+ * @param interpreter
+ * @param callerFrame the frame that called into the interpreter
+ * @return 0, -EJUST_RETURNED, or -ETHREW_OFF_THREAD with the same meaning as the return value of a handler
+ */
+int runCompiledCode(bc_interpreter_t *interpreter, stack_frame_t *callerFrame);
+
+void freeCompiledCode(compiled_code_t *compiledCode);
+
+#endif //JVM_JIT_H
@@ -4,54 +4,182 @@
 
 #include "jlock.h"
 #include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+// values of the state of a lock. Threads only wake parked threads when they release a contended lock
+#define JLOCK_UNLOCKED 0u
+#define JLOCK_LOCKED 1u
+#define JLOCK_CONTENDED 2u // locked and there might be parked threads
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CPU_RELAX() __builtin_ia32_pause()
+#else
+#define CPU_RELAX() atomic_signal_fence(memory_order_seq_cst)
+#endif
+
+#ifdef MONITOR_STATISTICS
+#define COUNT(jlock, counter, amount) atomic_fetch_add_explicit(&(jlock)->statistics.counter, (amount), memory_order_relaxed)
+#else
+#define COUNT(jlock, counter, amount) ((void) 0)
+#endif
+
+/**
+ * @return the time of a monotonic clock in nanoseconds
+ */
+static uint64_t currentTime() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t) time.tv_sec * 1000000000u + time.tv_nsec;
+}
+
+/**
+ * Parks the thread while the futex word has the expected value
+ * @param word
+ * @param expected
+ * @param timeout relative time after which the thread wakes up or NULL to wait until woken
+ * @return 0 if the thread was woken or the value didn't match, ETIMEDOUT or EINTR otherwise
+ */
+static int futexWait(atomic_uint *word, unsigned int expected, struct timespec *timeout) {
+    if(syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, expected, timeout, NULL, 0) == -1 && errno != EAGAIN)
+        return errno;
+    return 0;
+}
+
+static void futexWake(atomic_uint *word, int numThreads) {
+    syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, numThreads, NULL, NULL, 0);
+}
 
 void jlock_init(jlock_t *jlock) {
-    jlock->owner = 0;
+    atomic_init(&jlock->owner, 0);
     jlock->acquiredCount = 0;
-    pthread_mutex_init(&jlock->conditionMutex, NULL);
-    pthread_cond_init(&jlock->conditionVariable, NULL);
+    atomic_init(&jlock->state, JLOCK_UNLOCKED);
+    atomic_init(&jlock->notifySequence, 0);
+    jlock->acquireTime = 0;
+    atomic_init(&jlock->averageHoldTime, 0);
+#ifdef MONITOR_STATISTICS
+    atomic_init(&jlock->statistics.acquisitions, 0);
+    atomic_init(&jlock->statistics.contendedAcquisitions, 0);
+    atomic_init(&jlock->statistics.spins, 0);
+    atomic_init(&jlock->statistics.parks, 0);
+    atomic_init(&jlock->statistics.holdTime, 0);
+#endif
+}
+
+void jlock_transfer(jlock_t *jlock, int threadId, uint32_t acquiredCount) {
+    atomic_store_explicit(&jlock->state, threadId ? JLOCK_LOCKED : JLOCK_UNLOCKED, memory_order_relaxed);
+    atomic_store_explicit(&jlock->owner, threadId, memory_order_relaxed);
+    jlock->acquiredCount = threadId ? acquiredCount : 0;
+    jlock->acquireTime = currentTime();
+    if(threadId)
+        COUNT(jlock, acquisitions, 1);
+}
+
+/**
+ * Acquires the lock for the current thread without setting the owner. Spins while the lock is usually held briefly and
+ * parks the thread otherwise
+ * @param jlock
+ */
+static void acquire(jlock_t *jlock) {
+    unsigned int state = JLOCK_UNLOCKED;
+    if(atomic_compare_exchange_strong_explicit(&jlock->state, &state, JLOCK_LOCKED, memory_order_acquire, memory_order_relaxed))
+        return;
+    COUNT(jlock, contendedAcquisitions, 1);
+    
+    // the owner can't release the lock while another thread spins on the only processor
+    static atomic_int numProcessors = 0;
+    if(!atomic_load_explicit(&numProcessors, memory_order_relaxed))
+        atomic_store_explicit(&numProcessors, (int) sysconf(_SC_NPROCESSORS_ONLN), memory_order_relaxed);
+    uint64_t holdTime = atomic_load_explicit(&jlock->averageHoldTime, memory_order_relaxed);
+    if(atomic_load_explicit(&numProcessors, memory_order_relaxed) > 1 && holdTime <= JLOCK_MAX_SPIN_TIME) {
+        uint64_t spinTime = holdTime * 2 > JLOCK_MIN_SPIN_TIME ? holdTime * 2 : JLOCK_MIN_SPIN_TIME;
+        uint64_t spinEnd = currentTime() + spinTime;
+        uint64_t spins = 0;
+        do {
+            CPU_RELAX();
+            ++spins;
+            state = atomic_load_explicit(&jlock->state, memory_order_relaxed);
+            if(state == JLOCK_UNLOCKED && atomic_compare_exchange_weak_explicit(&jlock->state, &state, JLOCK_LOCKED, memory_order_acquire, memory_order_relaxed)) {
+                COUNT(jlock, spins, spins);
+                return;
+            }
+        } while(currentTime() < spinEnd);
+        COUNT(jlock, spins, spins);
+    }
+    
+    // the lock is marked as contended so the owner wakes a parked thread when it releases the lock. A thread which
+    // acquires it here keeps it marked since other threads might still be parked
+    while(atomic_exchange_explicit(&jlock->state, JLOCK_CONTENDED, memory_order_acquire) != JLOCK_UNLOCKED) {
+        COUNT(jlock, parks, 1);
+        futexWait(&jlock->state, JLOCK_CONTENDED, NULL);
+    }
+}
+
+/**
+ * Releases the lock completely and wakes a parked thread if there is one
+ * @param jlock
+ */
+static void release(jlock_t *jlock) {
+    uint64_t holdTime = currentTime() - jlock->acquireTime;
+    uint64_t averageHoldTime = atomic_load_explicit(&jlock->averageHoldTime, memory_order_relaxed);
+    // only the owner updates the average, so it doesn't need to be updated atomically
+    averageHoldTime = averageHoldTime - averageHoldTime / 8 + holdTime / 8;
+    atomic_store_explicit(&jlock->averageHoldTime, averageHoldTime, memory_order_relaxed);
+    COUNT(jlock, holdTime, holdTime);
+    
+    atomic_store_explicit(&jlock->owner, 0, memory_order_relaxed);
+    jlock->acquiredCount = 0;
+    if(atomic_exchange_explicit(&jlock->state, JLOCK_UNLOCKED, memory_order_release) == JLOCK_CONTENDED)
+        futexWake(&jlock->state, 1);
 }
 
 void jlock_lock(int threadId, jlock_t *jlock) {
-    if(jlock->owner == threadId) {
+    // only the owner stores its own id, so any other thread never sees its id here
+    if(atomic_load_explicit(&jlock->owner, memory_order_relaxed) == threadId) {
         ++jlock->acquiredCount;
+        return;
     }
-    else {
-        pthread_mutex_lock(&jlock->conditionMutex);
-        jlock->owner = threadId;
-        jlock->acquiredCount = 1;
-    }
+    acquire(jlock);
+    atomic_store_explicit(&jlock->owner, threadId, memory_order_relaxed);
+    jlock->acquiredCount = 1;
+    jlock->acquireTime = currentTime();
+    COUNT(jlock, acquisitions, 1);
 }
 
 void jlock_unlock(int threadId, jlock_t *jlock) {
     // sanity check to make sure it's not called on an unowned lock
-    if(jlock->owner == threadId) {
+    if(atomic_load_explicit(&jlock->owner, memory_order_relaxed) == threadId) {
         // at this point no other thread should act on jlock->acquiredCount so we don't need to atomically modify it.
         --jlock->acquiredCount;
         
-        if(!jlock->acquiredCount) {
-            // since we no longer have the lock, we should give up ownership
-            jlock->owner = 0;
-            pthread_mutex_unlock(&jlock->conditionMutex);
-        }
+        // since we no longer have the lock, we should give up ownership
+        if(!jlock->acquiredCount)
+            release(jlock);
     }
 }
 
 int jlock_wait(jlock_t *jlock, uint64_t millis) {
-    struct timespec timespec;
-    clock_gettime(CLOCK_REALTIME, &timespec);
-    timespec.tv_sec += millis / 1000;
-    timespec.tv_nsec += (millis % 1000) * 1000000;
-    if(timespec.tv_nsec >= 1000000000) {
-        timespec.tv_nsec -= 1000000000;
-        ++timespec.tv_sec;
-    }
+    struct timespec timeout = {.tv_sec = millis / 1000, .tv_nsec = (millis % 1000) * 1000000};
+    
+    // the lock is released while waiting and reacquired with the same count afterwards. The sequence is read before
+    // releasing the lock, so a notify which happens after the lock is released keeps the thread from parking
+    int owner = atomic_load_explicit(&jlock->owner, memory_order_relaxed);
+    uint32_t acquiredCount = jlock->acquiredCount;
+    unsigned int sequence = atomic_load_explicit(&jlock->notifySequence, memory_order_relaxed);
+    release(jlock);
+    
+    int result = futexWait(&jlock->notifySequence, sequence, millis ? &timeout : NULL);
     
-    int result;
-    if(millis)
-        result = pthread_cond_timedwait(&jlock->conditionVariable, &jlock->conditionMutex, &timespec);
-    else
-        result = pthread_cond_wait(&jlock->conditionVariable, &jlock->conditionMutex);
+    acquire(jlock);
+    atomic_store_explicit(&jlock->owner, owner, memory_order_relaxed);
+    jlock->acquiredCount = acquiredCount;
+    jlock->acquireTime = currentTime();
+    COUNT(jlock, acquisitions, 1);
     
     if(result == ETIMEDOUT)
         return 1;
@@ -59,9 +187,23 @@ int jlock_wait(jlock_t *jlock, uint64_t millis) {
 }
 
 void jlock_notify(jlock_t *jlock) {
-    pthread_cond_signal(&jlock->conditionVariable);
+    atomic_fetch_add_explicit(&jlock->notifySequence, 1, memory_order_release);
+    futexWake(&jlock->notifySequence, 1);
 }
 
 void jlock_notifyAll(jlock_t *jlock) {
-    pthread_cond_broadcast(&jlock->conditionVariable);
-}
\ No newline at end of file
+    atomic_fetch_add_explicit(&jlock->notifySequence, 1, memory_order_release);
+    futexWake(&jlock->notifySequence, INT_MAX);
+}
+
+#ifdef MONITOR_STATISTICS
+void jlock_printStatistics(jlock_t *jlock, const char *name) {
+    jlock_statistics_t *statistics = &jlock->statistics;
+    uint64_t contended = atomic_load(&statistics->contendedAcquisitions);
+    if(!contended)
+        return;
+    printf("%s: %" PRIuFAST64 " acquisitions, %" PRIuFAST64 " contended, %" PRIuFAST64 " spins, %" PRIuFAST64 " parks, %.3f ms held\n",
+           name, atomic_load(&statistics->acquisitions), contended, atomic_load(&statistics->spins),
+           atomic_load(&statistics->parks), atomic_load(&statistics->holdTime) / 1e6);
+}
+#endif
@@ -6,17 +6,53 @@
 #define JVM_JLOCK_H
 
 #include <stdint.h>
-#include <pthread.h>
+#include <stdatomic.h>
 
-// jlock_t is a re-entrant lock which is used by the jvm
+// a thread which finds a lock held spins for about twice as long as the lock was held recently before it parks. Locks
+// which are usually held for longer than JLOCK_MAX_SPIN_TIME nanoseconds aren't spun on since parking is cheaper then
+#ifndef JLOCK_MAX_SPIN_TIME
+#define JLOCK_MAX_SPIN_TIME 50000
+#endif
+// minimum time in nanoseconds a thread spins on a lock which is only held briefly
+#ifndef JLOCK_MIN_SPIN_TIME
+#define JLOCK_MIN_SPIN_TIME 1000
+#endif
+
+#ifdef MONITOR_STATISTICS
+typedef struct jlock_statistics {
+    atomic_uint_fast64_t acquisitions; // not counting reentries
+    atomic_uint_fast64_t contendedAcquisitions;
+    atomic_uint_fast64_t spins;
+    atomic_uint_fast64_t parks;
+    atomic_uint_fast64_t holdTime; // total nanoseconds the lock was held
+} jlock_statistics_t;
+#endif
+
+// jlock_t is a re-entrant lock which is used by the jvm. It belongs to a thread id, so a thin lock can be inflated into
+// a jlock_t on behalf of the thread which holds it. Contended threads spin for a while and then park on a futex
 typedef struct jlock {
-    volatile int owner;
+    atomic_int owner; // 0 while the lock isn't held
     uint32_t acquiredCount;
-    pthread_mutex_t conditionMutex;
-    pthread_cond_t conditionVariable;
+    atomic_uint state; // futex word, see jlock.c
+    atomic_uint notifySequence; // futex word waiting threads park on, incremented by every notify
+    uint64_t acquireTime; // when the owner acquired the lock
+    atomic_uint_fast64_t averageHoldTime; // in nanoseconds, weighted towards the most recent acquisitions
+#ifdef MONITOR_STATISTICS
+    jlock_statistics_t statistics;
+#endif
 } jlock_t;
 
 void jlock_init(jlock_t *jlock);
+
+/**
+ * Makes a thread the owner of an unlocked lock as if it acquired the lock acquiredCount times. Only valid while no other
+ * thread can use the lock
+ * @param jlock
+ * @param threadId the new owner or 0 to leave the lock unlocked
+ * @param acquiredCount
+ */
+void jlock_transfer(jlock_t *jlock, int threadId, uint32_t acquiredCount);
+
 void jlock_lock(int threadId, jlock_t *jlock);
 void jlock_unlock(int threadId, jlock_t *jlock);
 
@@ -24,4 +60,13 @@ int jlock_wait(jlock_t *jlock, uint64_t millis);
 void jlock_notify(jlock_t *jlock);
 void jlock_notifyAll(jlock_t *jlock);
 
-#endif //JVM_JLOCK_H
\ No newline at end of file
+#ifdef MONITOR_STATISTICS
+/**
+ * Prints the contention statistics of the lock if it was ever contended
+ * @param jlock
+ * @param name describes what the lock belongs to
+ */
+void jlock_printStatistics(jlock_t *jlock, const char *name);
+#endif
+
+#endif //JVM_JLOCK_H
@@ -6,7 +6,9 @@
 #include <sys/mman.h>
 #include "utils.h"
 #include "gc.h"
+#include "mm.h"
 #include "bytecode_interpreter.h"
+#include "bytecode_translator.h"
 #include <stdio.h>
 #include <stdatomic.h>
 #include "flags.h"
@@ -21,6 +23,9 @@ atomic_int nextThreadId = 1;
  * @return
  */
 jthread_t *createThread(char *name, method_t *method, object_t *arg, size_t stackSize) {
+    translated_code_t *translatedCode = getTranslatedCode(method);
+    if(!translatedCode)
+        return NULL;
     jthread_t *jthread = malloc(sizeof(jthread_t));
     if(!jthread)
         return NULL;
@@ -31,17 +36,23 @@ jthread_t *createThread(char *name, method_t *method, object_t *arg, size_t stac
     }
     jthread->stackSize = stackSize;
     if(method->numParameters)
-        ((cell_t *) jthread->stack)->a = arg->slot;
+        ((cell_t *) jthread->stack)->a = getReference(arg);
     jthread->currentStackFrame = jthread->stack + ALIGN(method->codeAttribute->maxLocals * sizeof(cell_t));
     stack_frame_t *stackFrame = jthread->currentStackFrame;
     stackFrame->currentMethod = method;
     stackFrame->previousStackFrame = NULL;
     stackFrame->prevFramePC = NULL;
     stackFrame->localVariableBase = jthread->stack;
-    stackFrame->operandStackTypeBase = (void *) stackFrame + sizeof(stackFrame);
-    stackFrame->operandStackBase = (void *) stackFrame->operandStackTypeBase + ALIGN(method->codeAttribute->maxStack);
+    stackFrame->operandStackBase = (void *) stackFrame + sizeof(stack_frame_t);
     stackFrame->topOfStack = 0;
-    jthread->pc = method->codeAttribute->code;
+#ifdef BASELINE_JIT
+    stackFrame->compiledCode = atomic_load_explicit(&translatedCode->compiledCode, memory_order_acquire);
+#endif
+    jthread->pc = translatedCode->code;
+    jthread->tlab = (tlab_t) {NULL, NULL, 0};
+    jthread->slotCache.numSlots = 0;
+    jthread->roots.numSlots = 0;
+    jthread->satbBuffer.numSlots = 0;
     jthread->id = nextThreadId++;
     
     return jthread;
@@ -83,50 +94,35 @@ double_cell_t readLocal2(stack_frame_t *stackFrame, uint16_t index, uint8_t *typ
     return *(double_cell_t *) (stackFrame->localVariableBase + index);
 }
 
-void writeLocal(stack_frame_t *stackFrame, uint16_t index, cell_t value, uint8_t type) {
+void writeLocal(stack_frame_t *stackFrame, uint16_t index, cell_t value) {
     stackFrame->localVariableBase[index] = value;
 }
 
-void writeLocal2(stack_frame_t *stackFrame, uint16_t index, double_cell_t value, uint8_t type) {
+void writeLocal2(stack_frame_t *stackFrame, uint16_t index, double_cell_t value) {
     *(double_cell_t *) (stackFrame->localVariableBase + index) = value;
 }
 
-cell_t popOperand(stack_frame_t *stackFrame, uint8_t *type) {
-    if(type)
-        *type = stackFrame->operandStackTypeBase[stackFrame->topOfStack - 1];
+cell_t popOperand(stack_frame_t *stackFrame) {
     return *(stackFrame->operandStackBase + --stackFrame->topOfStack);
 }
 
-double_cell_t popOperand2(stack_frame_t *stackFrame, uint8_t *type) {
-    if(type)
-        *type = stackFrame->operandStackTypeBase[stackFrame->topOfStack - 2];
+double_cell_t popOperand2(stack_frame_t *stackFrame) {
     return *(double_cell_t *) (stackFrame->operandStackBase + (stackFrame->topOfStack -= 2));
 }
 
-cell_t peekOperand(stack_frame_t *stackFrame, uint16_t index, uint8_t *type) {
-    if(type)
-        *type = stackFrame->operandStackTypeBase[stackFrame->topOfStack - 1 - index];
-    return *(stackFrame->operandStackBase - 1 - index);
-}
-
-double_cell_t peekOperand2(stack_frame_t *stackFrame, uint16_t index, uint8_t *type) {
-    if(type)
-        *type = stackFrame->operandStackTypeBase[stackFrame->topOfStack - 2 - index];
-    return *(double_cell_t *) (stackFrame->operandStackBase - 2 - index);
+cell_t peekOperand(stack_frame_t *stackFrame, uint16_t index) {
+    return *(stackFrame->operandStackBase + stackFrame->topOfStack - 1 - index);
 }
 
-uint8_t peekOperandType(stack_frame_t *stackFrame, uint16_t index) {
-    return stackFrame->operandStackTypeBase[stackFrame->topOfStack - 1 - index];
+double_cell_t peekOperand2(stack_frame_t *stackFrame, uint16_t index) {
+    return *(double_cell_t *) (stackFrame->operandStackBase + stackFrame->topOfStack - 2 - index);
 }
 
-void pushOperand(stack_frame_t *stackFrame, cell_t value, uint8_t type) {
-    stackFrame->operandStackTypeBase[stackFrame->topOfStack] = type;
+void pushOperand(stack_frame_t *stackFrame, cell_t value) {
     *(stackFrame->operandStackBase + stackFrame->topOfStack++) = value;
 }
 
-void pushOperand2(stack_frame_t *stackFrame, double_cell_t value, uint8_t type) {
-    stackFrame->operandStackTypeBase[stackFrame->topOfStack] = type;
-    stackFrame->operandStackTypeBase[stackFrame->topOfStack + 1] = type;
+void pushOperand2(stack_frame_t *stackFrame, double_cell_t value) {
     *(double_cell_t *) (stackFrame->operandStackBase + stackFrame->topOfStack) = value;
     stackFrame->topOfStack += 2;
 }
\ No newline at end of file
@@ -9,23 +9,57 @@
 #include <stdlib.h>
 #include "object.h"
 #include "dataTypes.h"
+#include "indirection.h"
+
+// instructions of a translated method. See bytecode_translator.h
+union code_word;
 
 typedef struct stack_frame {
     struct stack_frame *previousStackFrame;
-    void *prevFramePC;
+    union code_word *prevFramePC;
     method_t *currentMethod;
     cell_t *localVariableBase;
-    uint8_t *operandStackTypeBase;
     cell_t *operandStackBase;
     uint16_t topOfStack;
+#ifdef BASELINE_JIT
+    struct compiled_code *compiledCode; // set once the frame switches to compiled code
+#endif
 } stack_frame_t;
 
+// part of eden a thread allocates from without locking. See heap.c
+typedef struct tlab {
+    void *top; // the next object is allocated here
+    void *end;
+    size_t allocated; // bytes the thread recently took from eden, which decides the size of its next buffer
+} tlab_t;
+
+// newArray keeps every array it's still filling in alive, which is one per dimension
+#define MAX_ROOTS 256
+
+// handles of objects which only C code references, for example while more objects are allocated to fill them in
+typedef struct root_stack {
+    slot_t slots[MAX_ROOTS];
+    uint16_t numSlots;
+} root_stack_t;
+
+// references a thread overwrites while the old generation is marked concurrently, which are handed to the gc in batches
+#define SATB_BUFFER_SIZE 256
+
+typedef struct satb_buffer {
+    slot_t slots[SATB_BUFFER_SIZE];
+    uint16_t numSlots;
+} satb_buffer_t;
+
 typedef struct jthread {
     pthread_t pthread;
     void *stack;
     stack_frame_t *currentStackFrame;
-    void *pc;
+    union code_word *pc;
     size_t stackSize;
+    tlab_t tlab;
+    slot_cache_t slotCache;
+    root_stack_t roots;
+    satb_buffer_t satbBuffer;
     int id;
 } jthread_t;
 
@@ -45,18 +79,16 @@ void threadStart(jthread_t *jthread);
 cell_t readLocal(stack_frame_t *stackFrame, uint16_t index, uint8_t *type);
 double_cell_t readLocal2(stack_frame_t *stackFrame, uint16_t index, uint8_t *type);
 
-void writeLocal(stack_frame_t *stackFrame, uint16_t index, cell_t value, uint8_t type);
-void writeLocal2(stack_frame_t *stackFrame, uint16_t index, double_cell_t value, uint8_t type);
-
-cell_t popOperand(stack_frame_t *stackFrame, uint8_t *type);
-double_cell_t popOperand2(stack_frame_t *stackFrame, uint8_t *type);
+void writeLocal(stack_frame_t *stackFrame, uint16_t index, cell_t value);
+void writeLocal2(stack_frame_t *stackFrame, uint16_t index, double_cell_t value);
 
-cell_t peekOperand(stack_frame_t *stackFrame, uint16_t index, uint8_t *type);
-double_cell_t peekOperand2(stack_frame_t *stackFrame, uint16_t index, uint8_t *type);
+cell_t popOperand(stack_frame_t *stackFrame);
+double_cell_t popOperand2(stack_frame_t *stackFrame);
 
-uint8_t peekOperandType(stack_frame_t *stackFrame, uint16_t index);
+cell_t peekOperand(stack_frame_t *stackFrame, uint16_t index);
+double_cell_t peekOperand2(stack_frame_t *stackFrame, uint16_t index);
 
-void pushOperand(stack_frame_t *stackFrame, cell_t value, uint8_t type);
-void pushOperand2(stack_frame_t *stackFrame, double_cell_t value, uint8_t type);
+void pushOperand(stack_frame_t *stackFrame, cell_t value);
+void pushOperand2(stack_frame_t *stackFrame, double_cell_t value);
 
 #endif //JVM_JTHREAD_H
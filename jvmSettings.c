@@ -7,4 +7,9 @@
 
 size_t maxHeap = MEBIBYTES((size_t) 256);
 size_t stackSize = MEBIBYTES((size_t) 1);
-size_t gcInterval = 200;
\ No newline at end of file
+size_t gcInterval = 0;
+size_t gcThreads = 0;
+size_t tenuringThreshold = 6;
+size_t classLoaderThreads = 0;
+bool concurrentMarking = false;
+char *classpathIndexFile = NULL;
\ No newline at end of file
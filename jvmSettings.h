@@ -6,9 +6,15 @@
 #define JVM_JVMSETTINGS_H
 
 #include <stdlib.h>
+#include <stdbool.h>
 
 extern size_t maxHeap;
 extern size_t stackSize;
 extern size_t gcInterval;
+extern size_t gcThreads; // 0 uses one gc thread per processor
+extern size_t tenuringThreshold; // number of young gcs an object survives before it's moved to the old generation
+extern size_t classLoaderThreads; // 0 uses one class loader thread per processor
+extern bool concurrentMarking; // mark the old generation while java threads run instead of stopping them
+extern char *classpathIndexFile; // file the listings of classpath directories are kept in between runs or NULL
 
 #endif //JVM_JVMSETTINGS_H
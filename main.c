@@ -10,26 +10,33 @@
 #include "mm.h"
 #include "classloader.h"
 #include "flags.h"
+#include "bytecode_interpreter.h"
+#include "monitor.h"
+#include "classpath_index.h"
 
 object_t *convertToJavaArgs(int numArgs, char **args) {
     class_t *stringClass = loadClass("java/lang/String");
     if(!stringClass)
         return NULL;
     
-    slot_t stringArraySlot = newArray(1, &numArgs, stringClass);
+    slot_t stringArraySlot = newArray(NULL, 1, &numArgs, stringClass);
     if(!stringArraySlot)
         return NULL;
     
-    object_t *stringArray = getObject(stringArraySlot);
+    // the arguments stay alive for the whole run
+    pushRoot(NULL, stringArraySlot);
     for(int i = 0; i < numArgs; i++) {
-        slot_t stringSlot = convertToJavaString(args[i]);
+        slot_t stringSlot = convertToJavaString(NULL, args[i]);
         if(!stringSlot)
             return NULL;
         cell_t cell = {.a = stringSlot};
+        // converting the string can move the array, even into the old generation
+        object_t *stringArray = getObject(peekRoot(NULL));
+        MARK_CARD((slot_t *) ARRAY_ELEMENTS(stringArray) + i);
         setArrayElement(stringArray, i, cell);
     }
     
-    return stringArray;
+    return getObject(peekRoot(NULL));
 }
 
 int main(int argc, char **args) {
@@ -39,7 +46,7 @@ int main(int argc, char **args) {
     char **progArgs = NULL;
     
     if(argc <= 1) {
-        printf("JVM [options] classfile [args]\n    [options] -jar jarfile [args]\n\nOptions:\n    -Xmx<size>\t\t\t\tsize in bytes of the heap\n    -Xss<size>\t\t\t\tsize in bytes of each thread's stack\n    -Xgci<millis>\t\t\tinterval between each garbage collection cycle\n\t-classpath=<classpath>\tadditional classpath to look for classes. Can be a directory, jar, or zip file. This option can be specified multiple times.\n\n\t<size> must be a multiple of 4096 bytes. It can be suffixed with k, m, or g to specify a size in kibibytes, mebibytes, or gibibytes\n");
+        printf("JVM [options] classfile [args]\n    [options] -jar jarfile [args]\n\nOptions:\n    -Xmx<size>\t\t\t\tsize in bytes of the heap\n    -Xss<size>\t\t\t\tsize in bytes of each thread's stack\n    -Xgci<millis>\t\t\tmaximum interval between garbage collection cycles while objects are allocated. Defaults to 0 which only collects when enough was allocated\n    -Xgct<threads>\t\t\tnumber of threads which collect garbage in parallel. Defaults to 0 which uses one per processor\n    -Xgca<age>\t\t\t\tnumber of young garbage collection cycles an object survives before it is moved to the old generation. Defaults to 6\n    -Xgcc\t\t\t\t\tmark the old generation while java threads run so that major garbage collections only pause them briefly\n    -Xclt<threads>\t\t\tnumber of threads which load the classes referenced by loaded classes before they are needed. Defaults to 0 which uses one per processor\n\t-classpath=<classpath>\tadditional classpath to look for classes. Can be a directory, jar, or zip file. This option can be specified multiple times.\n\t-classpathIndex=<file>\tfile which keeps the class files in each directory of the classpath between runs, so directories which didn't change aren't read again\n\n\t<size> must be a multiple of 4096 bytes. It can be suffixed with k, m, or g to specify a size in kibibytes, mebibytes, or gibibytes\n");
         return 0;
     }
     
@@ -134,9 +141,77 @@ int main(int argc, char **args) {
                 return 1;
             }
         }
+        else if(startsWith(args[i], "-Xgct")) {
+            if(strLen > 5) {
+                char *numEnd;
+                size_t numGCThreads = strtoumax(args[i] + 5, &numEnd, 10);
+                if(numEnd < args[i] + strLen) {
+                    printf("Could not parse argument: %s", args[i]);
+                    return 1;
+                }
+        
+                gcThreads = numGCThreads;
+            }
+            else {
+                printf("Could not parse argument: %s", args[i]);
+                return 1;
+            }
+        }
+        else if(startsWith(args[i], "-Xgca")) {
+            if(strLen > 5) {
+                char *numEnd;
+                size_t age = strtoumax(args[i] + 5, &numEnd, 10);
+                if(numEnd < args[i] + strLen) {
+                    printf("Could not parse argument: %s", args[i]);
+                    return 1;
+                }
+                // the age of an object is stored in 4 bits of its lock word
+                if(age > MAX_AGE) {
+                    printf("The tenuring threshold can be at most %u\n", MAX_AGE);
+                    return 1;
+                }
+        
+                tenuringThreshold = age;
+            }
+            else {
+                printf("Could not parse argument: %s", args[i]);
+                return 1;
+            }
+        }
+        else if(!strcmp(args[i], "-Xgcc")) {
+            concurrentMarking = true;
+        }
+        else if(startsWith(args[i], "-Xclt")) {
+            if(strLen > 5) {
+                char *numEnd;
+                size_t numLoaderThreads = strtoumax(args[i] + 5, &numEnd, 10);
+                if(numEnd < args[i] + strLen) {
+                    printf("Could not parse argument: %s", args[i]);
+                    return 1;
+                }
+        
+                classLoaderThreads = numLoaderThreads;
+            }
+            else {
+                printf("Could not parse argument: %s", args[i]);
+                return 1;
+            }
+        }
         else if(startsWith(args[i], "-classpath=")) {
             if(strLen > 11) {
-                addToClasspath(args[i] + 11);
+                if(!addToClasspath(args[i] + 11)) {
+                    printf("Failed to add to the classpath: %s\n", args[i] + 11);
+                    return 1;
+                }
+            }
+            else {
+                printf("Could not parse argument: %s", args[i]);
+                return 1;
+            }
+        }
+        else if(startsWith(args[i], "-classpathIndex=")) {
+            if(strLen > 16) {
+                classpathIndexFile = args[i] + 16;
             }
             else {
                 printf("Could not parse argument: %s", args[i]);
@@ -169,6 +244,11 @@ int main(int argc, char **args) {
         return 1;
     }
     
+    if(classpathIndexFile && !loadClasspathIndex(classpathIndexFile)) {
+        printf("Failed to load the classpath index: %s\n", classpathIndexFile);
+        return 1;
+    }
+    
     if(!initHeap()) {
         printf("Failed to initialize heap\n");
         return 1;
@@ -180,19 +260,24 @@ int main(int argc, char **args) {
         return 1;
     }
     
-    class_t *mainClass;
+    // the jar has to be on the classpath before the class loader threads start
+    char *mainClassName = classOrJar;
     if(isJar) {
-        printf("Jar loading is not yet implemented\n");
-        return 1;
-    }
-    else {
-        mainClass = loadClass(classOrJar);
-        if(!mainClass) {
-            printf("Failed to find class: %s\n", classOrJar);
+        mainClassName = addJarToClasspath(classOrJar);
+        if(!mainClassName)
             return 1;
-        }
     }
     
+    if(!startClassLoaderThreads()) {
+        printf("Failed to start class loader threads\n");
+        return 1;
+    }
+    
+    // the class loader reports why the class couldn't be loaded
+    class_t *mainClass = loadClass(mainClassName);
+    if(!mainClass)
+        return 1;
+    
     object_t *javaArgs = convertToJavaArgs(numArgs, progArgs);
     
     method_t *main = NULL;
@@ -209,11 +294,28 @@ int main(int argc, char **args) {
     }
     
     jthread_t *mainThread = createThread("Main", main, (object_t *) javaArgs, stackSize);
+    if(!mainThread) {
+        printf("Failed to create main thread\n");
+        return 1;
+    }
     threadStart(mainThread);
     
     // Now we're done, so this thread can pause until all threads are done
     while(numThreads)
         sched_yield();
     
+#ifdef INLINE_CACHE_STATISTICS
+    printInlineCacheStatistics();
+#endif
+#ifdef OPCODE_PROFILING
+    printOpcodeProfile();
+#endif
+#ifdef MONITOR_STATISTICS
+    printMonitorStatistics();
+#endif
+    
+    if(classpathIndexFile && !saveClasspathIndex(classpathIndexFile))
+        printf("Failed to save the classpath index: %s\n", classpathIndexFile);
+    
     return 0;
 }
\ No newline at end of file
@@ -6,34 +6,49 @@
 #include "heap.h"
 #include <string.h>
 #include "classloader.h"
+#include "gc.h"
 
 /**
  *
+ * @param jthread the current thread or NULL if it isn't a java thread
  * @param class
  * @return a slot containing an uninitialized instance of the class. If the returned value is 0 then no object was created because of a lack of memory
  */
-slot_t newObject(class_t *class) {
-    slot_t slot = allocateSlot(addrIndInfo);
+slot_t newObject(jthread_t *jthread, class_t *class) {
+#ifdef DIRECT_REFERENCES
+    object_t *object = allocateObject(jthread, class);
+    if(!object)
+        return 0;
+    object->class = class;
+    slot_t slot = getReference(object);
+    markAllocatedObject(slot);
+#else
+    slot_t slot = allocateSlot(addrIndInfo, jthread ? &jthread->slotCache : NULL);
     if(slot) {
-        object_t *object = allocateObject(class);
+        object_t *object = allocateObject(jthread, class);
         if(!object) {
             freeSlot(addrIndInfo, slot);
             return 0;
         }
         setRawAddress(addrIndInfo, slot, object);
         object->class = class;
-        jlock_init(&object->jlock);
         object->slot = slot;
+        markAllocatedObject(slot);
     }
+#endif
     return slot;
 }
 
-slot_t newArray(uint8_t numDimensions, int32_t *sizes, class_t *class) {
+slot_t newArray(jthread_t *jthread, uint8_t numDimensions, int32_t *sizes, class_t *class) {
     if(numDimensions == 0)
         return 0;
-    slot_t slot = allocateSlot(addrIndInfo);
+#ifdef DIRECT_REFERENCES
+    slot_t slot;
+#else
+    slot_t slot = allocateSlot(addrIndInfo, jthread ? &jthread->slotCache : NULL);
     if(!slot)
         return 0;
+#endif
     char *className = malloc(numDimensions + 3u + strlen(class->name));
     if(!className)
         goto fail1;
@@ -50,33 +65,54 @@ slot_t newArray(uint8_t numDimensions, int32_t *sizes, class_t *class) {
     if(!arrayClass)
         goto fail2;
     int elementSize = arrayElementSize(arrayClass);
-    object_t *arrayObj = allocateArrayObject(arrayClass, elementSize, sizes[0], numDimensions == 1);
+    // the elements of arrays with several dimensions are zeroed too since the gc visits them while the sub arrays are
+    // allocated
+    object_t *arrayObj = allocateArrayObject(jthread, arrayClass, elementSize, sizes[0], true);
     if(!arrayObj)
         goto fail2;
+#ifdef DIRECT_REFERENCES
+    slot = getReference(arrayObj);
+#else
     setRawAddress(addrIndInfo, slot, arrayObj);
-    arrayObj->class = arrayClass;
-    jlock_init(&arrayObj->jlock);
     arrayObj->slot = slot;
-    arrayObj->length = sizes[0];
+#endif
+    arrayObj->class = arrayClass;
+    ARRAY_LENGTH(arrayObj) = sizes[0];
+    markAllocatedObject(slot);
     
     if(numDimensions > 1) {
-        slot_t *elements = (slot_t *) (arrayObj + 1);
+        // allocating the sub arrays can run the gc, which moves the array
+        pushRoot(jthread, slot);
         for(i = 0; i < sizes[0]; i++) {
-            slot_t subArray = newArray(numDimensions - 1, sizes + 1, class);
-            if(!subArray)
+            slot_t subArray = newArray(jthread, numDimensions - 1, sizes + 1, class);
+            if(!subArray) {
                 // garbage collector will free all the objects
+                popRoot(jthread);
                 return 0;
-            elements[i] = subArray;
+            }
+            slot_t *element = (slot_t *) ARRAY_ELEMENTS(getObject(peekRoot(jthread))) + i;
+            MARK_CARD(element);
+            *element = subArray;
         }
+        slot = popRoot(jthread);
     }
     
     return slot;
     
     fail2: free(className);
-    fail1: freeSlot(addrIndInfo, slot);
+    fail1:
+#ifndef DIRECT_REFERENCES
+    freeSlot(addrIndInfo, slot);
+#endif
     return 0;
 }
 
+#ifndef DIRECT_REFERENCES
 object_t *getObject(slot_t slot) {
     return getRawAddress(addrIndInfo, slot);
-}
\ No newline at end of file
+}
+
+slot_t getReference(object_t *obj) {
+    return obj ? obj->slot : 0;
+}
+#endif
\ No newline at end of file
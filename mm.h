@@ -8,10 +8,30 @@
 #include "classfile.h"
 #include "dataTypes.h"
 #include "object.h"
+#include "jthread.h"
+#ifdef DIRECT_REFERENCES
+#include "heap.h"
+#endif
 
-slot_t newObject(class_t *class);
-slot_t newArray(uint8_t numDimensions, int32_t *sizes, class_t *class);
+slot_t newObject(jthread_t *jthread, class_t *class);
+slot_t newArray(jthread_t *jthread, uint8_t numDimensions, int32_t *sizes, class_t *class);
 
+#ifdef DIRECT_REFERENCES
+static inline object_t *getObject(slot_t slot) {
+    return slot ? referenceBase + ((size_t) slot << 3u) : NULL;
+}
+
+static inline slot_t getReference(object_t *obj) {
+    return obj ? ((void *) obj - referenceBase) >> 3u : 0;
+}
+#else
 object_t *getObject(slot_t slot);
 
+/**
+ * @param obj
+ * @return the reference which is stored in fields, array elements, and on the stack to refer to the object
+ */
+slot_t getReference(object_t *obj);
+#endif
+
 #endif //JVM_MM_H
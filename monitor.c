@@ -0,0 +1,261 @@
+#include "monitor.h"
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <pthread.h>
+#include "jlock.h"
+#include "classloader.h"
+
+typedef struct monitor {
+    jlock_t jlock;
+    // number of threads which hold the monitor, wait on it, or are about to lock it, or -1 while it's deflated. Each
+    // thread is counted once no matter how often it reentered the monitor
+    atomic_int users;
+    uint32_t nextFree; // index + 1 of the next free monitor or 0 if it's the last one
+} monitor_t;
+
+static monitor_t *monitorChunks[MAX_MONITORS / MONITOR_CHUNK_SIZE];
+static uint32_t numMonitors = 0;
+static uint32_t freeMonitors = 0;
+static pthread_mutex_t monitorTableMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline monitor_t *getMonitor(uint32_t index) {
+    return monitorChunks[index / MONITOR_CHUNK_SIZE] + index % MONITOR_CHUNK_SIZE;
+}
+
+static uint32_t allocateMonitor() {
+    pthread_mutex_lock(&monitorTableMutex);
+    uint32_t index;
+    if(freeMonitors) {
+        index = freeMonitors - 1;
+        freeMonitors = getMonitor(index)->nextFree;
+    }
+    else {
+        if(numMonitors == MAX_MONITORS) {
+            printf("OutOfMemoryError: Too many monitors are in use\n");
+            exit(1);
+        }
+        index = numMonitors++;
+        if(index % MONITOR_CHUNK_SIZE == 0) {
+            monitor_t *chunk = malloc(MONITOR_CHUNK_SIZE * sizeof(monitor_t));
+            if(!chunk) {
+                printf("OutOfMemoryError: Failed to allocate monitors\n");
+                exit(1);
+            }
+            for(size_t i = 0; i < MONITOR_CHUNK_SIZE; ++i)
+                jlock_init(&chunk[i].jlock);
+            monitorChunks[index / MONITOR_CHUNK_SIZE] = chunk;
+        }
+    }
+    pthread_mutex_unlock(&monitorTableMutex);
+    return index;
+}
+
+static void freeMonitor(uint32_t index) {
+    pthread_mutex_lock(&monitorTableMutex);
+    getMonitor(index)->nextFree = freeMonitors;
+    freeMonitors = index + 1;
+    pthread_mutex_unlock(&monitorTableMutex);
+}
+
+/**
+ * Replaces the lock word of the object with an inflated lock
+ * @param obj
+ * @param word the lock word the object currently has
+ * @param owner the thread which holds the lock or 0 if it's unlocked
+ * @param acquiredCount the number of times the owner acquired the lock
+ * @return false if the lock word changed in the meantime
+ */
+static bool inflate(object_t *obj, uint32_t word, int owner, uint32_t acquiredCount) {
+    uint32_t index = allocateMonitor();
+    monitor_t *monitor = getMonitor(index);
+    jlock_transfer(&monitor->jlock, owner, acquiredCount);
+    atomic_store_explicit(&monitor->users, owner ? 1 : 0, memory_order_release);
+    uint32_t inflated = (word & LOCK_AGE_MASK) | index << MONITOR_INDEX_SHIFT | LOCK_INFLATED;
+    if(atomic_compare_exchange_strong_explicit(&obj->lockWord, &word, inflated, memory_order_acq_rel, memory_order_relaxed))
+        return true;
+    freeMonitor(index);
+    return false;
+}
+
+/**
+ * Counts the thread as a user of the monitor of an inflated lock, which keeps the monitor from being deflated
+ * @param obj
+ * @param word the inflated lock word the monitor was found through
+ * @param monitor
+ * @return false if the lock word changed in the meantime, in which case the thread isn't a user of the monitor
+ */
+static bool addUser(object_t *obj, uint32_t word, monitor_t *monitor) {
+    int users = atomic_load_explicit(&monitor->users, memory_order_relaxed);
+    do {
+        // the monitor is being deflated
+        if(users < 0)
+            return false;
+    } while(!atomic_compare_exchange_weak_explicit(&monitor->users, &users, users + 1, memory_order_acquire, memory_order_relaxed));
+    // the monitor could have been deflated and reused for another object before the thread was counted
+    if(atomic_load_explicit(&obj->lockWord, memory_order_acquire) == word)
+        return true;
+    atomic_fetch_sub_explicit(&monitor->users, 1, memory_order_release);
+    return false;
+}
+
+/**
+ * Stops counting the thread as a user of the monitor and deflates the lock if it was the last user
+ * @param obj
+ * @param word the inflated lock word of the object
+ * @param monitor
+ */
+static void removeUser(object_t *obj, uint32_t word, monitor_t *monitor) {
+    if(atomic_fetch_sub_explicit(&monitor->users, 1, memory_order_release) != 1)
+        return;
+    int users = 0;
+    if(!atomic_compare_exchange_strong_explicit(&monitor->users, &users, -1, memory_order_acquire, memory_order_relaxed))
+        return;
+    // another thread could have deflated the lock and the monitor could be reused by now, in which case the lock word
+    // doesn't refer to it anymore
+    if(atomic_compare_exchange_strong_explicit(&obj->lockWord, &word, word & LOCK_AGE_MASK, memory_order_release, memory_order_relaxed))
+        freeMonitor(word >> MONITOR_INDEX_SHIFT);
+    else
+        atomic_store_explicit(&monitor->users, 0, memory_order_release);
+}
+
+void lockObject(int threadId, object_t *obj) {
+    uint32_t word = atomic_load_explicit(&obj->lockWord, memory_order_acquire);
+    while(true) {
+        switch(word & LOCK_STATE_MASK) {
+            case LOCK_UNLOCKED:
+                if(threadId > 0 && (uint32_t) threadId <= MAX_THIN_OWNER) {
+                    uint32_t thin = word | (uint32_t) threadId << THIN_OWNER_SHIFT | LOCK_THIN;
+                    if(atomic_compare_exchange_weak_explicit(&obj->lockWord, &word, thin, memory_order_acquire, memory_order_acquire))
+                        return;
+                }
+                // the id doesn't fit in a thin lock
+                else if(inflate(obj, word, threadId, 1))
+                    return;
+                else
+                    word = atomic_load_explicit(&obj->lockWord, memory_order_acquire);
+                break;
+            case LOCK_THIN: {
+                uint32_t count = (word >> THIN_COUNT_SHIFT) & MAX_THIN_COUNT;
+                int owner = (int) (word >> THIN_OWNER_SHIFT);
+                if(owner == threadId && count < MAX_THIN_COUNT) {
+                    if(atomic_compare_exchange_weak_explicit(&obj->lockWord, &word, word + (1u << THIN_COUNT_SHIFT), memory_order_acquire, memory_order_acquire))
+                        return;
+                    break;
+                }
+                // the lock is contended or reentered too often, so it's inflated with the owner still holding it
+                if(owner == threadId) {
+                    if(inflate(obj, word, threadId, count + 2))
+                        return;
+                }
+                else
+                    inflate(obj, word, owner, count + 1);
+                word = atomic_load_explicit(&obj->lockWord, memory_order_acquire);
+                break;
+            }
+            default: {
+                monitor_t *monitor = getMonitor(word >> MONITOR_INDEX_SHIFT);
+                if(!addUser(obj, word, monitor)) {
+                    sched_yield();
+                    word = atomic_load_explicit(&obj->lockWord, memory_order_acquire);
+                    break;
+                }
+                bool reentered = monitor->jlock.owner == threadId;
+                jlock_lock(threadId, &monitor->jlock);
+                if(reentered)
+                    atomic_fetch_sub_explicit(&monitor->users, 1, memory_order_relaxed);
+                return;
+            }
+        }
+    }
+}
+
+bool unlockObject(int threadId, object_t *obj) {
+    uint32_t word = atomic_load_explicit(&obj->lockWord, memory_order_acquire);
+    while((word & LOCK_STATE_MASK) == LOCK_THIN) {
+        if((int) (word >> THIN_OWNER_SHIFT) != threadId)
+            return false;
+        uint32_t released = (word & (MAX_THIN_COUNT << THIN_COUNT_SHIFT)) ? word - (1u << THIN_COUNT_SHIFT) : word & LOCK_AGE_MASK;
+        // fails if another thread inflated the lock in the meantime
+        if(atomic_compare_exchange_weak_explicit(&obj->lockWord, &word, released, memory_order_acq_rel, memory_order_acquire))
+            return true;
+    }
+    if((word & LOCK_STATE_MASK) != LOCK_INFLATED)
+        return false;
+    monitor_t *monitor = getMonitor(word >> MONITOR_INDEX_SHIFT);
+    if(monitor->jlock.owner != threadId)
+        return false;
+    jlock_unlock(threadId, &monitor->jlock);
+    if(monitor->jlock.owner != threadId)
+        removeUser(obj, word, monitor);
+    return true;
+}
+
+/**
+ * Finds the monitor of a lock the thread holds, inflating the lock if it's thin
+ * @param threadId
+ * @param obj
+ * @return the monitor or NULL if the thread doesn't hold the lock
+ */
+static monitor_t *getOwnedMonitor(int threadId, object_t *obj) {
+    uint32_t word = atomic_load_explicit(&obj->lockWord, memory_order_acquire);
+    // only the owner changes the lock word of a thin lock it holds except for other threads inflating it
+    while((word & LOCK_STATE_MASK) == LOCK_THIN) {
+        if((int) (word >> THIN_OWNER_SHIFT) != threadId)
+            return NULL;
+        inflate(obj, word, threadId, ((word >> THIN_COUNT_SHIFT) & MAX_THIN_COUNT) + 1);
+        word = atomic_load_explicit(&obj->lockWord, memory_order_acquire);
+    }
+    if((word & LOCK_STATE_MASK) != LOCK_INFLATED)
+        return NULL;
+    monitor_t *monitor = getMonitor(word >> MONITOR_INDEX_SHIFT);
+    return monitor->jlock.owner == threadId ? monitor : NULL;
+}
+
+bool waitOnObject(int threadId, object_t *obj, uint64_t millis) {
+    monitor_t *monitor = getOwnedMonitor(threadId, obj);
+    if(!monitor)
+        return false;
+    // the thread stays a user of the monitor while it waits, so it isn't deflated
+    jlock_wait(&monitor->jlock, millis);
+    return true;
+}
+
+bool notifyObject(int threadId, object_t *obj) {
+    uint32_t word = atomic_load_explicit(&obj->lockWord, memory_order_relaxed);
+    // nobody can wait on a thin lock
+    if((word & LOCK_STATE_MASK) == LOCK_THIN)
+        return (int) (word >> THIN_OWNER_SHIFT) == threadId;
+    monitor_t *monitor = getOwnedMonitor(threadId, obj);
+    if(!monitor)
+        return false;
+    jlock_notify(&monitor->jlock);
+    return true;
+}
+
+bool notifyAllObject(int threadId, object_t *obj) {
+    uint32_t word = atomic_load_explicit(&obj->lockWord, memory_order_relaxed);
+    if((word & LOCK_STATE_MASK) == LOCK_THIN)
+        return (int) (word >> THIN_OWNER_SHIFT) == threadId;
+    monitor_t *monitor = getOwnedMonitor(threadId, obj);
+    if(!monitor)
+        return false;
+    jlock_notifyAll(&monitor->jlock);
+    return true;
+}
+
+#ifdef MONITOR_STATISTICS
+static void printClassLockStatistics(class_t *class, void *arg) {
+    jlock_printStatistics(&class->jlock, class->name);
+}
+
+void printMonitorStatistics() {
+    visitLoadedClasses(printClassLockStatistics, NULL);
+    char name[32];
+    for(uint32_t i = 0; i < numMonitors; ++i) {
+        snprintf(name, sizeof(name), "monitor %" PRIu32, i);
+        jlock_printStatistics(&getMonitor(i)->jlock, name);
+    }
+}
+#endif
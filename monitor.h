@@ -0,0 +1,82 @@
+#ifndef JVM_MONITOR_H
+#define JVM_MONITOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "object.h"
+
+// Objects are locked through their lock word. An uncontended lock is a thin lock, which stores its owner and recursion
+// count in the lock word and is acquired and released with a single compare and swap. It's inflated into a monitor from
+// a side table once another thread contends for it, the thread waits on the object, or the thin lock can't hold the
+// owner or count. The monitor is deflated back into an unlocked lock word when no thread uses it anymore.
+//
+// bits 0-1: state of the lock
+// bits 2-5: age of the object, see object.h
+// thin lock: bits 6-13 hold the number of times the owner reentered the lock, bits 14-31 the id of the owner
+// inflated lock: bits 6-31 hold the index of the monitor
+#define LOCK_STATE_MASK 3u
+#define LOCK_UNLOCKED 0u
+#define LOCK_THIN 1u
+#define LOCK_INFLATED 2u
+#define LOCK_AGE_MASK (MAX_AGE << AGE_SHIFT)
+#define THIN_COUNT_SHIFT 6u
+#define MAX_THIN_COUNT 0xFFu
+#define THIN_OWNER_SHIFT 14u
+#define MAX_THIN_OWNER 0x3FFFFu
+#define MONITOR_INDEX_SHIFT 6u
+#define MAX_MONITORS (1u << 26u)
+
+// number of monitors allocated at a time
+#ifndef MONITOR_CHUNK_SIZE
+#define MONITOR_CHUNK_SIZE 1024
+#endif
+
+/**
+ * Acquires the lock of the object. The thread blocks until no other thread holds the lock
+ * @param threadId
+ * @param obj
+ */
+void lockObject(int threadId, object_t *obj);
+
+/**
+ * Releases the lock of the object once
+ * @param threadId
+ * @param obj
+ * @return false if the thread doesn't hold the lock
+ */
+bool unlockObject(int threadId, object_t *obj);
+
+/**
+ * Releases the lock of the object until another thread notifies it or the time runs out and acquires it again
+ * @param threadId
+ * @param obj
+ * @param millis the maximum time to wait or 0 to wait until notified
+ * @return false if the thread doesn't hold the lock
+ */
+bool waitOnObject(int threadId, object_t *obj, uint64_t millis);
+
+/**
+ * Wakes one thread waiting on the object
+ * @param threadId
+ * @param obj
+ * @return false if the thread doesn't hold the lock
+ */
+bool notifyObject(int threadId, object_t *obj);
+
+/**
+ * Wakes all threads waiting on the object
+ * @param threadId
+ * @param obj
+ * @return false if the thread doesn't hold the lock
+ */
+bool notifyAllObject(int threadId, object_t *obj);
+
+#ifdef MONITOR_STATISTICS
+/**
+ * Prints the contention statistics of the locks of classes and of the monitors in the side table. A monitor is reused
+ * for other objects after it's deflated, so its statistics cover every object it was used for
+ */
+void printMonitorStatistics();
+#endif
+
+#endif //JVM_MONITOR_H
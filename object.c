@@ -23,7 +23,7 @@ uint8_t getArrayElementType(object_t *obj) {
 
 cell_t getArrayElement(object_t *obj, int32_t index, uint8_t *type) {
     cell_t cell;
-    void *arrayData = obj + 1;
+    void *arrayData = ARRAY_ELEMENTS(obj);
     
     char elementType = obj->class->name[1];
     switch(elementType) {
@@ -78,7 +78,7 @@ cell_t getArrayElement(object_t *obj, int32_t index, uint8_t *type) {
 
 double_cell_t getArrayElement2(object_t *obj, int32_t index, uint8_t *type) {
     double_cell_t cell;
-    void *arrayData = obj + 1;
+    void *arrayData = ARRAY_ELEMENTS(obj);
     
     char elementType = obj->class->name[1];
     switch(elementType) {
@@ -102,7 +102,7 @@ double_cell_t getArrayElement2(object_t *obj, int32_t index, uint8_t *type) {
 }
 
 void setArrayElement(object_t *obj, int32_t index, cell_t value) {
-    void *arrayData = obj + 1;
+    void *arrayData = ARRAY_ELEMENTS(obj);
     
     char elementType = obj->class->name[1];
     switch(elementType) {
@@ -136,7 +136,7 @@ void setArrayElement(object_t *obj, int32_t index, cell_t value) {
 }
 
 void setArrayElement2(object_t *obj, int32_t index, double_cell_t value) {
-    void *arrayData = obj + 1;
+    void *arrayData = ARRAY_ELEMENTS(obj);
     
     char elementType = obj->class->name[1];
     switch(elementType) {
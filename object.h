@@ -5,16 +5,35 @@
 #ifndef JVM_OBJECT_H
 #define JVM_OBJECT_H
 
+#include <stdatomic.h>
 #include "classfile.h"
 #include "dataTypes.h"
 
 typedef struct object {
     class_t *class;
-    jlock_t jlock;
     slot_t slot;
-    int32_t length; // only used for arrays
+    // state of the lock of the object and the number of young gcs the object survived, see monitor.h
+    _Atomic uint32_t lockWord;
 } object_t;
 
+// arrays store their length after the header of the object, which is followed by the elements
+typedef struct array_object {
+    object_t object;
+    int32_t length;
+} array_object_t;
+
+#define ARRAY_LENGTH(obj) (((array_object_t *) (obj))->length)
+#define ARRAY_ELEMENTS(obj) ((void *) ((array_object_t *) (obj) + 1))
+
+// the age of an object is stored in bits 2 to 5 of its lock word. It's only changed by the gc while the java threads are
+// stopped, so the lock word keeps it as it is
+#define AGE_SHIFT 2u
+#define MAX_AGE 15u
+#define GET_AGE(obj) ((atomic_load_explicit(&(obj)->lockWord, memory_order_relaxed) >> AGE_SHIFT) & MAX_AGE)
+#define SET_AGE(obj, age) atomic_store_explicit(&(obj)->lockWord, \
+        (atomic_load_explicit(&(obj)->lockWord, memory_order_relaxed) & ~(MAX_AGE << AGE_SHIFT)) | (uint32_t) (age) << AGE_SHIFT, \
+        memory_order_relaxed)
+
 uint8_t getArrayElementType(object_t *obj);
 cell_t getArrayElement(object_t *obj, int32_t index, uint8_t *type);
 double_cell_t getArrayElement2(object_t *obj, int32_t index, uint8_t *type);
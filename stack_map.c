@@ -0,0 +1,730 @@
+#include "stack_map.h"
+#include "bytecode_translator.h"
+#include "opcodes.h"
+#include "flags.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The abstract state of a frame during the dataflow pass. Only whether a slot may hold a reference is tracked.
+ */
+typedef struct frame_state {
+    uint8_t *row; // one bit per slot, laid out like a row of the stack map
+    uint16_t maxLocals;
+    uint16_t maxStack;
+    int32_t depth;
+} frame_state_t;
+
+static void setSlot(uint8_t *row, uint32_t slot, bool isReference) {
+    if(isReference)
+        row[slot / 8u] |= 1u << (slot % 8u);
+    else
+        row[slot / 8u] &= ~(1u << (slot % 8u));
+}
+
+static bool getSlot(uint8_t *row, uint32_t slot) {
+    return row[slot / 8u] & (1u << (slot % 8u));
+}
+
+static bool push(frame_state_t *state, bool isReference) {
+    if(state->depth >= state->maxStack)
+        return false;
+    setSlot(state->row, state->maxLocals + state->depth++, isReference);
+    return true;
+}
+
+static bool pop(frame_state_t *state, int32_t count) {
+    if(state->depth < count)
+        return false;
+    // cleared so that stale bits above the top of the stack don't leak into merges
+    while(count--)
+        setSlot(state->row, state->maxLocals + --state->depth, false);
+    return true;
+}
+
+/**
+ * Pops count slots and pushes them back in the order given by the indices
+ * @param state
+ * @param count the number of slots popped
+ * @param indices the slots to push given as indices from the top of the popped slots
+ * @param numIndices
+ * @return false if the stack under or overflows
+ */
+static bool shuffle(frame_state_t *state, int32_t count, const uint8_t *indices, int32_t numIndices) {
+    if(state->depth < count)
+        return false;
+    bool popped[4];
+    for(int32_t i = 0; i < count; ++i)
+        popped[i] = getSlot(state->row, state->maxLocals + state->depth - 1 - i);
+    pop(state, count);
+    for(int32_t i = 0; i < numIndices; ++i) {
+        if(!push(state, popped[indices[i]]))
+            return false;
+    }
+    return true;
+}
+
+static bool storeLocal(frame_state_t *state, uint32_t index, uint32_t size, bool isReference) {
+    if(index + size > state->maxLocals)
+        return false;
+    setSlot(state->row, index, isReference);
+    if(size == 2)
+        setSlot(state->row, index + 1, false);
+    return true;
+}
+
+/**
+ * Pushes a value of the type starting at the descriptor
+ * @param state
+ * @param descriptor a field descriptor or the return type of a method descriptor
+ * @return false if the stack overflows
+ */
+static bool pushType(frame_state_t *state, char *descriptor) {
+    switch(descriptor[0]) {
+        case 'V':
+            return true;
+        case 'J':
+        case 'D':
+            return push(state, false) && push(state, false);
+        case 'L':
+        case '[':
+            return push(state, true);
+        default:
+            return push(state, false);
+    }
+}
+
+/**
+ * @param class
+ * @param index the index of a field, method, interface method, or invokedynamic constant
+ * @return the descriptor of the constant or NULL if the index doesn't refer to one of those constants
+ */
+static char *getDescriptor(class_t *class, uint32_t index) {
+    constant_info_t **constantPool = class->constantPool;
+    if(index == 0 || index >= class->numConstants || !constantPool[index])
+        return NULL;
+    uint16_t nameAndTypeIndex;
+    switch(constantPool[index]->utf8Info.tag) {
+        case CONSTANT_Fieldref:
+        case CONSTANT_Methodref:
+        case CONSTANT_InterfaceMethodref:
+            nameAndTypeIndex = constantPool[index]->fieldMethodInterfaceMethodRefInfo.nameAndTypeIndex;
+            break;
+        case CONSTANT_InvokeDynamic:
+            nameAndTypeIndex = constantPool[index]->invokeDynamicInfo.nameAndTypeIndex;
+            break;
+        default:
+            return NULL;
+    }
+    if(nameAndTypeIndex >= class->numConstants || !constantPool[nameAndTypeIndex] || constantPool[nameAndTypeIndex]->utf8Info.tag != CONSTANT_NameAndType)
+        return NULL;
+    uint16_t descriptorIndex = constantPool[nameAndTypeIndex]->nameAndTypeInfo.descriptorIndex;
+    if(descriptorIndex >= class->numConstants || !constantPool[descriptorIndex] || constantPool[descriptorIndex]->utf8Info.tag != CONSTANT_utf8)
+        return NULL;
+    return constantPool[descriptorIndex]->utf8Info.chars;
+}
+
+/**
+ * Applies the effect of an instruction other than a branch to the frame state
+ * @param method
+ * @param words the translated instruction
+ * @param opcode
+ * @param state
+ * @return false if the instruction is malformed or the stack under or overflows
+ */
+static bool executeInstruction(method_t *method, code_word_t *words, uint8_t opcode, frame_state_t *state) {
+    // pushed slots given as indices from the top of the popped slots
+    static const uint8_t dupX1[] = {0, 1, 0};
+    static const uint8_t dupX2[] = {0, 2, 1, 0};
+    static const uint8_t dup2[] = {1, 0, 1, 0};
+    static const uint8_t dup2X1[] = {1, 0, 2, 1, 0};
+    static const uint8_t dup2X2[] = {1, 0, 3, 2, 1, 0};
+    static const uint8_t swap[] = {0, 1};
+
+    switch(opcode) {
+        case OP_nop:
+        case OP_iinc:
+        case OP_goto:
+        case OP_goto_w:
+        case OP_ineg:
+        case OP_fneg:
+        case OP_lneg:
+        case OP_dneg:
+        case OP_i2f:
+        case OP_f2i:
+        case OP_l2d:
+        case OP_d2l:
+        case OP_i2b:
+        case OP_i2c:
+        case OP_i2s:
+        case OP_ret:
+        case OP_return:
+            return true;
+        case OP_aconst_null:
+        case OP_new:
+            return push(state, true);
+        case OP_iconst_m1:
+        case OP_iconst_0:
+        case OP_iconst_1:
+        case OP_iconst_2:
+        case OP_iconst_3:
+        case OP_iconst_4:
+        case OP_iconst_5:
+        case OP_fconst_0:
+        case OP_fconst_1:
+        case OP_fconst_2:
+        case OP_bipush:
+        case OP_sipush:
+        case OP_iload:
+        case OP_fload:
+        case OP_iload_0:
+        case OP_iload_1:
+        case OP_iload_2:
+        case OP_iload_3:
+        case OP_fload_0:
+        case OP_fload_1:
+        case OP_fload_2:
+        case OP_fload_3:
+        case OP_jsr:
+        case OP_jsr_w:
+            // return addresses aren't references
+            return push(state, false);
+        case OP_lconst_0:
+        case OP_lconst_1:
+        case OP_dconst_0:
+        case OP_dconst_1:
+        case OP_ldc2_w:
+        case OP_lload:
+        case OP_dload:
+        case OP_lload_0:
+        case OP_lload_1:
+        case OP_lload_2:
+        case OP_lload_3:
+        case OP_dload_0:
+        case OP_dload_1:
+        case OP_dload_2:
+        case OP_dload_3:
+            return push(state, false) && push(state, false);
+        case OP_ldc:
+        case OP_ldc_w: {
+            uint32_t index = words[1].u;
+            if(index == 0 || index >= method->class->numConstants || !method->class->constantPool[index])
+                return false;
+            uint8_t tag = method->class->constantPool[index]->utf8Info.tag;
+            return push(state, tag != CONSTANT_Integer && tag != CONSTANT_Float);
+        }
+        case OP_aload:
+        case OP_aload_0:
+        case OP_aload_1:
+        case OP_aload_2:
+        case OP_aload_3:
+            return push(state, true);
+        case OP_iaload:
+        case OP_faload:
+        case OP_baload:
+        case OP_caload:
+        case OP_saload:
+        case OP_fcmpl:
+        case OP_fcmpg:
+        case OP_iadd:
+        case OP_isub:
+        case OP_imul:
+        case OP_idiv:
+        case OP_irem:
+        case OP_fadd:
+        case OP_fsub:
+        case OP_fmul:
+        case OP_fdiv:
+        case OP_frem:
+        case OP_ishl:
+        case OP_ishr:
+        case OP_iushr:
+        case OP_iand:
+        case OP_ior:
+        case OP_ixor:
+            return pop(state, 2) && push(state, false);
+        case OP_laload:
+        case OP_daload:
+            return pop(state, 2) && push(state, false) && push(state, false);
+        case OP_aaload:
+            return pop(state, 2) && push(state, true);
+        case OP_istore:
+        case OP_fstore:
+            return pop(state, 1) && storeLocal(state, words[1].u, 1, false);
+        case OP_istore_0:
+        case OP_istore_1:
+        case OP_istore_2:
+        case OP_istore_3:
+            return pop(state, 1) && storeLocal(state, opcode - OP_istore_0, 1, false);
+        case OP_fstore_0:
+        case OP_fstore_1:
+        case OP_fstore_2:
+        case OP_fstore_3:
+            return pop(state, 1) && storeLocal(state, opcode - OP_fstore_0, 1, false);
+        case OP_lstore:
+        case OP_dstore:
+            return pop(state, 2) && storeLocal(state, words[1].u, 2, false);
+        case OP_lstore_0:
+        case OP_lstore_1:
+        case OP_lstore_2:
+        case OP_lstore_3:
+            return pop(state, 2) && storeLocal(state, opcode - OP_lstore_0, 2, false);
+        case OP_dstore_0:
+        case OP_dstore_1:
+        case OP_dstore_2:
+        case OP_dstore_3:
+            return pop(state, 2) && storeLocal(state, opcode - OP_dstore_0, 2, false);
+        case OP_astore:
+        case OP_astore_0:
+        case OP_astore_1:
+        case OP_astore_2:
+        case OP_astore_3: {
+            // astore also stores the return addresses pushed by jsr
+            if(state->depth < 1)
+                return false;
+            bool isReference = getSlot(state->row, state->maxLocals + state->depth - 1);
+            uint32_t index = opcode == OP_astore ? words[1].u : (uint32_t) (opcode - OP_astore_0);
+            return pop(state, 1) && storeLocal(state, index, 1, isReference);
+        }
+        case OP_iastore:
+        case OP_fastore:
+        case OP_aastore:
+        case OP_bastore:
+        case OP_castore:
+        case OP_sastore:
+            return pop(state, 3);
+        case OP_lastore:
+        case OP_dastore:
+            return pop(state, 4);
+        case OP_pop:
+        case OP_ifeq:
+        case OP_ifne:
+        case OP_iflt:
+        case OP_ifge:
+        case OP_ifgt:
+        case OP_ifle:
+        case OP_ifnull:
+        case OP_ifnonnull:
+        case OP_tableswitch:
+        case OP_lookupswitch:
+        case OP_monitorenter:
+        case OP_monitorexit:
+        case OP_ireturn:
+        case OP_freturn:
+        case OP_areturn:
+        case OP_athrow:
+            return pop(state, 1);
+        case OP_pop2:
+        case OP_if_icmpeq:
+        case OP_if_icmpne:
+        case OP_if_icmplt:
+        case OP_if_icmpge:
+        case OP_if_icmpgt:
+        case OP_if_icmple:
+        case OP_if_acmpeq:
+        case OP_if_acmpne:
+        case OP_lreturn:
+        case OP_dreturn:
+            return pop(state, 2);
+        case OP_dup:
+            return state->depth >= 1 && push(state, getSlot(state->row, state->maxLocals + state->depth - 1));
+        case OP_dup_x1:
+            return shuffle(state, 2, dupX1, sizeof(dupX1));
+        case OP_dup_x2:
+            return shuffle(state, 3, dupX2, sizeof(dupX2));
+        case OP_dup2:
+            return shuffle(state, 2, dup2, sizeof(dup2));
+        case OP_dup2_x1:
+            return shuffle(state, 3, dup2X1, sizeof(dup2X1));
+        case OP_dup2_x2:
+            return shuffle(state, 4, dup2X2, sizeof(dup2X2));
+        case OP_swap:
+            return shuffle(state, 2, swap, sizeof(swap));
+        case OP_ladd:
+        case OP_lsub:
+        case OP_lmul:
+        case OP_ldiv:
+        case OP_lrem:
+        case OP_dadd:
+        case OP_dsub:
+        case OP_dmul:
+        case OP_ddiv:
+        case OP_drem:
+        case OP_land:
+        case OP_lor:
+        case OP_lxor:
+            return pop(state, 4) && push(state, false) && push(state, false);
+        case OP_lshl:
+        case OP_lshr:
+        case OP_lushr:
+            return pop(state, 3) && push(state, false) && push(state, false);
+        case OP_i2l:
+        case OP_i2d:
+        case OP_f2l:
+        case OP_f2d:
+            return pop(state, 1) && push(state, false) && push(state, false);
+        case OP_l2i:
+        case OP_l2f:
+        case OP_d2i:
+        case OP_d2f:
+            return pop(state, 2) && push(state, false);
+        case OP_lcmp:
+        case OP_dcmpl:
+        case OP_dcmpg:
+            return pop(state, 4) && push(state, false);
+        case OP_getstatic:
+        case OP_putstatic:
+        case OP_getfield:
+        case OP_putfield: {
+            char *descriptor = getDescriptor(method->class, words[1].u);
+            if(!descriptor)
+                return false;
+            int32_t size = descriptor[0] == 'J' || descriptor[0] == 'D' ? 2 : 1;
+            if(opcode == OP_getstatic)
+                return pushType(state, descriptor);
+            else if(opcode == OP_putstatic)
+                return pop(state, size);
+            else if(opcode == OP_getfield)
+                return pop(state, 1) && pushType(state, descriptor);
+            else
+                return pop(state, size + 1);
+        }
+        case OP_invokevirtual:
+        case OP_invokespecial:
+        case OP_invokestatic:
+        case OP_invokeinterface:
+        case OP_invokedynamic: {
+            char *descriptor = getDescriptor(method->class, words[1].u);
+            if(!descriptor || descriptor[0] != '(')
+                return false;
+            bool hasReceiver = opcode != OP_invokestatic && opcode != OP_invokedynamic;
+            return pop(state, countNumParametersFromMethodDescriptor(descriptor, !hasReceiver)) && pushType(state, strchr(descriptor, ')') + 1);
+        }
+        case OP_newarray:
+        case OP_anewarray:
+        case OP_checkcast:
+            return pop(state, 1) && push(state, true);
+        case OP_arraylength:
+        case OP_instanceof:
+            return pop(state, 1) && push(state, false);
+        case OP_multianewarray:
+            return pop(state, (int32_t) words[2].u) && push(state, true);
+        default:
+            return false;
+    }
+}
+
+/**
+ * Merges a frame state into the state before the instruction at the word index. With handles a slot is a reference if
+ * it is one on any path. With direct references it has to be one on every path, since the GC would rewrite anything
+ * else. A slot that holds a reference on only some paths can't be read afterwards, like an unusable slot of the verifier
+ * @param stackMap
+ * @param depths the stack depth before each instruction or -1 if the instruction hasn't been reached yet
+ * @param wordIndex
+ * @param state
+ * @param changed set to true if the state before the instruction changed
+ * @return false if the stack depths don't match
+ */
+static bool mergeState(stack_map_t *stackMap, int32_t *depths, uint32_t wordIndex, frame_state_t *state, bool *changed) {
+    uint8_t *row = stackMap->references + wordIndex * stackMap->rowSize;
+    if(depths[wordIndex] == -1) {
+        depths[wordIndex] = state->depth;
+        memcpy(row, state->row, stackMap->rowSize);
+        *changed = true;
+        return true;
+    }
+    if(depths[wordIndex] != state->depth)
+        return false;
+    *changed = false;
+    for(uint32_t i = 0; i < stackMap->rowSize; ++i) {
+#ifdef DIRECT_REFERENCES
+        uint8_t merged = row[i] & state->row[i];
+#else
+        uint8_t merged = row[i] | state->row[i];
+#endif
+        if(merged != row[i]) {
+            row[i] = merged;
+            *changed = true;
+        }
+    }
+    return true;
+}
+
+/**
+ * Runs the dataflow pass over the method. Each instruction is revisited whenever the state before it changes. The state
+ * only gains reference slots with handles and only loses them with direct references, so the pass terminates.
+ * @param method
+ * @param translatedCode
+ * @return the stack map or NULL if the method is malformed or memory ran out
+ */
+static stack_map_t *computeStackMap(method_t *method, translated_code_t *translatedCode) {
+    code_attribute_t *codeAttribute = method->codeAttribute;
+    uint8_t *code = codeAttribute->code;
+    uint32_t length = translatedCode->length;
+
+    stack_map_t *stackMap = malloc(sizeof(stack_map_t));
+    if(!stackMap)
+        return NULL;
+    stackMap->numSlots = codeAttribute->maxLocals + codeAttribute->maxStack;
+    stackMap->rowSize = (stackMap->numSlots + 7u) / 8u;
+    // rows of words that aren't reached stay empty
+    stackMap->references = calloc(length, stackMap->rowSize);
+    if(!stackMap->references && length && stackMap->rowSize)
+        goto fail1;
+    int32_t *depths = malloc(length * sizeof(int32_t));
+    if(!depths)
+        goto fail2;
+    for(uint32_t i = 0; i < length; ++i)
+        depths[i] = -1;
+    uint32_t *worklist = malloc(length * sizeof(uint32_t));
+    if(!worklist)
+        goto fail3;
+    bool *queued = calloc(length, sizeof(bool));
+    if(!queued)
+        goto fail4;
+    // the state being transformed plus a copy of the state before the instruction for the exception handlers
+    uint8_t *rows = calloc(2, stackMap->rowSize);
+    if(!rows && stackMap->rowSize)
+        goto fail5;
+    frame_state_t state = {rows, codeAttribute->maxLocals, codeAttribute->maxStack, 0};
+    uint8_t *before = rows + stackMap->rowSize;
+
+    // parameters start in the first local variables
+    uint32_t local = 0;
+    if(!(method->flags & METHOD_ACC_STATIC)) {
+        if(!storeLocal(&state, local++, 1, true))
+            goto fail6;
+    }
+    for(char *descriptor = method->descriptor + 1; *descriptor != ')'; ++descriptor) {
+        bool isReference = *descriptor == 'L' || *descriptor == '[';
+        uint32_t size = *descriptor == 'J' || *descriptor == 'D' ? 2 : 1;
+        while(*descriptor == '[')
+            ++descriptor;
+        if(*descriptor == 'L')
+            descriptor = strchr(descriptor, ';');
+        if(!storeLocal(&state, local, size, isReference))
+            goto fail6;
+        local += size;
+    }
+
+    bool changed;
+    uint32_t numQueued = 0;
+    mergeState(stackMap, depths, 0, &state, &changed);
+    worklist[numQueued++] = 0;
+    queued[0] = true;
+
+    while(numQueued) {
+        uint32_t wordIndex = worklist[--numQueued];
+        queued[wordIndex] = false;
+
+        code_word_t *words = translatedCode->code + wordIndex;
+        uint32_t offset = translatedCode->bytecodeOffsets[wordIndex];
+        uint8_t opcode = code[offset] == OP_wide ? code[offset + 1] : code[offset];
+        uint32_t numWords;
+        instructionSize(code, offset, codeAttribute->codeLength, &numWords);
+
+        memcpy(state.row, stackMap->references + wordIndex * stackMap->rowSize, stackMap->rowSize);
+        memcpy(before, state.row, stackMap->rowSize);
+        state.depth = depths[wordIndex];
+        if(!executeInstruction(method, words, opcode, &state))
+            goto fail6;
+
+        // successors are collected as word indices. At most one of the branch targets or the switch targets is used
+        uint32_t successors[3];
+        uint32_t numSuccessors = 0;
+        code_word_t *switchTargets = NULL;
+        uint32_t numSwitchTargets = 0;
+        uint32_t switchStride = 1;
+        bool returnsToAllCallers = false;
+        switch(opcode) {
+            case OP_goto:
+            case OP_goto_w:
+            case OP_jsr:
+            case OP_jsr_w:
+                successors[numSuccessors++] = words[1].target - translatedCode->code;
+                break;
+            case OP_ifeq:
+            case OP_ifne:
+            case OP_iflt:
+            case OP_ifge:
+            case OP_ifgt:
+            case OP_ifle:
+            case OP_if_icmpeq:
+            case OP_if_icmpne:
+            case OP_if_icmplt:
+            case OP_if_icmpge:
+            case OP_if_icmpgt:
+            case OP_if_icmple:
+            case OP_if_acmpeq:
+            case OP_if_acmpne:
+            case OP_ifnull:
+            case OP_ifnonnull:
+                successors[numSuccessors++] = words[1].target - translatedCode->code;
+                successors[numSuccessors++] = wordIndex + numWords;
+                break;
+            case OP_tableswitch:
+                successors[numSuccessors++] = words[1].target - translatedCode->code;
+                switchTargets = words + 4;
+                numSwitchTargets = numWords - 4;
+                break;
+            case OP_lookupswitch:
+                successors[numSuccessors++] = words[1].target - translatedCode->code;
+                switchTargets = words + 4;
+                numSwitchTargets = words[2].u;
+                switchStride = 2;
+                break;
+            case OP_ret:
+                // without tracking which subroutine is executing, ret may return after any jsr
+                returnsToAllCallers = true;
+                break;
+            case OP_ireturn:
+            case OP_lreturn:
+            case OP_freturn:
+            case OP_dreturn:
+            case OP_areturn:
+            case OP_return:
+            case OP_athrow:
+                break;
+            default:
+                successors[numSuccessors++] = wordIndex + numWords;
+                break;
+        }
+
+        for(uint32_t i = 0; i < numSuccessors + numSwitchTargets; ++i) {
+            uint32_t successor = i < numSuccessors ? successors[i] : (uint32_t) (switchTargets[(i - numSuccessors) * switchStride].target - translatedCode->code);
+            // falling off the end of the code
+            if(successor >= length)
+                goto fail6;
+            if(!mergeState(stackMap, depths, successor, &state, &changed))
+                goto fail6;
+            if(changed && !queued[successor]) {
+                queued[successor] = true;
+                worklist[numQueued++] = successor;
+            }
+        }
+
+        if(returnsToAllCallers) {
+            for(uint32_t jsrOffset = 0; jsrOffset < codeAttribute->codeLength;) {
+                uint32_t jsrWords;
+                uint32_t jsrBytes = instructionSize(code, jsrOffset, codeAttribute->codeLength, &jsrWords);
+                if(code[jsrOffset] == OP_jsr || code[jsrOffset] == OP_jsr_w) {
+                    uint32_t successor = translatedCode->wordOffsets[jsrOffset] + jsrWords;
+                    if(successor >= length || !mergeState(stackMap, depths, successor, &state, &changed))
+                        goto fail6;
+                    if(changed && !queued[successor]) {
+                        queued[successor] = true;
+                        worklist[numQueued++] = successor;
+                    }
+                }
+                jsrOffset += jsrBytes;
+            }
+        }
+
+        // an exception handler may start with the local variables from before or after the instruction and the exception on the stack
+        for(int i = 0; i < codeAttribute->exceptionTableLength; ++i) {
+            exception_table_t *handler = codeAttribute->exceptionHandlers + i;
+            if(offset < handler->startPC || offset >= handler->endPC)
+                continue;
+            for(uint16_t j = 0; j < codeAttribute->maxLocals; ++j) {
+#ifdef DIRECT_REFERENCES
+                setSlot(before, j, getSlot(before, j) && getSlot(state.row, j));
+#else
+                setSlot(before, j, getSlot(before, j) || getSlot(state.row, j));
+#endif
+            }
+            frame_state_t handlerState = {before, codeAttribute->maxLocals, codeAttribute->maxStack, 0};
+            for(uint16_t j = 0; j < codeAttribute->maxStack; ++j)
+                setSlot(before, codeAttribute->maxLocals + j, false);
+            if(!push(&handlerState, true))
+                goto fail6;
+            uint32_t successor = translatedCode->wordOffsets[handler->handlerPC];
+            if(!mergeState(stackMap, depths, successor, &handlerState, &changed))
+                goto fail6;
+            if(changed && !queued[successor]) {
+                queued[successor] = true;
+                worklist[numQueued++] = successor;
+            }
+        }
+    }
+
+    free(rows);
+    free(queued);
+    free(worklist);
+    stackMap->depths = depths;
+    return stackMap;
+
+    fail6: free(rows);
+    fail5: free(queued);
+    fail4: free(worklist);
+    fail3: free(depths);
+    fail2: free(stackMap->references);
+    fail1: free(stackMap);
+    return NULL;
+}
+
+stack_map_t *getStackMap(method_t *method) {
+    translated_code_t *translatedCode = getTranslatedCode(method);
+    if(!translatedCode)
+        return NULL;
+
+    stack_map_t *stackMap = atomic_load_explicit(&translatedCode->stackMap, memory_order_acquire);
+    if(stackMap)
+        return stackMap;
+
+    stack_map_t *newMap = computeStackMap(method, translatedCode);
+    if(!newMap)
+        return NULL;
+
+    // another thread may have finished computing the stack map first in which case its map is used instead
+    if(atomic_compare_exchange_strong_explicit(&translatedCode->stackMap, &stackMap, newMap, memory_order_acq_rel, memory_order_acquire))
+        return newMap;
+    freeStackMap(newMap);
+    return stackMap;
+}
+
+void visitStackReferences(jthread_t *jthread, void (*visitor)(slot_t *slot, void *arg), void *arg) {
+    code_word_t *pc = jthread->pc;
+    for(stack_frame_t *frame = jthread->currentStackFrame; frame; frame = frame->previousStackFrame) {
+        method_t *method = frame->currentMethod;
+        translated_code_t *translatedCode = getTranslatedCode(method);
+        stack_map_t *stackMap = getStackMap(method);
+        if(!stackMap) {
+#ifdef DIRECT_REFERENCES
+            // a number which looks like a reference would be changed when the gc moves the object it seems to refer to
+            printf("InternalError: Failed to compute the stack map of %s.%s%s\n", method->class->name, method->name, method->descriptor);
+            exit(1);
+#endif
+            // every slot of a frame that can't be mapped is treated as a possible reference
+            uint16_t maxLocals = method->codeAttribute ? method->codeAttribute->maxLocals : 0;
+            for(uint16_t i = 0; i < maxLocals; ++i)
+                visitor(&frame->localVariableBase[i].a, arg);
+            for(uint16_t i = 0; i < frame->topOfStack; ++i)
+                visitor(&frame->operandStackBase[i].a, arg);
+        }
+        else {
+            uint32_t wordIndex = pc - translatedCode->code;
+            uint16_t maxLocals = method->codeAttribute->maxLocals;
+            for(uint16_t i = 0; i < maxLocals; ++i) {
+                if(isReferenceSlot(stackMap, wordIndex, i))
+                    visitor(&frame->localVariableBase[i].a, arg);
+            }
+            // only slots below the top of the stack are live. Callers are stopped after the invoke and the map there
+            // already includes the return value
+            for(uint16_t i = 0; i < frame->topOfStack; ++i) {
+                if(isReferenceSlot(stackMap, wordIndex, maxLocals + i))
+                    visitor(&frame->operandStackBase[i].a, arg);
+            }
+        }
+        // the caller resumes where the frame returns to
+        pc = frame->prevFramePC;
+    }
+}
+
+void freeStackMap(stack_map_t *stackMap) {
+    if(!stackMap)
+        return;
+    free(stackMap->references);
+    free(stackMap->depths);
+    free(stackMap);
+}
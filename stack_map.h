@@ -0,0 +1,53 @@
+#ifndef JVM_STACK_MAP_H
+#define JVM_STACK_MAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "classfile.h"
+#include "jthread.h"
+
+/**
+ * Records which local variables and operand stack slots may hold a reference before each instruction of a method. The
+ * slots of a frame are numbered with the local variables first followed by the operand stack from the bottom up. When
+ * references are handles, a slot that might hold a reference on some path is reported as one. A handle that happens to
+ * be a stale or non-reference value only keeps an object alive longer than needed. With direct references the GC
+ * rewrites every reported slot, so only slots which hold a reference on every path are reported.
+ */
+typedef struct stack_map {
+    uint8_t *references; // a bitmap of numSlots bits for each word of the translated code. Only instruction starts are filled in
+    uint32_t rowSize; // bytes per word
+    uint32_t numSlots; // maxLocals + maxStack
+    int32_t *depths; // operand stack depth before each word or -1 for words that don't start a reachable instruction
+} stack_map_t;
+
+/**
+ * Computes the stack map of a method the first time it's needed and returns the cached map afterwards
+ * @param method
+ * @return the stack map or NULL if the method has no code, the bytecode doesn't have consistent stack heights, or memory
+ * ran out
+ */
+stack_map_t *getStackMap(method_t *method);
+
+/**
+ * @param stackMap
+ * @param wordIndex the index of the translated instruction
+ * @param slot
+ * @return true if the slot may hold a reference when the instruction starts executing
+ */
+static inline bool isReferenceSlot(stack_map_t *stackMap, uint32_t wordIndex, uint32_t slot) {
+    return stackMap->references[wordIndex * stackMap->rowSize + slot / 8u] & (1u << (slot % 8u));
+}
+
+/**
+ * Calls the visitor with every local variable and operand stack slot of the thread which may hold a reference. The thread
+ * must be stopped with its pc and top of stack synced to its stack frame, for example while it waits in savePoint.
+ * Every slot of frames whose method can't be mapped is visited, so the visitor has to cope with non-reference values.
+ * @param jthread
+ * @param visitor
+ * @param arg passed through to the visitor
+ */
+void visitStackReferences(jthread_t *jthread, void (*visitor)(slot_t *slot, void *arg), void *arg);
+
+void freeStackMap(stack_map_t *stackMap);
+
+#endif //JVM_STACK_MAP_H
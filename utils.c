@@ -6,9 +6,10 @@
 #include "dataTypes.h"
 #include "classloader.h"
 #include "mm.h"
+#include "gc.h"
 #include <string.h>
 
-slot_t convertToJavaString(char *arg) {
+slot_t convertToJavaString(jthread_t *jthread, char *arg) {
     size_t length = strlen(arg);
     if(length > INT32_MAX)
         return 0;
@@ -20,7 +21,7 @@ slot_t convertToJavaString(char *arg) {
         return 0;
     
     int32_t stringLength = (int32_t) length;
-    slot_t charArraySlot = newArray(1, &stringLength, stringClass);
+    slot_t charArraySlot = newArray(jthread, 1, &stringLength, stringClass);
     if(!charArraySlot)
         return 0;
     
@@ -30,7 +31,9 @@ slot_t convertToJavaString(char *arg) {
         setArrayElement(charArray, i, cell);
     }
     
-    slot_t stringSlot = newObject(stringClass);
+    pushRoot(jthread, charArraySlot);
+    slot_t stringSlot = newObject(jthread, stringClass);
+    charArraySlot = popRoot(jthread);
     if(!stringSlot)
         return 0;
     
@@ -6,6 +6,7 @@
 #define JVM_UTILS_H
 
 #include "dataTypes.h"
+#include "jthread.h"
 
 #define MIN(x, y) ((x) < (y) ? (x) : (y))
 #define MAX(x, y) ((x) > (y) ? (x) : (y))
@@ -20,6 +21,6 @@
 
 #define ALIGN(x) (((x) + 7) & ~7)
 
-slot_t convertToJavaString(char *arg);
+slot_t convertToJavaString(jthread_t *jthread, char *arg);
 
 #endif //JVM_UTILS_H
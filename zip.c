@@ -0,0 +1,244 @@
+#include "zip.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "inflate.h"
+
+#define END_OF_CENTRAL_DIRECTORY_SIGNATURE 0x06054B50u
+#define END_OF_CENTRAL_DIRECTORY_SIZE 22
+#define ZIP64_END_OF_CENTRAL_DIRECTORY_SIGNATURE 0x06064B50u
+#define ZIP64_END_OF_CENTRAL_DIRECTORY_SIZE 56
+#define ZIP64_LOCATOR_SIGNATURE 0x07064B50u
+#define ZIP64_LOCATOR_SIZE 20
+#define CENTRAL_DIRECTORY_SIGNATURE 0x02014B50u
+#define CENTRAL_DIRECTORY_ENTRY_SIZE 46
+#define LOCAL_HEADER_SIGNATURE 0x04034B50u
+#define LOCAL_HEADER_SIZE 30
+#define MAX_COMMENT_LENGTH 0xFFFFu
+#define ZIP64_EXTRA_FIELD 1
+#define FLAG_ENCRYPTED 1
+// archives with more entries than this are rejected so the index stays addressable with 32 bit indices
+#define MAX_ENTRIES (1u << 30u)
+#define MIN_INDEX_CAPACITY 16
+
+// zip files are little endian, unlike class files
+static inline uint16_t readLE2(const uint8_t *data) {
+    return (uint16_t) (data[0] | data[1] << 8);
+}
+
+static inline uint32_t readLE4(const uint8_t *data) {
+    return readLE2(data) | (uint32_t) readLE2(data + 2) << 16;
+}
+
+static inline uint64_t readLE8(const uint8_t *data) {
+    return readLE4(data) | (uint64_t) readLE4(data + 4) << 32;
+}
+
+/**
+ * FNV-1a hash of an entry name
+ */
+static uint32_t hashName(const char *name, size_t length) {
+    uint32_t hash = 2166136261u;
+    for(size_t i = 0; i < length; ++i)
+        hash = (hash ^ (uint8_t) name[i]) * 16777619u;
+    return hash;
+}
+
+/**
+ * The end of central directory record is the last record of the archive, only followed by a comment of up to 64 KiB
+ * @return the record or NULL if the archive doesn't have one
+ */
+static const uint8_t *findEndOfCentralDirectory(const uint8_t *data, size_t size) {
+    if(size < END_OF_CENTRAL_DIRECTORY_SIZE)
+        return NULL;
+    size_t last = size - END_OF_CENTRAL_DIRECTORY_SIZE;
+    size_t first = last > MAX_COMMENT_LENGTH ? last - MAX_COMMENT_LENGTH : 0;
+    for(size_t offset = last + 1; offset-- > first;) {
+        if(readLE4(data + offset) == END_OF_CENTRAL_DIRECTORY_SIGNATURE && offset + END_OF_CENTRAL_DIRECTORY_SIZE + readLE2(data + offset + 20) == size)
+            return data + offset;
+    }
+    return NULL;
+}
+
+/**
+ * Replaces the sizes and offset of an entry which didn't fit into 32 bits with their values from the zip64 extra field
+ */
+static void readZip64ExtraField(zip_entry_t *entry, const uint8_t *extra, uint16_t extraLength) {
+    while(extraLength >= 4) {
+        uint16_t id = readLE2(extra);
+        uint16_t fieldLength = readLE2(extra + 2);
+        if(fieldLength > extraLength - 4)
+            return;
+        if(id == ZIP64_EXTRA_FIELD) {
+            // only the values which overflowed are present, in this order
+            const uint8_t *value = extra + 4;
+            const uint8_t *end = value + fieldLength;
+            if(entry->size == 0xFFFFFFFFu && end - value >= 8) {
+                entry->size = readLE8(value);
+                value += 8;
+            }
+            if(entry->compressedSize == 0xFFFFFFFFu && end - value >= 8) {
+                entry->compressedSize = readLE8(value);
+                value += 8;
+            }
+            if(entry->localHeaderOffset == 0xFFFFFFFFu && end - value >= 8)
+                entry->localHeaderOffset = readLE8(value);
+            return;
+        }
+        extra += 4 + fieldLength;
+        extraLength -= 4 + fieldLength;
+    }
+}
+
+/**
+ * Reads the entries from the central directory and indexes them by name
+ * @return false if the archive is malformed or memory ran out
+ */
+static bool readCentralDirectory(zip_archive_t *archive) {
+    const uint8_t *data = archive->data;
+    size_t size = archive->size;
+    const uint8_t *end = findEndOfCentralDirectory(data, size);
+    if(!end)
+        return false;
+    uint64_t numEntries = readLE2(end + 10);
+    uint64_t directorySize = readLE4(end + 12);
+    uint64_t directoryOffset = readLE4(end + 16);
+    if(numEntries == 0xFFFFu || directorySize == 0xFFFFFFFFu || directoryOffset == 0xFFFFFFFFu) {
+        // the values overflowed, so they're stored in the zip64 end of central directory record instead
+        if((size_t) (end - data) < ZIP64_LOCATOR_SIZE || readLE4(end - ZIP64_LOCATOR_SIZE) != ZIP64_LOCATOR_SIGNATURE)
+            return false;
+        uint64_t recordOffset = readLE8(end - ZIP64_LOCATOR_SIZE + 8);
+        if(size < ZIP64_END_OF_CENTRAL_DIRECTORY_SIZE || recordOffset > size - ZIP64_END_OF_CENTRAL_DIRECTORY_SIZE || readLE4(data + recordOffset) != ZIP64_END_OF_CENTRAL_DIRECTORY_SIGNATURE)
+            return false;
+        numEntries = readLE8(data + recordOffset + 32);
+        directorySize = readLE8(data + recordOffset + 40);
+        directoryOffset = readLE8(data + recordOffset + 48);
+    }
+    if(directoryOffset > size || directorySize > size - directoryOffset || numEntries > directorySize / CENTRAL_DIRECTORY_ENTRY_SIZE || numEntries > MAX_ENTRIES)
+        return false;
+    
+    uint32_t capacity = MIN_INDEX_CAPACITY;
+    while(capacity < numEntries * 2)
+        capacity *= 2;
+    archive->entries = malloc((numEntries ? numEntries : 1) * sizeof(zip_entry_t));
+    archive->index = calloc(capacity, sizeof(uint32_t));
+    if(!archive->entries || !archive->index)
+        return false;
+    archive->indexMask = capacity - 1;
+    
+    const uint8_t *record = data + directoryOffset;
+    const uint8_t *directoryEnd = record + directorySize;
+    for(uint32_t i = 0; i < numEntries; ++i) {
+        if(directoryEnd - record < CENTRAL_DIRECTORY_ENTRY_SIZE || readLE4(record) != CENTRAL_DIRECTORY_SIGNATURE)
+            return false;
+        uint16_t flags = readLE2(record + 8);
+        uint16_t nameLength = readLE2(record + 28);
+        uint16_t extraLength = readLE2(record + 30);
+        uint16_t commentLength = readLE2(record + 32);
+        size_t recordSize = CENTRAL_DIRECTORY_ENTRY_SIZE + (size_t) nameLength + extraLength + commentLength;
+        if((size_t) (directoryEnd - record) < recordSize)
+            return false;
+        
+        zip_entry_t *entry = archive->entries + i;
+        entry->name = (const char *) record + CENTRAL_DIRECTORY_ENTRY_SIZE;
+        entry->nameLength = nameLength;
+        entry->method = readLE2(record + 10);
+        entry->hash = hashName(entry->name, nameLength);
+        entry->compressedSize = readLE4(record + 20);
+        entry->size = readLE4(record + 24);
+        entry->localHeaderOffset = readLE4(record + 42);
+        readZip64ExtraField(entry, record + CENTRAL_DIRECTORY_ENTRY_SIZE + nameLength, extraLength);
+        record += recordSize;
+        
+        // encrypted entries can't be read, so they're left out of the index as if they didn't exist
+        if(flags & FLAG_ENCRYPTED)
+            continue;
+        // the first of several entries with the same name is the one which is found
+        uint32_t slot = entry->hash & archive->indexMask;
+        bool isDuplicate = false;
+        while(archive->index[slot] && !isDuplicate) {
+            zip_entry_t *other = archive->entries + archive->index[slot] - 1;
+            isDuplicate = other->hash == entry->hash && other->nameLength == nameLength && memcmp(other->name, entry->name, nameLength) == 0;
+            slot = (slot + 1) & archive->indexMask;
+        }
+        if(!isDuplicate)
+            archive->index[slot] = i + 1;
+    }
+    archive->numEntries = numEntries;
+    return true;
+}
+
+zip_archive_t *zip_open(char *path) {
+    int fd = open(path, O_RDONLY);
+    if(fd == -1)
+        return NULL;
+    struct stat s;
+    if(fstat(fd, &s) == -1 || s.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+    void *data = mmap(NULL, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED)
+        return NULL;
+    
+    zip_archive_t *archive = calloc(1, sizeof(zip_archive_t));
+    if(!archive) {
+        munmap(data, s.st_size);
+        return NULL;
+    }
+    archive->path = path;
+    archive->data = data;
+    archive->size = s.st_size;
+    if(!readCentralDirectory(archive)) {
+        free(archive->entries);
+        free(archive->index);
+        free(archive);
+        munmap(data, s.st_size);
+        return NULL;
+    }
+    return archive;
+}
+
+zip_entry_t *zip_findEntry(zip_archive_t *archive, const char *name) {
+    size_t length = strlen(name);
+    uint32_t hash = hashName(name, length);
+    for(uint32_t slot = hash & archive->indexMask; archive->index[slot]; slot = (slot + 1) & archive->indexMask) {
+        zip_entry_t *entry = archive->entries + archive->index[slot] - 1;
+        if(entry->hash == hash && entry->nameLength == length && memcmp(entry->name, name, length) == 0)
+            return entry;
+    }
+    return NULL;
+}
+
+const uint8_t *zip_readEntry(zip_archive_t *archive, zip_entry_t *entry) {
+    // the local header repeats most of the central directory entry, but its name and extra field can differ in length
+    uint64_t offset = entry->localHeaderOffset;
+    if(archive->size < LOCAL_HEADER_SIZE || offset > archive->size - LOCAL_HEADER_SIZE || readLE4(archive->data + offset) != LOCAL_HEADER_SIGNATURE)
+        return NULL;
+    uint64_t dataOffset = offset + LOCAL_HEADER_SIZE + readLE2(archive->data + offset + 26) + readLE2(archive->data + offset + 28);
+    if(dataOffset > archive->size || entry->compressedSize > archive->size - dataOffset)
+        return NULL;
+    const uint8_t *compressed = archive->data + dataOffset;
+    
+    if(entry->method == ZIP_STORED)
+        return entry->compressedSize == entry->size ? compressed : NULL;
+    if(entry->method != ZIP_DEFLATED || entry->size > SIZE_MAX)
+        return NULL;
+    uint8_t *contents = malloc(entry->size ? entry->size : 1);
+    if(!contents)
+        return NULL;
+    if(!inflateData(compressed, entry->compressedSize, contents, entry->size)) {
+        free(contents);
+        return NULL;
+    }
+    return contents;
+}
+
+void zip_releaseEntry(zip_entry_t *entry, const uint8_t *contents) {
+    if(entry->method != ZIP_STORED)
+        free((void *) contents);
+}
@@ -0,0 +1,64 @@
+#ifndef JVM_ZIP_H
+#define JVM_ZIP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct zip_entry {
+    const char *name; // points into the central directory, so it isn't null terminated
+    uint16_t nameLength;
+    uint16_t method; // ZIP_STORED or ZIP_DEFLATED
+    uint32_t hash;
+    uint64_t compressedSize;
+    uint64_t size;
+    uint64_t localHeaderOffset;
+} zip_entry_t;
+
+#define ZIP_STORED 0
+#define ZIP_DEFLATED 8
+
+// A zip or jar file which is mapped into memory as a whole. Its central directory is read once into an open addressing
+// index of the entry names, so finding an entry takes a single hash probe no matter how many entries there are
+typedef struct zip_archive {
+    char *path;
+    const uint8_t *data;
+    size_t size;
+    uint32_t numEntries;
+    zip_entry_t *entries;
+    uint32_t indexMask; // the index has indexMask + 1 slots, a power of 2 at least twice the number of entries
+    uint32_t *index; // index + 1 of the entry in each slot or 0 if the slot is empty
+} zip_archive_t;
+
+/**
+ * Maps an archive and indexes its central directory
+ * @param path
+ * @return the archive or NULL if it couldn't be read or isn't a zip file
+ */
+zip_archive_t *zip_open(char *path);
+
+/**
+ * @param archive
+ * @param name the name of the entry, such as java/lang/Object.class
+ * @return the entry or NULL if the archive doesn't contain it
+ */
+zip_entry_t *zip_findEntry(zip_archive_t *archive, const char *name);
+
+/**
+ * Gets the contents of an entry. Stored entries are returned straight from the mapped archive while deflated entries
+ * are decompressed into a new buffer
+ * @param archive
+ * @param entry
+ * @return the contents, which must be given to zip_releaseEntry once they aren't used anymore, or NULL if the entry is
+ * malformed, compressed with an unsupported method, or memory ran out
+ */
+const uint8_t *zip_readEntry(zip_archive_t *archive, zip_entry_t *entry);
+
+/**
+ * Frees the contents of an entry if they were decompressed
+ * @param entry
+ * @param contents returned by zip_readEntry
+ */
+void zip_releaseEntry(zip_entry_t *entry, const uint8_t *contents);
+
+#endif //JVM_ZIP_H